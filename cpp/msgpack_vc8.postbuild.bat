@@ -2,6 +2,8 @@ IF NOT EXIST include                  MKDIR include
 IF NOT EXIST include\msgpack          MKDIR include\msgpack
 IF NOT EXIST include\msgpack\type     MKDIR include\msgpack\type
 IF NOT EXIST include\msgpack\type\tr1 MKDIR include\msgpack\type\tr1
+IF NOT EXIST include\msgpack\type\cpp11 MKDIR include\msgpack\type\cpp11
+IF NOT EXIST include\msgpack\type\cpp17 MKDIR include\msgpack\type\cpp17
 copy src\msgpack\pack_define.h      include\msgpack\
 copy src\msgpack\pack_template.h    include\msgpack\
 copy src\msgpack\unpack_define.h    include\msgpack\
@@ -16,6 +18,18 @@ copy src\msgpack\pack.h                include\msgpack\
 copy src\msgpack\unpack.h              include\msgpack\
 copy src\msgpack\object.h              include\msgpack\
 copy src\msgpack\zone.h                include\msgpack\
+copy src\msgpack\compact.h             include\msgpack\
+copy src\msgpack\hash.h                include\msgpack\
+copy src\msgpack\struct.h              include\msgpack\
+copy src\msgpack\json.h                include\msgpack\
+copy src\msgpack\zunpacker.h           include\msgpack\
+copy src\msgpack\codec.h               include\msgpack\
+copy src\msgpack\cbuffer.h             include\msgpack\
+copy src\msgpack\cunpacker.h           include\msgpack\
+copy src\msgpack\pzbuffer.h            include\msgpack\
+copy src\msgpack\zerocopy.h            include\msgpack\
+copy src\msgpack\mbuffer.h             include\msgpack\
+copy src\msgpack\mreader.h             include\msgpack\
 copy src\msgpack.hpp                   include\
 copy src\msgpack\sbuffer.hpp           include\msgpack\
 copy src\msgpack\vrefbuffer.hpp        include\msgpack\
@@ -24,6 +38,18 @@ copy src\msgpack\pack.hpp              include\msgpack\
 copy src\msgpack\unpack.hpp            include\msgpack\
 copy src\msgpack\object.hpp            include\msgpack\
 copy src\msgpack\zone.hpp              include\msgpack\
+copy src\msgpack\compact.hpp           include\msgpack\
+copy src\msgpack\map_index.hpp         include\msgpack\
+copy src\msgpack\visitor.hpp           include\msgpack\
+copy src\msgpack\decode.hpp            include\msgpack\
+copy src\msgpack\json.hpp              include\msgpack\
+copy src\msgpack\zunpacker.hpp         include\msgpack\
+copy src\msgpack\cbuffer.hpp           include\msgpack\
+copy src\msgpack\cunpacker.hpp         include\msgpack\
+copy src\msgpack\pzbuffer.hpp          include\msgpack\
+copy src\msgpack\zerocopy.hpp          include\msgpack\
+copy src\msgpack\mbuffer.hpp           include\msgpack\
+copy src\msgpack\mreader.hpp           include\msgpack\
 copy src\msgpack\type.hpp              include\msgpack\type\
 copy src\msgpack\type\bool.hpp         include\msgpack\type\
 copy src\msgpack\type\float.hpp        include\msgpack\type\
@@ -31,6 +57,8 @@ copy src\msgpack\type\int.hpp          include\msgpack\type\
 copy src\msgpack\type\list.hpp         include\msgpack\type\
 copy src\msgpack\type\deque.hpp        include\msgpack\type\
 copy src\msgpack\type\map.hpp          include\msgpack\type\
+copy src\msgpack\type\flat_map.hpp     include\msgpack\type\
+copy src\msgpack\type\flat_set.hpp     include\msgpack\type\
 copy src\msgpack\type\nil.hpp          include\msgpack\type\
 copy src\msgpack\type\pair.hpp         include\msgpack\type\
 copy src\msgpack\type\raw.hpp          include\msgpack\type\
@@ -41,4 +69,7 @@ copy src\msgpack\type\tuple.hpp        include\msgpack\type\
 copy src\msgpack\type\define.hpp       include\msgpack\type\
 copy src\msgpack\type\tr1\unordered_map.hpp  include\msgpack\type\
 copy src\msgpack\type\tr1\unordered_set.hpp  include\msgpack\type\
+copy src\msgpack\type\cpp11\unordered_map.hpp  include\msgpack\type\cpp11\
+copy src\msgpack\type\cpp11\unordered_set.hpp  include\msgpack\type\cpp11\
+copy src\msgpack\type\cpp17\string_view.hpp    include\msgpack\type\cpp17\
 
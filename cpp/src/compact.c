@@ -0,0 +1,424 @@
+/*
+ * MessagePack for C compact object tree
+ *
+ * Copyright (C) 2008-2010 FURUHASHI Sadayuki
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+#include "msgpack/compact.h"
+#include "msgpack/unpack_define.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define COMPACT_ALIGN 8
+#define COMPACT_MAX_SIZE ((size_t)0xffffffff)
+
+static bool compact_expand(msgpack_compact* c, size_t size)
+{
+	size_t nsize = (c->alloc) ? c->alloc * 2 : MSGPACK_COMPACT_INIT_SIZE;
+	while(nsize < c->used + size) { nsize *= 2; }
+
+	char* tmp = (char*)realloc(c->data, nsize);
+	if(tmp == NULL) {
+		return false;
+	}
+
+	c->data = tmp;
+	c->alloc = nsize;
+	return true;
+}
+
+static inline bool compact_malloc(msgpack_compact* c, size_t size, size_t align, uint32_t* off)
+{
+	size_t used = (c->used + (align-1)) & ~(align-1);
+	if(used + size > COMPACT_MAX_SIZE) {
+		return false;
+	}
+	if(c->alloc < used + size) {
+		c->used = used;
+		if(!compact_expand(c, size)) {
+			return false;
+		}
+	}
+	*off = (uint32_t)used;
+	c->used = used + size;
+	return true;
+}
+
+static inline msgpack_compact_object* compact_at(msgpack_compact* c, uint32_t off)
+{
+	return (msgpack_compact_object*)(c->data + off);
+}
+
+static inline int compact_raw(msgpack_compact* c, const char* p, uint32_t l,
+		msgpack_compact_object* o)
+{
+	o->size = l;
+	if(l <= MSGPACK_COMPACT_INLINE_RAW) {
+		o->head = MSGPACK_OBJECT_RAW | MSGPACK_COMPACT_INLINE;
+		o->via.u64 = 0;
+		memcpy(o->via.raw, p, l);
+	} else {
+		o->head = MSGPACK_OBJECT_RAW;
+		if(!compact_malloc(c, l, 1, &o->via.off)) { return -1; }
+		memcpy(c->data + o->via.off, p, l);
+	}
+	return 0;
+}
+
+static inline int compact_container(msgpack_compact* c, msgpack_object_type type,
+		size_t nnodes, msgpack_compact_object* o)
+{
+	o->head = type;
+	o->size = 0;
+	o->via.u64 = 0;
+	if(nnodes == 0) { return 0; }
+	if(!compact_malloc(c, nnodes*sizeof(msgpack_compact_object),
+				COMPACT_ALIGN, &o->via.off)) {
+		return -1;
+	}
+	return 0;
+}
+
+
+typedef struct {
+	msgpack_compact* c;
+} compact_user;
+
+
+#define msgpack_unpack_struct(name) \
+	struct compact_template ## name
+
+#define msgpack_unpack_func(ret, name) \
+	ret compact_template ## name
+
+#define msgpack_unpack_callback(name) \
+	compact_template_callback ## name
+
+#define msgpack_unpack_object msgpack_compact_object
+
+#define msgpack_unpack_user compact_user
+
+
+struct compact_template_context;
+typedef struct compact_template_context compact_template_context;
+
+static void compact_template_init(compact_template_context* ctx);
+
+static msgpack_compact_object compact_template_data(compact_template_context* ctx);
+
+static int compact_template_execute(compact_template_context* ctx,
+		const char* data, size_t len, size_t* off);
+
+
+static inline msgpack_compact_object compact_template_callback_root(compact_user* u)
+{ msgpack_compact_object o = {}; return o; }
+
+static inline int compact_template_callback_uint8(compact_user* u, uint8_t d, msgpack_compact_object* o)
+{ o->head = MSGPACK_OBJECT_POSITIVE_INTEGER; o->size = 0; o->via.u64 = d; return 0; }
+
+static inline int compact_template_callback_uint16(compact_user* u, uint16_t d, msgpack_compact_object* o)
+{ o->head = MSGPACK_OBJECT_POSITIVE_INTEGER; o->size = 0; o->via.u64 = d; return 0; }
+
+static inline int compact_template_callback_uint32(compact_user* u, uint32_t d, msgpack_compact_object* o)
+{ o->head = MSGPACK_OBJECT_POSITIVE_INTEGER; o->size = 0; o->via.u64 = d; return 0; }
+
+static inline int compact_template_callback_uint64(compact_user* u, uint64_t d, msgpack_compact_object* o)
+{ o->head = MSGPACK_OBJECT_POSITIVE_INTEGER; o->size = 0; o->via.u64 = d; return 0; }
+
+static inline int compact_template_callback_int64(compact_user* u, int64_t d, msgpack_compact_object* o)
+{
+	o->size = 0;
+	if(d >= 0) { o->head = MSGPACK_OBJECT_POSITIVE_INTEGER; o->via.u64 = d; }
+	else { o->head = MSGPACK_OBJECT_NEGATIVE_INTEGER; o->via.i64 = d; }
+	return 0;
+}
+
+static inline int compact_template_callback_int8(compact_user* u, int8_t d, msgpack_compact_object* o)
+{ return compact_template_callback_int64(u, d, o); }
+
+static inline int compact_template_callback_int16(compact_user* u, int16_t d, msgpack_compact_object* o)
+{ return compact_template_callback_int64(u, d, o); }
+
+static inline int compact_template_callback_int32(compact_user* u, int32_t d, msgpack_compact_object* o)
+{ return compact_template_callback_int64(u, d, o); }
+
+static inline int compact_template_callback_float(compact_user* u, float d, msgpack_compact_object* o)
+{ o->head = MSGPACK_OBJECT_DOUBLE; o->size = 0; o->via.dec = d; return 0; }
+
+static inline int compact_template_callback_double(compact_user* u, double d, msgpack_compact_object* o)
+{ o->head = MSGPACK_OBJECT_DOUBLE; o->size = 0; o->via.dec = d; return 0; }
+
+static inline int compact_template_callback_nil(compact_user* u, msgpack_compact_object* o)
+{ o->head = MSGPACK_OBJECT_NIL; o->size = 0; o->via.u64 = 0; return 0; }
+
+static inline int compact_template_callback_true(compact_user* u, msgpack_compact_object* o)
+{ o->head = MSGPACK_OBJECT_BOOLEAN; o->size = 0; o->via.u64 = 0; o->via.boolean = true; return 0; }
+
+static inline int compact_template_callback_false(compact_user* u, msgpack_compact_object* o)
+{ o->head = MSGPACK_OBJECT_BOOLEAN; o->size = 0; o->via.u64 = 0; o->via.boolean = false; return 0; }
+
+static inline int compact_template_callback_array(compact_user* u, unsigned int n, msgpack_compact_object* o)
+{ return compact_container(u->c, MSGPACK_OBJECT_ARRAY, n, o); }
+
+static inline int compact_template_callback_array_item(compact_user* u, msgpack_compact_object* c, msgpack_compact_object o)
+{ compact_at(u->c, c->via.off)[c->size++] = o; return 0; }
+
+static inline int compact_template_callback_map(compact_user* u, unsigned int n, msgpack_compact_object* o)
+{ return compact_container(u->c, MSGPACK_OBJECT_MAP, (size_t)n*2, o); }
+
+static inline int compact_template_callback_map_item(compact_user* u, msgpack_compact_object* c, msgpack_compact_object k, msgpack_compact_object v)
+{
+	msgpack_compact_object* kv = compact_at(u->c, c->via.off) + c->size*2;
+	kv[0] = k;
+	kv[1] = v;
+	++c->size;
+	return 0;
+}
+
+static inline int compact_template_callback_raw(compact_user* u, const char* b, const char* p, unsigned int l, msgpack_compact_object* o)
+{ return compact_raw(u->c, p, l, o); }
+
+#include "msgpack/unpack_template.h"
+
+
+bool msgpack_compact_init(msgpack_compact* c, size_t init_size)
+{
+	c->used = 0;
+	c->alloc = init_size;
+	c->data = (char*)malloc(init_size);
+	if(c->data == NULL) {
+		return false;
+	}
+	return true;
+}
+
+void msgpack_compact_destroy(msgpack_compact* c)
+{
+	free(c->data);
+}
+
+msgpack_compact* msgpack_compact_new(size_t init_size)
+{
+	msgpack_compact* c = (msgpack_compact*)malloc(sizeof(msgpack_compact));
+	if(c == NULL) {
+		return NULL;
+	}
+	if(!msgpack_compact_init(c, init_size)) {
+		free(c);
+		return NULL;
+	}
+	return c;
+}
+
+void msgpack_compact_free(msgpack_compact* c)
+{
+	if(c == NULL) { return; }
+	msgpack_compact_destroy(c);
+	free(c);
+}
+
+static bool compact_push_root(msgpack_compact* c,
+		msgpack_compact_object o, uint32_t* root)
+{
+	if(!compact_malloc(c, sizeof(msgpack_compact_object), COMPACT_ALIGN, root)) {
+		return false;
+	}
+	*compact_at(c, *root) = o;
+	return true;
+}
+
+msgpack_unpack_return
+msgpack_compact_unpack(msgpack_compact* c,
+		const char* data, size_t len, size_t* off, uint32_t* root)
+{
+	size_t noff = 0;
+	if(off != NULL) { noff = *off; }
+
+	if(len <= noff) {
+		return MSGPACK_UNPACK_CONTINUE;
+	}
+
+	const size_t used = c->used;
+
+	compact_template_context ctx;
+	compact_template_init(&ctx);
+	ctx.user.c = c;
+
+	int e = compact_template_execute(&ctx, data, len, &noff);
+	if(e <= 0) {
+		c->used = used;
+		return (e < 0) ? MSGPACK_UNPACK_PARSE_ERROR : MSGPACK_UNPACK_CONTINUE;
+	}
+
+	if(!compact_push_root(c, compact_template_data(&ctx), root)) {
+		c->used = used;
+		return MSGPACK_UNPACK_PARSE_ERROR;
+	}
+
+	if(off != NULL) { *off = noff; }
+
+	if(noff < len) {
+		return MSGPACK_UNPACK_EXTRA_BYTES;
+	}
+
+	return MSGPACK_UNPACK_SUCCESS;
+}
+
+
+static bool compact_copy_object(msgpack_compact* c, msgpack_object o, uint32_t to)
+{
+	msgpack_compact_object n;
+	n.size = 0;
+	n.via.u64 = 0;
+
+	switch(o.type) {
+	case MSGPACK_OBJECT_NIL:
+	case MSGPACK_OBJECT_BOOLEAN:
+	case MSGPACK_OBJECT_POSITIVE_INTEGER:
+	case MSGPACK_OBJECT_NEGATIVE_INTEGER:
+	case MSGPACK_OBJECT_DOUBLE:
+		n.head = o.type;
+		n.via.u64 = o.via.u64;
+		if(o.type == MSGPACK_OBJECT_BOOLEAN) {
+			n.via.u64 = 0;
+			n.via.boolean = o.via.boolean;
+		}
+		break;
+
+	case MSGPACK_OBJECT_RAW:
+		if(compact_raw(c, o.via.raw.ptr, o.via.raw.size, &n) < 0) {
+			return false;
+		}
+		break;
+
+	case MSGPACK_OBJECT_ARRAY:
+		if(compact_container(c, MSGPACK_OBJECT_ARRAY, o.via.array.size, &n) < 0) {
+			return false;
+		}
+		for(; n.size < o.via.array.size; ++n.size) {
+			if(!compact_copy_object(c, o.via.array.ptr[n.size],
+					n.via.off + n.size*sizeof(msgpack_compact_object))) {
+				return false;
+			}
+		}
+		break;
+
+	case MSGPACK_OBJECT_MAP:
+		if(compact_container(c, MSGPACK_OBJECT_MAP, (size_t)o.via.map.size*2, &n) < 0) {
+			return false;
+		}
+		for(; n.size < o.via.map.size; ++n.size) {
+			uint32_t k = n.via.off + n.size*2*sizeof(msgpack_compact_object);
+			if(!compact_copy_object(c, o.via.map.ptr[n.size].key, k) ||
+					!compact_copy_object(c, o.via.map.ptr[n.size].val,
+						k + sizeof(msgpack_compact_object))) {
+				return false;
+			}
+		}
+		break;
+
+	default:
+		return false;
+	}
+
+	*compact_at(c, to) = n;
+	return true;
+}
+
+bool msgpack_compact_from_object(msgpack_compact* c,
+		msgpack_object o, uint32_t* root)
+{
+	const size_t used = c->used;
+	if(!compact_malloc(c, sizeof(msgpack_compact_object), COMPACT_ALIGN, root) ||
+			!compact_copy_object(c, o, *root)) {
+		c->used = used;
+		return false;
+	}
+	return true;
+}
+
+
+static bool compact_expand_object(const msgpack_compact* c,
+		const msgpack_compact_object* n, msgpack_zone* z, msgpack_object* o)
+{
+	o->type = msgpack_compact_type(n);
+
+	switch(o->type) {
+	case MSGPACK_OBJECT_NIL:
+		o->via.u64 = 0;
+		return true;
+
+	case MSGPACK_OBJECT_BOOLEAN:
+		o->via.boolean = n->via.boolean;
+		return true;
+
+	case MSGPACK_OBJECT_POSITIVE_INTEGER:
+	case MSGPACK_OBJECT_NEGATIVE_INTEGER:
+	case MSGPACK_OBJECT_DOUBLE:
+		o->via.u64 = n->via.u64;
+		return true;
+
+	case MSGPACK_OBJECT_RAW:
+		o->via.raw.size = n->size;
+		o->via.raw.ptr = msgpack_compact_raw(c, n);
+		return true;
+
+	case MSGPACK_OBJECT_ARRAY:
+		o->via.array.size = n->size;
+		o->via.array.ptr = NULL;
+		if(n->size != 0) {
+			const msgpack_compact_object* e = msgpack_compact_elements(c, n);
+			msgpack_object* p = (msgpack_object*)msgpack_zone_malloc(z,
+					n->size*sizeof(msgpack_object));
+			if(p == NULL) { return false; }
+			o->via.array.ptr = p;
+			uint32_t i;
+			for(i = 0; i < n->size; ++i) {
+				if(!compact_expand_object(c, e+i, z, p+i)) {
+					return false;
+				}
+			}
+		}
+		return true;
+
+	case MSGPACK_OBJECT_MAP:
+		o->via.map.size = n->size;
+		o->via.map.ptr = NULL;
+		if(n->size != 0) {
+			const msgpack_compact_object* e = msgpack_compact_elements(c, n);
+			msgpack_object_kv* p = (msgpack_object_kv*)msgpack_zone_malloc(z,
+					n->size*sizeof(msgpack_object_kv));
+			if(p == NULL) { return false; }
+			o->via.map.ptr = p;
+			uint32_t i;
+			for(i = 0; i < n->size; ++i) {
+				if(!compact_expand_object(c, e+i*2, z, &p[i].key) ||
+						!compact_expand_object(c, e+i*2+1, z, &p[i].val)) {
+					return false;
+				}
+			}
+		}
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+bool msgpack_compact_to_object(const msgpack_compact* c, uint32_t node,
+		msgpack_zone* z, msgpack_object* result)
+{
+	return compact_expand_object(c, msgpack_compact_node(c, node), z, result);
+}
+
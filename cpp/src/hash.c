@@ -0,0 +1,331 @@
+/*
+ * MessagePack for C hash functions
+ *
+ * Copyright (C) 2008-2010 FURUHASHI Sadayuki
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+#include "msgpack/hash.h"
+#include "msgpack/unpack_define.h"
+#include <string.h>
+
+/*
+ * The byte hash is a variant of wyhash: input words are combined with
+ * a 64x64->128 bit multiplication and the halves are folded by xor.
+ */
+#define HASH_P0 0xa0761d6478bd642fULL
+#define HASH_P1 0xe7037ed1a0b428dbULL
+#define HASH_P2 0x8ebc6af09c88c6e3ULL
+#define HASH_P3 0x589965cc75374cc3ULL
+
+#define HASH_SEED 0x2d358dccaa6c78a5ULL
+
+static inline void hash_mum(uint64_t* a, uint64_t* b)
+{
+#if defined(__SIZEOF_INT128__)
+	__uint128_t r = (__uint128_t)*a * *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32;
+	uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32);
+	uint64_t c = t < rl;
+	uint64_t lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t hash_mix(uint64_t a, uint64_t b)
+{
+	hash_mum(&a, &b);
+	return a ^ b;
+}
+
+/* little endian loads; compilers merge them into one load */
+static inline uint64_t hash_load64(const uint8_t* p)
+{
+	return (uint64_t)p[0]       | (uint64_t)p[1] << 8  |
+	       (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24 |
+	       (uint64_t)p[4] << 32 | (uint64_t)p[5] << 40 |
+	       (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+}
+
+static inline uint64_t hash_load32(const uint8_t* p)
+{
+	return (uint64_t)p[0]       | (uint64_t)p[1] << 8  |
+	       (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24;
+}
+
+uint64_t msgpack_hash_bytes(const void* data, size_t len, uint64_t seed)
+{
+	const uint8_t* p = (const uint8_t*)data;
+	uint64_t a, b;
+
+	seed ^= hash_mix(seed ^ HASH_P0, HASH_P1);
+
+	if(len <= 16) {
+		if(len >= 4) {
+			const size_t d = (len >> 3) << 2;
+			a = (hash_load32(p) << 32) | hash_load32(p + d);
+			b = (hash_load32(p + len - 4) << 32) | hash_load32(p + len - 4 - d);
+		} else if(len > 0) {
+			a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		size_t i = len;
+		if(i > 48) {
+			uint64_t see1 = seed, see2 = seed;
+			do {
+				seed = hash_mix(hash_load64(p)      ^ HASH_P1, hash_load64(p + 8)  ^ seed);
+				see1 = hash_mix(hash_load64(p + 16) ^ HASH_P2, hash_load64(p + 24) ^ see1);
+				see2 = hash_mix(hash_load64(p + 32) ^ HASH_P3, hash_load64(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while(i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while(i > 16) {
+			seed = hash_mix(hash_load64(p) ^ HASH_P1, hash_load64(p + 8) ^ seed);
+			p += 16;
+			i -= 16;
+		}
+		a = hash_load64(p + i - 16);
+		b = hash_load64(p + i - 8);
+	}
+
+	a ^= HASH_P1;
+	b ^= seed;
+	hash_mum(&a, &b);
+	return hash_mix(a ^ HASH_P0 ^ len, b ^ HASH_P1);
+}
+
+
+/*
+ * An object is hashed by folding its nodes in pre-order. Each node
+ * contributes its type and a 64-bit value: the value of a scalar,
+ * the number of elements of a container or the hash of a raw.
+ * Since deserialization normalizes integers and floats, hashing the
+ * serialized form with the same folding gives the same result.
+ */
+static inline uint64_t hash_fold(uint64_t h, msgpack_object_type type, uint64_t v)
+{
+	return hash_mix(h ^ (HASH_P0 * ((uint64_t)type + 1)), v ^ HASH_P1);
+}
+
+static inline uint64_t hash_double(double d)
+{
+	/* 0.0 == -0.0 */
+	union { double f; uint64_t i; } mem;
+	if(d == 0) { return 0; }
+	mem.f = d;
+	return mem.i;
+}
+
+static inline uint64_t hash_raw(const char* p, uint32_t l)
+{
+	return msgpack_hash_bytes(p, l, HASH_SEED);
+}
+
+static uint64_t hash_object(uint64_t h, msgpack_object o)
+{
+	switch(o.type) {
+	case MSGPACK_OBJECT_NIL:
+		return hash_fold(h, o.type, 0);
+
+	case MSGPACK_OBJECT_BOOLEAN:
+		return hash_fold(h, o.type, o.via.boolean ? 1 : 0);
+
+	case MSGPACK_OBJECT_POSITIVE_INTEGER:
+	case MSGPACK_OBJECT_NEGATIVE_INTEGER:
+		return hash_fold(h, o.type, o.via.u64);
+
+	case MSGPACK_OBJECT_DOUBLE:
+		return hash_fold(h, o.type, hash_double(o.via.dec));
+
+	case MSGPACK_OBJECT_RAW:
+		return hash_fold(h, o.type, hash_raw(o.via.raw.ptr, o.via.raw.size));
+
+	case MSGPACK_OBJECT_ARRAY:
+		{
+			msgpack_object* p = o.via.array.ptr;
+			msgpack_object* const pend = o.via.array.ptr + o.via.array.size;
+			h = hash_fold(h, o.type, o.via.array.size);
+			for(; p < pend; ++p) {
+				h = hash_object(h, *p);
+			}
+			return h;
+		}
+
+	case MSGPACK_OBJECT_MAP:
+		{
+			msgpack_object_kv* p = o.via.map.ptr;
+			msgpack_object_kv* const pend = o.via.map.ptr + o.via.map.size;
+			h = hash_fold(h, o.type, o.via.map.size);
+			for(; p < pend; ++p) {
+				h = hash_object(h, p->key);
+				h = hash_object(h, p->val);
+			}
+			return h;
+		}
+
+	default:
+		return hash_fold(h, o.type, o.via.u64);
+	}
+}
+
+uint64_t msgpack_object_hash(const msgpack_object o)
+{
+	return hash_mix(hash_object(HASH_SEED, o), HASH_P2);
+}
+
+
+typedef struct {
+	uint64_t h;
+} hash_user;
+
+typedef char hash_object_t;
+
+
+#define msgpack_unpack_struct(name) \
+	struct hash_template ## name
+
+#define msgpack_unpack_func(ret, name) \
+	static inline ret hash_template ## name
+
+#define msgpack_unpack_callback(name) \
+	hash_template_callback ## name
+
+#define msgpack_unpack_object hash_object_t
+
+#define msgpack_unpack_user hash_user
+
+
+struct hash_template_context;
+typedef struct hash_template_context hash_template_context;
+
+static void hash_template_init(hash_template_context* ctx);
+
+static int hash_template_execute(hash_template_context* ctx,
+		const char* data, size_t len, size_t* off);
+
+
+#define HASH_FOLD(type, v) \
+	u->h = hash_fold(u->h, type, v)
+
+static inline hash_object_t hash_template_callback_root(hash_user* u)
+{ return 0; }
+
+static inline int hash_template_callback_uint8(hash_user* u, uint8_t d, hash_object_t* o)
+{ *o = 0; HASH_FOLD(MSGPACK_OBJECT_POSITIVE_INTEGER, d); return 0; }
+
+static inline int hash_template_callback_uint16(hash_user* u, uint16_t d, hash_object_t* o)
+{ *o = 0; HASH_FOLD(MSGPACK_OBJECT_POSITIVE_INTEGER, d); return 0; }
+
+static inline int hash_template_callback_uint32(hash_user* u, uint32_t d, hash_object_t* o)
+{ *o = 0; HASH_FOLD(MSGPACK_OBJECT_POSITIVE_INTEGER, d); return 0; }
+
+static inline int hash_template_callback_uint64(hash_user* u, uint64_t d, hash_object_t* o)
+{ *o = 0; HASH_FOLD(MSGPACK_OBJECT_POSITIVE_INTEGER, d); return 0; }
+
+static inline int hash_template_callback_int64(hash_user* u, int64_t d, hash_object_t* o)
+{
+	*o = 0;
+	if(d >= 0) { HASH_FOLD(MSGPACK_OBJECT_POSITIVE_INTEGER, (uint64_t)d); }
+	else { HASH_FOLD(MSGPACK_OBJECT_NEGATIVE_INTEGER, (uint64_t)d); }
+	return 0;
+}
+
+static inline int hash_template_callback_int8(hash_user* u, int8_t d, hash_object_t* o)
+{ return hash_template_callback_int64(u, d, o); }
+
+static inline int hash_template_callback_int16(hash_user* u, int16_t d, hash_object_t* o)
+{ return hash_template_callback_int64(u, d, o); }
+
+static inline int hash_template_callback_int32(hash_user* u, int32_t d, hash_object_t* o)
+{ return hash_template_callback_int64(u, d, o); }
+
+static inline int hash_template_callback_float(hash_user* u, float d, hash_object_t* o)
+{ *o = 0; HASH_FOLD(MSGPACK_OBJECT_DOUBLE, hash_double(d)); return 0; }
+
+static inline int hash_template_callback_double(hash_user* u, double d, hash_object_t* o)
+{ *o = 0; HASH_FOLD(MSGPACK_OBJECT_DOUBLE, hash_double(d)); return 0; }
+
+static inline int hash_template_callback_nil(hash_user* u, hash_object_t* o)
+{ *o = 0; HASH_FOLD(MSGPACK_OBJECT_NIL, 0); return 0; }
+
+static inline int hash_template_callback_true(hash_user* u, hash_object_t* o)
+{ *o = 0; HASH_FOLD(MSGPACK_OBJECT_BOOLEAN, 1); return 0; }
+
+static inline int hash_template_callback_false(hash_user* u, hash_object_t* o)
+{ *o = 0; HASH_FOLD(MSGPACK_OBJECT_BOOLEAN, 0); return 0; }
+
+static inline int hash_template_callback_array(hash_user* u, unsigned int n, hash_object_t* o)
+{ *o = 0; HASH_FOLD(MSGPACK_OBJECT_ARRAY, n); return 0; }
+
+static inline int hash_template_callback_array_item(hash_user* u, hash_object_t* c, hash_object_t o)
+{ return 0; }
+
+static inline int hash_template_callback_map(hash_user* u, unsigned int n, hash_object_t* o)
+{ *o = 0; HASH_FOLD(MSGPACK_OBJECT_MAP, n); return 0; }
+
+static inline int hash_template_callback_map_item(hash_user* u, hash_object_t* c, hash_object_t k, hash_object_t v)
+{ return 0; }
+
+static inline int hash_template_callback_raw(hash_user* u, const char* b, const char* p, unsigned int l, hash_object_t* o)
+{ *o = 0; HASH_FOLD(MSGPACK_OBJECT_RAW, hash_raw(p, l)); return 0; }
+
+#include "msgpack/unpack_template.h"
+
+
+msgpack_unpack_return
+msgpack_hash_encoded(const char* data, size_t len, size_t* off,
+		uint64_t* result)
+{
+	size_t noff = 0;
+	if(off != NULL) { noff = *off; }
+
+	if(len <= noff) {
+		return MSGPACK_UNPACK_CONTINUE;
+	}
+
+	hash_template_context ctx;
+	hash_template_init(&ctx);
+	ctx.user.h = HASH_SEED;
+
+	int e = hash_template_execute(&ctx, data, len, &noff);
+	if(e < 0) {
+		return MSGPACK_UNPACK_PARSE_ERROR;
+	}
+
+	if(off != NULL) { *off = noff; }
+
+	if(e == 0) {
+		return MSGPACK_UNPACK_CONTINUE;
+	}
+
+	*result = hash_mix(ctx.user.h, HASH_P2);
+
+	if(noff < len) {
+		return MSGPACK_UNPACK_EXTRA_BYTES;
+	}
+
+	return MSGPACK_UNPACK_SUCCESS;
+}
+
@@ -0,0 +1,973 @@
+/*
+ * MessagePack for C JSON transcoder
+ *
+ * Copyright (C) 2008-2010 FURUHASHI Sadayuki
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+#include "msgpack/json.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define JSON_SSE2
+#define JSON_CTZ(x) __builtin_ctz(x)
+#elif defined(_MSC_VER) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#include <intrin.h>
+#define JSON_SSE2
+static __inline unsigned int JSON_CTZ(unsigned int x)
+{
+	unsigned long i;
+	_BitScanForward(&i, x);
+	return i;
+}
+#endif
+
+/*
+ * Functions return 1 on success, 0 if the data is insufficient, -1 if
+ * the data is broken and -2 if memory allocation or the output failed.
+ */
+#define JSON_NOMEM -2
+
+static msgpack_unpack_return json_return(int ret)
+{
+	switch(ret) {
+	case 0:  return MSGPACK_UNPACK_CONTINUE;
+	case -1: return MSGPACK_UNPACK_PARSE_ERROR;
+	default: return MSGPACK_UNPACK_NOMEM_ERROR;
+	}
+}
+
+
+/*
+ * Characters which are escaped in JSON strings, and the characters
+ * following the backslash of their escape sequences.
+ * They are also the special characters of JSON strings to the parser.
+ */
+static const char json_escape[256] = {
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+	0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+};
+
+static const char json_hex[] = "0123456789abcdef";
+
+/* returns the first character to be escaped, or the end */
+static inline const char* find_escape(const char* p, const char* end)
+{
+#ifdef JSON_SSE2
+	/* 16 bytes at a time: '"', '\\', or less than 0x20 */
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i bslash = _mm_set1_epi8('\\');
+	const __m128i ctrl = _mm_set1_epi8(0x1f);
+	while(end - p >= 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)p);
+		const __m128i m = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)),
+				_mm_cmpeq_epi8(_mm_min_epu8(v, ctrl), v));
+		const unsigned int mask = (unsigned int)_mm_movemask_epi8(m);
+		if(mask != 0) { return p + JSON_CTZ(mask); }
+		p += 16;
+	}
+#endif
+	for(; p < end; ++p) {
+		if(json_escape[(unsigned char)*p]) { break; }
+	}
+	return p;
+}
+
+
+/*
+ * Output is buffered, so that the callback is called per 4KB rather
+ * than per token.
+ */
+#define JSON_WRITER_SIZE 4096
+
+typedef struct json_writer {
+	char* p;
+	void* data;
+	msgpack_packer_write callback;
+	char buf[JSON_WRITER_SIZE];
+} json_writer;
+
+static int writer_flush(json_writer* w)
+{
+	const unsigned int n = (unsigned int)(w->p - w->buf);
+	w->p = w->buf;
+	if(n == 0) { return 1; }
+	return (*w->callback)(w->data, w->buf, n) < 0 ? JSON_NOMEM : 1;
+}
+
+/* makes room for a token of n bytes; n is small */
+static inline int writer_reserve(json_writer* w, size_t n)
+{
+	if((size_t)(w->buf + JSON_WRITER_SIZE - w->p) >= n) { return 1; }
+	return writer_flush(w);
+}
+
+static int writer_write(json_writer* w, const char* ptr, size_t n)
+{
+	if((size_t)(w->buf + JSON_WRITER_SIZE - w->p) < n) {
+		if(writer_flush(w) < 0) { return JSON_NOMEM; }
+		if(n >= JSON_WRITER_SIZE / 2) {
+			return (*w->callback)(w->data, ptr, (unsigned int)n) < 0 ? JSON_NOMEM : 1;
+		}
+	}
+	memcpy(w->p, ptr, n);
+	w->p += n;
+	return 1;
+}
+
+static inline void writer_put(json_writer* w, char c)
+{
+	*w->p++ = c;
+}
+
+
+static const char json_digits[] =
+	"00010203040506070809" "10111213141516171819"
+	"20212223242526272829" "30313233343536373839"
+	"40414243444546474849" "50515253545556575859"
+	"60616263646566676869" "70717273747576777879"
+	"80818283848586878889" "90919293949596979899";
+
+/* writes digits backward from the end, two at a time */
+static inline char* format_uint(char* end, uint64_t u)
+{
+	char* p = end;
+	while(u >= 100) {
+		const unsigned int r = (unsigned int)(u % 100);
+		u /= 100;
+		p -= 2;
+		memcpy(p, json_digits + r * 2, 2);
+	}
+	if(u >= 10) {
+		p -= 2;
+		memcpy(p, json_digits + u * 2, 2);
+	} else {
+		*--p = (char)('0' + u);
+	}
+	return p;
+}
+
+static int write_integer(json_writer* w, uint64_t u, bool negative)
+{
+	char buf[24];
+	char* const end = buf + sizeof(buf);
+	char* p = format_uint(end, negative ? (uint64_t)0 - u : u);
+	if(negative) { *--p = '-'; }
+	return writer_write(w, p, end - p);
+}
+
+static const double json_pow10[16] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+	1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+};
+
+/*
+ * Doubles with integral values below 2^53 are written like 1.0, and
+ * others with the fewest digits which are parsed back to the same
+ * value. Floats are written with the digits of floats.
+ * Decimals with up to 15 fraction digits are formatted without printf.
+ */
+static int write_double(json_writer* w, double d, bool single)
+{
+	char buf[40];
+	size_t n;
+	union { double f; uint64_t i; } mem;
+
+	if(d - d != d - d) {
+		/* NaN or an infinity */
+		return writer_write(w, "null", 4);
+	}
+
+	if(-9007199254740992.0 < d && d < 9007199254740992.0 && d == (double)(int64_t)d) {
+		char* const end = buf + sizeof(buf) - 2;
+		char* p = format_uint(end, (uint64_t)(d < 0 ? -d : d));
+		mem.f = d;
+		if(mem.i >> 63) { *--p = '-'; }
+		end[0] = '.';
+		end[1] = '0';
+		return writer_write(w, p, end + 2 - p);
+	}
+
+	if(1e-4 <= (d < 0 ? -d : d) && (d < 0 ? -d : d) < 1e15) {
+		/* the fewest fraction digits k where m / 10^k is parsed back to d */
+		int k;
+		for(k=1; k < 16; ++k) {
+			const double scaled = d * json_pow10[k];
+			int64_t m;
+			if(scaled <= -9007199254740992.0 || 9007199254740992.0 <= scaled) { break; }
+			m = (int64_t)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+			if(single ? (float)(m / json_pow10[k]) == (float)d : m / json_pow10[k] == d) {
+				const uint64_t u = m < 0 ? (uint64_t)0 - (uint64_t)m : (uint64_t)m;
+				const uint64_t div = (uint64_t)json_pow10[k];
+				char* const end = buf + sizeof(buf);
+				char* p = format_uint(end, u % div + div);
+				*p = '.';  /* over the leading 1 */
+				p = format_uint(p, u / div);
+				if(m < 0) { *--p = '-'; }
+				return writer_write(w, p, end - p);
+			}
+		}
+	}
+
+	{
+		int prec = single ? 6 : 15;
+		const int max = single ? 9 : 17;
+		for(;; ++prec) {
+			const double parsed = (sprintf(buf, "%.*g", prec, d), strtod(buf, NULL));
+			if(prec >= max || (single ? (float)parsed == (float)d : parsed == d)) {
+				break;
+			}
+		}
+		n = strlen(buf);
+		{
+			/* decimal point of the locale */
+			char* comma = (char*)memchr(buf, ',', n);
+			if(comma) { *comma = '.'; }
+		}
+	}
+	return writer_write(w, buf, n);
+}
+
+static int write_string(json_writer* w, const char* p, size_t size)
+{
+	const char* const end = p + size;
+	int ret;
+	if((ret = writer_reserve(w, 1)) < 0) { return ret; }
+	writer_put(w, '"');
+	for(;;) {
+		const char* const q = find_escape(p, end);
+		char c;
+		if(q != p && (ret = writer_write(w, p, q - p)) < 0) { return ret; }
+		if(q == end) { break; }
+		if((ret = writer_reserve(w, 6)) < 0) { return ret; }
+		c = json_escape[(unsigned char)*q];
+		writer_put(w, '\\');
+		writer_put(w, c);
+		if(c == 'u') {
+			writer_put(w, '0');
+			writer_put(w, '0');
+			writer_put(w, json_hex[(unsigned char)*q >> 4]);
+			writer_put(w, json_hex[(unsigned char)*q & 0x0f]);
+		}
+		p = q + 1;
+	}
+	if((ret = writer_reserve(w, 1)) < 0) { return ret; }
+	writer_put(w, '"');
+	return 1;
+}
+
+
+/*
+ * Reads the header of a serialized object: the size of the header and
+ * the body, and the number of objects following it as elements.
+ */
+static inline int object_header(const char* p, const char* end,
+		size_t* size, uint64_t* children)
+{
+	const unsigned char h = (unsigned char)*p;
+	const size_t avail = end - p;
+	*children = 0;
+	if(h <= 0x7f || h >= 0xe0 || h == 0xc0 || h == 0xc2 || h == 0xc3) {
+		*size = 1;
+		return 1;
+	} else if(0xa0 <= h && h <= 0xbf) {
+		*size = 1 + (h & 0x1f);
+	} else if(0x90 <= h && h <= 0x9f) {
+		*size = 1;
+		*children = h & 0x0f;
+	} else if(0x80 <= h && h <= 0x8f) {
+		*size = 1;
+		*children = (h & 0x0f) * 2;
+	} else {
+		uint32_t n;
+		switch(h) {
+		case 0xcc: case 0xd0: *size = 2; break;
+		case 0xcd: case 0xd1: *size = 3; break;
+		case 0xca: case 0xce: case 0xd2: *size = 5; break;
+		case 0xcb: case 0xcf: case 0xd3: *size = 9; break;
+		case 0xda: case 0xdc: case 0xde:
+			if(avail < 3) { return 0; }
+			n = _msgpack_load16(uint16_t, (p + 1));
+			*size = 3;
+			if(h == 0xda) { *size += n; }
+			else { *children = (uint64_t)n * (h == 0xde ? 2 : 1); }
+			break;
+		case 0xdb: case 0xdd: case 0xdf:
+			if(avail < 5) { return 0; }
+			n = _msgpack_load32(uint32_t, (p + 1));
+			*size = 5;
+			if(h == 0xdb) { *size += n; }
+			else { *children = (uint64_t)n * (h == 0xdf ? 2 : 1); }
+			break;
+		default:
+			return -1;
+		}
+	}
+	return avail < *size ? 0 : 1;
+}
+
+/* finds the end of one object */
+static int skip_object(const char* p, const char* end, const char** next)
+{
+	uint64_t count = 1;
+	do {
+		size_t size;
+		uint64_t children;
+		int ret;
+		if(p == end) { return 0; }
+		ret = object_header(p, end, &size, &children);
+		if(ret <= 0) { return ret; }
+		p += size;
+		count += children - 1;
+	} while(count > 0);
+	*next = p;
+	return 1;
+}
+
+typedef struct json_frame {
+	uint64_t count;
+	uint64_t index;
+	bool map;
+} json_frame;
+
+#define JSON_EMBED_FRAMES 32
+
+/* writes one complete object */
+static int write_object(json_writer* w, const char* p, const char* end)
+{
+	json_frame embed[JSON_EMBED_FRAMES];
+	json_frame* stack = embed;
+	size_t capacity = JSON_EMBED_FRAMES;
+	size_t depth = 0;
+	bool key = false;
+	int ret;
+
+	for(;;) {
+		const unsigned char h = (unsigned char)*p;
+		size_t size;
+		uint64_t children;
+		if(object_header(p, end, &size, &children) <= 0) {
+			ret = -1;
+			goto out;
+		}
+
+		if(key && h != 0xda && h != 0xdb && !(0xa0 <= h && h <= 0xbf)) {
+			if((0x80 <= h && h <= 0x9f) || h == 0xdc || h == 0xdd || h == 0xde || h == 0xdf) {
+				ret = -1;
+				goto out;
+			}
+			if((ret = writer_reserve(w, 1)) < 0) { goto out; }
+			writer_put(w, '"');
+		}
+
+		if(h <= 0x7f) {
+			ret = write_integer(w, h, false);
+		} else if(h >= 0xe0) {
+			ret = write_integer(w, (uint64_t)(int64_t)(int8_t)h, true);
+		} else if(0xa0 <= h && h <= 0xbf) {
+			ret = write_string(w, p + 1, h & 0x1f);
+		} else if((0x80 <= h && h <= 0x9f) || h == 0xdc || h == 0xdd || h == 0xde || h == 0xdf) {
+			const bool map = h <= 0x8f || h == 0xde || h == 0xdf;
+			if(depth == capacity) {
+				json_frame* tmp = (json_frame*)malloc(sizeof(json_frame) * capacity * 2);
+				if(tmp == NULL) { ret = JSON_NOMEM; goto out; }
+				memcpy(tmp, stack, sizeof(json_frame) * depth);
+				if(stack != embed) { free(stack); }
+				stack = tmp;
+				capacity *= 2;
+			}
+			stack[depth].count = children;
+			stack[depth].index = 0;
+			stack[depth].map = map;
+			++depth;
+			if((ret = writer_reserve(w, 1)) < 0) { goto out; }
+			writer_put(w, map ? '{' : '[');
+		} else {
+			union { uint32_t i; float f; } mem32;
+			union { uint64_t i; double f; } mem64;
+			switch(h) {
+			case 0xc0: ret = writer_write(w, "null", 4); break;
+			case 0xc2: ret = writer_write(w, "false", 5); break;
+			case 0xc3: ret = writer_write(w, "true", 4); break;
+			case 0xcc: ret = write_integer(w, (uint8_t)p[1], false); break;
+			case 0xcd: ret = write_integer(w, _msgpack_load16(uint16_t, (p + 1)), false); break;
+			case 0xce: ret = write_integer(w, _msgpack_load32(uint32_t, (p + 1)), false); break;
+			case 0xcf: ret = write_integer(w, _msgpack_load64(uint64_t, (p + 1)), false); break;
+			case 0xd0: {
+				const int64_t i = (int8_t)p[1];
+				ret = write_integer(w, (uint64_t)i, i < 0);
+				break; }
+			case 0xd1: {
+				const int64_t i = _msgpack_load16(int16_t, (p + 1));
+				ret = write_integer(w, (uint64_t)i, i < 0);
+				break; }
+			case 0xd2: {
+				const int64_t i = _msgpack_load32(int32_t, (p + 1));
+				ret = write_integer(w, (uint64_t)i, i < 0);
+				break; }
+			case 0xd3: {
+				const int64_t i = _msgpack_load64(int64_t, (p + 1));
+				ret = write_integer(w, (uint64_t)i, i < 0);
+				break; }
+			case 0xca:
+				mem32.i = _msgpack_load32(uint32_t, (p + 1));
+				ret = write_double(w, mem32.f, true);
+				break;
+			case 0xcb:
+				mem64.i = _msgpack_load64(uint64_t, (p + 1));
+				ret = write_double(w, mem64.f, false);
+				break;
+			case 0xda:
+				ret = write_string(w, p + 3, size - 3);
+				break;
+			default:  /* 0xdb */
+				ret = write_string(w, p + 5, size - 5);
+				break;
+			}
+		}
+		if(ret < 0) { goto out; }
+
+		if(key && h != 0xda && h != 0xdb && !(0xa0 <= h && h <= 0xbf)) {
+			if((ret = writer_reserve(w, 1)) < 0) { goto out; }
+			writer_put(w, '"');
+		}
+		p += size;
+
+		while(depth > 0 && stack[depth-1].index == stack[depth-1].count) {
+			--depth;
+			if((ret = writer_reserve(w, 1)) < 0) { goto out; }
+			writer_put(w, stack[depth].map ? '}' : ']');
+		}
+		if(depth == 0) { break; }
+
+		{
+			json_frame* const f = &stack[depth-1];
+			if(f->index > 0) {
+				if((ret = writer_reserve(w, 1)) < 0) { goto out; }
+				writer_put(w, (f->map && (f->index & 1)) ? ':' : ',');
+			}
+			key = f->map && !(f->index & 1);
+			++f->index;
+		}
+	}
+	ret = 1;
+
+out:
+	if(stack != embed) { free(stack); }
+	return ret;
+}
+
+msgpack_unpack_return
+msgpack_to_json(const char* data, size_t len, size_t* off,
+		void* out, msgpack_packer_write callback)
+{
+	const size_t noff = off ? *off : 0;
+	const char* const end = data + len;
+	const char* next;
+	json_writer w;
+	int ret;
+
+	if(len <= noff) { return MSGPACK_UNPACK_CONTINUE; }
+
+	ret = skip_object(data + noff, end, &next);
+	if(ret <= 0) { return json_return(ret); }
+
+	w.p = w.buf;
+	w.data = out;
+	w.callback = callback;
+	ret = write_object(&w, data + noff, next);
+	if(ret > 0) { ret = writer_flush(&w); }
+	if(ret <= 0) { return json_return(ret); }
+
+	if(off) { *off = next - data; }
+	return next < end ? MSGPACK_UNPACK_EXTRA_BYTES : MSGPACK_UNPACK_SUCCESS;
+}
+
+
+/*
+ * JSON text is parsed twice. The first pass validates the text and
+ * counts the elements of arrays and objects, which precede the elements
+ * in serialized data. The second pass packs the values.
+ */
+#define JSON_EMBED_COUNTS 64
+
+typedef struct json_vector {
+	size_t* ptr;
+	size_t size;
+	size_t capacity;
+	size_t embed[JSON_EMBED_COUNTS];
+} json_vector;
+
+static void vector_init(json_vector* v)
+{
+	v->ptr = v->embed;
+	v->size = 0;
+	v->capacity = JSON_EMBED_COUNTS;
+}
+
+static void vector_destroy(json_vector* v)
+{
+	if(v->ptr != v->embed) { free(v->ptr); }
+}
+
+static bool vector_push(json_vector* v, size_t x)
+{
+	if(v->size == v->capacity) {
+		size_t* tmp;
+		if(v->ptr == v->embed) {
+			tmp = (size_t*)malloc(sizeof(size_t) * v->capacity * 2);
+			if(tmp == NULL) { return false; }
+			memcpy(tmp, v->embed, sizeof(size_t) * v->size);
+		} else {
+			tmp = (size_t*)realloc(v->ptr, sizeof(size_t) * v->capacity * 2);
+			if(tmp == NULL) { return false; }
+		}
+		v->ptr = tmp;
+		v->capacity *= 2;
+	}
+	v->ptr[v->size++] = x;
+	return true;
+}
+
+static inline const char* skip_space(const char* p, const char* end)
+{
+	while(p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) { ++p; }
+	return p;
+}
+
+static inline bool is_digit(char c)
+{
+	return '0' <= c && c <= '9';
+}
+
+static inline int hex_value(char c)
+{
+	if('0' <= c && c <= '9') { return c - '0'; }
+	if('a' <= c && c <= 'f') { return c - 'a' + 10; }
+	if('A' <= c && c <= 'F') { return c - 'A' + 10; }
+	return -1;
+}
+
+/* *pp points after the opening quotation mark */
+static int validate_string(const char** pp, const char* end)
+{
+	const char* p = *pp;
+	for(;;) {
+		p = find_escape(p, end);
+		if(p == end) { return 0; }
+		if(*p == '"') { break; }
+		if(*p != '\\') { return -1; }  /* control character */
+		if(end - p < 2) { return 0; }
+		switch(p[1]) {
+		case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+			p += 2;
+			break;
+		case 'u': {
+			int i;
+			for(i=2; i < 6; ++i) {
+				if(p + i >= end) { return 0; }
+				if(hex_value(p[i]) < 0) { return -1; }
+			}
+			p += 6;
+			break; }
+		default:
+			return -1;
+		}
+	}
+	*pp = p + 1;
+	return 1;
+}
+
+/* a number ending the text is complete */
+static int validate_number(const char** pp, const char* end)
+{
+	const char* p = *pp;
+	if(*p == '-') {
+		if(++p == end) { return 0; }
+	}
+	if(*p == '0') {
+		++p;
+	} else if(is_digit(*p)) {
+		while(p < end && is_digit(*p)) { ++p; }
+	} else {
+		return -1;
+	}
+	if(p < end && *p == '.') {
+		if(++p == end) { return 0; }
+		if(!is_digit(*p)) { return -1; }
+		while(p < end && is_digit(*p)) { ++p; }
+	}
+	if(p < end && (*p == 'e' || *p == 'E')) {
+		if(++p == end) { return 0; }
+		if(*p == '+' || *p == '-') {
+			if(++p == end) { return 0; }
+		}
+		if(!is_digit(*p)) { return -1; }
+		while(p < end && is_digit(*p)) { ++p; }
+	}
+	*pp = p;
+	return 1;
+}
+
+static int validate_literal(const char** pp, const char* end, const char* word, size_t n)
+{
+	const size_t avail = end - *pp;
+	if(memcmp(*pp, word, avail < n ? avail : n) != 0) { return -1; }
+	if(avail < n) { return 0; }
+	*pp += n;
+	return 1;
+}
+
+/* a key and the following colon */
+static int validate_key(const char** pp, const char* end)
+{
+	const char* p = skip_space(*pp, end);
+	int ret;
+	if(p == end) { return 0; }
+	if(*p != '"') { return -1; }
+	++p;
+	if((ret = validate_string(&p, end)) <= 0) { return ret; }
+	p = skip_space(p, end);
+	if(p == end) { return 0; }
+	if(*p != ':') { return -1; }
+	*pp = p + 1;
+	return 1;
+}
+
+static int validate_json(const char* p, const char* end,
+		const char** next, json_vector* counts)
+{
+	/* indexes of counts of open containers, shifted left by 1 and
+	 * or-ed with 1 for objects */
+	json_vector stack;
+	int ret;
+	vector_init(&stack);
+
+	for(;;) {
+		p = skip_space(p, end);
+		if(p == end) { ret = 0; goto out; }
+
+		switch(*p) {
+		case '[':
+		case '{': {
+			const bool map = *p == '{';
+			if(!vector_push(counts, 0) ||
+					!vector_push(&stack, ((counts->size - 1) << 1) | (map ? 1 : 0))) {
+				ret = JSON_NOMEM;
+				goto out;
+			}
+			p = skip_space(p + 1, end);
+			if(p == end) { ret = 0; goto out; }
+			if(*p == (map ? '}' : ']')) {
+				++p;
+				--stack.size;
+				ret = 1;
+				break;
+			}
+			++counts->ptr[counts->size - 1];
+			if(map && (ret = validate_key(&p, end)) <= 0) { goto out; }
+			continue; }
+		case '"':
+			++p;
+			ret = validate_string(&p, end);
+			break;
+		case 't':
+			ret = validate_literal(&p, end, "true", 4);
+			break;
+		case 'f':
+			ret = validate_literal(&p, end, "false", 5);
+			break;
+		case 'n':
+			ret = validate_literal(&p, end, "null", 4);
+			break;
+		default:
+			ret = (*p == '-' || is_digit(*p)) ? validate_number(&p, end) : -1;
+			break;
+		}
+		if(ret <= 0) { goto out; }
+
+		/* closing brackets, and the separator of the next element */
+		for(;;) {
+			size_t top;
+			if(stack.size == 0) {
+				*next = p;
+				ret = 1;
+				goto out;
+			}
+			top = stack.ptr[stack.size - 1];
+			p = skip_space(p, end);
+			if(p == end) { ret = 0; goto out; }
+			if(*p == ((top & 1) ? '}' : ']')) {
+				++p;
+				--stack.size;
+				continue;
+			}
+			if(*p != ',') { ret = -1; goto out; }
+			++p;
+			++counts->ptr[top >> 1];
+			if((top & 1) && (ret = validate_key(&p, end)) <= 0) { goto out; }
+			break;
+		}
+	}
+
+out:
+	vector_destroy(&stack);
+	return ret;
+}
+
+
+typedef struct json_buffer {
+	char* ptr;
+	size_t size;
+	size_t capacity;
+	char embed[256];
+} json_buffer;
+
+static bool buffer_reserve(json_buffer* b, size_t n)
+{
+	if(b->capacity - b->size < n) {
+		size_t capacity = b->capacity * 2;
+		char* tmp;
+		while(capacity - b->size < n) { capacity *= 2; }
+		if(b->ptr == b->embed) {
+			tmp = (char*)malloc(capacity);
+			if(tmp == NULL) { return false; }
+			memcpy(tmp, b->embed, b->size);
+		} else {
+			tmp = (char*)realloc(b->ptr, capacity);
+			if(tmp == NULL) { return false; }
+		}
+		b->ptr = tmp;
+		b->capacity = capacity;
+	}
+	return true;
+}
+
+static inline unsigned int read_hex4(const char* p)
+{
+	return (hex_value(p[0]) << 12) | (hex_value(p[1]) << 8) |
+		(hex_value(p[2]) << 4) | hex_value(p[3]);
+}
+
+static inline size_t encode_utf8(char* out, unsigned int cp)
+{
+	if(cp < 0x80) {
+		out[0] = (char)cp;
+		return 1;
+	} else if(cp < 0x800) {
+		out[0] = (char)(0xc0 | (cp >> 6));
+		out[1] = (char)(0x80 | (cp & 0x3f));
+		return 2;
+	} else if(cp < 0x10000) {
+		out[0] = (char)(0xe0 | (cp >> 12));
+		out[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+		out[2] = (char)(0x80 | (cp & 0x3f));
+		return 3;
+	} else {
+		out[0] = (char)(0xf0 | (cp >> 18));
+		out[1] = (char)(0x80 | ((cp >> 12) & 0x3f));
+		out[2] = (char)(0x80 | ((cp >> 6) & 0x3f));
+		out[3] = (char)(0x80 | (cp & 0x3f));
+		return 4;
+	}
+}
+
+/* *pp points to the opening quotation mark of a valid string */
+static int pack_string(msgpack_packer* pk, const char** pp, const char* end,
+		json_buffer* b)
+{
+	const char* p = *pp + 1;
+	const char* q = find_escape(p, end);
+
+	if(*q != '"') {
+		/* unescape into the buffer */
+		b->size = 0;
+		for(;;) {
+			unsigned int cp;
+			if(!buffer_reserve(b, (q - p) + 4)) { return JSON_NOMEM; }
+			memcpy(b->ptr + b->size, p, q - p);
+			b->size += q - p;
+			if(*q == '"') { break; }
+			switch(q[1]) {
+			case 'b': b->ptr[b->size++] = '\b'; p = q + 2; break;
+			case 'f': b->ptr[b->size++] = '\f'; p = q + 2; break;
+			case 'n': b->ptr[b->size++] = '\n'; p = q + 2; break;
+			case 'r': b->ptr[b->size++] = '\r'; p = q + 2; break;
+			case 't': b->ptr[b->size++] = '\t'; p = q + 2; break;
+			case 'u':
+				cp = read_hex4(q + 2);
+				p = q + 6;
+				if(0xd800 <= cp && cp <= 0xdbff && end - p >= 6 &&
+						p[0] == '\\' && p[1] == 'u') {
+					const unsigned int low = read_hex4(p + 2);
+					if(0xdc00 <= low && low <= 0xdfff) {
+						cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+						p += 6;
+					}
+				}
+				if(0xd800 <= cp && cp <= 0xdfff) {
+					cp = 0xfffd;  /* unpaired surrogate */
+				}
+				b->size += encode_utf8(b->ptr + b->size, cp);
+				break;
+			default:  /* '"', '\\' or '/' */
+				b->ptr[b->size++] = q[1];
+				p = q + 2;
+				break;
+			}
+			q = find_escape(p, end);
+		}
+		*pp = q + 1;
+		if(msgpack_pack_raw(pk, b->size) < 0 ||
+				msgpack_pack_raw_body(pk, b->ptr, b->size) < 0) {
+			return JSON_NOMEM;
+		}
+		return 1;
+	}
+
+	*pp = q + 1;
+	if(msgpack_pack_raw(pk, q - p) < 0 ||
+			msgpack_pack_raw_body(pk, p, q - p) < 0) {
+		return JSON_NOMEM;
+	}
+	return 1;
+}
+
+/* *pp points to a valid number */
+static int pack_number(msgpack_packer* pk, const char** pp, const char* end)
+{
+	const char* p = *pp;
+	const char* q;
+	const bool negative = *p == '-';
+	bool integer = true;
+	uint64_t u = 0;
+	int ret;
+
+	for(q = negative ? p + 1 : p; q < end && is_digit(*q); ++q) {
+		const unsigned int d = *q - '0';
+		if(u > (UINT64_MAX - d) / 10) { integer = false; }
+		u = u * 10 + d;
+	}
+	for(; q < end && (is_digit(*q) || *q == '.' || *q == 'e' || *q == 'E' ||
+				*q == '+' || *q == '-'); ++q) {
+		integer = false;
+	}
+	*pp = q;
+
+	if(integer && (!negative || u <= (uint64_t)INT64_MAX + 1)) {
+		if(negative) {
+			ret = msgpack_pack_int64(pk, (int64_t)((uint64_t)0 - u));
+		} else {
+			ret = msgpack_pack_uint64(pk, u);
+		}
+	} else {
+		/* strtod needs a terminated string */
+		char buf[64];
+		char* s = buf;
+		double d;
+		if((size_t)(q - p) >= sizeof(buf)) {
+			s = (char*)malloc(q - p + 1);
+			if(s == NULL) { return JSON_NOMEM; }
+		}
+		memcpy(s, p, q - p);
+		s[q - p] = '\0';
+		d = strtod(s, NULL);
+		if(s != buf) { free(s); }
+		ret = msgpack_pack_double(pk, d);
+	}
+	return ret < 0 ? JSON_NOMEM : 1;
+}
+
+/* packs a valid value, walking its tokens */
+static int pack_json(msgpack_packer* pk, const char* p, const char* end,
+		const json_vector* counts)
+{
+	json_buffer b;
+	size_t k = 0;
+	int ret = 1;
+	b.ptr = b.embed;
+	b.size = 0;
+	b.capacity = sizeof(b.embed);
+
+	while(p < end) {
+		switch(*p) {
+		case ' ': case '\t': case '\n': case '\r':
+		case ',': case ':': case ']': case '}':
+			++p;
+			continue;
+		case '[':
+			ret = msgpack_pack_array(pk, (unsigned int)counts->ptr[k++]) < 0 ? JSON_NOMEM : 1;
+			++p;
+			break;
+		case '{':
+			ret = msgpack_pack_map(pk, (unsigned int)counts->ptr[k++]) < 0 ? JSON_NOMEM : 1;
+			++p;
+			break;
+		case '"':
+			ret = pack_string(pk, &p, end, &b);
+			break;
+		case 't':
+			ret = msgpack_pack_true(pk) < 0 ? JSON_NOMEM : 1;
+			p += 4;
+			break;
+		case 'f':
+			ret = msgpack_pack_false(pk) < 0 ? JSON_NOMEM : 1;
+			p += 5;
+			break;
+		case 'n':
+			ret = msgpack_pack_nil(pk) < 0 ? JSON_NOMEM : 1;
+			p += 4;
+			break;
+		default:
+			ret = pack_number(pk, &p, end);
+			break;
+		}
+		if(ret < 0) { break; }
+	}
+
+	if(b.ptr != b.embed) { free(b.ptr); }
+	return ret;
+}
+
+msgpack_unpack_return
+msgpack_pack_json(msgpack_packer* pk,
+		const char* data, size_t len, size_t* off)
+{
+	const size_t noff = off ? *off : 0;
+	const char* const end = data + len;
+	const char* next;
+	json_vector counts;
+	int ret;
+
+	if(len <= noff) { return MSGPACK_UNPACK_CONTINUE; }
+
+	vector_init(&counts);
+	ret = validate_json(data + noff, end, &next, &counts);
+	if(ret > 0) { ret = pack_json(pk, data + noff, next, &counts); }
+	vector_destroy(&counts);
+	if(ret <= 0) { return json_return(ret); }
+
+	next = skip_space(next, end);
+	if(off) { *off = next - data; }
+	return next < end ? MSGPACK_UNPACK_EXTRA_BYTES : MSGPACK_UNPACK_SUCCESS;
+}
+
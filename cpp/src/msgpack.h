@@ -26,5 +26,8 @@
 #include "msgpack/unpack.h"
 #include "msgpack/sbuffer.h"
 #include "msgpack/vrefbuffer.h"
+#include "msgpack/hash.h"
+#include "msgpack/struct.h"
+#include "msgpack/json.h"
 #include "msgpack/version.h"
 
@@ -0,0 +1,265 @@
+/*
+ * MessagePack for C compressing buffer implementation
+ *
+ * Copyright (C) 2010 FURUHASHI Sadayuki
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+#ifndef MSGPACK_CBUFFER_H__
+#define MSGPACK_CBUFFER_H__
+
+#include "msgpack/codec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_cbuffer Compressing buffer
+ * @ingroup msgpack_buffer
+ *
+ * Buffer which compresses the data written to it with a codec, like
+ * msgpack_zbuffer does with deflate. msgpack_cunpacker decompresses it.
+ * @{
+ */
+
+typedef struct msgpack_cbuffer {
+	const msgpack_codec* codec;
+	void* ctx;
+	char* data;
+	size_t size;
+	size_t alloc;
+	size_t init_size;
+} msgpack_cbuffer;
+
+#ifndef MSGPACK_CBUFFER_INIT_SIZE
+#define MSGPACK_CBUFFER_INIT_SIZE 8192
+#endif
+
+#ifndef MSGPACK_CBUFFER_RESERVE_SIZE
+#define MSGPACK_CBUFFER_RESERVE_SIZE 512
+#endif
+
+/**
+ * Initializes a buffer compressing with the codec, for example
+ * msgpack_codec_zstd(), at the level of the codec or
+ * MSGPACK_CODEC_DEFAULT_LEVEL.
+ */
+static inline bool msgpack_cbuffer_init(msgpack_cbuffer* cbuf,
+		const msgpack_codec* codec, int level, size_t init_size);
+static inline void msgpack_cbuffer_destroy(msgpack_cbuffer* cbuf);
+
+static inline msgpack_cbuffer* msgpack_cbuffer_new(const msgpack_codec* codec,
+		int level, size_t init_size);
+static inline void msgpack_cbuffer_free(msgpack_cbuffer* cbuf);
+
+/**
+ * Ends the frame like msgpack_zbuffer_flush() and returns the buffer,
+ * or NULL on errors.
+ */
+static inline char* msgpack_cbuffer_flush(msgpack_cbuffer* cbuf);
+
+/**
+ * Flushes the data written so far without ending the frame, like
+ * msgpack_zbuffer_sync_flush(). Returns the buffer, or NULL on errors.
+ */
+static inline char* msgpack_cbuffer_sync_flush(msgpack_cbuffer* cbuf);
+
+/**
+ * Sets a preset dictionary like msgpack_zbuffer_set_dictionary().
+ * Returns false if the codec has no dictionaries. Zstd copies the
+ * dictionary; deflate needs it to outlive the buffer.
+ */
+static inline bool msgpack_cbuffer_set_dictionary(msgpack_cbuffer* cbuf,
+		const char* dictionary, size_t size);
+
+static inline const char* msgpack_cbuffer_data(const msgpack_cbuffer* cbuf);
+static inline size_t msgpack_cbuffer_size(const msgpack_cbuffer* cbuf);
+
+/**
+ * Starts a new frame and empties the buffer.
+ */
+static inline bool msgpack_cbuffer_reset(msgpack_cbuffer* cbuf);
+static inline void msgpack_cbuffer_reset_buffer(msgpack_cbuffer* cbuf);
+static inline char* msgpack_cbuffer_release_buffer(msgpack_cbuffer* cbuf);
+
+static inline int msgpack_cbuffer_write(void* data, const char* buf, unsigned int len);
+
+static inline int msgpack_cbuffer_compress(msgpack_cbuffer* cbuf,
+		const char* buf, size_t len, msgpack_codec_mode mode);
+
+static inline bool msgpack_cbuffer_expand(msgpack_cbuffer* cbuf, size_t size);
+
+
+bool msgpack_cbuffer_init(msgpack_cbuffer* cbuf,
+		const msgpack_codec* codec, int level, size_t init_size)
+{
+	memset(cbuf, 0, sizeof(msgpack_cbuffer));
+	cbuf->codec = codec;
+	cbuf->init_size = init_size;
+	cbuf->ctx = codec->compressor_new(level);
+	return cbuf->ctx != NULL;
+}
+
+void msgpack_cbuffer_destroy(msgpack_cbuffer* cbuf)
+{
+	if(cbuf->ctx != NULL) {
+		cbuf->codec->compressor_free(cbuf->ctx);
+	}
+	free(cbuf->data);
+}
+
+msgpack_cbuffer* msgpack_cbuffer_new(const msgpack_codec* codec,
+		int level, size_t init_size)
+{
+	msgpack_cbuffer* cbuf = (msgpack_cbuffer*)malloc(sizeof(msgpack_cbuffer));
+	if(cbuf == NULL) {
+		return NULL;
+	}
+	if(!msgpack_cbuffer_init(cbuf, codec, level, init_size)) {
+		msgpack_cbuffer_destroy(cbuf);
+		free(cbuf);
+		return NULL;
+	}
+	return cbuf;
+}
+
+void msgpack_cbuffer_free(msgpack_cbuffer* cbuf)
+{
+	if(cbuf == NULL) { return; }
+	msgpack_cbuffer_destroy(cbuf);
+	free(cbuf);
+}
+
+bool msgpack_cbuffer_expand(msgpack_cbuffer* cbuf, size_t size)
+{
+	size_t nsize = (cbuf->alloc == 0) ? cbuf->init_size : cbuf->alloc * 2;
+	char* tmp;
+
+	if(nsize == 0) {
+		nsize = MSGPACK_CBUFFER_INIT_SIZE;
+	}
+	while(nsize < cbuf->size + size) {
+		nsize *= 2;
+	}
+
+	tmp = (char*)realloc(cbuf->data, nsize);
+	if(tmp == NULL) {
+		return false;
+	}
+
+	cbuf->data = tmp;
+	cbuf->alloc = nsize;
+	return true;
+}
+
+int msgpack_cbuffer_compress(msgpack_cbuffer* cbuf,
+		const char* buf, size_t len, msgpack_codec_mode mode)
+{
+	size_t need = MSGPACK_CBUFFER_RESERVE_SIZE;
+	while(true) {
+		char* out;
+		size_t avail;
+		int ret;
+
+		if(cbuf->alloc - cbuf->size < need) {
+			if(!msgpack_cbuffer_expand(cbuf, need)) {
+				return -1;
+			}
+		}
+
+		out = cbuf->data + cbuf->size;
+		avail = cbuf->alloc - cbuf->size;
+		ret = cbuf->codec->compress(cbuf->ctx, &buf, &len, &out, &avail, mode);
+		cbuf->size = cbuf->alloc - avail;
+		if(ret <= 0) {
+			return ret;
+		}
+
+		need = (size_t)ret > MSGPACK_CBUFFER_RESERVE_SIZE ? (size_t)ret : MSGPACK_CBUFFER_RESERVE_SIZE;
+	}
+}
+
+int msgpack_cbuffer_write(void* data, const char* buf, unsigned int len)
+{
+	return msgpack_cbuffer_compress((msgpack_cbuffer*)data, buf, len, MSGPACK_CODEC_RUN);
+}
+
+char* msgpack_cbuffer_flush(msgpack_cbuffer* cbuf)
+{
+	if(msgpack_cbuffer_compress(cbuf, NULL, 0, MSGPACK_CODEC_END) < 0) {
+		return NULL;
+	}
+	return cbuf->data;
+}
+
+char* msgpack_cbuffer_sync_flush(msgpack_cbuffer* cbuf)
+{
+	if(msgpack_cbuffer_compress(cbuf, NULL, 0, MSGPACK_CODEC_FLUSH) < 0) {
+		return NULL;
+	}
+	return cbuf->data;
+}
+
+bool msgpack_cbuffer_set_dictionary(msgpack_cbuffer* cbuf,
+		const char* dictionary, size_t size)
+{
+	if(cbuf->codec->compressor_set_dictionary == NULL) {
+		return false;
+	}
+	return cbuf->codec->compressor_set_dictionary(cbuf->ctx, dictionary, size);
+}
+
+const char* msgpack_cbuffer_data(const msgpack_cbuffer* cbuf)
+{
+	return cbuf->data;
+}
+
+size_t msgpack_cbuffer_size(const msgpack_cbuffer* cbuf)
+{
+	return cbuf->size;
+}
+
+void msgpack_cbuffer_reset_buffer(msgpack_cbuffer* cbuf)
+{
+	cbuf->size = 0;
+}
+
+bool msgpack_cbuffer_reset(msgpack_cbuffer* cbuf)
+{
+	if(!cbuf->codec->compressor_reset(cbuf->ctx)) {
+		return false;
+	}
+	msgpack_cbuffer_reset_buffer(cbuf);
+	return true;
+}
+
+char* msgpack_cbuffer_release_buffer(msgpack_cbuffer* cbuf)
+{
+	char* tmp = cbuf->data;
+	cbuf->data = NULL;
+	cbuf->size = 0;
+	cbuf->alloc = 0;
+	return tmp;
+}
+
+/** @} */
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/cbuffer.h */
+
@@ -0,0 +1,131 @@
+//
+// MessagePack for C++ compressing buffer implementation
+//
+// Copyright (C) 2010 FURUHASHI Sadayuki
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+#ifndef MSGPACK_CBUFFER_HPP__
+#define MSGPACK_CBUFFER_HPP__
+
+#include "msgpack/cbuffer.h"
+#include <stdexcept>
+
+namespace msgpack {
+
+
+// Compressing buffer like zbuffer, with a codec chosen at run time:
+//
+// msgpack::cbuffer buf(msgpack_codec_zstd());
+// msgpack::pack(buf, obj);
+// buf.flush();
+class cbuffer : public msgpack_cbuffer {
+public:
+	cbuffer(const msgpack_codec* codec = msgpack_codec_deflate(),
+			int level = MSGPACK_CODEC_DEFAULT_LEVEL,
+			size_t init_size = MSGPACK_CBUFFER_INIT_SIZE)
+	{
+		if(!msgpack_cbuffer_init(this, codec, level, init_size)) {
+			msgpack_cbuffer_destroy(this);
+			throw std::bad_alloc();
+		}
+	}
+
+	~cbuffer()
+	{
+		msgpack_cbuffer_destroy(this);
+	}
+
+public:
+	void write(const char* buf, unsigned int len)
+	{
+		if(msgpack_cbuffer_write(this, buf, len) < 0) {
+			throw std::bad_alloc();
+		}
+	}
+
+	char* flush()
+	{
+		char* buf = msgpack_cbuffer_flush(this);
+		if(!buf) {
+			throw std::bad_alloc();
+		}
+		return buf;
+	}
+
+	char* sync_flush()
+	{
+		char* buf = msgpack_cbuffer_sync_flush(this);
+		if(!buf) {
+			throw std::bad_alloc();
+		}
+		return buf;
+	}
+
+	// see msgpack_cbuffer_set_dictionary()
+	void set_dictionary(const char* dictionary, size_t size)
+	{
+		if(!msgpack_cbuffer_set_dictionary(this, dictionary, size)) {
+			throw std::invalid_argument("cbuffer dictionary");
+		}
+	}
+
+	const msgpack_codec* codec() const
+	{
+		return base::codec;
+	}
+
+	char* data()
+	{
+		return base::data;
+	}
+
+	const char* data() const
+	{
+		return base::data;
+	}
+
+	size_t size() const
+	{
+		return msgpack_cbuffer_size(this);
+	}
+
+	void reset()
+	{
+		if(!msgpack_cbuffer_reset(this)) {
+			throw std::bad_alloc();
+		}
+	}
+
+	void reset_buffer()
+	{
+		msgpack_cbuffer_reset_buffer(this);
+	}
+
+	char* release_buffer()
+	{
+		return msgpack_cbuffer_release_buffer(this);
+	}
+
+private:
+	typedef msgpack_cbuffer base;
+
+private:
+	cbuffer(const cbuffer&);
+};
+
+
+}  // namespace msgpack
+
+#endif /* msgpack/cbuffer.hpp */
+
@@ -0,0 +1,573 @@
+/*
+ * MessagePack for C compression codecs
+ *
+ * Copyright (C) 2010 FURUHASHI Sadayuki
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+#ifndef MSGPACK_CODEC_H__
+#define MSGPACK_CODEC_H__
+
+#include "msgpack/sysdep.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#ifdef MSGPACK_USE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef MSGPACK_USE_LZ4
+#include <lz4frame.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_codec Compression codecs
+ * @ingroup msgpack_buffer
+ *
+ * Streaming compressors and decompressors used by msgpack_cbuffer and
+ * msgpack_cunpacker. Deflate is always available; zstd and LZ4 (frame
+ * format) are available if MSGPACK_USE_ZSTD and MSGPACK_USE_LZ4 are
+ * defined and the program is linked with -lzstd and -llz4.
+ *
+ * A codec is a table of functions, so that other codecs can be plugged
+ * in by defining one.
+ * @{
+ */
+
+typedef enum {
+	MSGPACK_CODEC_RUN	= 0,  /* compress, buffering as the codec likes */
+	MSGPACK_CODEC_FLUSH	= 1,  /* and flush to a byte boundary */
+	MSGPACK_CODEC_END	= 2   /* and end the frame */
+} msgpack_codec_mode;
+
+/* uses the default level of the codec */
+#define MSGPACK_CODEC_DEFAULT_LEVEL INT_MIN
+
+typedef struct msgpack_codec {
+	const char* name;
+
+	/* returns NULL if memory allocation failed */
+	void* (*compressor_new)(int level);
+	void  (*compressor_free)(void* ctx);
+	/* starts a new frame; the dictionary is kept */
+	bool  (*compressor_reset)(void* ctx);
+	/* NULL if the codec has no dictionaries */
+	bool  (*compressor_set_dictionary)(void* ctx, const char* dictionary, size_t size);
+	/*
+	 * Compresses *src into *dst and advances both. Returns 0 if all of
+	 * the input is consumed and the mode is done, a positive number of
+	 * bytes of output space which the next call needs at least if the
+	 * output space ran out, or -1 on errors.
+	 */
+	int   (*compress)(void* ctx, const char** src, size_t* src_size,
+			char** dst, size_t* dst_size, msgpack_codec_mode mode);
+
+	void* (*decompressor_new)(void);
+	void  (*decompressor_free)(void* ctx);
+	bool  (*decompressor_set_dictionary)(void* ctx, const char* dictionary, size_t size);
+	/*
+	 * Decompresses *src into *dst and advances both. Frames which follow
+	 * one another are decompressed in turn. Returns 1 if any data was
+	 * consumed or produced, 0 if more input is needed, -1 if the data is
+	 * broken or -2 if memory allocation failed.
+	 */
+	int   (*decompress)(void* ctx, const char** src, size_t* src_size,
+			char** dst, size_t* dst_size);
+} msgpack_codec;
+
+static inline const msgpack_codec* msgpack_codec_deflate(void);
+#ifdef MSGPACK_USE_ZSTD
+static inline const msgpack_codec* msgpack_codec_zstd(void);
+#endif
+#ifdef MSGPACK_USE_LZ4
+static inline const msgpack_codec* msgpack_codec_lz4(void);
+#endif
+
+
+/* deflate (zlib format) */
+
+typedef struct msgpack_codec_zlib_context {
+	z_stream stream;
+	const char* dictionary;
+	size_t dictionary_size;
+} msgpack_codec_zlib_context;
+
+static inline void* msgpack_codec_deflate_compressor_new(int level)
+{
+	msgpack_codec_zlib_context* z = (msgpack_codec_zlib_context*)calloc(1, sizeof(msgpack_codec_zlib_context));
+	if(z == NULL) {
+		return NULL;
+	}
+	if(level == MSGPACK_CODEC_DEFAULT_LEVEL) {
+		level = Z_DEFAULT_COMPRESSION;
+	}
+	if(deflateInit(&z->stream, level) != Z_OK) {
+		free(z);
+		return NULL;
+	}
+	return z;
+}
+
+static inline void msgpack_codec_deflate_compressor_free(void* ctx)
+{
+	msgpack_codec_zlib_context* z = (msgpack_codec_zlib_context*)ctx;
+	deflateEnd(&z->stream);
+	free(z);
+}
+
+static inline bool msgpack_codec_deflate_compressor_set_dictionary(void* ctx,
+		const char* dictionary, size_t size)
+{
+	msgpack_codec_zlib_context* z = (msgpack_codec_zlib_context*)ctx;
+	if(deflateSetDictionary(&z->stream,
+				(const Bytef*)dictionary, (uInt)size) != Z_OK) {
+		return false;
+	}
+	z->dictionary = dictionary;
+	z->dictionary_size = size;
+	return true;
+}
+
+static inline bool msgpack_codec_deflate_compressor_reset(void* ctx)
+{
+	msgpack_codec_zlib_context* z = (msgpack_codec_zlib_context*)ctx;
+	if(deflateReset(&z->stream) != Z_OK) {
+		return false;
+	}
+	if(z->dictionary != NULL &&
+			deflateSetDictionary(&z->stream, (const Bytef*)z->dictionary,
+				(uInt)z->dictionary_size) != Z_OK) {
+		return false;
+	}
+	return true;
+}
+
+static inline int msgpack_codec_deflate_compress(void* ctx,
+		const char** src, size_t* src_size,
+		char** dst, size_t* dst_size, msgpack_codec_mode mode)
+{
+	static const int flush[] = { Z_NO_FLUSH, Z_SYNC_FLUSH, Z_FINISH };
+	msgpack_codec_zlib_context* z = (msgpack_codec_zlib_context*)ctx;
+	int zret;
+
+	z->stream.next_in = (Bytef*)*src;
+	z->stream.avail_in = (uInt)*src_size;
+	z->stream.next_out = (Bytef*)*dst;
+	z->stream.avail_out = (uInt)*dst_size;
+	zret = deflate(&z->stream, flush[mode]);
+	*src = (const char*)z->stream.next_in;
+	*src_size = z->stream.avail_in;
+	*dst = (char*)z->stream.next_out;
+	*dst_size = z->stream.avail_out;
+
+	switch(zret) {
+	case Z_STREAM_END:
+		return 0;
+	case Z_OK:
+	case Z_BUF_ERROR:  /* no progress was possible */
+		/* the output space ran out unless everything is done */
+		if(z->stream.avail_out > 0 && z->stream.avail_in == 0 && mode != MSGPACK_CODEC_END) {
+			return 0;
+		}
+		return 1;
+	default:
+		return -1;
+	}
+}
+
+static inline void* msgpack_codec_deflate_decompressor_new(void)
+{
+	msgpack_codec_zlib_context* z = (msgpack_codec_zlib_context*)calloc(1, sizeof(msgpack_codec_zlib_context));
+	if(z == NULL) {
+		return NULL;
+	}
+	if(inflateInit(&z->stream) != Z_OK) {
+		free(z);
+		return NULL;
+	}
+	return z;
+}
+
+static inline void msgpack_codec_deflate_decompressor_free(void* ctx)
+{
+	msgpack_codec_zlib_context* z = (msgpack_codec_zlib_context*)ctx;
+	inflateEnd(&z->stream);
+	free(z);
+}
+
+static inline bool msgpack_codec_deflate_decompressor_set_dictionary(void* ctx,
+		const char* dictionary, size_t size)
+{
+	/* set when a stream asks for it */
+	msgpack_codec_zlib_context* z = (msgpack_codec_zlib_context*)ctx;
+	z->dictionary = dictionary;
+	z->dictionary_size = size;
+	return true;
+}
+
+static inline int msgpack_codec_deflate_decompress(void* ctx,
+		const char** src, size_t* src_size,
+		char** dst, size_t* dst_size)
+{
+	msgpack_codec_zlib_context* z = (msgpack_codec_zlib_context*)ctx;
+	bool progress;
+	int zret;
+
+	z->stream.next_in = (Bytef*)*src;
+	z->stream.avail_in = (uInt)*src_size;
+	z->stream.next_out = (Bytef*)*dst;
+	z->stream.avail_out = (uInt)*dst_size;
+	zret = inflate(&z->stream, Z_NO_FLUSH);
+	progress = z->stream.avail_in != *src_size || z->stream.avail_out != *dst_size;
+	*src = (const char*)z->stream.next_in;
+	*src_size = z->stream.avail_in;
+	*dst = (char*)z->stream.next_out;
+	*dst_size = z->stream.avail_out;
+
+	switch(zret) {
+	case Z_OK:
+		return 1;
+	case Z_STREAM_END:
+		/* another stream may follow */
+		return inflateReset(&z->stream) == Z_OK ? 1 : -1;
+	case Z_NEED_DICT:
+		if(z->dictionary == NULL ||
+				inflateSetDictionary(&z->stream, (const Bytef*)z->dictionary,
+					(uInt)z->dictionary_size) != Z_OK) {
+			return -1;
+		}
+		return 1;
+	case Z_BUF_ERROR:
+		return progress ? 1 : 0;
+	case Z_MEM_ERROR:
+		return -2;
+	default:
+		return -1;
+	}
+}
+
+const msgpack_codec* msgpack_codec_deflate(void)
+{
+	static const msgpack_codec codec = {
+		"deflate",
+		msgpack_codec_deflate_compressor_new,
+		msgpack_codec_deflate_compressor_free,
+		msgpack_codec_deflate_compressor_reset,
+		msgpack_codec_deflate_compressor_set_dictionary,
+		msgpack_codec_deflate_compress,
+		msgpack_codec_deflate_decompressor_new,
+		msgpack_codec_deflate_decompressor_free,
+		msgpack_codec_deflate_decompressor_set_dictionary,
+		msgpack_codec_deflate_decompress,
+	};
+	return &codec;
+}
+
+
+#ifdef MSGPACK_USE_ZSTD
+
+static inline void* msgpack_codec_zstd_compressor_new(int level)
+{
+	ZSTD_CCtx* c = ZSTD_createCCtx();
+	if(c == NULL) {
+		return NULL;
+	}
+	if(level == MSGPACK_CODEC_DEFAULT_LEVEL) {
+		level = ZSTD_CLEVEL_DEFAULT;
+	}
+	if(ZSTD_isError(ZSTD_CCtx_setParameter(c, ZSTD_c_compressionLevel, level))) {
+		ZSTD_freeCCtx(c);
+		return NULL;
+	}
+	return c;
+}
+
+static inline void msgpack_codec_zstd_compressor_free(void* ctx)
+{
+	ZSTD_freeCCtx((ZSTD_CCtx*)ctx);
+}
+
+static inline bool msgpack_codec_zstd_compressor_set_dictionary(void* ctx,
+		const char* dictionary, size_t size)
+{
+	/* zstd copies the dictionary and uses it for every frame */
+	return !ZSTD_isError(ZSTD_CCtx_loadDictionary((ZSTD_CCtx*)ctx, dictionary, size));
+}
+
+static inline bool msgpack_codec_zstd_compressor_reset(void* ctx)
+{
+	return !ZSTD_isError(ZSTD_CCtx_reset((ZSTD_CCtx*)ctx, ZSTD_reset_session_only));
+}
+
+static inline int msgpack_codec_zstd_compress(void* ctx,
+		const char** src, size_t* src_size,
+		char** dst, size_t* dst_size, msgpack_codec_mode mode)
+{
+	static const ZSTD_EndDirective directive[] = { ZSTD_e_continue, ZSTD_e_flush, ZSTD_e_end };
+	ZSTD_inBuffer in = { *src, *src_size, 0 };
+	ZSTD_outBuffer out = { *dst, *dst_size, 0 };
+
+	size_t rest = ZSTD_compressStream2((ZSTD_CCtx*)ctx, &out, &in, directive[mode]);
+	*src += in.pos;
+	*src_size -= in.pos;
+	*dst += out.pos;
+	*dst_size -= out.pos;
+
+	if(ZSTD_isError(rest)) {
+		return -1;
+	}
+	if(*src_size > 0 || (mode != MSGPACK_CODEC_RUN && rest > 0)) {
+		return 1;
+	}
+	return 0;
+}
+
+static inline void* msgpack_codec_zstd_decompressor_new(void)
+{
+	return ZSTD_createDCtx();
+}
+
+static inline void msgpack_codec_zstd_decompressor_free(void* ctx)
+{
+	ZSTD_freeDCtx((ZSTD_DCtx*)ctx);
+}
+
+static inline bool msgpack_codec_zstd_decompressor_set_dictionary(void* ctx,
+		const char* dictionary, size_t size)
+{
+	return !ZSTD_isError(ZSTD_DCtx_loadDictionary((ZSTD_DCtx*)ctx, dictionary, size));
+}
+
+static inline int msgpack_codec_zstd_decompress(void* ctx,
+		const char** src, size_t* src_size,
+		char** dst, size_t* dst_size)
+{
+	ZSTD_inBuffer in = { *src, *src_size, 0 };
+	ZSTD_outBuffer out = { *dst, *dst_size, 0 };
+
+	size_t ret = ZSTD_decompressStream((ZSTD_DCtx*)ctx, &out, &in);
+	*src += in.pos;
+	*src_size -= in.pos;
+	*dst += out.pos;
+	*dst_size -= out.pos;
+
+	if(ZSTD_isError(ret)) {
+		return -1;
+	}
+	return (in.pos > 0 || out.pos > 0) ? 1 : 0;
+}
+
+const msgpack_codec* msgpack_codec_zstd(void)
+{
+	static const msgpack_codec codec = {
+		"zstd",
+		msgpack_codec_zstd_compressor_new,
+		msgpack_codec_zstd_compressor_free,
+		msgpack_codec_zstd_compressor_reset,
+		msgpack_codec_zstd_compressor_set_dictionary,
+		msgpack_codec_zstd_compress,
+		msgpack_codec_zstd_decompressor_new,
+		msgpack_codec_zstd_decompressor_free,
+		msgpack_codec_zstd_decompressor_set_dictionary,
+		msgpack_codec_zstd_decompress,
+	};
+	return &codec;
+}
+
+#endif /* MSGPACK_USE_ZSTD */
+
+
+#ifdef MSGPACK_USE_LZ4
+
+typedef struct msgpack_codec_lz4_context {
+	LZ4F_cctx* cctx;
+	LZ4F_preferences_t prefs;
+	bool started;  /* the frame header is written */
+} msgpack_codec_lz4_context;
+
+/* LZ4F_compressUpdate() needs space for the worst case of its input */
+#ifndef MSGPACK_CODEC_LZ4_CHUNK_SIZE
+#define MSGPACK_CODEC_LZ4_CHUNK_SIZE (64*1024)
+#endif
+
+static inline void* msgpack_codec_lz4_compressor_new(int level)
+{
+	msgpack_codec_lz4_context* l = (msgpack_codec_lz4_context*)calloc(1, sizeof(msgpack_codec_lz4_context));
+	if(l == NULL) {
+		return NULL;
+	}
+	if(LZ4F_isError(LZ4F_createCompressionContext(&l->cctx, LZ4F_VERSION))) {
+		free(l);
+		return NULL;
+	}
+	/* linked blocks compress small messages with the earlier ones */
+	l->prefs.frameInfo.blockSizeID = LZ4F_max64KB;
+	l->prefs.frameInfo.blockMode = LZ4F_blockLinked;
+	l->prefs.compressionLevel = (level == MSGPACK_CODEC_DEFAULT_LEVEL) ? 0 : level;
+	return l;
+}
+
+static inline void msgpack_codec_lz4_compressor_free(void* ctx)
+{
+	msgpack_codec_lz4_context* l = (msgpack_codec_lz4_context*)ctx;
+	LZ4F_freeCompressionContext(l->cctx);
+	free(l);
+}
+
+static inline bool msgpack_codec_lz4_compressor_reset(void* ctx)
+{
+	/* the next frame is started by the next compression */
+	msgpack_codec_lz4_context* l = (msgpack_codec_lz4_context*)ctx;
+	if(l->started) {
+		/* drops the unfinished frame */
+		LZ4F_freeCompressionContext(l->cctx);
+		l->started = false;
+		if(LZ4F_isError(LZ4F_createCompressionContext(&l->cctx, LZ4F_VERSION))) {
+			l->cctx = NULL;
+			return false;
+		}
+	}
+	return true;
+}
+
+static inline int msgpack_codec_lz4_compress(void* ctx,
+		const char** src, size_t* src_size,
+		char** dst, size_t* dst_size, msgpack_codec_mode mode)
+{
+	msgpack_codec_lz4_context* l = (msgpack_codec_lz4_context*)ctx;
+	size_t need;
+	size_t n;
+
+	if(l->cctx == NULL) {
+		return -1;
+	}
+
+	if(!l->started) {
+		if(*dst_size < LZ4F_HEADER_SIZE_MAX) {
+			return LZ4F_HEADER_SIZE_MAX;
+		}
+		n = LZ4F_compressBegin(l->cctx, *dst, *dst_size, &l->prefs);
+		if(LZ4F_isError(n)) {
+			return -1;
+		}
+		*dst += n;
+		*dst_size -= n;
+		l->started = true;
+	}
+
+	while(*src_size > 0) {
+		size_t chunk = *src_size < MSGPACK_CODEC_LZ4_CHUNK_SIZE ?
+			*src_size : MSGPACK_CODEC_LZ4_CHUNK_SIZE;
+		need = LZ4F_compressBound(chunk, &l->prefs);
+		if(*dst_size < need) {
+			return (int)need;
+		}
+		n = LZ4F_compressUpdate(l->cctx, *dst, *dst_size, *src, chunk, NULL);
+		if(LZ4F_isError(n)) {
+			return -1;
+		}
+		*src += chunk;
+		*src_size -= chunk;
+		*dst += n;
+		*dst_size -= n;
+	}
+
+	if(mode == MSGPACK_CODEC_RUN) {
+		return 0;
+	}
+
+	need = LZ4F_compressBound(0, &l->prefs);
+	if(*dst_size < need) {
+		return (int)need;
+	}
+	if(mode == MSGPACK_CODEC_FLUSH) {
+		n = LZ4F_flush(l->cctx, *dst, *dst_size, NULL);
+	} else {
+		n = LZ4F_compressEnd(l->cctx, *dst, *dst_size, NULL);
+		l->started = false;
+	}
+	if(LZ4F_isError(n)) {
+		return -1;
+	}
+	*dst += n;
+	*dst_size -= n;
+	return 0;
+}
+
+static inline void* msgpack_codec_lz4_decompressor_new(void)
+{
+	LZ4F_dctx* d;
+	if(LZ4F_isError(LZ4F_createDecompressionContext(&d, LZ4F_VERSION))) {
+		return NULL;
+	}
+	return d;
+}
+
+static inline void msgpack_codec_lz4_decompressor_free(void* ctx)
+{
+	LZ4F_freeDecompressionContext((LZ4F_dctx*)ctx);
+}
+
+static inline int msgpack_codec_lz4_decompress(void* ctx,
+		const char** src, size_t* src_size,
+		char** dst, size_t* dst_size)
+{
+	size_t in = *src_size;
+	size_t out = *dst_size;
+
+	size_t ret = LZ4F_decompress((LZ4F_dctx*)ctx, *dst, &out, *src, &in, NULL);
+	*src += in;
+	*src_size -= in;
+	*dst += out;
+	*dst_size -= out;
+
+	if(LZ4F_isError(ret)) {
+		return -1;
+	}
+	return (in > 0 || out > 0) ? 1 : 0;
+}
+
+const msgpack_codec* msgpack_codec_lz4(void)
+{
+	/* dictionaries of LZ4 frames are an experimental API of liblz4 */
+	static const msgpack_codec codec = {
+		"lz4",
+		msgpack_codec_lz4_compressor_new,
+		msgpack_codec_lz4_compressor_free,
+		msgpack_codec_lz4_compressor_reset,
+		NULL,
+		msgpack_codec_lz4_compress,
+		msgpack_codec_lz4_decompressor_new,
+		msgpack_codec_lz4_decompressor_free,
+		NULL,
+		msgpack_codec_lz4_decompress,
+	};
+	return &codec;
+}
+
+#endif /* MSGPACK_USE_LZ4 */
+
+/** @} */
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/codec.h */
+
@@ -0,0 +1,166 @@
+/*
+ * MessagePack for C compact object tree
+ *
+ * Copyright (C) 2008-2010 FURUHASHI Sadayuki
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+#ifndef MSGPACK_COMPACT_H__
+#define MSGPACK_COMPACT_H__
+
+#include "msgpack/object.h"
+#include "msgpack/unpack.h"
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_compact Compact object tree
+ * @ingroup msgpack
+ * @{
+ */
+
+/*
+ * A node is 16 bytes (msgpack_object is 24 and msgpack_object_kv is 48).
+ *
+ * head: bits 0-2 msgpack_object_type
+ *       bit  3   the raw body is stored inline
+ * size: number of elements of an array or a map, or length of a raw
+ * via:  value, or offset of the elements or the raw body in the arena
+ *
+ * Raws up to MSGPACK_COMPACT_INLINE_RAW bytes are stored in the via field.
+ * Elements of a map are stored as key, value, key, value, ...
+ * Offsets are relative to the arena so that it can be reallocated.
+ */
+typedef struct msgpack_compact_object {
+	uint32_t head;
+	uint32_t size;
+	union {
+		bool boolean;
+		uint64_t u64;
+		int64_t  i64;
+		double   dec;
+		uint32_t off;
+		char raw[8];
+	} via;
+} msgpack_compact_object;
+
+#define MSGPACK_COMPACT_TYPE_MASK   0x07
+#define MSGPACK_COMPACT_INLINE      0x08
+#define MSGPACK_COMPACT_INLINE_RAW  8
+
+typedef struct msgpack_compact {
+	char* data;
+	size_t used;
+	size_t alloc;
+} msgpack_compact;
+
+#ifndef MSGPACK_COMPACT_INIT_SIZE
+#define MSGPACK_COMPACT_INIT_SIZE 8192
+#endif
+
+bool msgpack_compact_init(msgpack_compact* c, size_t init_size);
+void msgpack_compact_destroy(msgpack_compact* c);
+
+msgpack_compact* msgpack_compact_new(size_t init_size);
+void msgpack_compact_free(msgpack_compact* c);
+
+/**
+ * Removes all trees. The arena is kept.
+ */
+static inline void msgpack_compact_clear(msgpack_compact* c);
+
+/**
+ * Deserializes one object into the arena.
+ * The offset of the root node is stored to *root.
+ */
+msgpack_unpack_return
+msgpack_compact_unpack(msgpack_compact* c,
+		const char* data, size_t len, size_t* off, uint32_t* root);
+
+/**
+ * Copies a dynamically typed object into the arena.
+ */
+bool msgpack_compact_from_object(msgpack_compact* c,
+		msgpack_object o, uint32_t* root);
+
+/**
+ * Expands a node into a dynamically typed object allocated in the zone.
+ * Raws refer to the arena. The arena must not be modified or freed
+ * while the object is used.
+ */
+bool msgpack_compact_to_object(const msgpack_compact* c, uint32_t node,
+		msgpack_zone* z, msgpack_object* result);
+
+static inline const msgpack_compact_object* msgpack_compact_node(
+		const msgpack_compact* c, uint32_t off);
+
+static inline msgpack_object_type msgpack_compact_type(
+		const msgpack_compact_object* o);
+
+/**
+ * Gets the body of a raw node.
+ */
+static inline const char* msgpack_compact_raw(
+		const msgpack_compact* c, const msgpack_compact_object* o);
+
+/**
+ * Gets the first element of an array node or the first key of a map node.
+ */
+static inline const msgpack_compact_object* msgpack_compact_elements(
+		const msgpack_compact* c, const msgpack_compact_object* o);
+
+/** @} */
+
+
+void msgpack_compact_clear(msgpack_compact* c)
+{
+	c->used = 0;
+}
+
+const msgpack_compact_object* msgpack_compact_node(
+		const msgpack_compact* c, uint32_t off)
+{
+	return (const msgpack_compact_object*)(c->data + off);
+}
+
+msgpack_object_type msgpack_compact_type(const msgpack_compact_object* o)
+{
+	return (msgpack_object_type)(o->head & MSGPACK_COMPACT_TYPE_MASK);
+}
+
+const char* msgpack_compact_raw(
+		const msgpack_compact* c, const msgpack_compact_object* o)
+{
+	if(o->head & MSGPACK_COMPACT_INLINE) {
+		return o->via.raw;
+	}
+	return c->data + o->via.off;
+}
+
+const msgpack_compact_object* msgpack_compact_elements(
+		const msgpack_compact* c, const msgpack_compact_object* o)
+{
+	return (const msgpack_compact_object*)(c->data + o->via.off);
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/compact.h */
+
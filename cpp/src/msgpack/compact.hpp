@@ -0,0 +1,172 @@
+//
+// MessagePack for C++ compact object tree
+//
+// Copyright (C) 2008-2010 FURUHASHI Sadayuki
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+#ifndef MSGPACK_COMPACT_HPP__
+#define MSGPACK_COMPACT_HPP__
+
+#include "msgpack/compact.h"
+#include "msgpack/object.hpp"
+#include "msgpack/unpack.hpp"
+#include "msgpack/zone.hpp"
+#include <stdexcept>
+
+namespace msgpack {
+
+
+class compact_object {
+public:
+	compact_object(const msgpack_compact* c, const msgpack_compact_object* o) :
+		m_c(c), m_o(o) { }
+
+	type::object_type type() const
+		{ return (type::object_type)msgpack_compact_type(m_o); }
+
+	bool is_nil() const { return type() == type::NIL; }
+
+	/*! number of elements of an array or a map, or length of a raw */
+	uint32_t size() const { return m_o->size; }
+
+	bool boolean() const { return m_o->via.boolean; }
+	uint64_t u64() const { return m_o->via.u64; }
+	int64_t i64() const { return m_o->via.i64; }
+	double dec() const { return m_o->via.dec; }
+	const char* raw() const { return msgpack_compact_raw(m_c, m_o); }
+
+	/*! element of an array */
+	compact_object operator[] (uint32_t i) const
+		{ return compact_object(m_c, msgpack_compact_elements(m_c, m_o) + i); }
+
+	/*! key and value of a map */
+	compact_object key(uint32_t i) const
+		{ return compact_object(m_c, msgpack_compact_elements(m_c, m_o) + i*2); }
+	compact_object val(uint32_t i) const
+		{ return compact_object(m_c, msgpack_compact_elements(m_c, m_o) + i*2 + 1); }
+
+	/*! expands the node into an object allocated in the zone */
+	object get(zone* z) const;
+
+	template <typename T>
+	T as(zone* z) const { return get(z).as<T>(); }
+
+private:
+	const msgpack_compact* m_c;
+	const msgpack_compact_object* m_o;
+};
+
+
+class compact : public msgpack_compact {
+public:
+	compact(size_t init_size = MSGPACK_COMPACT_INIT_SIZE);
+	~compact();
+
+public:
+	/*! deserializes one object and returns offset of the root node */
+	uint32_t unpack(const char* data, size_t len, size_t* offset = NULL);
+
+	/*! copies an object and returns offset of the root node */
+	uint32_t append(object o);
+
+	compact_object get(uint32_t root) const;
+
+	/*! size of the arena in bytes */
+	size_t size() const;
+
+	void clear();
+
+private:
+	typedef msgpack_compact base;
+
+private:
+	compact(const compact&);
+};
+
+
+inline object compact_object::get(zone* z) const
+{
+	object o;
+	if(!msgpack_compact_to_object(m_c, (const char*)m_o - m_c->data, z,
+				reinterpret_cast<msgpack_object*>(&o))) {
+		throw std::bad_alloc();
+	}
+	return o;
+}
+
+
+inline compact::compact(size_t init_size)
+{
+	if(!msgpack_compact_init(this, init_size)) {
+		throw std::bad_alloc();
+	}
+}
+
+inline compact::~compact()
+{
+	msgpack_compact_destroy(this);
+}
+
+inline uint32_t compact::unpack(const char* data, size_t len, size_t* offset)
+{
+	uint32_t root;
+	switch(msgpack_compact_unpack(this, data, len, offset, &root)) {
+	case MSGPACK_UNPACK_SUCCESS:
+		return root;
+
+	case MSGPACK_UNPACK_EXTRA_BYTES:
+		if(offset) {
+			return root;
+		} else {
+			throw unpack_error("extra bytes");
+		}
+
+	case MSGPACK_UNPACK_CONTINUE:
+		throw unpack_error("insufficient bytes");
+
+	case MSGPACK_UNPACK_PARSE_ERROR:
+	default:
+		throw unpack_error("parse error");
+	}
+}
+
+inline uint32_t compact::append(object o)
+{
+	uint32_t root;
+	if(!msgpack_compact_from_object(this, o, &root)) {
+		throw std::bad_alloc();
+	}
+	return root;
+}
+
+inline compact_object compact::get(uint32_t root) const
+{
+	return compact_object(this, msgpack_compact_node(this, root));
+}
+
+inline size_t compact::size() const
+{
+	return base::used;
+}
+
+inline void compact::clear()
+{
+	msgpack_compact_clear(this);
+}
+
+
+}  // namespace msgpack
+
+#endif /* msgpack/compact.hpp */
+
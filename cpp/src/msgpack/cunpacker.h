@@ -0,0 +1,293 @@
+/*
+ * MessagePack for C decompressing unpacker implementation
+ *
+ * Copyright (C) 2010 FURUHASHI Sadayuki
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+#ifndef MSGPACK_CUNPACKER_H__
+#define MSGPACK_CUNPACKER_H__
+
+#include "msgpack/codec.h"
+#include "msgpack/unpack.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_cunpacker Decompressing unpacker
+ * @ingroup msgpack_unpack
+ *
+ * Deserializes a stream compressed by msgpack_cbuffer with the same
+ * codec. Compressed data is fed like to msgpack_unpacker and
+ * decompressed into the buffer of the unpacker in windows of
+ * MSGPACK_CUNPACKER_WINDOW_SIZE bytes, as many as needed to complete the
+ * next message. Decompressed data is never held twice, and messages are
+ * returned as soon as their bytes are decompressed.
+ * @{
+ */
+
+typedef struct msgpack_cunpacker {
+	msgpack_unpacker mpac;  /* receives the decompressed data */
+	const msgpack_codec* codec;
+	void* ctx;
+	char* buffer;
+	size_t used;
+	size_t free;
+	size_t off;             /* start of the data not decompressed yet */
+	size_t initial_buffer_size;
+	size_t window;
+} msgpack_cunpacker;
+
+#ifndef MSGPACK_CUNPACKER_INIT_BUFFER_SIZE
+#define MSGPACK_CUNPACKER_INIT_BUFFER_SIZE 8192
+#endif
+
+#ifndef MSGPACK_CUNPACKER_WINDOW_SIZE
+#define MSGPACK_CUNPACKER_WINDOW_SIZE (32*1024)
+#endif
+
+static inline bool msgpack_cunpacker_init(msgpack_cunpacker* cpac,
+		const msgpack_codec* codec, size_t initial_buffer_size);
+static inline void msgpack_cunpacker_destroy(msgpack_cunpacker* cpac);
+
+static inline msgpack_cunpacker* msgpack_cunpacker_new(const msgpack_codec* codec,
+		size_t initial_buffer_size);
+static inline void msgpack_cunpacker_free(msgpack_cunpacker* cpac);
+
+/**
+ * Sets the preset dictionary which the sender set by
+ * msgpack_cbuffer_set_dictionary(). Returns false if the codec has no
+ * dictionaries. The dictionary must outlive the unpacker.
+ */
+static inline bool msgpack_cunpacker_set_dictionary(msgpack_cunpacker* cpac,
+		const char* dictionary, size_t size);
+
+static inline bool   msgpack_cunpacker_reserve_buffer(msgpack_cunpacker* cpac, size_t size);
+static inline char*  msgpack_cunpacker_buffer(msgpack_cunpacker* cpac);
+static inline size_t msgpack_cunpacker_buffer_capacity(const msgpack_cunpacker* cpac);
+static inline void   msgpack_cunpacker_buffer_consumed(msgpack_cunpacker* cpac, size_t size);
+
+/**
+ * Decompresses the buffered data until the next message is complete
+ * and deserializes it. Returns 1 if a message is complete, which is got
+ * by msgpack_unpacker_data(&cpac->mpac) like msgpack_unpacker_execute();
+ * 0 if more compressed data is needed; MSGPACK_UNPACK_PARSE_ERROR if
+ * the compressed data or the message is broken;
+ * MSGPACK_UNPACK_NOMEM_ERROR if memory allocation failed.
+ */
+static inline int msgpack_cunpacker_execute(msgpack_cunpacker* cpac);
+
+static inline bool msgpack_cunpacker_next(msgpack_cunpacker* cpac, msgpack_unpacked* result);
+
+static inline int msgpack_cunpacker_decompress(msgpack_cunpacker* cpac);
+
+static inline bool msgpack_cunpacker_expand_buffer(msgpack_cunpacker* cpac, size_t size);
+
+
+bool msgpack_cunpacker_init(msgpack_cunpacker* cpac,
+		const msgpack_codec* codec, size_t initial_buffer_size)
+{
+	memset(cpac, 0, sizeof(msgpack_cunpacker));
+	cpac->codec = codec;
+	cpac->initial_buffer_size = initial_buffer_size;
+	cpac->window = MSGPACK_CUNPACKER_WINDOW_SIZE;
+
+	cpac->buffer = (char*)malloc(initial_buffer_size);
+	if(cpac->buffer == NULL) {
+		return false;
+	}
+	cpac->free = initial_buffer_size;
+
+	cpac->ctx = codec->decompressor_new();
+	if(cpac->ctx == NULL) {
+		free(cpac->buffer);
+		return false;
+	}
+	if(!msgpack_unpacker_init(&cpac->mpac, MSGPACK_UNPACKER_INIT_BUFFER_SIZE)) {
+		codec->decompressor_free(cpac->ctx);
+		free(cpac->buffer);
+		return false;
+	}
+	return true;
+}
+
+void msgpack_cunpacker_destroy(msgpack_cunpacker* cpac)
+{
+	msgpack_unpacker_destroy(&cpac->mpac);
+	cpac->codec->decompressor_free(cpac->ctx);
+	free(cpac->buffer);
+}
+
+msgpack_cunpacker* msgpack_cunpacker_new(const msgpack_codec* codec,
+		size_t initial_buffer_size)
+{
+	msgpack_cunpacker* cpac = (msgpack_cunpacker*)malloc(sizeof(msgpack_cunpacker));
+	if(cpac == NULL) {
+		return NULL;
+	}
+	if(!msgpack_cunpacker_init(cpac, codec, initial_buffer_size)) {
+		free(cpac);
+		return NULL;
+	}
+	return cpac;
+}
+
+void msgpack_cunpacker_free(msgpack_cunpacker* cpac)
+{
+	if(cpac == NULL) { return; }
+	msgpack_cunpacker_destroy(cpac);
+	free(cpac);
+}
+
+bool msgpack_cunpacker_set_dictionary(msgpack_cunpacker* cpac,
+		const char* dictionary, size_t size)
+{
+	if(cpac->codec->decompressor_set_dictionary == NULL) {
+		return false;
+	}
+	return cpac->codec->decompressor_set_dictionary(cpac->ctx, dictionary, size);
+}
+
+bool msgpack_cunpacker_expand_buffer(msgpack_cunpacker* cpac, size_t size)
+{
+	/* moves the data which is not decompressed yet to the head */
+	const size_t rest = cpac->used - cpac->off;
+	size_t nsize = cpac->used + cpac->free;
+	if(rest > 0 && cpac->off > 0) {
+		memmove(cpac->buffer, cpac->buffer + cpac->off, rest);
+	}
+	cpac->free += cpac->off;
+	cpac->used = rest;
+	cpac->off = 0;
+	if(cpac->free >= size) {
+		return true;
+	}
+
+	if(nsize == 0) {
+		nsize = MSGPACK_CUNPACKER_INIT_BUFFER_SIZE;
+	}
+	while(nsize < rest + size) {
+		nsize *= 2;
+	}
+
+	{
+		char* tmp = (char*)realloc(cpac->buffer, nsize);
+		if(tmp == NULL) {
+			return false;
+		}
+		cpac->buffer = tmp;
+		cpac->free = nsize - rest;
+	}
+	return true;
+}
+
+bool msgpack_cunpacker_reserve_buffer(msgpack_cunpacker* cpac, size_t size)
+{
+	if(cpac->free >= size) { return true; }
+	return msgpack_cunpacker_expand_buffer(cpac, size);
+}
+
+char* msgpack_cunpacker_buffer(msgpack_cunpacker* cpac)
+{
+	return cpac->buffer + cpac->used;
+}
+
+size_t msgpack_cunpacker_buffer_capacity(const msgpack_cunpacker* cpac)
+{
+	return cpac->free;
+}
+
+void msgpack_cunpacker_buffer_consumed(msgpack_cunpacker* cpac, size_t size)
+{
+	cpac->used += size;
+	cpac->free -= size;
+}
+
+int msgpack_cunpacker_decompress(msgpack_cunpacker* cpac)
+{
+	msgpack_unpacker* const mpac = &cpac->mpac;
+	const char* in = cpac->buffer + cpac->off;
+	size_t in_size = cpac->used - cpac->off;
+	char* out;
+	size_t avail;
+	size_t rest;
+	int ret;
+
+	if(!msgpack_unpacker_reserve_buffer(mpac, cpac->window)) {
+		return MSGPACK_UNPACK_NOMEM_ERROR;
+	}
+	avail = msgpack_unpacker_buffer_capacity(mpac);
+	if(avail > cpac->window) {
+		avail = cpac->window;
+	}
+
+	out = msgpack_unpacker_buffer(mpac);
+	rest = avail;
+	ret = cpac->codec->decompress(cpac->ctx, &in, &in_size, &out, &rest);
+	cpac->off = cpac->used - in_size;
+	msgpack_unpacker_buffer_consumed(mpac, avail - rest);
+
+	if(ret == -2) {
+		return MSGPACK_UNPACK_NOMEM_ERROR;
+	}
+	if(ret < 0) {
+		return MSGPACK_UNPACK_PARSE_ERROR;
+	}
+	return ret;
+}
+
+int msgpack_cunpacker_execute(msgpack_cunpacker* cpac)
+{
+	while(true) {
+		int ret = msgpack_unpacker_execute(&cpac->mpac);
+		if(ret != 0) {
+			return ret;
+		}
+		ret = msgpack_cunpacker_decompress(cpac);
+		if(ret <= 0) {
+			return ret;
+		}
+	}
+}
+
+bool msgpack_cunpacker_next(msgpack_cunpacker* cpac, msgpack_unpacked* result)
+{
+	if(result->zone != NULL) {
+		msgpack_zone_free(result->zone);
+	}
+
+	if(msgpack_cunpacker_execute(cpac) <= 0) {
+		result->zone = NULL;
+		memset(&result->data, 0, sizeof(msgpack_object));
+		return false;
+	}
+
+	result->zone = msgpack_unpacker_release_zone(&cpac->mpac);
+	result->data = msgpack_unpacker_data(&cpac->mpac);
+	msgpack_unpacker_reset(&cpac->mpac);
+
+	return true;
+}
+
+/** @} */
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/cunpacker.h */
+
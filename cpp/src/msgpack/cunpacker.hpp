@@ -0,0 +1,154 @@
+//
+// MessagePack for C++ decompressing unpacker
+//
+// Copyright (C) 2010 FURUHASHI Sadayuki
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+#ifndef MSGPACK_CUNPACKER_HPP__
+#define MSGPACK_CUNPACKER_HPP__
+
+#include "msgpack/cunpacker.h"
+#include "msgpack/unpack.hpp"
+#include <stdexcept>
+
+namespace msgpack {
+
+
+// Unpacker of a stream compressed by cbuffer with the same codec.
+// It is used like unpacker; compressed data is decompressed into the
+// unpacker as next() needs it.
+//
+// msgpack::cunpacker pac(msgpack_codec_zstd());
+// while( /* input is readable */ ) {
+//     pac.reserve_buffer(32*1024);
+//     size_t bytes = input.readsome(pac.buffer(), pac.buffer_capacity());
+//     pac.buffer_consumed(bytes);
+//
+//     msgpack::unpacked result;
+//     while(pac.next(&result)) {
+//         on_message(result.get(), result.zone());
+//     }
+// }
+class cunpacker : public msgpack_cunpacker {
+public:
+	cunpacker(const msgpack_codec* codec = msgpack_codec_deflate(),
+			size_t init_buffer_size = MSGPACK_CUNPACKER_INIT_BUFFER_SIZE)
+	{
+		if(!msgpack_cunpacker_init(this, codec, init_buffer_size)) {
+			throw std::bad_alloc();
+		}
+	}
+
+	~cunpacker()
+	{
+		msgpack_cunpacker_destroy(this);
+	}
+
+public:
+	void reserve_buffer(size_t size = MSGPACK_UNPACKER_RESERVE_SIZE)
+	{
+		if(!msgpack_cunpacker_reserve_buffer(this, size)) {
+			throw std::bad_alloc();
+		}
+	}
+
+	char* buffer()
+	{
+		return msgpack_cunpacker_buffer(this);
+	}
+
+	size_t buffer_capacity() const
+	{
+		return msgpack_cunpacker_buffer_capacity(this);
+	}
+
+	void buffer_consumed(size_t size)
+	{
+		msgpack_cunpacker_buffer_consumed(this, size);
+	}
+
+	// see msgpack_cunpacker_set_dictionary()
+	void set_dictionary(const char* dictionary, size_t size)
+	{
+		if(!msgpack_cunpacker_set_dictionary(this, dictionary, size)) {
+			throw std::invalid_argument("cunpacker dictionary");
+		}
+	}
+
+	bool next(unpacked* result)
+	{
+		int ret = msgpack_cunpacker_execute(this);
+		if(ret == MSGPACK_UNPACK_NOMEM_ERROR) {
+			throw std::bad_alloc();
+		}
+		if(ret < 0) {
+			throw unpack_error("parse error");
+		}
+		if(ret == 0) {
+			result->zone().reset();
+			result->get() = object();
+			return false;
+		}
+		result->zone().reset( release_zone() );
+		result->get() = msgpack_unpacker_data(&mpac);
+		msgpack_unpacker_reset(&mpac);
+		return true;
+	}
+
+	// size of the decompressed message being deserialized
+	size_t message_size() const
+	{
+		return msgpack_unpacker_message_size(&mpac);
+	}
+
+	void set_limit(const unpack_limit& limit)
+	{
+		msgpack_unpacker_set_limit(&mpac, &limit);
+	}
+
+	void set_intern(size_t max_keys, size_t max_length = 32)
+	{
+		if(!msgpack_unpacker_set_intern(&mpac, max_keys, max_length)) {
+			throw std::bad_alloc();
+		}
+	}
+
+private:
+	zone* release_zone()
+	{
+		if(!msgpack_unpacker_flush_zone(&mpac)) {
+			throw std::bad_alloc();
+		}
+
+		zone* r = new zone();
+
+		msgpack_zone old = *mpac.z;
+		*mpac.z = *r;
+		*static_cast<msgpack_zone*>(r) = old;
+
+		return r;
+	}
+
+private:
+	typedef msgpack_cunpacker base;
+
+private:
+	cunpacker(const cunpacker&);
+};
+
+
+}  // namespace msgpack
+
+#endif /* msgpack/cunpacker.hpp */
+
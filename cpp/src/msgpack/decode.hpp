@@ -0,0 +1,463 @@
+//
+// MessagePack for C++ direct deserializer
+//
+// Copyright (C) 2008-2010 FURUHASHI Sadayuki
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+#ifndef MSGPACK_DECODE_HPP__
+#define MSGPACK_DECODE_HPP__
+
+#include "msgpack/unpack.h"
+#include "msgpack/sysdep.h"
+#include <limits>
+
+namespace msgpack {
+
+
+class zone;
+struct object;
+struct object_raw;
+
+
+// Reads serialized data directly into variables without building objects.
+// Types which have no direct decoder are deserialized into an object
+// allocated in the zone of the decoder, and converted from it.
+// Conversion rules and errors are the same as object::convert():
+// type_error on a type mismatch, unpack_error on broken or short data.
+class decoder {
+public:
+	decoder(const char* data, size_t len, size_t off = 0);
+	~decoder();
+
+public:
+	size_t offset() const;
+
+	/*! reads an array header and returns the number of elements */
+	uint32_t read_array();
+
+	/*! reads a map header and returns the number of pairs */
+	uint32_t read_map();
+
+	/*! reads an integer */
+	template <typename T>
+	T read_integer();
+
+	double read_double();
+	bool read_boolean();
+	void read_nil();
+
+	/*! returns a raw which refers to the data */
+	object_raw read_raw();
+
+	/*! returns true if the next object is a raw */
+	bool next_is_raw() const;
+
+	/*! deserializes an object into the zone of the decoder */
+	object read_object();
+
+	/*! skips an object */
+	void skip();
+
+private:
+	unsigned char peek() const;
+	const char* take(size_t n);
+	uint8_t take8();
+	uint16_t take16();
+	uint32_t take32();
+	uint64_t take64();
+	void check_elements(size_t n) const;
+	void mismatch(unsigned char head) const;
+
+	const char* m_ptr;
+	const char* const m_begin;
+	const char* const m_end;
+	zone* m_zone;
+
+private:
+	decoder(const decoder&);
+};
+
+
+// Deserializes one object into the variable.
+template <typename T>
+void decode(const char* data, size_t len, T& v, size_t* off = NULL);
+
+
+}  // namespace msgpack
+
+// decoders of types are defined in msgpack/type/*.hpp
+#include "msgpack/object.hpp"
+#include "msgpack/zone.hpp"
+
+namespace msgpack {
+
+
+namespace detail {
+
+// true if T has void msgpack_decode(decoder&), generated by MSGPACK_DEFINE
+template <typename T>
+class has_msgpack_decode {
+	typedef char yes;
+	typedef char (&no)[2];
+	template <typename U, void (U::*)(decoder&)> struct check;
+	template <typename U> static yes test(check<U, &U::msgpack_decode>*);
+	template <typename U> static no test(...);
+public:
+	static const bool value = sizeof(test<T>(0)) == sizeof(yes);
+};
+
+template <typename T, bool Direct = has_msgpack_decode<T>::value>
+struct decode_dispatch {
+	static void decode(decoder& d, T& v)
+		{ d.read_object().convert(&v); }
+};
+
+template <typename T>
+struct decode_dispatch<T, true> {
+	static void decode(decoder& d, T& v)
+		{ v.msgpack_decode(d); }
+};
+
+template <typename T, bool Signed>
+struct decode_integer_sign;
+
+template <typename T>
+struct decode_integer_sign<T, true> {
+	static inline T positive(uint64_t u)
+	{
+		if(u > (uint64_t)std::numeric_limits<T>::max()) { throw type_error(); }
+		return (T)u;
+	}
+	static inline T negative(int64_t i)
+	{
+		if(i < (int64_t)std::numeric_limits<T>::min()) { throw type_error(); }
+		return (T)i;
+	}
+};
+
+template <typename T>
+struct decode_integer_sign<T, false> {
+	static inline T positive(uint64_t u)
+	{
+		if(u > (uint64_t)std::numeric_limits<T>::max()) { throw type_error(); }
+		return (T)u;
+	}
+	static inline T negative(int64_t i)
+	{
+		throw type_error();
+	}
+};
+
+}  // namespace detail
+
+
+template <typename T>
+inline decoder& operator>> (decoder& d, T& v)
+{
+	detail::decode_dispatch<T>::decode(d, v);
+	return d;
+}
+
+inline decoder& operator>> (decoder& d, object& v)
+	{ v = d.read_object(); return d; }
+
+inline decoder::decoder(const char* data, size_t len, size_t off) :
+	m_ptr(data + off), m_begin(data), m_end(data + len), m_zone(NULL) { }
+
+inline decoder::~decoder()
+{
+	delete m_zone;
+}
+
+inline size_t decoder::offset() const
+{
+	return m_ptr - m_begin;
+}
+
+inline unsigned char decoder::peek() const
+{
+	if(m_ptr == m_end) { throw unpack_error("insufficient bytes"); }
+	return (unsigned char)*m_ptr;
+}
+
+inline const char* decoder::take(size_t n)
+{
+	if((size_t)(m_end - m_ptr) < n) { throw unpack_error("insufficient bytes"); }
+	const char* p = m_ptr;
+	m_ptr += n;
+	return p;
+}
+
+// take a header byte and a big-endian number following it
+inline uint8_t decoder::take8()
+{
+	const char* p = take(2);
+	return *(uint8_t*)(p + 1);
+}
+
+inline uint16_t decoder::take16()
+{
+	const char* p = take(3);
+	return _msgpack_load16(uint16_t, (p + 1));
+}
+
+inline uint32_t decoder::take32()
+{
+	const char* p = take(5);
+	return _msgpack_load32(uint32_t, (p + 1));
+}
+
+inline uint64_t decoder::take64()
+{
+	const char* p = take(9);
+	return _msgpack_load64(uint64_t, (p + 1));
+}
+
+inline void decoder::check_elements(size_t n) const
+{
+	// every element takes at least 1 byte
+	if((size_t)(m_end - m_ptr) < n) { throw unpack_error("insufficient bytes"); }
+}
+
+inline void decoder::mismatch(unsigned char head) const
+{
+	if(head == 0xc1 || (0xc4 <= head && head <= 0xc9) ||
+			(0xd4 <= head && head <= 0xd9)) {
+		throw unpack_error("parse error");
+	}
+	throw type_error();
+}
+
+inline uint32_t decoder::read_array()
+{
+	const unsigned char h = peek();
+	uint32_t n;
+	if(0x90 <= h && h <= 0x9f) {
+		++m_ptr;
+		n = h & 0x0f;
+	} else if(h == 0xdc) {
+		n = take16();
+	} else if(h == 0xdd) {
+		n = take32();
+	} else {
+		mismatch(h);
+		return 0;
+	}
+	check_elements(n);
+	return n;
+}
+
+inline uint32_t decoder::read_map()
+{
+	const unsigned char h = peek();
+	uint32_t n;
+	if(0x80 <= h && h <= 0x8f) {
+		++m_ptr;
+		n = h & 0x0f;
+	} else if(h == 0xde) {
+		n = take16();
+	} else if(h == 0xdf) {
+		n = take32();
+	} else {
+		mismatch(h);
+		return 0;
+	}
+	check_elements((size_t)n * 2);
+	return n;
+}
+
+template <typename T>
+inline T decoder::read_integer()
+{
+	typedef detail::decode_integer_sign<T, std::numeric_limits<T>::is_signed> sign;
+	const unsigned char h = peek();
+	int64_t i;
+	if(h <= 0x7f) {
+		++m_ptr;
+		return sign::positive(h);
+	} else if(h >= 0xe0) {
+		++m_ptr;
+		return sign::negative((int8_t)h);
+	}
+	switch(h) {
+	case 0xcc:
+		return sign::positive(take8());
+	case 0xcd:
+		return sign::positive(take16());
+	case 0xce:
+		return sign::positive(take32());
+	case 0xcf:
+		return sign::positive(take64());
+	case 0xd0:
+		i = (int8_t)take8();
+		break;
+	case 0xd1:
+		i = (int16_t)take16();
+		break;
+	case 0xd2:
+		i = (int32_t)take32();
+		break;
+	case 0xd3:
+		i = (int64_t)take64();
+		break;
+	default:
+		mismatch(h);
+		return 0;
+	}
+	if(i >= 0) {
+		return sign::positive(i);
+	}
+	return sign::negative(i);
+}
+
+inline double decoder::read_double()
+{
+	const unsigned char h = peek();
+	if(h == 0xca) {
+		union { uint32_t i; float f; } mem;
+		mem.i = take32();
+		return mem.f;
+	} else if(h == 0xcb) {
+		union { uint64_t i; double f; } mem;
+		mem.i = take64();
+		return mem.f;
+	}
+	mismatch(h);
+	return 0;
+}
+
+inline bool decoder::read_boolean()
+{
+	const unsigned char h = peek();
+	if(h == 0xc2 || h == 0xc3) {
+		++m_ptr;
+		return h == 0xc3;
+	}
+	mismatch(h);
+	return false;
+}
+
+inline void decoder::read_nil()
+{
+	const unsigned char h = peek();
+	if(h != 0xc0) {
+		mismatch(h);
+	}
+	++m_ptr;
+}
+
+inline object_raw decoder::read_raw()
+{
+	const unsigned char h = peek();
+	uint32_t n;
+	if(0xa0 <= h && h <= 0xbf) {
+		++m_ptr;
+		n = h & 0x1f;
+	} else if(h == 0xda) {
+		n = take16();
+	} else if(h == 0xdb) {
+		n = take32();
+	} else {
+		mismatch(h);
+		n = 0;
+	}
+	object_raw r;
+	r.ptr = take(n);
+	r.size = n;
+	return r;
+}
+
+inline bool decoder::next_is_raw() const
+{
+	const unsigned char h = peek();
+	return (0xa0 <= h && h <= 0xbf) || h == 0xda || h == 0xdb;
+}
+
+inline object decoder::read_object()
+{
+	if(m_zone == NULL) {
+		m_zone = new zone();
+	}
+
+	object o;
+	size_t off = offset();
+	switch(msgpack_unpack(m_begin, m_end - m_begin, &off, m_zone,
+				reinterpret_cast<msgpack_object*>(&o))) {
+	case MSGPACK_UNPACK_SUCCESS:
+	case MSGPACK_UNPACK_EXTRA_BYTES:
+		m_ptr = m_begin + off;
+		return o;
+
+	case MSGPACK_UNPACK_CONTINUE:
+		throw unpack_error("insufficient bytes");
+
+	case MSGPACK_UNPACK_PARSE_ERROR:
+	default:
+		throw unpack_error("parse error");
+	}
+}
+
+inline void decoder::skip()
+{
+	size_t count = 1;
+	do {
+		const unsigned char h = peek();
+		--count;
+		if(h <= 0x7f || h >= 0xe0 || h == 0xc0 || h == 0xc2 || h == 0xc3) {
+			++m_ptr;
+		} else if(0xa0 <= h && h <= 0xbf) {
+			read_raw();
+		} else if(0x90 <= h && h <= 0x9f) {
+			++m_ptr;
+			count += h & 0x0f;
+		} else if(0x80 <= h && h <= 0x8f) {
+			++m_ptr;
+			count += (h & 0x0f) * 2;
+		} else {
+			switch(h) {
+			case 0xcc: case 0xd0: take(2); break;
+			case 0xcd: case 0xd1: take(3); break;
+			case 0xca: case 0xce: case 0xd2: take(5); break;
+			case 0xcb: case 0xcf: case 0xd3: take(9); break;
+			case 0xda: case 0xdb: read_raw(); break;
+			case 0xdc: case 0xdd: count += read_array(); break;
+			case 0xde: case 0xdf: count += (size_t)read_map() * 2; break;
+			default: throw unpack_error("parse error");
+			}
+		}
+	} while(count > 0);
+}
+
+
+template <typename T>
+inline void decode(const char* data, size_t len, T& v, size_t* off)
+{
+	size_t noff = 0;
+	if(off != NULL) { noff = *off; }
+
+	decoder d(data, len, noff);
+	d >> v;
+
+	if(off != NULL) {
+		*off = d.offset();
+	} else if(d.offset() < len) {
+		throw unpack_error("extra bytes");
+	}
+}
+
+
+}  // namespace msgpack
+
+#endif /* msgpack/decode.hpp */
+
@@ -0,0 +1,60 @@
+/*
+ * MessagePack for C hash functions
+ *
+ * Copyright (C) 2008-2010 FURUHASHI Sadayuki
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+#ifndef MSGPACK_HASH_H__
+#define MSGPACK_HASH_H__
+
+#include "msgpack/object.h"
+#include "msgpack/unpack.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_hash Hash functions
+ * @ingroup msgpack
+ * @{
+ */
+
+/**
+ * Hashes a byte sequence.
+ * The result doesn't depend on the byte order of the host,
+ * so it can be stored or sent to other hosts.
+ */
+uint64_t msgpack_hash_bytes(const void* data, size_t len, uint64_t seed);
+
+/**
+ * Hashes one serialized object without deserializing it.
+ * The result equals to msgpack_object_hash() of the deserialized object,
+ * regardless of the width of integers or floats in the serialized form.
+ * *off is updated like msgpack_unpack().
+ */
+msgpack_unpack_return
+msgpack_hash_encoded(const char* data, size_t len, size_t* off,
+		uint64_t* result);
+
+/** @} */
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/hash.h */
+
@@ -0,0 +1,83 @@
+/*
+ * MessagePack for C JSON transcoder
+ *
+ * Copyright (C) 2008-2010 FURUHASHI Sadayuki
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+#ifndef MSGPACK_JSON_H__
+#define MSGPACK_JSON_H__
+
+#include "msgpack/pack.h"
+#include "msgpack/unpack.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_json JSON transcoder
+ * @ingroup msgpack
+ *
+ * Converts serialized objects to JSON text and JSON text to serialized
+ * objects directly, without deserializing them into objects:
+ *
+ *     msgpack_to_json(data, len, &off, &sbuf, msgpack_sbuffer_write);
+ *     msgpack_pack_json(&pk, text, text_len, &off);
+ *
+ * @{
+ */
+
+/**
+ * Writes one serialized object as JSON text through the callback.
+ * Raws are written as strings assuming they are UTF-8; quotation marks,
+ * backslashes and control characters are escaped. NaN and infinities
+ * are written as null. Keys of maps which are not raws are written as
+ * strings of their JSON text; arrays and maps as keys are parse errors.
+ *
+ * Returns MSGPACK_UNPACK_SUCCESS or MSGPACK_UNPACK_EXTRA_BYTES and
+ * updates *off like msgpack_unpack(); MSGPACK_UNPACK_CONTINUE without
+ * writing anything if the data is insufficient;
+ * MSGPACK_UNPACK_PARSE_ERROR if the data is broken;
+ * MSGPACK_UNPACK_NOMEM_ERROR if the callback or memory allocation failed.
+ * A part of the text may have been written on errors.
+ */
+msgpack_unpack_return
+msgpack_to_json(const char* data, size_t len, size_t* off,
+		void* out, msgpack_packer_write callback);
+
+/**
+ * Parses one JSON value and serializes it with the packer.
+ * Numbers without a fraction or an exponent are packed as integers if
+ * they fit in 64 bits, and others as doubles. Strings are unescaped
+ * into raws, encoding \\u escapes in UTF-8.
+ *
+ * White spaces around the value are skipped. Returns like
+ * msgpack_to_json(): MSGPACK_UNPACK_EXTRA_BYTES if other text follows
+ * the value, and MSGPACK_UNPACK_CONTINUE if the text ends inside it.
+ * Nothing is packed if the text is not valid JSON.
+ */
+msgpack_unpack_return
+msgpack_pack_json(msgpack_packer* pk,
+		const char* data, size_t len, size_t* off);
+
+/** @} */
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/json.h */
+
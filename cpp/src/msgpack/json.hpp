@@ -0,0 +1,142 @@
+//
+// MessagePack for C++ JSON transcoder
+//
+// Copyright (C) 2008-2010 FURUHASHI Sadayuki
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+#ifndef MSGPACK_JSON_HPP__
+#define MSGPACK_JSON_HPP__
+
+#include "msgpack/json.h"
+#include "msgpack/object.hpp"
+#include <stdexcept>
+#include <exception>
+#include <string>
+
+namespace msgpack {
+
+
+namespace detail {
+	// An exception thrown by the stream is caught in the callback, since
+	// exceptions must not pass through the C code, and is thrown again
+	// after the C code returns. Without C++11, std::bad_alloc is thrown as
+	// it is and other exceptions as std::runtime_error with their what().
+	template <typename Stream>
+	class json_stream {
+	public:
+		json_stream(Stream& s) : m_stream(s), m_failed(false) { }
+
+		static int write(void* data, const char* buf, unsigned int len)
+		{
+			json_stream* self = static_cast<json_stream*>(data);
+			try {
+				self->m_stream.write(buf, len);
+			} catch(...) {
+				self->record();
+				return -1;
+			}
+			return 0;
+		}
+
+		void rethrow() const
+		{
+			if(!m_failed) { return; }
+#ifdef MSGPACK_USE_CPP11
+			std::rethrow_exception(m_error);
+#else
+			if(m_nomem) { throw std::bad_alloc(); }
+			throw std::runtime_error(m_what);
+#endif
+		}
+
+	private:
+		void record()
+		{
+			m_failed = true;
+#ifdef MSGPACK_USE_CPP11
+			m_error = std::current_exception();
+#else
+			m_nomem = false;
+			try {
+				throw;
+			} catch(std::bad_alloc&) {
+				m_nomem = true;
+			} catch(std::exception& e) {
+				m_what = e.what();
+			} catch(...) {
+				m_what = "stream write failed";
+			}
+#endif
+		}
+
+		Stream& m_stream;
+		bool m_failed;
+#ifdef MSGPACK_USE_CPP11
+		std::exception_ptr m_error;
+#else
+		bool m_nomem;
+		std::string m_what;
+#endif
+	};
+
+	inline void json_check(msgpack_unpack_return ret, size_t* off)
+	{
+		switch(ret) {
+		case MSGPACK_UNPACK_SUCCESS:
+			return;
+		case MSGPACK_UNPACK_EXTRA_BYTES:
+			if(off) { return; }
+			throw unpack_error("extra bytes");
+		case MSGPACK_UNPACK_CONTINUE:
+			throw unpack_error("insufficient bytes");
+		case MSGPACK_UNPACK_NOMEM_ERROR:
+			throw std::bad_alloc();
+		case MSGPACK_UNPACK_PARSE_ERROR:
+		default:
+			throw unpack_error("parse error");
+		}
+	}
+}
+
+
+// Writes one serialized object as JSON text into the stream, which has
+// write(const char*, size_t) like sbuffer and std::ostream.
+// Exceptions of the stream are thrown again.
+template <typename Stream>
+inline void to_json(Stream& s, const char* data, size_t len, size_t* off = NULL)
+{
+	detail::json_stream<Stream> js(s);
+	msgpack_unpack_return ret = msgpack_to_json(data, len, off,
+			&js, &detail::json_stream<Stream>::write);
+	js.rethrow();
+	detail::json_check(ret, off);
+}
+
+// Parses one JSON value and writes it serialized into the stream.
+template <typename Stream>
+inline void pack_json(Stream& s, const char* data, size_t len, size_t* off = NULL)
+{
+	detail::json_stream<Stream> js(s);
+	msgpack_packer pk;
+	msgpack_packer_init(&pk, &js, &detail::json_stream<Stream>::write);
+	msgpack_unpack_return ret = msgpack_pack_json(&pk, data, len, off);
+	js.rethrow();
+	detail::json_check(ret, off);
+}
+
+
+}  // namespace msgpack
+
+#endif /* msgpack/json.hpp */
+
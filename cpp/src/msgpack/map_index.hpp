@@ -0,0 +1,141 @@
+//
+// MessagePack for C++ hash index of maps
+//
+// Copyright (C) 2008-2010 FURUHASHI Sadayuki
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+#ifndef MSGPACK_MAP_INDEX_HPP__
+#define MSGPACK_MAP_INDEX_HPP__
+
+#include "msgpack/object.hpp"
+#include "msgpack/zone.hpp"
+#include <string.h>
+
+namespace msgpack {
+
+
+// Lookup table of a map object.
+// The table is allocated in the zone on the first call of find() and
+// refers to the elements of the map, so it must not outlive the zone
+// that holds the map.
+class map_index {
+public:
+	map_index(object map, zone* z);
+
+public:
+	/*! returns the value of the first pair whose key equals to the key */
+	const object* find(const object& key) const;
+
+	/*! finds a raw key without copying it */
+	const object* find(const char* key, size_t len) const;
+
+	template <typename T>
+	const object* find(const T& key) const
+		{ return find(object(key)); }
+
+	uint32_t size() const { return m_map.size; }
+
+private:
+	struct slot {
+		uint32_t hash;
+		uint32_t index;  // index of the pair + 1, 0 if empty
+	};
+
+	void build() const;
+	const object* lookup(const object& key, uint32_t hash) const;
+
+	object_map m_map;
+	zone* m_zone;
+	mutable slot* m_slots;
+	mutable uint32_t m_mask;
+};
+
+
+inline map_index::map_index(object map, zone* z) :
+	m_zone(z), m_slots(NULL), m_mask(0)
+{
+	if(map.type != type::MAP) { throw type_error(); }
+	m_map = map.via.map;
+}
+
+inline void map_index::build() const
+{
+	size_t n = 8;
+	while(n < (size_t)m_map.size * 2) { n *= 2; }
+
+	slot* slots = (slot*)m_zone->malloc(sizeof(slot) * n);
+	memset(slots, 0, sizeof(slot) * n);
+	const uint32_t mask = n - 1;
+
+	for(uint32_t i=0; i < m_map.size; ++i) {
+		const object& key = m_map.ptr[i].key;
+		const uint32_t hash = (uint32_t)msgpack_object_hash(key);
+		uint32_t pos = hash & mask;
+		while(true) {
+			slot& s = slots[pos];
+			if(s.index == 0) {
+				s.hash = hash;
+				s.index = i + 1;
+				break;
+			}
+			if(s.hash == hash && m_map.ptr[s.index-1].key == key) {
+				break;  // keep the first one of duplicated keys
+			}
+			pos = (pos + 1) & mask;
+		}
+	}
+
+	m_mask = mask;
+	m_slots = slots;
+}
+
+inline const object* map_index::lookup(const object& key, uint32_t hash) const
+{
+	if(m_slots == NULL) { build(); }
+
+	uint32_t pos = hash & m_mask;
+	while(true) {
+		const slot& s = m_slots[pos];
+		if(s.index == 0) {
+			return NULL;
+		}
+		if(s.hash == hash) {
+			const object_kv& kv = m_map.ptr[s.index-1];
+			if(kv.key == key) {
+				return &kv.val;
+			}
+		}
+		pos = (pos + 1) & m_mask;
+	}
+}
+
+inline const object* map_index::find(const object& key) const
+{
+	return lookup(key, (uint32_t)msgpack_object_hash(key));
+}
+
+inline const object* map_index::find(const char* key, size_t len) const
+{
+	object o;
+	o.type = type::RAW;
+	o.via.raw.ptr = key;
+	o.via.raw.size = len;
+	return find(o);
+}
+
+
+}  // namespace msgpack
+
+#endif /* msgpack/map_index.hpp */
+
@@ -0,0 +1,248 @@
+/*
+ * MessagePack for C memory-mapped file buffer implementation
+ *
+ * Copyright (C) 2010 FURUHASHI Sadayuki
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+#ifndef MSGPACK_MBUFFER_H__
+#define MSGPACK_MBUFFER_H__
+
+#include "msgpack/sysdep.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_mbuffer Memory-mapped file buffer
+ * @ingroup msgpack_buffer
+ *
+ * Buffer which writes into a file through a mapping instead of memory.
+ * The file is extended by extent bytes at a time and only the extent
+ * being written is mapped, so the memory used stays the same however
+ * large the file grows; finished extents are unmapped and left to the
+ * kernel to write back. Extents are allocated with posix_fallocate
+ * where the file system supports it (ftruncate otherwise), so that a
+ * full disk fails a write instead of raising SIGBUS.
+ *
+ * msgpack_mbuffer_close() truncates the file to the written size. It
+ * does not fsync the file.
+ * @{
+ */
+
+typedef struct msgpack_mbuffer {
+	int fd;
+	size_t extent;
+	char* map;          /* the extent being written */
+	size_t map_size;
+	off_t map_off;      /* file offset of map */
+	size_t used;        /* bytes written to map */
+	off_t reserved;     /* size the file is extended to */
+} msgpack_mbuffer;
+
+#ifndef MSGPACK_MBUFFER_EXTENT
+#define MSGPACK_MBUFFER_EXTENT (64*1024*1024)
+#endif
+
+/**
+ * Creates or truncates the file at path. extent is rounded up to a
+ * multiple of the page size.
+ */
+static inline bool msgpack_mbuffer_init(msgpack_mbuffer* mbuf,
+		const char* path, size_t extent);
+static inline void msgpack_mbuffer_destroy(msgpack_mbuffer* mbuf);
+
+static inline msgpack_mbuffer* msgpack_mbuffer_new(const char* path, size_t extent);
+static inline void msgpack_mbuffer_free(msgpack_mbuffer* mbuf);
+
+static inline int msgpack_mbuffer_write(void* data, const char* buf, unsigned int len);
+
+/**
+ * The number of bytes written.
+ */
+static inline uint64_t msgpack_mbuffer_size(const msgpack_mbuffer* mbuf);
+
+/**
+ * Unmaps the file, truncates it to msgpack_mbuffer_size() and closes it.
+ * @return false on errors, with errno set.
+ */
+static inline bool msgpack_mbuffer_close(msgpack_mbuffer* mbuf);
+
+/** @} */
+
+
+bool msgpack_mbuffer_init(msgpack_mbuffer* mbuf,
+		const char* path, size_t extent)
+{
+	const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	if(extent == 0) {
+		extent = page;
+	}
+	extent = (extent + page - 1) / page * page;
+
+	/* mappings need read access even when only written */
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) {
+		return false;
+	}
+
+	mbuf->fd = fd;
+	mbuf->extent = extent;
+	mbuf->map = NULL;
+	mbuf->map_size = 0;
+	mbuf->map_off = 0;
+	mbuf->used = 0;
+	mbuf->reserved = 0;
+	return true;
+}
+
+void msgpack_mbuffer_destroy(msgpack_mbuffer* mbuf)
+{
+	msgpack_mbuffer_close(mbuf);
+}
+
+msgpack_mbuffer* msgpack_mbuffer_new(const char* path, size_t extent)
+{
+	msgpack_mbuffer* mbuf = (msgpack_mbuffer*)malloc(sizeof(msgpack_mbuffer));
+	if(mbuf == NULL) {
+		return NULL;
+	}
+
+	if(!msgpack_mbuffer_init(mbuf, path, extent)) {
+		free(mbuf);
+		return NULL;
+	}
+	return mbuf;
+}
+
+void msgpack_mbuffer_free(msgpack_mbuffer* mbuf)
+{
+	if(mbuf == NULL) { return; }
+	msgpack_mbuffer_destroy(mbuf);
+	free(mbuf);
+}
+
+static inline bool msgpack_mbuffer_next_extent(msgpack_mbuffer* mbuf)
+{
+	if(mbuf->fd < 0) {
+		errno = EBADF;
+		return false;
+	}
+
+	if(mbuf->map != NULL) {
+		munmap(mbuf->map, mbuf->map_size);
+		mbuf->map = NULL;
+	}
+	mbuf->map_off += mbuf->map_size;
+	mbuf->map_size = 0;
+	mbuf->used = 0;
+
+	const off_t end = mbuf->map_off + (off_t)mbuf->extent;
+	if(mbuf->reserved < end) {
+		int err = posix_fallocate(mbuf->fd, mbuf->map_off, mbuf->extent);
+		if(err != 0) {
+			if(err != EINVAL && err != EOPNOTSUPP) {
+				errno = err;
+				return false;
+			}
+			if(ftruncate(mbuf->fd, end) < 0) {
+				return false;
+			}
+		}
+		mbuf->reserved = end;
+	}
+
+	void* map = mmap(NULL, mbuf->extent, PROT_READ | PROT_WRITE,
+			MAP_SHARED, mbuf->fd, mbuf->map_off);
+	if(map == MAP_FAILED) {
+		return false;
+	}
+	madvise(map, mbuf->extent, MADV_SEQUENTIAL);
+
+	mbuf->map = (char*)map;
+	mbuf->map_size = mbuf->extent;
+	return true;
+}
+
+int msgpack_mbuffer_write(void* data, const char* buf, unsigned int len)
+{
+	msgpack_mbuffer* mbuf = (msgpack_mbuffer*)data;
+
+	if(len == 0) {
+		return 0;
+	}
+
+	while(mbuf->map_size - mbuf->used < len) {
+		size_t n = mbuf->map_size - mbuf->used;
+		if(n > 0) {
+			memcpy(mbuf->map + mbuf->used, buf, n);
+			mbuf->used += n;
+			buf += n;
+			len -= n;
+		}
+		if(!msgpack_mbuffer_next_extent(mbuf)) {
+			return -1;
+		}
+	}
+
+	memcpy(mbuf->map + mbuf->used, buf, len);
+	mbuf->used += len;
+	return 0;
+}
+
+uint64_t msgpack_mbuffer_size(const msgpack_mbuffer* mbuf)
+{
+	return (uint64_t)mbuf->map_off + mbuf->used;
+}
+
+bool msgpack_mbuffer_close(msgpack_mbuffer* mbuf)
+{
+	if(mbuf->fd < 0) {
+		return true;
+	}
+
+	bool ok = true;
+	if(mbuf->map != NULL && munmap(mbuf->map, mbuf->map_size) < 0) {
+		ok = false;
+	}
+	mbuf->map = NULL;
+	mbuf->map_off += mbuf->used;
+	mbuf->map_size = 0;
+	mbuf->used = 0;
+
+	if(ftruncate(mbuf->fd, mbuf->map_off) < 0) {
+		ok = false;
+	}
+	if(close(mbuf->fd) < 0) {
+		ok = false;
+	}
+	mbuf->fd = -1;
+	return ok;
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/mbuffer.h */
+
@@ -0,0 +1,74 @@
+//
+// MessagePack for C++ memory-mapped file buffer implementation
+//
+// Copyright (C) 2010 FURUHASHI Sadayuki
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+#ifndef MSGPACK_MBUFFER_HPP__
+#define MSGPACK_MBUFFER_HPP__
+
+#include "msgpack/mbuffer.h"
+#include <stdexcept>
+
+namespace msgpack {
+
+
+// Buffer which packs into a file through a sliding mapping;
+// see msgpack_mbuffer. The file is closed by close() or the destructor.
+class mbuffer : public msgpack_mbuffer {
+public:
+	mbuffer(const char* path, size_t extent = MSGPACK_MBUFFER_EXTENT)
+	{
+		if(!msgpack_mbuffer_init(this, path, extent)) {
+			throw std::runtime_error("mbuffer open failed");
+		}
+	}
+
+	~mbuffer()
+	{
+		msgpack_mbuffer_destroy(this);
+	}
+
+public:
+	void write(const char* buf, unsigned int len)
+	{
+		if(msgpack_mbuffer_write(this, buf, len) < 0) {
+			throw std::runtime_error("mbuffer write failed");
+		}
+	}
+
+	uint64_t size() const
+	{
+		return msgpack_mbuffer_size(this);
+	}
+
+	void close()
+	{
+		if(!msgpack_mbuffer_close(this)) {
+			throw std::runtime_error("mbuffer close failed");
+		}
+	}
+
+private:
+	typedef msgpack_mbuffer base;
+
+private:
+	mbuffer(const mbuffer&);
+};
+
+
+}  // namespace msgpack
+
+#endif /* msgpack/mbuffer.hpp */
+
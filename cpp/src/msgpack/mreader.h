@@ -0,0 +1,316 @@
+/*
+ * MessagePack for C memory-mapped file reader implementation
+ *
+ * Copyright (C) 2010 FURUHASHI Sadayuki
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+#ifndef MSGPACK_MREADER_H__
+#define MSGPACK_MREADER_H__
+
+#include "msgpack/unpack.h"
+#include "msgpack/sysdep.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_mreader Memory-mapped file reader
+ * @ingroup msgpack_unpack
+ *
+ * Deserializes the messages of a file from a read-only mapping of it,
+ * without copying them into a buffer. Raw objects point into the
+ * mapping.
+ *
+ * The file is mapped window by window, so files larger than memory or
+ * than the address space can be read. The zone of each message keeps
+ * the window it was deserialized from mapped with a finalizer, so the
+ * objects stay valid after the reader moves on or is destroyed.
+ * Windows are advised MADV_SEQUENTIAL, and MADV_WILLNEED is applied to
+ * the readahead bytes after the cursor as it advances.
+ * @{
+ */
+
+typedef struct msgpack_mreader_window {
+	_msgpack_atomic_counter_t count;
+	char* map;
+	size_t size;
+} msgpack_mreader_window;
+
+typedef struct msgpack_mreader {
+	int fd;
+	uint64_t file_size;
+	size_t window_size;
+	size_t readahead;
+	size_t page;
+	msgpack_mreader_window* window;
+	uint64_t window_off;  /* file offset of the window */
+	size_t off;           /* cursor in the window */
+	size_t advised;       /* end of the range advised MADV_WILLNEED */
+} msgpack_mreader;
+
+#ifndef MSGPACK_MREADER_WINDOW_SIZE
+#define MSGPACK_MREADER_WINDOW_SIZE (256*1024*1024)
+#endif
+
+#ifndef MSGPACK_MREADER_READAHEAD
+#define MSGPACK_MREADER_READAHEAD (4*1024*1024)
+#endif
+
+/**
+ * Opens the file at path. A window is mapped up to window_size bytes,
+ * or more if a message is larger than that.
+ */
+static inline bool msgpack_mreader_init(msgpack_mreader* mr, const char* path,
+		size_t window_size, size_t readahead);
+static inline void msgpack_mreader_destroy(msgpack_mreader* mr);
+
+static inline msgpack_mreader* msgpack_mreader_new(const char* path,
+		size_t window_size, size_t readahead);
+static inline void msgpack_mreader_free(msgpack_mreader* mr);
+
+/**
+ * Deserializes the next message into the zone. Objects already in the
+ * zone are kept.
+ * @return 1 if a message is deserialized, 0 at the end of the file,
+ *         MSGPACK_UNPACK_PARSE_ERROR on broken or truncated data and
+ *         MSGPACK_UNPACK_NOMEM_ERROR if memory or the mapping fails.
+ */
+static inline int msgpack_mreader_execute(msgpack_mreader* mr,
+		msgpack_zone* z, msgpack_object* obj);
+
+/**
+ * Deserializes the next message like msgpack_unpacker_next().
+ * Returns false at the end of the file and on errors.
+ */
+static inline bool msgpack_mreader_next(msgpack_mreader* mr, msgpack_unpacked* result);
+
+/**
+ * Offset of the next message in the file.
+ */
+static inline uint64_t msgpack_mreader_offset(const msgpack_mreader* mr);
+
+/** @} */
+
+
+static inline void msgpack_mreader_window_release(void* data)
+{
+	msgpack_mreader_window* w = (msgpack_mreader_window*)data;
+	if(_msgpack_sync_decr_and_fetch(&w->count) == 0) {
+		munmap(w->map, w->size);
+		free(w);
+	}
+}
+
+bool msgpack_mreader_init(msgpack_mreader* mr, const char* path,
+		size_t window_size, size_t readahead)
+{
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) < 0) {
+		close(fd);
+		return false;
+	}
+
+	mr->fd = fd;
+	mr->file_size = st.st_size;
+	mr->page = (size_t)sysconf(_SC_PAGESIZE);
+	mr->window_size = window_size < mr->page ? mr->page : window_size;
+	mr->readahead = readahead;
+	mr->window = NULL;
+	mr->window_off = 0;
+	mr->off = 0;
+	mr->advised = 0;
+	return true;
+}
+
+void msgpack_mreader_destroy(msgpack_mreader* mr)
+{
+	if(mr->window != NULL) {
+		msgpack_mreader_window_release(mr->window);
+		mr->window = NULL;
+	}
+	close(mr->fd);
+}
+
+msgpack_mreader* msgpack_mreader_new(const char* path,
+		size_t window_size, size_t readahead)
+{
+	msgpack_mreader* mr = (msgpack_mreader*)malloc(sizeof(msgpack_mreader));
+	if(mr == NULL) {
+		return NULL;
+	}
+
+	if(!msgpack_mreader_init(mr, path, window_size, readahead)) {
+		free(mr);
+		return NULL;
+	}
+	return mr;
+}
+
+void msgpack_mreader_free(msgpack_mreader* mr)
+{
+	if(mr == NULL) { return; }
+	msgpack_mreader_destroy(mr);
+	free(mr);
+}
+
+static inline void msgpack_mreader_readahead(msgpack_mreader* mr)
+{
+	msgpack_mreader_window* const w = mr->window;
+	if(mr->readahead == 0 || mr->advised >= w->size ||
+			mr->off + mr->readahead / 2 < mr->advised) {
+		return;
+	}
+
+	size_t begin = mr->advised / mr->page * mr->page;
+	size_t end = mr->off + mr->readahead;
+	if(end > w->size) {
+		end = w->size;
+	}
+	madvise(w->map + begin, end - begin, MADV_WILLNEED);
+	mr->advised = end;
+}
+
+/* maps a window from the page of the cursor */
+static inline bool msgpack_mreader_map(msgpack_mreader* mr, size_t size)
+{
+	const uint64_t pos = mr->window_off + mr->off;
+	const uint64_t begin = pos / mr->page * mr->page;
+	if(size > mr->file_size - begin) {
+		size = mr->file_size - begin;
+	}
+
+	msgpack_mreader_window* w = (msgpack_mreader_window*)malloc(
+			sizeof(msgpack_mreader_window));
+	if(w == NULL) {
+		return false;
+	}
+
+	void* map = mmap(NULL, size, PROT_READ, MAP_SHARED, mr->fd, (off_t)begin);
+	if(map == MAP_FAILED) {
+		free(w);
+		return false;
+	}
+	madvise(map, size, MADV_SEQUENTIAL);
+
+	w->count = 1;
+	w->map = (char*)map;
+	w->size = size;
+
+	if(mr->window != NULL) {
+		msgpack_mreader_window_release(mr->window);
+	}
+	mr->window = w;
+	mr->window_off = begin;
+	mr->off = pos - begin;
+	mr->advised = mr->off;
+	msgpack_mreader_readahead(mr);
+	return true;
+}
+
+int msgpack_mreader_execute(msgpack_mreader* mr,
+		msgpack_zone* z, msgpack_object* obj)
+{
+	size_t size = mr->window_size;
+	const msgpack_zone_chunk_list mark = z->chunk_list;
+
+	while(true) {
+		if(mr->window_off + mr->off >= mr->file_size) {
+			return 0;
+		}
+
+		if(mr->window == NULL || mr->off >= mr->window->size) {
+			if(!msgpack_mreader_map(mr, size)) {
+				return MSGPACK_UNPACK_NOMEM_ERROR;
+			}
+		}
+
+		msgpack_mreader_window* const w = mr->window;
+		size_t noff = mr->off;
+		msgpack_unpack_return ret = msgpack_unpack(w->map, w->size, &noff, z, obj);
+
+		if(ret == MSGPACK_UNPACK_SUCCESS || ret == MSGPACK_UNPACK_EXTRA_BYTES) {
+			if(!msgpack_zone_push_finalizer(z, msgpack_mreader_window_release, w)) {
+				return MSGPACK_UNPACK_NOMEM_ERROR;
+			}
+			_msgpack_sync_incr_and_fetch(&w->count);
+			mr->off = noff;
+			msgpack_mreader_readahead(mr);
+			return 1;
+		}
+		if(ret == MSGPACK_UNPACK_PARSE_ERROR) {
+			return MSGPACK_UNPACK_PARSE_ERROR;
+		}
+
+		/* the message continues after the window; drop only the
+		 * objects of this attempt, the zone may hold others */
+		msgpack_zone_rollback(z, &mark);
+		if(mr->window_off + w->size >= mr->file_size) {
+			return MSGPACK_UNPACK_PARSE_ERROR;
+		}
+		if(mr->off < mr->page) {
+			/* the window starts at the message already; it is too small */
+			size = w->size * 2;
+		}
+		if(!msgpack_mreader_map(mr, size)) {
+			return MSGPACK_UNPACK_NOMEM_ERROR;
+		}
+	}
+}
+
+bool msgpack_mreader_next(msgpack_mreader* mr, msgpack_unpacked* result)
+{
+	msgpack_unpacked_destroy(result);
+
+	msgpack_zone* z = msgpack_zone_new(MSGPACK_ZONE_CHUNK_SIZE);
+	if(z == NULL) {
+		return false;
+	}
+
+	if(msgpack_mreader_execute(mr, z, &result->data) <= 0) {
+		msgpack_zone_free(z);
+		memset(&result->data, 0, sizeof(msgpack_object));
+		return false;
+	}
+
+	result->zone = z;
+	return true;
+}
+
+uint64_t msgpack_mreader_offset(const msgpack_mreader* mr)
+{
+	return mr->window_off + mr->off;
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/mreader.h */
+
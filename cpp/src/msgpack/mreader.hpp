@@ -0,0 +1,89 @@
+//
+// MessagePack for C++ memory-mapped file reader implementation
+//
+// Copyright (C) 2010 FURUHASHI Sadayuki
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+#ifndef MSGPACK_MREADER_HPP__
+#define MSGPACK_MREADER_HPP__
+
+#include "msgpack/mreader.h"
+#include "msgpack/unpack.hpp"
+#include <stdexcept>
+
+namespace msgpack {
+
+
+// Reads the messages of a file from a mapping; see msgpack_mreader.
+//
+// msgpack::mreader reader("data.mpac");
+// msgpack::unpacked result;
+// while(reader.next(&result)) {
+//     on_message(result.get(), result.zone());
+// }
+class mreader : public msgpack_mreader {
+public:
+	mreader(const char* path,
+			size_t window_size = MSGPACK_MREADER_WINDOW_SIZE,
+			size_t readahead = MSGPACK_MREADER_READAHEAD)
+	{
+		if(!msgpack_mreader_init(this, path, window_size, readahead)) {
+			throw std::runtime_error("mreader open failed");
+		}
+	}
+
+	~mreader()
+	{
+		msgpack_mreader_destroy(this);
+	}
+
+public:
+	bool next(unpacked* result)
+	{
+		std::auto_ptr<msgpack::zone> z(new msgpack::zone());
+		msgpack_object obj;
+		int ret = msgpack_mreader_execute(this, z.get(), &obj);
+		if(ret == MSGPACK_UNPACK_NOMEM_ERROR) {
+			throw std::bad_alloc();
+		}
+		if(ret < 0) {
+			throw unpack_error("parse error");
+		}
+		if(ret == 0) {
+			result->zone().reset();
+			result->get() = object();
+			return false;
+		}
+		result->zone() = z;
+		result->get() = obj;
+		return true;
+	}
+
+	uint64_t offset() const
+	{
+		return msgpack_mreader_offset(this);
+	}
+
+private:
+	typedef msgpack_mreader base;
+
+private:
+	mreader(const mreader&);
+};
+
+
+}  // namespace msgpack
+
+#endif /* msgpack/mreader.hpp */
+
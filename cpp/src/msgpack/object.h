@@ -85,8 +85,18 @@ typedef struct msgpack_object_kv {
 
 void msgpack_object_print(FILE* out, msgpack_object o);
 
+/**
+ * Compares objects deeply. Nested objects are walked without recursion;
+ * returns false if the memory for walking them can't be allocated.
+ */
 bool msgpack_object_equal(const msgpack_object x, const msgpack_object y);
 
+/**
+ * Hashes an object. Objects which msgpack_object_equal() considers equal
+ * have the same hash value. See also msgpack/hash.h.
+ */
+uint64_t msgpack_object_hash(const msgpack_object o);
+
 /** @} */
 
 
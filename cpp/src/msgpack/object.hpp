@@ -21,17 +21,40 @@
 #include "msgpack/object.h"
 #include "msgpack/pack.hpp"
 #include "msgpack/zone.hpp"
+#include <stdlib.h>
 #include <string.h>
 #include <stdexcept>
+#include <new>
 #include <typeinfo>
 #include <limits>
 #include <ostream>
+#include <utility>
+
+#if !defined(MSGPACK_USE_CPP11) && __cplusplus >= 201103L
+#define MSGPACK_USE_CPP11 1
+#endif
+
+#if !defined(MSGPACK_USE_CPP17) && __cplusplus >= 201703L
+#define MSGPACK_USE_CPP17 1
+#endif
+
+// moves a converted value into containers if rvalue references are available
+#ifdef MSGPACK_USE_CPP11
+#define MSGPACK_MOVE(x) std::move(x)
+#else
+#define MSGPACK_MOVE(x) (x)
+#endif
 
 namespace msgpack {
 
 
 class type_error : public std::bad_cast { };
 
+struct unpack_error : public std::runtime_error {
+	unpack_error(const std::string& msg) :
+		std::runtime_error(msg) { }
+};
+
 
 namespace type {
 	enum object_type {
@@ -346,66 +369,141 @@ inline void pack_copy(packer<Stream>& o, T v)
 }
 
 
-template <typename Stream>
-packer<Stream>& operator<< (packer<Stream>& o, const object& v)
-{
-	switch(v.type) {
-	case type::NIL:
-		o.pack_nil();
-		return o;
+namespace detail {
+	// Range of objects being walked. The keys and values of a map are
+	// walked as an array of 2 * size objects.
+	struct object_frame {
+		const object* p;
+		const object* end;
+		bool map;
+	};
 
-	case type::BOOLEAN:
-		if(v.via.boolean) {
-			o.pack_true();
-		} else {
-			o.pack_false();
+	// Stack of frames saved while the children of containers are walked,
+	// used instead of recursion so that deeply nested objects can't
+	// overflow the stack.
+	class object_stack {
+	public:
+		object_stack() : m_frames(m_embed), m_depth(0), m_capacity(EMBED_FRAMES) { }
+		~object_stack() { if(m_frames != m_embed) { ::free(m_frames); } }
+
+		bool empty() const { return m_depth == 0; }
+
+		// saves cur and starts the children of the non-empty container o
+		void push(object_frame& cur, const object& o)
+		{
+			if(m_depth == m_capacity) { expand(); }
+			m_frames[m_depth++] = cur;
+			if(o.type == type::ARRAY) {
+				cur.p = o.via.array.ptr;
+				cur.end = o.via.array.ptr + o.via.array.size;
+				cur.map = false;
+			} else {
+				cur.p = &o.via.map.ptr->key;
+				cur.end = cur.p + (size_t)o.via.map.size * 2;
+				cur.map = true;
+			}
 		}
-		return o;
 
-	case type::POSITIVE_INTEGER:
-		o.pack_uint64(v.via.u64);
-		return o;
-
-	case type::NEGATIVE_INTEGER:
-		o.pack_int64(v.via.i64);
-		return o;
+		void pop(object_frame& cur) { cur = m_frames[--m_depth]; }
+
+	private:
+		void expand()
+		{
+			object_frame* tmp = (object_frame*)::malloc(sizeof(object_frame) * m_capacity * 2);
+			if(!tmp) { throw std::bad_alloc(); }
+			::memcpy(tmp, m_frames, sizeof(object_frame) * m_depth);
+			if(m_frames != m_embed) { ::free(m_frames); }
+			m_frames = tmp;
+			m_capacity *= 2;
+		}
 
-	case type::DOUBLE:
-		o.pack_double(v.via.dec);
-		return o;
+		enum { EMBED_FRAMES = 32 };
+		object_frame* m_frames;
+		size_t m_depth;
+		size_t m_capacity;
+		object_frame m_embed[EMBED_FRAMES];
 
-	case type::RAW:
-		o.pack_raw(v.via.raw.size);
-		o.pack_raw_body(v.via.raw.ptr, v.via.raw.size);
-		return o;
+	private:
+		object_stack(const object_stack&);
+		object_stack& operator=(const object_stack&);
+	};
 
-	case type::ARRAY:
-		o.pack_array(v.via.array.size);
-		for(object* p(v.via.array.ptr),
-				* const pend(v.via.array.ptr + v.via.array.size);
-				p < pend; ++p) {
-			o << *p;
+	// takes the next object of cur, loading the raw body or the
+	// children of the following one while the object is visited
+	inline const object* object_next(object_frame& cur)
+	{
+		const object* const o = cur.p++;
+		if(cur.p < cur.end && cur.p->type >= type::RAW) {
+			_msgpack_prefetch(cur.p->via.array.ptr);
 		}
 		return o;
+	}
+}
 
-	case type::MAP:
-		o.pack_map(v.via.map.size);
-		for(object_kv* p(v.via.map.ptr),
-				* const pend(v.via.map.ptr + v.via.map.size);
-				p < pend; ++p) {
-			o << p->key;
-			o << p->val;
+template <typename Stream>
+packer<Stream>& operator<< (packer<Stream>& o, const object& v)
+{
+	detail::object_stack stack;
+	detail::object_frame cur = { &v, &v + 1, false };
+	for(;;) {
+		if(cur.p == cur.end) {
+			if(stack.empty()) { break; }
+			stack.pop(cur);
+			continue;
+		}
+		const object* const p = detail::object_next(cur);
+
+		switch(p->type) {
+		case type::NIL:
+			o.pack_nil();
+			break;
+
+		case type::BOOLEAN:
+			if(p->via.boolean) {
+				o.pack_true();
+			} else {
+				o.pack_false();
+			}
+			break;
+
+		case type::POSITIVE_INTEGER:
+			o.pack_uint64(p->via.u64);
+			break;
+
+		case type::NEGATIVE_INTEGER:
+			o.pack_int64(p->via.i64);
+			break;
+
+		case type::DOUBLE:
+			o.pack_double(p->via.dec);
+			break;
+
+		case type::RAW:
+			o.pack_raw(p->via.raw.size);
+			o.pack_raw_body(p->via.raw.ptr, p->via.raw.size);
+			break;
+
+		case type::ARRAY:
+			o.pack_array(p->via.array.size);
+			if(p->via.array.size > 0) { stack.push(cur, *p); }
+			break;
+
+		case type::MAP:
+			o.pack_map(p->via.map.size);
+			if(p->via.map.size > 0) { stack.push(cur, *p); }
+			break;
+
+		default:
+			throw type_error();
 		}
-		return o;
-
-	default:
-		throw type_error();
 	}
+	return o;
 }
 
 
 }  // namespace msgpack
 
+#include "msgpack/decode.hpp"
 #include "msgpack/type.hpp"
 
 #endif /* msgpack/object.hpp */
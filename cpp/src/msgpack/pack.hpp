@@ -25,6 +25,10 @@
 namespace msgpack {
 
 
+namespace type { namespace detail {
+	template <size_t Size> struct define_fused;
+} }
+
 template <typename Stream>
 class packer {
 public:
@@ -107,6 +111,9 @@ private:
 private:
 	Stream& m_stream;
 
+	template <size_t Size>
+	friend struct type::detail::define_fused;
+
 private:
 	packer();
 };
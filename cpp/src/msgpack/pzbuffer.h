@@ -0,0 +1,575 @@
+/*
+ * MessagePack for C parallel deflate buffer implementation
+ *
+ * Copyright (C) 2010 FURUHASHI Sadayuki
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+#ifndef MSGPACK_PZBUFFER_H__
+#define MSGPACK_PZBUFFER_H__
+
+#include "msgpack/sysdep.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <zlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_pzbuffer Parallel compressed buffer
+ * @ingroup msgpack_buffer
+ *
+ * Buffer which compresses like msgpack_zbuffer on a pool of threads.
+ * The written data is split into blocks which are deflated in parallel,
+ * each primed with the last 32KB of the block before it, and ended by a
+ * sync flush, as pigz does. The blocks are joined in order into one
+ * zlib stream, so that zlib's inflate, msgpack_zunpacker and
+ * msgpack_cunpacker with deflate read it as any other.
+ *
+ * Programs using it are linked with -lpthread.
+ * @{
+ */
+
+typedef struct msgpack_pzbuffer_job {
+	char* in;           /* the dictionary followed by the block */
+	size_t dict_size;
+	size_t size;
+	char* out;
+	size_t out_size;
+	size_t out_alloc;
+	uLong adler;        /* of the block */
+	bool last;
+	int state;
+} msgpack_pzbuffer_job;
+
+typedef struct msgpack_pzbuffer {
+	char* data;
+	size_t size;
+	size_t alloc;
+	size_t init_size;
+
+	int level;
+	size_t block_size;
+	uLong adler;
+	bool started;       /* the zlib header is written */
+	bool finished;      /* the last block is submitted */
+	bool failed;        /* a block is lost; see msgpack_pzbuffer_reset() */
+
+	pthread_mutex_t mutex;
+	pthread_cond_t queued;
+	pthread_cond_t done;
+	pthread_t* workers;
+	unsigned int nworkers;
+	bool stop;
+
+	/* ring of jobs; head..tail-1 are in flight and tail is being filled */
+	msgpack_pzbuffer_job* jobs;
+	unsigned int njobs;
+	unsigned int head;
+	unsigned int tail;
+	unsigned int pending;  /* jobs in flight */
+	unsigned int next;  /* the next job for a worker */
+} msgpack_pzbuffer;
+
+#ifndef MSGPACK_PZBUFFER_INIT_SIZE
+#define MSGPACK_PZBUFFER_INIT_SIZE 8192
+#endif
+
+#ifndef MSGPACK_PZBUFFER_BLOCK_SIZE
+#define MSGPACK_PZBUFFER_BLOCK_SIZE (256*1024)
+#endif
+
+#define MSGPACK_PZBUFFER_DICT_SIZE (32*1024)
+
+/**
+ * Initializes a buffer compressing blocks of block_size bytes at the
+ * level on the number of threads.
+ */
+static inline bool msgpack_pzbuffer_init(msgpack_pzbuffer* pzbuf,
+		int level, size_t block_size, unsigned int threads, size_t init_size);
+static inline void msgpack_pzbuffer_destroy(msgpack_pzbuffer* pzbuf);
+
+static inline msgpack_pzbuffer* msgpack_pzbuffer_new(int level,
+		size_t block_size, unsigned int threads, size_t init_size);
+static inline void msgpack_pzbuffer_free(msgpack_pzbuffer* pzbuf);
+
+static inline int msgpack_pzbuffer_write(void* data, const char* buf, unsigned int len);
+
+/**
+ * Waits for all blocks and ends the stream like msgpack_zbuffer_flush().
+ * Returns the buffer, or NULL on errors.
+ *
+ * Once a block fails, the stream misses it, so msgpack_pzbuffer_write()
+ * returns -1 and msgpack_pzbuffer_flush() returns NULL until
+ * msgpack_pzbuffer_reset() starts a new stream.
+ */
+static inline char* msgpack_pzbuffer_flush(msgpack_pzbuffer* pzbuf);
+
+/**
+ * The data and the size of the blocks compressed so far. The rest is
+ * added by later writes and by msgpack_pzbuffer_flush(); the buffer can
+ * be sent and emptied by msgpack_pzbuffer_reset_buffer() in the meantime.
+ */
+static inline const char* msgpack_pzbuffer_data(const msgpack_pzbuffer* pzbuf);
+static inline size_t msgpack_pzbuffer_size(const msgpack_pzbuffer* pzbuf);
+
+/**
+ * Drops the blocks of an unfinished or failed stream and starts a new
+ * one. Returns true.
+ */
+static inline bool msgpack_pzbuffer_reset(msgpack_pzbuffer* pzbuf);
+static inline void msgpack_pzbuffer_reset_buffer(msgpack_pzbuffer* pzbuf);
+static inline char* msgpack_pzbuffer_release_buffer(msgpack_pzbuffer* pzbuf);
+
+
+enum {
+	MSGPACK_PZBUFFER_FREE,
+	MSGPACK_PZBUFFER_QUEUED,
+	MSGPACK_PZBUFFER_RUNNING,
+	MSGPACK_PZBUFFER_DONE,
+	MSGPACK_PZBUFFER_FAILED
+};
+
+static inline void* msgpack_pzbuffer_worker(void* arg);
+static inline bool msgpack_pzbuffer_deflate(z_stream* s, msgpack_pzbuffer_job* job);
+static inline bool msgpack_pzbuffer_append(msgpack_pzbuffer* pzbuf, const char* buf, size_t len);
+static inline bool msgpack_pzbuffer_collect(msgpack_pzbuffer* pzbuf, unsigned int max_pending);
+static inline bool msgpack_pzbuffer_submit(msgpack_pzbuffer* pzbuf, bool last);
+
+
+bool msgpack_pzbuffer_init(msgpack_pzbuffer* pzbuf,
+		int level, size_t block_size, unsigned int threads, size_t init_size)
+{
+	unsigned int i;
+
+	memset(pzbuf, 0, sizeof(msgpack_pzbuffer));
+	if(threads == 0) {
+		threads = 1;
+	}
+	pzbuf->init_size = init_size;
+	pzbuf->level = level;
+	pzbuf->block_size = block_size;
+	pzbuf->adler = adler32(0L, Z_NULL, 0);
+
+	/* enough to keep the workers busy while finished blocks wait in order */
+	pzbuf->njobs = threads * 2 + 1;
+	pzbuf->jobs = (msgpack_pzbuffer_job*)calloc(pzbuf->njobs, sizeof(msgpack_pzbuffer_job));
+	pzbuf->workers = (pthread_t*)malloc(sizeof(pthread_t) * threads);
+	if(pzbuf->jobs == NULL || pzbuf->workers == NULL) {
+		free(pzbuf->jobs);
+		free(pzbuf->workers);
+		return false;
+	}
+	for(i=0; i < pzbuf->njobs; ++i) {
+		pzbuf->jobs[i].in = (char*)malloc(MSGPACK_PZBUFFER_DICT_SIZE + block_size);
+		if(pzbuf->jobs[i].in == NULL) {
+			while(i > 0) { free(pzbuf->jobs[--i].in); }
+			free(pzbuf->jobs);
+			free(pzbuf->workers);
+			return false;
+		}
+	}
+
+	pthread_mutex_init(&pzbuf->mutex, NULL);
+	pthread_cond_init(&pzbuf->queued, NULL);
+	pthread_cond_init(&pzbuf->done, NULL);
+	for(i=0; i < threads; ++i) {
+		if(pthread_create(&pzbuf->workers[i], NULL, msgpack_pzbuffer_worker, pzbuf) != 0) {
+			break;
+		}
+	}
+	pzbuf->nworkers = i;
+	if(pzbuf->nworkers == 0) {
+		msgpack_pzbuffer_destroy(pzbuf);
+		return false;
+	}
+	return true;
+}
+
+void msgpack_pzbuffer_destroy(msgpack_pzbuffer* pzbuf)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&pzbuf->mutex);
+	pzbuf->stop = true;
+	pthread_cond_broadcast(&pzbuf->queued);
+	pthread_mutex_unlock(&pzbuf->mutex);
+	for(i=0; i < pzbuf->nworkers; ++i) {
+		pthread_join(pzbuf->workers[i], NULL);
+	}
+
+	pthread_cond_destroy(&pzbuf->done);
+	pthread_cond_destroy(&pzbuf->queued);
+	pthread_mutex_destroy(&pzbuf->mutex);
+	for(i=0; i < pzbuf->njobs; ++i) {
+		free(pzbuf->jobs[i].in);
+		free(pzbuf->jobs[i].out);
+	}
+	free(pzbuf->jobs);
+	free(pzbuf->workers);
+	free(pzbuf->data);
+}
+
+msgpack_pzbuffer* msgpack_pzbuffer_new(int level,
+		size_t block_size, unsigned int threads, size_t init_size)
+{
+	msgpack_pzbuffer* pzbuf = (msgpack_pzbuffer*)malloc(sizeof(msgpack_pzbuffer));
+	if(pzbuf == NULL) {
+		return NULL;
+	}
+	if(!msgpack_pzbuffer_init(pzbuf, level, block_size, threads, init_size)) {
+		free(pzbuf);
+		return NULL;
+	}
+	return pzbuf;
+}
+
+void msgpack_pzbuffer_free(msgpack_pzbuffer* pzbuf)
+{
+	if(pzbuf == NULL) { return; }
+	msgpack_pzbuffer_destroy(pzbuf);
+	free(pzbuf);
+}
+
+bool msgpack_pzbuffer_deflate(z_stream* s, msgpack_pzbuffer_job* job)
+{
+	const int flush = job->last ? Z_FINISH : Z_SYNC_FLUSH;
+	size_t bound;
+
+	if(deflateReset(s) != Z_OK) {
+		return false;
+	}
+	if(job->dict_size > 0 &&
+			deflateSetDictionary(s, (const Bytef*)job->in, (uInt)job->dict_size) != Z_OK) {
+		return false;
+	}
+	job->adler = adler32(0L, Z_NULL, 0);
+	job->adler = adler32(job->adler, (const Bytef*)job->in + job->dict_size, (uInt)job->size);
+
+	/* the bound and the sync flush marker are enough but for the end */
+	bound = deflateBound(s, job->size) + 16;
+	if(job->out_alloc < bound) {
+		char* tmp = (char*)realloc(job->out, bound);
+		if(tmp == NULL) {
+			return false;
+		}
+		job->out = tmp;
+		job->out_alloc = bound;
+	}
+
+	s->next_in = (Bytef*)job->in + job->dict_size;
+	s->avail_in = (uInt)job->size;
+	s->next_out = (Bytef*)job->out;
+	s->avail_out = (uInt)job->out_alloc;
+	while(true) {
+		int ret = deflate(s, flush);
+		if(ret == Z_STREAM_END || (ret != Z_STREAM_ERROR &&
+					flush == Z_SYNC_FLUSH && s->avail_out > 0)) {
+			break;
+		}
+		if(ret != Z_OK && ret != Z_BUF_ERROR) {
+			return false;
+		}
+		{
+			size_t used = (char*)s->next_out - job->out;
+			char* tmp = (char*)realloc(job->out, job->out_alloc * 2);
+			if(tmp == NULL) {
+				return false;
+			}
+			job->out = tmp;
+			job->out_alloc *= 2;
+			s->next_out = (Bytef*)tmp + used;
+			s->avail_out = (uInt)(job->out_alloc - used);
+		}
+	}
+	job->out_size = (char*)s->next_out - job->out;
+	return true;
+}
+
+void* msgpack_pzbuffer_worker(void* arg)
+{
+	msgpack_pzbuffer* pzbuf = (msgpack_pzbuffer*)arg;
+	z_stream s;
+	bool init_ok;
+
+	/* raw deflate; the zlib header and trailer are added in order */
+	memset(&s, 0, sizeof(z_stream));
+	init_ok = deflateInit2(&s, pzbuf->level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+
+	pthread_mutex_lock(&pzbuf->mutex);
+	while(true) {
+		msgpack_pzbuffer_job* job = &pzbuf->jobs[pzbuf->next];
+		bool ok;
+		if(job->state != MSGPACK_PZBUFFER_QUEUED) {
+			if(pzbuf->stop) {
+				break;
+			}
+			pthread_cond_wait(&pzbuf->queued, &pzbuf->mutex);
+			continue;
+		}
+		job->state = MSGPACK_PZBUFFER_RUNNING;
+		pzbuf->next = (pzbuf->next + 1) % pzbuf->njobs;
+		pthread_mutex_unlock(&pzbuf->mutex);
+
+		/* each job stands alone; deflateReset() clears what a failed
+		 * one left in the stream */
+		ok = init_ok && msgpack_pzbuffer_deflate(&s, job);
+
+		pthread_mutex_lock(&pzbuf->mutex);
+		job->state = ok ? MSGPACK_PZBUFFER_DONE : MSGPACK_PZBUFFER_FAILED;
+		pthread_cond_broadcast(&pzbuf->done);
+	}
+	pthread_mutex_unlock(&pzbuf->mutex);
+
+	deflateEnd(&s);
+	return NULL;
+}
+
+bool msgpack_pzbuffer_append(msgpack_pzbuffer* pzbuf, const char* buf, size_t len)
+{
+	if(pzbuf->alloc - pzbuf->size < len) {
+		size_t nsize = (pzbuf->alloc == 0) ? pzbuf->init_size : pzbuf->alloc * 2;
+		char* tmp;
+		if(nsize == 0) {
+			nsize = MSGPACK_PZBUFFER_INIT_SIZE;
+		}
+		while(nsize < pzbuf->size + len) {
+			nsize *= 2;
+		}
+		tmp = (char*)realloc(pzbuf->data, nsize);
+		if(tmp == NULL) {
+			return false;
+		}
+		pzbuf->data = tmp;
+		pzbuf->alloc = nsize;
+	}
+	memcpy(pzbuf->data + pzbuf->size, buf, len);
+	pzbuf->size += len;
+	return true;
+}
+
+bool msgpack_pzbuffer_collect(msgpack_pzbuffer* pzbuf, unsigned int max_pending)
+{
+	/* appends the finished blocks in order, until at most max_pending
+	 * blocks are in flight */
+	while(pzbuf->pending > 0) {
+		msgpack_pzbuffer_job* job = &pzbuf->jobs[pzbuf->head];
+		int state;
+
+		pthread_mutex_lock(&pzbuf->mutex);
+		while(pzbuf->pending > max_pending && (job->state == MSGPACK_PZBUFFER_QUEUED ||
+					job->state == MSGPACK_PZBUFFER_RUNNING)) {
+			pthread_cond_wait(&pzbuf->done, &pzbuf->mutex);
+		}
+		state = job->state;
+		pthread_mutex_unlock(&pzbuf->mutex);
+
+		if(state == MSGPACK_PZBUFFER_FAILED) {
+			/* the stream is broken; see msgpack_pzbuffer_reset() */
+			job->state = MSGPACK_PZBUFFER_FREE;
+			pzbuf->head = (pzbuf->head + 1) % pzbuf->njobs;
+			--pzbuf->pending;
+			pzbuf->failed = true;
+			return false;
+		}
+		if(state != MSGPACK_PZBUFFER_DONE) {
+			return true;  /* not finished yet */
+		}
+
+		if(!pzbuf->started) {
+			/* zlib header with the level hint, as deflate writes it */
+			int head = 0x78 << 8;
+			const int level = pzbuf->level;
+			if(level == 0 || level == 1) {
+				head |= 0 << 6;
+			} else if(level >= 2 && level <= 5) {
+				head |= 1 << 6;
+			} else if(level >= 7) {
+				head |= 3 << 6;
+			} else {
+				head |= 2 << 6;
+			}
+			head += 31 - (head % 31);
+			{
+				const char header[2] = { (char)(head >> 8), (char)(head & 0xff) };
+				if(!msgpack_pzbuffer_append(pzbuf, header, 2)) {
+					pzbuf->failed = true;
+					return false;
+				}
+			}
+			pzbuf->started = true;
+		}
+
+		if(!msgpack_pzbuffer_append(pzbuf, job->out, job->out_size)) {
+			pzbuf->failed = true;
+			return false;
+		}
+		pzbuf->adler = adler32_combine(pzbuf->adler, job->adler, (z_off_t)job->size);
+
+		if(job->last) {
+			const char trailer[4] = {
+				(char)(pzbuf->adler >> 24), (char)(pzbuf->adler >> 16),
+				(char)(pzbuf->adler >> 8), (char)pzbuf->adler };
+			if(!msgpack_pzbuffer_append(pzbuf, trailer, 4)) {
+				pzbuf->failed = true;
+				return false;
+			}
+		}
+
+		job->state = MSGPACK_PZBUFFER_FREE;
+		pzbuf->head = (pzbuf->head + 1) % pzbuf->njobs;
+		--pzbuf->pending;
+	}
+	return true;
+}
+
+bool msgpack_pzbuffer_submit(msgpack_pzbuffer* pzbuf, bool last)
+{
+	msgpack_pzbuffer_job* job = &pzbuf->jobs[pzbuf->tail];
+	msgpack_pzbuffer_job* next;
+	size_t dict;
+	bool ok;
+
+	job->last = last;
+	pthread_mutex_lock(&pzbuf->mutex);
+	job->state = MSGPACK_PZBUFFER_QUEUED;
+	pthread_cond_signal(&pzbuf->queued);
+	pthread_mutex_unlock(&pzbuf->mutex);
+	pzbuf->tail = (pzbuf->tail + 1) % pzbuf->njobs;
+	++pzbuf->pending;
+
+	/* the job to fill next must not be in flight */
+	ok = msgpack_pzbuffer_collect(pzbuf, pzbuf->njobs - 1);
+	next = &pzbuf->jobs[pzbuf->tail];
+	next->size = 0;
+	next->dict_size = 0;
+	if(!ok) {
+		return false;
+	}
+
+	/* primes the next block with the end of this one */
+	if(!last) {
+		dict = job->dict_size + job->size;
+		if(dict > MSGPACK_PZBUFFER_DICT_SIZE) {
+			dict = MSGPACK_PZBUFFER_DICT_SIZE;
+		}
+		memcpy(next->in, job->in + job->dict_size + job->size - dict, dict);
+		next->dict_size = dict;
+	}
+	return true;
+}
+
+int msgpack_pzbuffer_write(void* data, const char* buf, unsigned int len)
+{
+	msgpack_pzbuffer* pzbuf = (msgpack_pzbuffer*)data;
+	if(pzbuf->finished || pzbuf->failed) {
+		return -1;
+	}
+	while(len > 0) {
+		msgpack_pzbuffer_job* job = &pzbuf->jobs[pzbuf->tail];
+		size_t n = pzbuf->block_size - job->size;
+		if(n > len) {
+			n = len;
+		}
+		memcpy(job->in + job->dict_size + job->size, buf, n);
+		job->size += n;
+		buf += n;
+		len -= n;
+		if(job->size == pzbuf->block_size) {
+			if(!msgpack_pzbuffer_submit(pzbuf, false)) {
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+char* msgpack_pzbuffer_flush(msgpack_pzbuffer* pzbuf)
+{
+	if(pzbuf->failed) {
+		return NULL;
+	}
+	if(!pzbuf->finished) {
+		pzbuf->finished = true;
+		if(!msgpack_pzbuffer_submit(pzbuf, true)) {
+			return NULL;
+		}
+	}
+	if(!msgpack_pzbuffer_collect(pzbuf, 0)) {
+		return NULL;
+	}
+	return pzbuf->data;
+}
+
+const char* msgpack_pzbuffer_data(const msgpack_pzbuffer* pzbuf)
+{
+	return pzbuf->data;
+}
+
+size_t msgpack_pzbuffer_size(const msgpack_pzbuffer* pzbuf)
+{
+	return pzbuf->size;
+}
+
+void msgpack_pzbuffer_reset_buffer(msgpack_pzbuffer* pzbuf)
+{
+	pzbuf->size = 0;
+}
+
+bool msgpack_pzbuffer_reset(msgpack_pzbuffer* pzbuf)
+{
+	/* drops the blocks in flight without appending them */
+	pthread_mutex_lock(&pzbuf->mutex);
+	while(pzbuf->pending > 0) {
+		msgpack_pzbuffer_job* job = &pzbuf->jobs[pzbuf->head];
+		while(job->state == MSGPACK_PZBUFFER_QUEUED ||
+				job->state == MSGPACK_PZBUFFER_RUNNING) {
+			pthread_cond_wait(&pzbuf->done, &pzbuf->mutex);
+		}
+		job->state = MSGPACK_PZBUFFER_FREE;
+		pzbuf->head = (pzbuf->head + 1) % pzbuf->njobs;
+		--pzbuf->pending;
+	}
+	pthread_mutex_unlock(&pzbuf->mutex);
+	pzbuf->jobs[pzbuf->tail].size = 0;
+	pzbuf->jobs[pzbuf->tail].dict_size = 0;
+	pzbuf->adler = adler32(0L, Z_NULL, 0);
+	pzbuf->started = false;
+	pzbuf->finished = false;
+	pzbuf->failed = false;
+	msgpack_pzbuffer_reset_buffer(pzbuf);
+	return true;
+}
+
+char* msgpack_pzbuffer_release_buffer(msgpack_pzbuffer* pzbuf)
+{
+	char* tmp = pzbuf->data;
+	pzbuf->data = NULL;
+	pzbuf->size = 0;
+	pzbuf->alloc = 0;
+	return tmp;
+}
+
+/** @} */
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/pzbuffer.h */
+
@@ -0,0 +1,105 @@
+//
+// MessagePack for C++ parallel deflate buffer implementation
+//
+// Copyright (C) 2010 FURUHASHI Sadayuki
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+#ifndef MSGPACK_PZBUFFER_HPP__
+#define MSGPACK_PZBUFFER_HPP__
+
+#include "msgpack/pzbuffer.h"
+#include <stdexcept>
+
+namespace msgpack {
+
+
+// Buffer like zbuffer which deflates blocks on a pool of threads
+// and joins them into one zlib stream; see msgpack_pzbuffer.
+class pzbuffer : public msgpack_pzbuffer {
+public:
+	pzbuffer(unsigned int threads, int level = Z_DEFAULT_COMPRESSION,
+			size_t block_size = MSGPACK_PZBUFFER_BLOCK_SIZE,
+			size_t init_size = MSGPACK_PZBUFFER_INIT_SIZE)
+	{
+		if(!msgpack_pzbuffer_init(this, level, block_size, threads, init_size)) {
+			throw std::bad_alloc();
+		}
+	}
+
+	~pzbuffer()
+	{
+		msgpack_pzbuffer_destroy(this);
+	}
+
+public:
+	void write(const char* buf, unsigned int len)
+	{
+		if(msgpack_pzbuffer_write(this, buf, len) < 0) {
+			throw std::bad_alloc();
+		}
+	}
+
+	char* flush()
+	{
+		char* buf = msgpack_pzbuffer_flush(this);
+		if(!buf) {
+			throw std::bad_alloc();
+		}
+		return buf;
+	}
+
+	char* data()
+	{
+		return base::data;
+	}
+
+	const char* data() const
+	{
+		return base::data;
+	}
+
+	size_t size() const
+	{
+		return msgpack_pzbuffer_size(this);
+	}
+
+	void reset()
+	{
+		if(!msgpack_pzbuffer_reset(this)) {
+			throw std::bad_alloc();
+		}
+	}
+
+	void reset_buffer()
+	{
+		msgpack_pzbuffer_reset_buffer(this);
+	}
+
+	char* release_buffer()
+	{
+		return msgpack_pzbuffer_release_buffer(this);
+	}
+
+private:
+	typedef msgpack_pzbuffer base;
+
+private:
+	pzbuffer(const pzbuffer&);
+};
+
+
+}  // namespace msgpack
+
+#endif /* msgpack/pzbuffer.hpp */
+
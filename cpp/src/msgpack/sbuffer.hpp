@@ -52,6 +52,31 @@ public:
 		base::size += len;
 	}
 
+	/*! 1. reserve buffer at least size bytes */
+	void reserve_buffer(size_t size)
+	{
+		if(base::alloc - base::size < size) {
+			expand_buffer(size);
+		}
+	}
+
+	/*! 2. write data to the buffer() up to buffer_capacity() bytes */
+	char* buffer()
+	{
+		return base::data + base::size;
+	}
+
+	size_t buffer_capacity() const
+	{
+		return base::alloc - base::size;
+	}
+
+	/*! 3. specify the number of bytes written to the buffer() */
+	void buffer_consumed(size_t size)
+	{
+		base::size += size;
+	}
+
 	char* data()
 	{
 		return base::data;
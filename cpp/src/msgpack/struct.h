@@ -0,0 +1,132 @@
+/*
+ * MessagePack for C struct serializer
+ *
+ * Copyright (C) 2008-2010 FURUHASHI Sadayuki
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+#ifndef MSGPACK_STRUCT_H__
+#define MSGPACK_STRUCT_H__
+
+#include "msgpack/pack.h"
+#include "msgpack/unpack.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_struct Struct serializer
+ * @ingroup msgpack
+ *
+ * Serializes C structs described by tables of their fields:
+ *
+ *     typedef struct { int id; msgpack_object_raw name; } user;
+ *
+ *     static const msgpack_struct_field user_fields[] = {
+ *         MSGPACK_STRUCT_FIELD(user, id, MSGPACK_FIELD_INT),
+ *         MSGPACK_STRUCT_FIELD(user, name, MSGPACK_FIELD_RAW),
+ *     };
+ *     static const msgpack_struct_desc user_desc =
+ *         MSGPACK_STRUCT_DESC(user_fields, MSGPACK_STRUCT_ARRAY);
+ *
+ *     msgpack_struct_pack(pk, &user_desc, &u);
+ *     msgpack_struct_unpack(&user_desc, data, len, &off, &u);
+ *
+ * @{
+ */
+
+typedef enum {
+	MSGPACK_FIELD_BOOL,    /**< bool */
+	MSGPACK_FIELD_INT8,
+	MSGPACK_FIELD_INT16,
+	MSGPACK_FIELD_INT32,
+	MSGPACK_FIELD_INT64,
+	MSGPACK_FIELD_UINT8,
+	MSGPACK_FIELD_UINT16,
+	MSGPACK_FIELD_UINT32,
+	MSGPACK_FIELD_UINT64,
+	MSGPACK_FIELD_FLOAT,
+	MSGPACK_FIELD_DOUBLE,
+	MSGPACK_FIELD_RAW,     /**< msgpack_object_raw */
+	MSGPACK_FIELD_STRUCT,  /**< struct described by the desc of the field */
+	MSGPACK_FIELD_TYPE_MAX
+} msgpack_field_type;
+
+#define MSGPACK_FIELD_INT \
+	(sizeof(int) == 8 ? MSGPACK_FIELD_INT64 : MSGPACK_FIELD_INT32)
+#define MSGPACK_FIELD_UINT \
+	(sizeof(unsigned int) == 8 ? MSGPACK_FIELD_UINT64 : MSGPACK_FIELD_UINT32)
+
+typedef enum {
+	MSGPACK_STRUCT_ARRAY,  /**< fields in order, like MSGPACK_DEFINE */
+	MSGPACK_STRUCT_MAP     /**< map keyed by names of fields */
+} msgpack_struct_format;
+
+struct msgpack_struct_desc;
+
+typedef struct msgpack_struct_field {
+	const char* name;
+	size_t name_size;
+	size_t offset;
+	msgpack_field_type type;
+	const struct msgpack_struct_desc* desc;
+} msgpack_struct_field;
+
+typedef struct msgpack_struct_desc {
+	const msgpack_struct_field* fields;
+	unsigned int count;
+	msgpack_struct_format format;
+} msgpack_struct_desc;
+
+#define MSGPACK_STRUCT_FIELD(type, member, field_type) \
+	{ #member, sizeof(#member)-1, offsetof(type, member), field_type, NULL }
+
+#define MSGPACK_STRUCT_NESTED(type, member, desc) \
+	{ #member, sizeof(#member)-1, offsetof(type, member), MSGPACK_FIELD_STRUCT, desc }
+
+#define MSGPACK_STRUCT_DESC(fields, format) \
+	{ fields, sizeof(fields) / sizeof(fields[0]), format }
+
+/**
+ * Serializes a struct described by the desc.
+ * Returns 0 on success, or the negative value returned by the packer.
+ */
+int msgpack_struct_pack(msgpack_packer* pk,
+		const msgpack_struct_desc* desc, const void* obj);
+
+/**
+ * Deserializes one object into a struct without building objects.
+ * Fields missing in the data are left unchanged, and elements or keys
+ * unknown to the desc are skipped. Raw fields refer to the data.
+ * Returns MSGPACK_UNPACK_SUCCESS or MSGPACK_UNPACK_EXTRA_BYTES and
+ * updates *off like msgpack_unpack(); MSGPACK_UNPACK_CONTINUE if the
+ * data is insufficient; MSGPACK_UNPACK_PARSE_ERROR if the data is broken
+ * or doesn't match the desc. The struct may be partially updated on
+ * failure.
+ */
+msgpack_unpack_return
+msgpack_struct_unpack(const msgpack_struct_desc* desc,
+		const char* data, size_t len, size_t* off, void* obj);
+
+/** @} */
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/struct.h */
+
@@ -4,6 +4,8 @@
 #include "msgpack/type/list.hpp"
 #include "msgpack/type/deque.hpp"
 #include "msgpack/type/map.hpp"
+#include "msgpack/type/flat_map.hpp"
+#include "msgpack/type/flat_set.hpp"
 #include "msgpack/type/nil.hpp"
 #include "msgpack/type/pair.hpp"
 #include "msgpack/type/raw.hpp"
@@ -31,6 +31,12 @@ inline bool& operator>> (object o, bool& v)
 	return v;
 }
 
+inline decoder& operator>> (decoder& d, bool& v)
+{
+	v = d.read_boolean();
+	return d;
+}
+
 template <typename Stream>
 inline packer<Stream>& operator<< (packer<Stream>& o, const bool& v)
 {
@@ -0,0 +1,139 @@
+//
+// MessagePack for C++ static resolution routine
+//
+// Copyright (C) 2008-2009 FURUHASHI Sadayuki
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+#ifndef MSGPACK_TYPE_CPP11_UNORDERED_MAP_HPP__
+#define MSGPACK_TYPE_CPP11_UNORDERED_MAP_HPP__
+
+#include "msgpack/object.hpp"
+#include <unordered_map>
+#include <tuple>
+
+namespace msgpack {
+
+
+template <typename K, typename V, typename H, typename E>
+inline std::unordered_map<K,V,H,E>& operator>> (object o, std::unordered_map<K,V,H,E>& v)
+{
+	if(o.type != type::MAP) { throw type_error(); }
+	v.reserve(v.size() + o.via.map.size);
+	object_kv* p(o.via.map.ptr);
+	object_kv* const pend(o.via.map.ptr + o.via.map.size);
+	for(; p != pend; ++p) {
+		K key;
+		p->key.convert(&key);
+		p->val.convert(&v[std::move(key)]);
+	}
+	return v;
+}
+
+template <typename Stream, typename K, typename V, typename H, typename E>
+inline packer<Stream>& operator<< (packer<Stream>& o, const std::unordered_map<K,V,H,E>& v)
+{
+	o.pack_map(v.size());
+	for(typename std::unordered_map<K,V,H,E>::const_iterator it(v.begin()), it_end(v.end());
+			it != it_end; ++it) {
+		o.pack(it->first);
+		o.pack(it->second);
+	}
+	return o;
+}
+
+template <typename K, typename V, typename H, typename E>
+inline void operator<< (object::with_zone& o, const std::unordered_map<K,V,H,E>& v)
+{
+	o.type = type::MAP;
+	if(v.empty()) {
+		o.via.map.ptr  = NULL;
+		o.via.map.size = 0;
+	} else {
+		object_kv* p = (object_kv*)o.zone->malloc(sizeof(object_kv)*v.size());
+		object_kv* const pend = p + v.size();
+		o.via.map.ptr  = p;
+		o.via.map.size = v.size();
+		typename std::unordered_map<K,V,H,E>::const_iterator it(v.begin());
+		do {
+			p->key = object(it->first, o.zone);
+			p->val = object(it->second, o.zone);
+			++p;
+			++it;
+		} while(p < pend);
+	}
+}
+
+
+template <typename K, typename V, typename H, typename E>
+inline std::unordered_multimap<K,V,H,E>& operator>> (object o, std::unordered_multimap<K,V,H,E>& v)
+{
+	if(o.type != type::MAP) { throw type_error(); }
+	v.reserve(v.size() + o.via.map.size);
+	object_kv* p(o.via.map.ptr);
+	object_kv* const pend(o.via.map.ptr + o.via.map.size);
+	for(; p != pend; ++p) {
+		K key;
+		p->key.convert(&key);
+		typename std::unordered_multimap<K,V,H,E>::iterator it = v.emplace(
+				std::piecewise_construct,
+				std::forward_as_tuple(std::move(key)), std::tuple<>());
+		try {
+			p->val.convert(&it->second);
+		} catch(...) {
+			v.erase(it);
+			throw;
+		}
+	}
+	return v;
+}
+
+template <typename Stream, typename K, typename V, typename H, typename E>
+inline packer<Stream>& operator<< (packer<Stream>& o, const std::unordered_multimap<K,V,H,E>& v)
+{
+	o.pack_map(v.size());
+	for(typename std::unordered_multimap<K,V,H,E>::const_iterator it(v.begin()), it_end(v.end());
+			it != it_end; ++it) {
+		o.pack(it->first);
+		o.pack(it->second);
+	}
+	return o;
+}
+
+template <typename K, typename V, typename H, typename E>
+inline void operator<< (object::with_zone& o, const std::unordered_multimap<K,V,H,E>& v)
+{
+	o.type = type::MAP;
+	if(v.empty()) {
+		o.via.map.ptr  = NULL;
+		o.via.map.size = 0;
+	} else {
+		object_kv* p = (object_kv*)o.zone->malloc(sizeof(object_kv)*v.size());
+		object_kv* const pend = p + v.size();
+		o.via.map.ptr  = p;
+		o.via.map.size = v.size();
+		typename std::unordered_multimap<K,V,H,E>::const_iterator it(v.begin());
+		do {
+			p->key = object(it->first, o.zone);
+			p->val = object(it->second, o.zone);
+			++p;
+			++it;
+		} while(p < pend);
+	}
+}
+
+
+}  // namespace msgpack
+
+#endif /* msgpack/type/cpp11/unordered_map.hpp */
+
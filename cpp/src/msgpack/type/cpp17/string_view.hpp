@@ -0,0 +1,75 @@
+//
+// MessagePack for C++ static resolution routine
+//
+// Copyright (C) 2008-2010 FURUHASHI Sadayuki
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+#ifndef MSGPACK_TYPE_CPP17_STRING_VIEW_HPP__
+#define MSGPACK_TYPE_CPP17_STRING_VIEW_HPP__
+
+#include "msgpack/object.hpp"
+#include <string_view>
+
+namespace msgpack {
+
+
+// Converted views refer to the raw of the object, and decoded views to
+// the data of the decoder; they are valid while the zone of the object
+// or the data is alive. Containers of views, like
+// std::vector<std::string_view> or std::map<std::string_view, T>, copy
+// no bytes of strings.
+
+inline std::string_view& operator>> (object o, std::string_view& v)
+{
+	if(o.type != type::RAW) { throw type_error(); }
+	v = std::string_view(o.via.raw.ptr, o.via.raw.size);
+	return v;
+}
+
+inline decoder& operator>> (decoder& d, std::string_view& v)
+{
+	object_raw r = d.read_raw();
+	v = std::string_view(r.ptr, r.size);
+	return d;
+}
+
+template <typename Stream>
+inline packer<Stream>& operator<< (packer<Stream>& o, const std::string_view& v)
+{
+	o.pack_raw(v.size());
+	o.pack_raw_body(v.data(), v.size());
+	return o;
+}
+
+inline void operator<< (object::with_zone& o, const std::string_view& v)
+{
+	o.type = type::RAW;
+	char* ptr = (char*)o.zone->malloc(v.size());
+	o.via.raw.ptr = ptr;
+	o.via.raw.size = v.size();
+	memcpy(ptr, v.data(), v.size());
+}
+
+inline void operator<< (object& o, const std::string_view& v)
+{
+	o.type = type::RAW;
+	o.via.raw.ptr = v.data();
+	o.via.raw.size = v.size();
+}
+
+
+}  // namespace msgpack
+
+#endif /* msgpack/type/cpp17/string_view.hpp */
+
@@ -0,0 +1,246 @@
+//
+// MessagePack for C++ static resolution routine
+//
+// Copyright (C) 2008-2010 FURUHASHI Sadayuki
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+#ifndef MSGPACK_TYPE_FLAT_MAP_HPP__
+#define MSGPACK_TYPE_FLAT_MAP_HPP__
+
+#include "msgpack/object.hpp"
+#include "msgpack/type/flat_set.hpp"
+#include <vector>
+#include <functional>
+#include <algorithm>
+
+namespace msgpack {
+
+
+namespace type {
+
+// Sorted map on a vector of pairs, like assoc_vector but keeping the
+// elements sorted and unique. Lookups are binary searches on contiguous
+// memory, and conversion fills the vector with one allocation and sorts
+// it only if the keys are not in order. The last one of duplicated keys
+// wins, as in conversion to std::map.
+template <typename K, typename V, typename Compare = std::less<K> >
+class flat_map {
+public:
+	typedef K key_type;
+	typedef V mapped_type;
+	typedef std::pair<K, V> value_type;
+	typedef Compare key_compare;
+	typedef std::vector<value_type> sequence_type;
+	typedef typename sequence_type::size_type size_type;
+	typedef typename sequence_type::iterator iterator;
+	typedef typename sequence_type::const_iterator const_iterator;
+
+	class value_compare {
+	public:
+		value_compare(const Compare& comp) : m_comp(comp) { }
+		bool operator() (const value_type& x, const value_type& y) const
+			{ return m_comp(x.first, y.first); }
+		bool operator() (const value_type& x, const K& y) const
+			{ return m_comp(x.first, y); }
+		bool operator() (const K& x, const value_type& y) const
+			{ return m_comp(x, y.first); }
+	private:
+		Compare m_comp;
+	};
+
+	flat_map() { }
+	explicit flat_map(const Compare& comp) : m_comp(comp) { }
+
+	iterator begin() { return m_seq.begin(); }
+	iterator end() { return m_seq.end(); }
+	const_iterator begin() const { return m_seq.begin(); }
+	const_iterator end() const { return m_seq.end(); }
+
+	bool empty() const { return m_seq.empty(); }
+	size_type size() const { return m_seq.size(); }
+	size_type capacity() const { return m_seq.capacity(); }
+	void reserve(size_type n) { m_seq.reserve(n); }
+	void clear() { m_seq.clear(); }
+	void swap(flat_map& x) { m_seq.swap(x.m_seq); std::swap(m_comp, x.m_comp); }
+
+	key_compare key_comp() const { return m_comp; }
+	value_compare value_comp() const { return value_compare(m_comp); }
+
+	iterator lower_bound(const K& k)
+		{ return std::lower_bound(begin(), end(), k, value_comp()); }
+	const_iterator lower_bound(const K& k) const
+		{ return std::lower_bound(begin(), end(), k, value_comp()); }
+	iterator upper_bound(const K& k)
+		{ return std::upper_bound(begin(), end(), k, value_comp()); }
+	const_iterator upper_bound(const K& k) const
+		{ return std::upper_bound(begin(), end(), k, value_comp()); }
+
+	iterator find(const K& k)
+	{
+		iterator it = lower_bound(k);
+		return (it != end() && !m_comp(k, it->first)) ? it : end();
+	}
+
+	const_iterator find(const K& k) const
+	{
+		const_iterator it = lower_bound(k);
+		return (it != end() && !m_comp(k, it->first)) ? it : end();
+	}
+
+	size_type count(const K& k) const { return find(k) != end() ? 1 : 0; }
+
+	V& operator[] (const K& k)
+	{
+		iterator it = lower_bound(k);
+		if(it == end() || m_comp(k, it->first)) {
+			it = m_seq.insert(it, value_type(k, V()));
+		}
+		return it->second;
+	}
+
+	std::pair<iterator, bool> insert(const value_type& x)
+	{
+		iterator it = lower_bound(x.first);
+		if(it != end() && !m_comp(x.first, it->first)) {
+			return std::pair<iterator, bool>(it, false);
+		}
+		return std::pair<iterator, bool>(m_seq.insert(it, x), true);
+	}
+
+	void erase(iterator pos) { m_seq.erase(pos); }
+
+	size_type erase(const K& k)
+	{
+		iterator it = find(k);
+		if(it == end()) { return 0; }
+		m_seq.erase(it);
+		return 1;
+	}
+
+	// The underlying vector. Elements may be appended to it directly
+	// as long as restore_order() is called before the map is used.
+	sequence_type& sequence() { return m_seq; }
+	const sequence_type& sequence() const { return m_seq; }
+
+	// Sorts the elements appended to the sequence from pos and removes
+	// duplicated keys. Cheap if the appended keys are already in order.
+	void restore_order(size_type pos = 0)
+		{ detail::flat_restore_order(m_seq, pos, value_comp()); }
+
+	bool operator== (const flat_map& x) const { return m_seq == x.m_seq; }
+	bool operator!= (const flat_map& x) const { return m_seq != x.m_seq; }
+
+private:
+	sequence_type m_seq;
+	Compare m_comp;
+};
+
+}  // namespace type
+
+
+template <typename K, typename V, typename C>
+inline type::flat_map<K,V,C>& operator>> (object o, type::flat_map<K,V,C>& v)
+{
+	if(o.type != type::MAP) { throw type_error(); }
+	typename type::flat_map<K,V,C>::sequence_type& seq = v.sequence();
+	const size_t pos = seq.size();
+	try {
+		seq.resize(pos + o.via.map.size);
+		if(o.via.map.size > 0) {
+			object_kv* p = o.via.map.ptr;
+			object_kv* const pend = o.via.map.ptr + o.via.map.size;
+			std::pair<K, V>* it = &seq[pos];
+			do {
+				p->key.convert(&it->first);
+				p->val.convert(&it->second);
+				++p;
+				++it;
+			} while(p < pend);
+		}
+	} catch(...) {
+		seq.resize(pos);
+		throw;
+	}
+	v.restore_order(pos);
+	return v;
+}
+
+template <typename K, typename V, typename C>
+inline decoder& operator>> (decoder& d, type::flat_map<K,V,C>& v)
+{
+	const uint32_t size = d.read_map();
+	typename type::flat_map<K,V,C>::sequence_type& seq = v.sequence();
+	const size_t pos = seq.size();
+	try {
+		seq.resize(pos + size);
+		if(size > 0) {
+			std::pair<K, V>* it = &seq[pos];
+			std::pair<K, V>* const end = it + size;
+			do {
+				d >> it->first;
+				d >> it->second;
+				++it;
+			} while(it < end);
+		}
+	} catch(...) {
+		seq.resize(pos);
+		throw;
+	}
+	v.restore_order(pos);
+	return d;
+}
+
+template <typename Stream, typename K, typename V, typename C>
+inline packer<Stream>& operator<< (packer<Stream>& o, const type::flat_map<K,V,C>& v)
+{
+	o.pack_map(v.size());
+	if(!v.empty()) {
+		const std::pair<K, V>* it = &v.sequence()[0];
+		const std::pair<K, V>* const end = it + v.size();
+		do {
+			o.pack(it->first);
+			o.pack(it->second);
+			++it;
+		} while(it < end);
+	}
+	return o;
+}
+
+template <typename K, typename V, typename C>
+inline void operator<< (object::with_zone& o, const type::flat_map<K,V,C>& v)
+{
+	o.type = type::MAP;
+	if(v.empty()) {
+		o.via.map.ptr  = NULL;
+		o.via.map.size = 0;
+	} else {
+		object_kv* p = (object_kv*)o.zone->malloc(sizeof(object_kv)*v.size());
+		object_kv* const pend = p + v.size();
+		o.via.map.ptr  = p;
+		o.via.map.size = v.size();
+		const std::pair<K, V>* it = &v.sequence()[0];
+		do {
+			p->key = object(it->first, o.zone);
+			p->val = object(it->second, o.zone);
+			++p;
+			++it;
+		} while(p < pend);
+	}
+}
+
+
+}  // namespace msgpack
+
+#endif /* msgpack/type/flat_map.hpp */
+
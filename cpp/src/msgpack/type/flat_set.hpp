@@ -0,0 +1,246 @@
+//
+// MessagePack for C++ static resolution routine
+//
+// Copyright (C) 2008-2010 FURUHASHI Sadayuki
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+#ifndef MSGPACK_TYPE_FLAT_SET_HPP__
+#define MSGPACK_TYPE_FLAT_SET_HPP__
+
+#include "msgpack/object.hpp"
+#include <vector>
+#include <functional>
+#include <algorithm>
+
+namespace msgpack {
+
+
+namespace type {
+
+namespace detail {
+	// Sorts the elements appended to a sorted sequence from pos, and
+	// removes duplicates keeping the last one. Does nothing if the
+	// appended elements are already in order.
+	template <typename Vector, typename Less>
+	void flat_restore_order(Vector& v, typename Vector::size_type pos, Less less)
+	{
+		typedef typename Vector::iterator iterator;
+		if(v.size() < 2 || pos >= v.size()) { return; }
+		iterator it = v.begin() + (pos > 0 ? pos : 1);
+		const iterator end = v.end();
+		for(; it < end; ++it) {
+			if(!less(*(it-1), *it)) { break; }
+		}
+		if(it >= end) { return; }
+
+		std::stable_sort(v.begin(), end, less);
+
+		iterator out = v.begin();
+		for(it = v.begin(); it != end; ++it) {
+			if(it+1 != end && !less(*it, *(it+1))) { continue; }
+			if(out != it) { *out = MSGPACK_MOVE(*it); }
+			++out;
+		}
+		v.erase(out, end);
+	}
+}
+
+
+// Sorted set on a vector. Lookups are binary searches on contiguous
+// memory, and conversion fills the vector with one allocation and sorts
+// it only if the elements are not in order.
+template <typename T, typename Compare = std::less<T> >
+class flat_set {
+public:
+	typedef T key_type;
+	typedef T value_type;
+	typedef Compare key_compare;
+	typedef Compare value_compare;
+	typedef std::vector<T> sequence_type;
+	typedef typename sequence_type::size_type size_type;
+	typedef typename sequence_type::iterator iterator;
+	typedef typename sequence_type::const_iterator const_iterator;
+
+	flat_set() { }
+	explicit flat_set(const Compare& comp) : m_comp(comp) { }
+
+	iterator begin() { return m_seq.begin(); }
+	iterator end() { return m_seq.end(); }
+	const_iterator begin() const { return m_seq.begin(); }
+	const_iterator end() const { return m_seq.end(); }
+
+	bool empty() const { return m_seq.empty(); }
+	size_type size() const { return m_seq.size(); }
+	size_type capacity() const { return m_seq.capacity(); }
+	void reserve(size_type n) { m_seq.reserve(n); }
+	void clear() { m_seq.clear(); }
+	void swap(flat_set& x) { m_seq.swap(x.m_seq); std::swap(m_comp, x.m_comp); }
+
+	key_compare key_comp() const { return m_comp; }
+	value_compare value_comp() const { return m_comp; }
+
+	iterator lower_bound(const T& x)
+		{ return std::lower_bound(begin(), end(), x, m_comp); }
+	const_iterator lower_bound(const T& x) const
+		{ return std::lower_bound(begin(), end(), x, m_comp); }
+	iterator upper_bound(const T& x)
+		{ return std::upper_bound(begin(), end(), x, m_comp); }
+	const_iterator upper_bound(const T& x) const
+		{ return std::upper_bound(begin(), end(), x, m_comp); }
+
+	iterator find(const T& x)
+	{
+		iterator it = lower_bound(x);
+		return (it != end() && !m_comp(x, *it)) ? it : end();
+	}
+
+	const_iterator find(const T& x) const
+	{
+		const_iterator it = lower_bound(x);
+		return (it != end() && !m_comp(x, *it)) ? it : end();
+	}
+
+	size_type count(const T& x) const { return find(x) != end() ? 1 : 0; }
+
+	std::pair<iterator, bool> insert(const T& x)
+	{
+		iterator it = lower_bound(x);
+		if(it != end() && !m_comp(x, *it)) {
+			return std::pair<iterator, bool>(it, false);
+		}
+		return std::pair<iterator, bool>(m_seq.insert(it, x), true);
+	}
+
+	void erase(iterator pos) { m_seq.erase(pos); }
+
+	size_type erase(const T& x)
+	{
+		iterator it = find(x);
+		if(it == end()) { return 0; }
+		m_seq.erase(it);
+		return 1;
+	}
+
+	// The underlying vector. Elements may be appended to it directly
+	// as long as restore_order() is called before the set is used.
+	sequence_type& sequence() { return m_seq; }
+	const sequence_type& sequence() const { return m_seq; }
+
+	// Sorts the elements appended to the sequence from pos and removes
+	// duplicates. Cheap if the appended elements are already in order.
+	void restore_order(size_type pos = 0)
+		{ detail::flat_restore_order(m_seq, pos, m_comp); }
+
+	bool operator== (const flat_set& x) const { return m_seq == x.m_seq; }
+	bool operator!= (const flat_set& x) const { return m_seq != x.m_seq; }
+
+private:
+	sequence_type m_seq;
+	Compare m_comp;
+};
+
+}  // namespace type
+
+
+template <typename T, typename C>
+inline type::flat_set<T,C>& operator>> (object o, type::flat_set<T,C>& v)
+{
+	if(o.type != type::ARRAY) { throw type_error(); }
+	typename type::flat_set<T,C>::sequence_type& seq = v.sequence();
+	const size_t pos = seq.size();
+	try {
+		seq.resize(pos + o.via.array.size);
+		if(o.via.array.size > 0) {
+			object* p = o.via.array.ptr;
+			object* const pend = o.via.array.ptr + o.via.array.size;
+			T* it = &seq[pos];
+			do {
+				p->convert(it);
+				++p;
+				++it;
+			} while(p < pend);
+		}
+	} catch(...) {
+		seq.resize(pos);
+		throw;
+	}
+	v.restore_order(pos);
+	return v;
+}
+
+template <typename T, typename C>
+inline decoder& operator>> (decoder& d, type::flat_set<T,C>& v)
+{
+	const uint32_t size = d.read_array();
+	typename type::flat_set<T,C>::sequence_type& seq = v.sequence();
+	const size_t pos = seq.size();
+	try {
+		seq.resize(pos + size);
+		if(size > 0) {
+			T* it = &seq[pos];
+			T* const end = it + size;
+			do {
+				d >> *it;
+				++it;
+			} while(it < end);
+		}
+	} catch(...) {
+		seq.resize(pos);
+		throw;
+	}
+	v.restore_order(pos);
+	return d;
+}
+
+template <typename Stream, typename T, typename C>
+inline packer<Stream>& operator<< (packer<Stream>& o, const type::flat_set<T,C>& v)
+{
+	o.pack_array(v.size());
+	if(!v.empty()) {
+		const T* it = &v.sequence()[0];
+		const T* const end = it + v.size();
+		do {
+			o.pack(*it);
+			++it;
+		} while(it < end);
+	}
+	return o;
+}
+
+template <typename T, typename C>
+inline void operator<< (object::with_zone& o, const type::flat_set<T,C>& v)
+{
+	o.type = type::ARRAY;
+	if(v.empty()) {
+		o.via.array.ptr = NULL;
+		o.via.array.size = 0;
+	} else {
+		object* p = (object*)o.zone->malloc(sizeof(object)*v.size());
+		object* const pend = p + v.size();
+		o.via.array.ptr = p;
+		o.via.array.size = v.size();
+		const T* it = &v.sequence()[0];
+		do {
+			*p = object(*it, o.zone);
+			++p;
+			++it;
+		} while(p < pend);
+	}
+}
+
+
+}  // namespace msgpack
+
+#endif /* msgpack/type/flat_set.hpp */
+
@@ -34,6 +34,12 @@ inline float& operator>> (object o, float& v)
 	return v;
 }
 
+inline decoder& operator>> (decoder& d, float& v)
+{
+	v = d.read_double();
+	return d;
+}
+
 template <typename Stream>
 inline packer<Stream>& operator<< (packer<Stream>& o, const float& v)
 {
@@ -49,6 +55,12 @@ inline double& operator>> (object o, double& v)
 	return v;
 }
 
+inline decoder& operator>> (decoder& d, double& v)
+{
+	v = d.read_double();
+	return d;
+}
+
 template <typename Stream>
 inline packer<Stream>& operator<< (packer<Stream>& o, const double& v)
 {
@@ -99,6 +99,38 @@ inline unsigned long long& operator>> (object o, unsigned long long& v)
 	{ v = type::detail::convert_integer<unsigned long long>(o); return v; }
 
 
+inline decoder& operator>> (decoder& d, signed char& v)
+	{ v = d.read_integer<signed char>(); return d; }
+
+inline decoder& operator>> (decoder& d, signed short& v)
+	{ v = d.read_integer<signed short>(); return d; }
+
+inline decoder& operator>> (decoder& d, signed int& v)
+	{ v = d.read_integer<signed int>(); return d; }
+
+inline decoder& operator>> (decoder& d, signed long& v)
+	{ v = d.read_integer<signed long>(); return d; }
+
+inline decoder& operator>> (decoder& d, signed long long& v)
+	{ v = d.read_integer<signed long long>(); return d; }
+
+
+inline decoder& operator>> (decoder& d, unsigned char& v)
+	{ v = d.read_integer<unsigned char>(); return d; }
+
+inline decoder& operator>> (decoder& d, unsigned short& v)
+	{ v = d.read_integer<unsigned short>(); return d; }
+
+inline decoder& operator>> (decoder& d, unsigned int& v)
+	{ v = d.read_integer<unsigned int>(); return d; }
+
+inline decoder& operator>> (decoder& d, unsigned long& v)
+	{ v = d.read_integer<unsigned long>(); return d; }
+
+inline decoder& operator>> (decoder& d, unsigned long long& v)
+	{ v = d.read_integer<unsigned long long>(); return d; }
+
+
 template <typename Stream>
 inline packer<Stream>& operator<< (packer<Stream>& o, const signed char& v)
 	{ o.pack_int8(v); return o; }
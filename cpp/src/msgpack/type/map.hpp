@@ -19,9 +19,15 @@
 #define MSGPACK_TYPE_MAP_HPP__
 
 #include "msgpack/object.hpp"
+#include "msgpack/type/raw.hpp"
 #include <map>
 #include <vector>
+#include <string>
+#include <string.h>
 #include <algorithm>
+#ifdef MSGPACK_USE_CPP11
+#include <tuple>
+#endif
 
 namespace msgpack {
 
@@ -37,6 +43,61 @@ namespace detail {
 		bool operator() (const std::pair<K, V>& x, const std::pair<K, V>& y) const
 			{ return x.first < y.first; }
 	};
+
+	// compares a key without converting it; false if not supported
+	template <typename K>
+	inline bool key_equal(const object& o, const K& k)
+		{ return false; }
+
+	inline bool key_equal(const object& o, const std::string& k)
+	{
+		return o.type == type::RAW && o.via.raw.size == k.size() &&
+			memcmp(o.via.raw.ptr, k.data(), k.size()) == 0;
+	}
+
+	inline bool key_equal(const object& o, const raw_ref& k)
+	{
+		return o.type == type::RAW && o.via.raw.size == k.size &&
+			memcmp(o.via.raw.ptr, k.ptr, k.size) == 0;
+	}
+
+#ifdef MSGPACK_USE_CPP17
+	inline bool key_equal(const object& o, const std::string_view& k)
+	{
+		return o.type == type::RAW && o.via.raw.size == k.size() &&
+			memcmp(o.via.raw.ptr, k.data(), k.size()) == 0;
+	}
+#endif
+
+	// inserts the key with a default value at the hint
+	template <typename Map, typename K>
+	inline typename Map::iterator map_emplace(Map& v, typename Map::iterator hint, K& key)
+	{
+#ifdef MSGPACK_USE_CPP11
+		return v.emplace_hint(hint, std::piecewise_construct,
+				std::forward_as_tuple(std::move(key)), std::tuple<>());
+#else
+		return v.insert(hint, typename Map::value_type(key, typename Map::mapped_type()));
+#endif
+	}
+
+	// returns the entry of the key, inserting it with a default value if
+	// it doesn't exist. Keys which arrive sorted are appended without lookup.
+	template <typename K, typename V, typename C>
+	inline typename std::map<K,V,C>::iterator map_find_or_insert(std::map<K,V,C>& v,
+			K& key, bool* inserted)
+	{
+		typename std::map<K,V,C>::iterator it = v.end();
+		if(!v.empty() && !v.key_comp()(v.rbegin()->first, key)) {
+			it = v.lower_bound(key);
+			if(!v.key_comp()(key, it->first)) {
+				*inserted = false;
+				return it;
+			}
+		}
+		*inserted = true;
+		return map_emplace(v, it, key);
+	}
 }
 
 }  //namespace type
@@ -93,32 +154,44 @@ inline void operator<< (object::with_zone& o, const type::assoc_vector<K,V>& v)
 }
 
 
-template <typename K, typename V>
-inline std::map<K, V> operator>> (object o, std::map<K, V>& v)
+template <typename K, typename V, typename C>
+inline std::map<K,V,C>& operator>> (object o, std::map<K,V,C>& v)
 {
 	if(o.type != type::MAP) { throw type_error(); }
 	object_kv* p(o.via.map.ptr);
 	object_kv* const pend(o.via.map.ptr + o.via.map.size);
+	// Records often repeat keys in the same order. When the map is reused,
+	// keys are compared with the next entry first to skip conversion and
+	// lookup of them.
+	typename std::map<K,V,C>::iterator hint(v.begin());
 	for(; p != pend; ++p) {
-		K key;
-		p->key.convert(&key);
-		typename std::map<K,V>::iterator it(v.lower_bound(key));
-		if(it != v.end() && !(key < it->first)) {
-			p->val.convert(&it->second);
+		typename std::map<K,V,C>::iterator it;
+		bool inserted = false;
+		if(hint != v.end() && type::detail::key_equal(p->key, hint->first)) {
+			it = hint;
 		} else {
-			V val;
-			p->val.convert(&val);
-			v.insert(it, std::pair<K,V>(key, val));
+			K key;
+			p->key.convert(&key);
+			it = type::detail::map_find_or_insert(v, key, &inserted);
+		}
+		try {
+			p->val.convert(&it->second);
+		} catch(...) {
+			// a new key doesn't stay with a value which was never converted
+			if(inserted) { v.erase(it); }
+			throw;
 		}
+		hint = it;
+		++hint;
 	}
 	return v;
 }
 
-template <typename Stream, typename K, typename V>
-inline packer<Stream>& operator<< (packer<Stream>& o, const std::map<K,V>& v)
+template <typename Stream, typename K, typename V, typename C>
+inline packer<Stream>& operator<< (packer<Stream>& o, const std::map<K,V,C>& v)
 {
 	o.pack_map(v.size());
-	for(typename std::map<K,V>::const_iterator it(v.begin()), it_end(v.end());
+	for(typename std::map<K,V,C>::const_iterator it(v.begin()), it_end(v.end());
 			it != it_end; ++it) {
 		o.pack(it->first);
 		o.pack(it->second);
@@ -126,8 +199,8 @@ inline packer<Stream>& operator<< (packer<Stream>& o, const std::map<K,V>& v)
 	return o;
 }
 
-template <typename K, typename V>
-inline void operator<< (object::with_zone& o, const std::map<K,V>& v)
+template <typename K, typename V, typename C>
+inline void operator<< (object::with_zone& o, const std::map<K,V,C>& v)
 {
 	o.type = type::MAP;
 	if(v.empty()) {
@@ -138,7 +211,7 @@ inline void operator<< (object::with_zone& o, const std::map<K,V>& v)
 		object_kv* const pend = p + v.size();
 		o.via.map.ptr  = p;
 		o.via.map.size = v.size();
-		typename std::map<K,V>::const_iterator it(v.begin());
+		typename std::map<K,V,C>::const_iterator it(v.begin());
 		do {
 			p->key = object(it->first, o.zone);
 			p->val = object(it->second, o.zone);
@@ -149,26 +222,33 @@ inline void operator<< (object::with_zone& o, const std::map<K,V>& v)
 }
 
 
-template <typename K, typename V>
-inline std::multimap<K, V> operator>> (object o, std::multimap<K, V>& v)
+template <typename K, typename V, typename C>
+inline std::multimap<K,V,C>& operator>> (object o, std::multimap<K,V,C>& v)
 {
 	if(o.type != type::MAP) { throw type_error(); }
 	object_kv* p(o.via.map.ptr);
 	object_kv* const pend(o.via.map.ptr + o.via.map.size);
 	for(; p != pend; ++p) {
-		std::pair<K, V> value;
-		p->key.convert(&value.first);
-		p->val.convert(&value.second);
-		v.insert(value);
+		K key;
+		p->key.convert(&key);
+		// the end is the right place for sorted keys and keeps the order of equal keys
+		typename std::multimap<K,V,C>::iterator it =
+			type::detail::map_emplace(v, v.end(), key);
+		try {
+			p->val.convert(&it->second);
+		} catch(...) {
+			v.erase(it);
+			throw;
+		}
 	}
 	return v;
 }
 
-template <typename Stream, typename K, typename V>
-inline packer<Stream>& operator<< (packer<Stream>& o, const std::multimap<K,V>& v)
+template <typename Stream, typename K, typename V, typename C>
+inline packer<Stream>& operator<< (packer<Stream>& o, const std::multimap<K,V,C>& v)
 {
 	o.pack_map(v.size());
-	for(typename std::multimap<K,V>::const_iterator it(v.begin()), it_end(v.end());
+	for(typename std::multimap<K,V,C>::const_iterator it(v.begin()), it_end(v.end());
 			it != it_end; ++it) {
 		o.pack(it->first);
 		o.pack(it->second);
@@ -176,8 +256,8 @@ inline packer<Stream>& operator<< (packer<Stream>& o, const std::multimap<K,V>&
 	return o;
 }
 
-template <typename K, typename V>
-inline void operator<< (object::with_zone& o, const std::multimap<K,V>& v)
+template <typename K, typename V, typename C>
+inline void operator<< (object::with_zone& o, const std::multimap<K,V,C>& v)
 {
 	o.type = type::MAP;
 	if(v.empty()) {
@@ -188,7 +268,7 @@ inline void operator<< (object::with_zone& o, const std::multimap<K,V>& v)
 		object_kv* const pend = p + v.size();
 		o.via.map.ptr  = p;
 		o.via.map.size = v.size();
-		typename std::multimap<K,V>::const_iterator it(v.begin());
+		typename std::multimap<K,V,C>::const_iterator it(v.begin());
 		do {
 			p->key = object(it->first, o.zone);
 			p->val = object(it->second, o.zone);
@@ -35,6 +35,12 @@ inline type::nil& operator>> (object o, type::nil& v)
 	return v;
 }
 
+inline decoder& operator>> (decoder& d, type::nil& v)
+{
+	d.read_nil();
+	return d;
+}
+
 template <typename Stream>
 inline packer<Stream>& operator<< (packer<Stream>& o, const type::nil& v)
 {
@@ -19,8 +19,15 @@
 #define MSGPACK_TYPE_RAW_HPP__
 
 #include "msgpack/object.hpp"
+#include "msgpack/hash.h"
 #include <string.h>
 #include <string>
+#ifdef MSGPACK_USE_CPP11
+#include <functional>
+#endif
+#ifdef MSGPACK_USE_CPP17
+#include <string_view>
+#endif
 
 namespace msgpack {
 
@@ -33,29 +40,82 @@ struct raw_ref {
 	uint32_t size;
 	const char* ptr;
 
-	std::string str() { return std::string(ptr, size); }
+	std::string str() const { return std::string(ptr, size); }
 
-	bool operator== (const raw_ref& x)
+	// Raws are ordered by size first, and then by bytes.
+	bool operator== (const raw_ref& x) const
 	{
 		return size == x.size && memcmp(ptr, x.ptr, size) == 0;
 	}
 
-	bool operator!= (const raw_ref& x)
+	bool operator!= (const raw_ref& x) const
 	{
-		return !(*this != x);
+		return !(*this == x);
 	}
 
-	bool operator< (const raw_ref& x)
+	bool operator< (const raw_ref& x) const
 	{
 		if(size == x.size) { return memcmp(ptr, x.ptr, size) < 0; }
 		else { return size < x.size; }
 	}
 
-	bool operator> (const raw_ref& x)
+	bool operator> (const raw_ref& x) const
 	{
 		if(size == x.size) { return memcmp(ptr, x.ptr, size) > 0; }
 		else { return size > x.size; }
 	}
+
+	bool operator<= (const raw_ref& x) const { return !(*this > x); }
+	bool operator>= (const raw_ref& x) const { return !(*this < x); }
+};
+
+namespace detail {
+	inline raw_ref as_raw_ref(const raw_ref& x) { return x; }
+	inline raw_ref as_raw_ref(const std::string& x)
+		{ return raw_ref(x.data(), (uint32_t)x.size()); }
+	inline raw_ref as_raw_ref(const char* x)
+		{ return raw_ref(x, (uint32_t)strlen(x)); }
+#ifdef MSGPACK_USE_CPP17
+	inline raw_ref as_raw_ref(std::string_view x)
+		{ return raw_ref(x.data(), (uint32_t)x.size()); }
+#endif
+}
+
+// Function objects for containers keyed by raw_ref.
+// They also accept std::string, const char* and std::string_view
+// in the order of raw_ref, so that keys are looked up without building
+// a raw_ref, or a std::string, where heterogeneous lookup is supported:
+//
+//   std::map<raw_ref, int, raw_ref_less> m;
+//   m.find(std::string("key"));
+//
+//   std::unordered_map<raw_ref, int, raw_ref_hash, raw_ref_equal_to> u;
+
+struct raw_ref_less {
+	typedef void is_transparent;
+
+	template <typename X, typename Y>
+	bool operator() (const X& x, const Y& y) const
+		{ return detail::as_raw_ref(x) < detail::as_raw_ref(y); }
+};
+
+struct raw_ref_equal_to {
+	typedef void is_transparent;
+
+	template <typename X, typename Y>
+	bool operator() (const X& x, const Y& y) const
+		{ return detail::as_raw_ref(x) == detail::as_raw_ref(y); }
+};
+
+struct raw_ref_hash {
+	typedef void is_transparent;
+
+	template <typename X>
+	size_t operator() (const X& x) const
+	{
+		raw_ref r = detail::as_raw_ref(x);
+		return (size_t)msgpack_hash_bytes(r.ptr, r.size, 0);
+	}
 };
 
 }  // namespace type
@@ -69,6 +129,14 @@ inline type::raw_ref& operator>> (object o, type::raw_ref& v)
 	return v;
 }
 
+inline decoder& operator>> (decoder& d, type::raw_ref& v)
+{
+	object_raw r = d.read_raw();
+	v.ptr  = r.ptr;
+	v.size = r.size;
+	return d;
+}
+
 template <typename Stream>
 inline packer<Stream>& operator<< (packer<Stream>& o, const type::raw_ref& v)
 {
@@ -90,5 +158,14 @@ inline void operator<< (object::with_zone& o, const type::raw_ref& v)
 
 }  // namespace msgpack
 
+#ifdef MSGPACK_USE_CPP11
+namespace std {
+
+template <>
+struct hash<msgpack::type::raw_ref> : msgpack::type::raw_ref_hash { };
+
+}  // namespace std
+#endif
+
 #endif /* msgpack/type/raw.hpp */
 
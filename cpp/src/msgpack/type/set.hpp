@@ -24,32 +24,34 @@
 namespace msgpack {
 
 
-template <typename T>
-inline std::set<T>& operator>> (object o, std::set<T>& v)
+template <typename T, typename C>
+inline std::set<T,C>& operator>> (object o, std::set<T,C>& v)
 {
 	if(o.type != type::ARRAY) { throw type_error(); }
-	object* p = o.via.array.ptr + o.via.array.size;
-	object* const pbegin = o.via.array.ptr;
-	while(p > pbegin) {
-		--p;
-		v.insert(p->as<T>());
+	object* p = o.via.array.ptr;
+	object* const pend = o.via.array.ptr + o.via.array.size;
+	for(; p < pend; ++p) {
+		T value;
+		p->convert(&value);
+		// constant time for sorted elements
+		v.insert(v.end(), MSGPACK_MOVE(value));
 	}
 	return v;
 }
 
-template <typename Stream, typename T>
-inline packer<Stream>& operator<< (packer<Stream>& o, const std::set<T>& v)
+template <typename Stream, typename T, typename C>
+inline packer<Stream>& operator<< (packer<Stream>& o, const std::set<T,C>& v)
 {
 	o.pack_array(v.size());
-	for(typename std::set<T>::const_iterator it(v.begin()), it_end(v.end());
+	for(typename std::set<T,C>::const_iterator it(v.begin()), it_end(v.end());
 			it != it_end; ++it) {
 		o.pack(*it);
 	}
 	return o;
 }
 
-template <typename T>
-inline void operator<< (object::with_zone& o, const std::set<T>& v)
+template <typename T, typename C>
+inline void operator<< (object::with_zone& o, const std::set<T,C>& v)
 {
 	o.type = type::ARRAY;
 	if(v.empty()) {
@@ -60,7 +62,7 @@ inline void operator<< (object::with_zone& o, const std::set<T>& v)
 		object* const pend = p + v.size();
 		o.via.array.ptr = p;
 		o.via.array.size = v.size();
-		typename std::set<T>::const_iterator it(v.begin());
+		typename std::set<T,C>::const_iterator it(v.begin());
 		do {
 			*p = object(*it, o.zone);
 			++p;
@@ -70,32 +72,34 @@ inline void operator<< (object::with_zone& o, const std::set<T>& v)
 }
 
 
-template <typename T>
-inline std::multiset<T>& operator>> (object o, std::multiset<T>& v)
+template <typename T, typename C>
+inline std::multiset<T,C>& operator>> (object o, std::multiset<T,C>& v)
 {
 	if(o.type != type::ARRAY) { throw type_error(); }
-	object* p = o.via.array.ptr + o.via.array.size;
-	object* const pbegin = o.via.array.ptr;
-	while(p > pbegin) {
-		--p;
-		v.insert(p->as<T>());
+	object* p = o.via.array.ptr;
+	object* const pend = o.via.array.ptr + o.via.array.size;
+	for(; p < pend; ++p) {
+		T value;
+		p->convert(&value);
+		// constant time for sorted elements
+		v.insert(v.end(), MSGPACK_MOVE(value));
 	}
 	return v;
 }
 
-template <typename Stream, typename T>
-inline packer<Stream>& operator<< (packer<Stream>& o, const std::multiset<T>& v)
+template <typename Stream, typename T, typename C>
+inline packer<Stream>& operator<< (packer<Stream>& o, const std::multiset<T,C>& v)
 {
 	o.pack_array(v.size());
-	for(typename std::multiset<T>::const_iterator it(v.begin()), it_end(v.end());
+	for(typename std::multiset<T,C>::const_iterator it(v.begin()), it_end(v.end());
 			it != it_end; ++it) {
 		o.pack(*it);
 	}
 	return o;
 }
 
-template <typename T>
-inline void operator<< (object::with_zone& o, const std::multiset<T>& v)
+template <typename T, typename C>
+inline void operator<< (object::with_zone& o, const std::multiset<T,C>& v)
 {
 	o.type = type::ARRAY;
 	if(v.empty()) {
@@ -106,7 +110,7 @@ inline void operator<< (object::with_zone& o, const std::multiset<T>& v)
 		object* const pend = p + v.size();
 		o.via.array.ptr = p;
 		o.via.array.size = v.size();
-		typename std::multiset<T>::const_iterator it(v.begin());
+		typename std::multiset<T,C>::const_iterator it(v.begin());
 		do {
 			*p = object(*it, o.zone);
 			++p;
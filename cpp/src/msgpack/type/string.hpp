@@ -31,6 +31,13 @@ inline std::string& operator>> (object o, std::string& v)
 	return v;
 }
 
+inline decoder& operator>> (decoder& d, std::string& v)
+{
+	object_raw r = d.read_raw();
+	v.assign(r.ptr, r.size);
+	return d;
+}
+
 template <typename Stream>
 inline packer<Stream>& operator<< (packer<Stream>& o, const std::string& v)
 {
@@ -24,10 +24,14 @@
 namespace msgpack {
 
 
-template <typename K, typename V>
-inline std::tr1::unordered_map<K, V> operator>> (object o, std::tr1::unordered_map<K, V>& v)
+template <typename K, typename V, typename H, typename E>
+inline std::tr1::unordered_map<K,V,H,E>& operator>> (object o, std::tr1::unordered_map<K,V,H,E>& v)
 {
 	if(o.type != type::MAP) { throw type_error(); }
+	const size_t n = v.size() + o.via.map.size;
+	if(n > v.bucket_count() * v.max_load_factor()) {
+		v.rehash((size_t)(n / v.max_load_factor()) + 1);
+	}
 	object_kv* p(o.via.map.ptr);
 	object_kv* const pend(o.via.map.ptr + o.via.map.size);
 	for(; p != pend; ++p) {
@@ -38,11 +42,11 @@ inline std::tr1::unordered_map<K, V> operator>> (object o, std::tr1::unordered_m
 	return v;
 }
 
-template <typename Stream, typename K, typename V>
-inline packer<Stream>& operator<< (packer<Stream>& o, const std::tr1::unordered_map<K,V>& v)
+template <typename Stream, typename K, typename V, typename H, typename E>
+inline packer<Stream>& operator<< (packer<Stream>& o, const std::tr1::unordered_map<K,V,H,E>& v)
 {
 	o.pack_map(v.size());
-	for(typename std::tr1::unordered_map<K,V>::const_iterator it(v.begin()), it_end(v.end());
+	for(typename std::tr1::unordered_map<K,V,H,E>::const_iterator it(v.begin()), it_end(v.end());
 			it != it_end; ++it) {
 		o.pack(it->first);
 		o.pack(it->second);
@@ -50,8 +54,8 @@ inline packer<Stream>& operator<< (packer<Stream>& o, const std::tr1::unordered_
 	return o;
 }
 
-template <typename K, typename V>
-inline void operator<< (object::with_zone& o, const std::tr1::unordered_map<K,V>& v)
+template <typename K, typename V, typename H, typename E>
+inline void operator<< (object::with_zone& o, const std::tr1::unordered_map<K,V,H,E>& v)
 {
 	o.type = type::MAP;
 	if(v.empty()) {
@@ -62,7 +66,7 @@ inline void operator<< (object::with_zone& o, const std::tr1::unordered_map<K,V>
 		object_kv* const pend = p + v.size();
 		o.via.map.ptr  = p;
 		o.via.map.size = v.size();
-		typename std::tr1::unordered_map<K,V>::const_iterator it(v.begin());
+		typename std::tr1::unordered_map<K,V,H,E>::const_iterator it(v.begin());
 		do {
 			p->key = object(it->first, o.zone);
 			p->val = object(it->second, o.zone);
@@ -73,10 +77,14 @@ inline void operator<< (object::with_zone& o, const std::tr1::unordered_map<K,V>
 }
 
 
-template <typename K, typename V>
-inline std::tr1::unordered_multimap<K, V> operator>> (object o, std::tr1::unordered_multimap<K, V>& v)
+template <typename K, typename V, typename H, typename E>
+inline std::tr1::unordered_multimap<K,V,H,E>& operator>> (object o, std::tr1::unordered_multimap<K,V,H,E>& v)
 {
 	if(o.type != type::MAP) { throw type_error(); }
+	const size_t n = v.size() + o.via.map.size;
+	if(n > v.bucket_count() * v.max_load_factor()) {
+		v.rehash((size_t)(n / v.max_load_factor()) + 1);
+	}
 	object_kv* p(o.via.map.ptr);
 	object_kv* const pend(o.via.map.ptr + o.via.map.size);
 	for(; p != pend; ++p) {
@@ -88,11 +96,11 @@ inline std::tr1::unordered_multimap<K, V> operator>> (object o, std::tr1::unorde
 	return v;
 }
 
-template <typename Stream, typename K, typename V>
-inline packer<Stream>& operator<< (packer<Stream>& o, const std::tr1::unordered_multimap<K,V>& v)
+template <typename Stream, typename K, typename V, typename H, typename E>
+inline packer<Stream>& operator<< (packer<Stream>& o, const std::tr1::unordered_multimap<K,V,H,E>& v)
 {
 	o.pack_map(v.size());
-	for(typename std::tr1::unordered_multimap<K,V>::const_iterator it(v.begin()), it_end(v.end());
+	for(typename std::tr1::unordered_multimap<K,V,H,E>::const_iterator it(v.begin()), it_end(v.end());
 			it != it_end; ++it) {
 		o.pack(it->first);
 		o.pack(it->second);
@@ -100,8 +108,8 @@ inline packer<Stream>& operator<< (packer<Stream>& o, const std::tr1::unordered_
 	return o;
 }
 
-template <typename K, typename V>
-inline void operator<< (object::with_zone& o, const std::tr1::unordered_multimap<K,V>& v)
+template <typename K, typename V, typename H, typename E>
+inline void operator<< (object::with_zone& o, const std::tr1::unordered_multimap<K,V,H,E>& v)
 {
 	o.type = type::MAP;
 	if(v.empty()) {
@@ -112,7 +120,7 @@ inline void operator<< (object::with_zone& o, const std::tr1::unordered_multimap
 		object_kv* const pend = p + v.size();
 		o.via.map.ptr  = p;
 		o.via.map.size = v.size();
-		typename std::tr1::unordered_multimap<K,V>::const_iterator it(v.begin());
+		typename std::tr1::unordered_multimap<K,V,H,E>::const_iterator it(v.begin());
 		do {
 			p->key = object(it->first, o.zone);
 			p->val = object(it->second, o.zone);
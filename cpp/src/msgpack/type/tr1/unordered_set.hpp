@@ -24,32 +24,37 @@
 namespace msgpack {
 
 
-template <typename T>
-inline std::tr1::unordered_set<T>& operator>> (object o, std::tr1::unordered_set<T>& v)
+template <typename T, typename H, typename E>
+inline std::tr1::unordered_set<T,H,E>& operator>> (object o, std::tr1::unordered_set<T,H,E>& v)
 {
 	if(o.type != type::ARRAY) { throw type_error(); }
-	object* p = o.via.array.ptr + o.via.array.size;
-	object* const pbegin = o.via.array.ptr;
-	while(p > pbegin) {
-		--p;
-		v.insert(p->as<T>());
+	const size_t n = v.size() + o.via.array.size;
+	if(n > v.bucket_count() * v.max_load_factor()) {
+		v.rehash((size_t)(n / v.max_load_factor()) + 1);
+	}
+	object* p = o.via.array.ptr;
+	object* const pend = o.via.array.ptr + o.via.array.size;
+	for(; p < pend; ++p) {
+		T value;
+		p->convert(&value);
+		v.insert(value);
 	}
 	return v;
 }
 
-template <typename Stream, typename T>
-inline packer<Stream>& operator<< (packer<Stream>& o, const std::tr1::unordered_set<T>& v)
+template <typename Stream, typename T, typename H, typename E>
+inline packer<Stream>& operator<< (packer<Stream>& o, const std::tr1::unordered_set<T,H,E>& v)
 {
 	o.pack_array(v.size());
-	for(typename std::tr1::unordered_set<T>::const_iterator it(v.begin()), it_end(v.end());
+	for(typename std::tr1::unordered_set<T,H,E>::const_iterator it(v.begin()), it_end(v.end());
 			it != it_end; ++it) {
 		o.pack(*it);
 	}
 	return o;
 }
 
-template <typename T>
-inline void operator<< (object::with_zone& o, const std::tr1::unordered_set<T>& v)
+template <typename T, typename H, typename E>
+inline void operator<< (object::with_zone& o, const std::tr1::unordered_set<T,H,E>& v)
 {
 	o.type = type::ARRAY;
 	if(v.empty()) {
@@ -60,7 +65,7 @@ inline void operator<< (object::with_zone& o, const std::tr1::unordered_set<T>&
 		object* const pend = p + v.size();
 		o.via.array.ptr = p;
 		o.via.array.size = v.size();
-		typename std::tr1::unordered_set<T>::const_iterator it(v.begin());
+		typename std::tr1::unordered_set<T,H,E>::const_iterator it(v.begin());
 		do {
 			*p = object(*it, o.zone);
 			++p;
@@ -70,32 +75,37 @@ inline void operator<< (object::with_zone& o, const std::tr1::unordered_set<T>&
 }
 
 
-template <typename T>
-inline std::tr1::unordered_multiset<T>& operator>> (object o, std::tr1::unordered_multiset<T>& v)
+template <typename T, typename H, typename E>
+inline std::tr1::unordered_multiset<T,H,E>& operator>> (object o, std::tr1::unordered_multiset<T,H,E>& v)
 {
 	if(o.type != type::ARRAY) { throw type_error(); }
-	object* p = o.via.array.ptr + o.via.array.size;
-	object* const pbegin = o.via.array.ptr;
-	while(p > pbegin) {
-		--p;
-		v.insert(p->as<T>());
+	const size_t n = v.size() + o.via.array.size;
+	if(n > v.bucket_count() * v.max_load_factor()) {
+		v.rehash((size_t)(n / v.max_load_factor()) + 1);
+	}
+	object* p = o.via.array.ptr;
+	object* const pend = o.via.array.ptr + o.via.array.size;
+	for(; p < pend; ++p) {
+		T value;
+		p->convert(&value);
+		v.insert(value);
 	}
 	return v;
 }
 
-template <typename Stream, typename T>
-inline packer<Stream>& operator<< (packer<Stream>& o, const std::tr1::unordered_multiset<T>& v)
+template <typename Stream, typename T, typename H, typename E>
+inline packer<Stream>& operator<< (packer<Stream>& o, const std::tr1::unordered_multiset<T,H,E>& v)
 {
 	o.pack_array(v.size());
-	for(typename std::tr1::unordered_multiset<T>::const_iterator it(v.begin()), it_end(v.end());
+	for(typename std::tr1::unordered_multiset<T,H,E>::const_iterator it(v.begin()), it_end(v.end());
 			it != it_end; ++it) {
 		o.pack(*it);
 	}
 	return o;
 }
 
-template <typename T>
-inline void operator<< (object::with_zone& o, const std::tr1::unordered_multiset<T>& v)
+template <typename T, typename H, typename E>
+inline void operator<< (object::with_zone& o, const std::tr1::unordered_multiset<T,H,E>& v)
 {
 	o.type = type::ARRAY;
 	if(v.empty()) {
@@ -106,7 +116,7 @@ inline void operator<< (object::with_zone& o, const std::tr1::unordered_multiset
 		object* const pend = p + v.size();
 		o.via.array.ptr = p;
 		o.via.array.size = v.size();
-		typename std::tr1::unordered_multiset<T>::const_iterator it(v.begin());
+		typename std::tr1::unordered_multiset<T,H,E>::const_iterator it(v.begin());
 		do {
 			*p = object(*it, o.zone);
 			++p;
@@ -42,6 +42,22 @@ inline std::vector<T>& operator>> (object o, std::vector<T>& v)
 	return v;
 }
 
+template <typename T>
+inline decoder& operator>> (decoder& d, std::vector<T>& v)
+{
+	const uint32_t size = d.read_array();
+	v.resize(size);
+	if(size > 0) {
+		T* it = &v[0];
+		T* const end = it + size;
+		do {
+			d >> *it;
+			++it;
+		} while(it < end);
+	}
+	return d;
+}
+
 template <typename Stream, typename T>
 inline packer<Stream>& operator<< (packer<Stream>& o, const std::vector<T>& v)
 {
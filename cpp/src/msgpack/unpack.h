@@ -59,6 +59,7 @@ typedef struct msgpack_unpacker {
 	msgpack_zone* z;
 	size_t initial_buffer_size;
 	void* ctx;
+	size_t ring;  /* capacity of the ring buffer, 0 if buffer is malloc'ed */
 } msgpack_unpacker;
 
 
@@ -89,6 +90,68 @@ msgpack_unpacker* msgpack_unpacker_new(size_t initial_buffer_size);
  */
 void msgpack_unpacker_free(msgpack_unpacker* mpac);
 
+/**
+ * Initializes a streaming deserializer which receives data into a ring
+ * buffer of fixed capacity (rounded up to a multiple of the page size).
+ * The ring is mapped twice back to back, so a message which wraps around
+ * its end is still contiguous in memory and is never copied or moved.
+ *
+ * The buffer never grows: msgpack_unpacker_reserve_buffer(msgpack_unpacker*, size_t)
+ * reclaims the space of parsed messages and fails if fewer than size
+ * bytes are free, and a message larger than the capacity can't be
+ * received. Zones of deserialized objects don't keep the buffer, so raw
+ * objects point into the ring and are valid only until the next
+ * msgpack_unpacker_reserve_buffer(msgpack_unpacker*, size_t) call;
+ * objects which are used later must be copied out before it.
+ *
+ * Destroy it by msgpack_unpacker_destroy(msgpack_unpacker*).
+ * Not available on Windows.
+ */
+bool msgpack_unpacker_init_ring(msgpack_unpacker* mpac, size_t capacity);
+
+/**
+ * Creates a streaming deserializer with a ring buffer like
+ * msgpack_unpacker_init_ring(msgpack_unpacker*, size_t).
+ * The created deserializer must be destroyed by msgpack_unpacker_free(msgpack_unpacker*).
+ */
+msgpack_unpacker* msgpack_unpacker_new_ring(size_t capacity);
+
+
+/**
+ * Upper bounds of a message accepted by the streaming deserializer.
+ * 0 means unlimited.
+ */
+typedef struct msgpack_unpack_limit {
+	size_t raw;          /* length of a raw value */
+	size_t array;        /* number of elements of an array */
+	size_t map;          /* number of key-value pairs of a map */
+	size_t bytes;        /* size of a message */
+	unsigned int depth;  /* nesting level of arrays and maps */
+} msgpack_unpack_limit;
+
+/**
+ * Sets limits of incoming messages.
+ * Lengths are checked as soon as a header is parsed, before the body
+ * is buffered or memory for the elements is allocated, so that
+ * msgpack_unpacker_next(msgpack_unpacker*, msgpack_unpacked*) fails
+ * on a message which exceeds them.
+ * Passing NULL removes all limits.
+ */
+void msgpack_unpacker_set_limit(msgpack_unpacker* mpac, const msgpack_unpack_limit* limit);
+
+/**
+ * Enables interning of keys of maps.
+ * Raw keys up to max_length bytes are copied into a dictionary held by the
+ * deserializer, and equal keys in following messages point to the same
+ * memory, so that they can be compared by pointer.
+ * The dictionary keeps up to max_keys keys. When it's full, it is cleared
+ * and starts over. Keys remain valid while zones of messages which refer
+ * them are alive.
+ * Passing 0 to max_keys disables interning.
+ */
+bool msgpack_unpacker_set_intern(msgpack_unpacker* mpac,
+		size_t max_keys, size_t max_length);
+
 
 #ifndef MSGPACK_UNPACKER_RESERVE_SIZE
 #define MSGPACK_UNPACKER_RESERVE_SIZE (32*1024)
@@ -180,6 +243,7 @@ typedef enum {
 	MSGPACK_UNPACK_EXTRA_BYTES			=  1,
 	MSGPACK_UNPACK_CONTINUE				=  0,
 	MSGPACK_UNPACK_PARSE_ERROR			= -1,
+	MSGPACK_UNPACK_NOMEM_ERROR			= -2,
 } msgpack_unpack_return;
 
 // obsolete
@@ -32,9 +32,16 @@
 namespace msgpack {
 
 
-struct unpack_error : public std::runtime_error {
-	unpack_error(const std::string& msg) :
-		std::runtime_error(msg) { }
+struct unpack_limit : msgpack_unpack_limit {
+	unpack_limit(size_t raw = 0, size_t array = 0, size_t map = 0,
+			size_t bytes = 0, unsigned int depth = 0)
+	{
+		msgpack_unpack_limit::raw = raw;
+		msgpack_unpack_limit::array = array;
+		msgpack_unpack_limit::map = map;
+		msgpack_unpack_limit::bytes = bytes;
+		msgpack_unpack_limit::depth = depth;
+	}
 };
 
 
@@ -85,6 +92,12 @@ public:
 	/*! 5. check if the size of message doesn't exceed assumption. */
 	size_t message_size() const;
 
+	/*! reject too large messages as soon as their headers are parsed */
+	void set_limit(const unpack_limit& limit);
+
+	/*! share memory of repeated keys of maps among messages */
+	void set_intern(size_t max_keys, size_t max_length = 32);
+
 	// Basic usage of the unpacker is as following:
 	//
 	// msgpack::unpacker pac;
@@ -120,6 +133,16 @@ public:
 	//     }
 	// }
 	//
+	// Instead of 5., set_limit() makes next() throw unpack_error as soon as
+	// a header declares a raw, an array or a map beyond the limits:
+	//
+	//     pac.set_limit(msgpack::unpack_limit(
+	//             1024*1024,          // raw
+	//             64*1024,            // array
+	//             64*1024,            // map
+	//             10*1024*1024,       // bytes
+	//             16));               // depth
+	//
 
 	/*! for backward compatibility */
 	bool execute();
@@ -153,6 +176,10 @@ public:
 	// Note that reset() leaves non-parsed buffer.
 	void remove_nonparsed_buffer();
 
+protected:
+	struct ring_tag { };
+	unpacker(ring_tag, size_t capacity);
+
 private:
 	typedef msgpack_unpacker base;
 
@@ -161,6 +188,35 @@ private:
 };
 
 
+// Unpacker which receives data into a ring buffer of fixed capacity;
+// see msgpack_unpacker_init_ring. The buffer is never grown or copied,
+// and raw objects point into it: they are valid only until the next
+// reserve_buffer() call, so copy or convert each message before it.
+//
+// msgpack::ring_unpacker pac(1024*1024);
+// while( /* input is readable */ ) {
+//     pac.reserve_buffer();
+//     size_t bytes = input.readsome(pac.buffer(), pac.buffer_capacity());
+//     pac.buffer_consumed(bytes);
+//
+//     msgpack::unpacked result;
+//     while(pac.next(&result)) {
+//         on_message(result.get().as<message_type>());
+//     }
+// }
+class ring_unpacker : public unpacker {
+public:
+	ring_unpacker(size_t capacity);
+
+	/*! reclaim space of parsed messages; throws unpack_error if less than
+	 *  `size' bytes are free, as when a message exceeds the capacity */
+	void reserve_buffer(size_t size = 1);
+
+private:
+	ring_unpacker(const ring_unpacker&);
+};
+
+
 static void unpack(unpacked* result,
 		const char* data, size_t len, size_t* offset = NULL);
 
@@ -189,6 +245,13 @@ inline unpacker::unpacker(size_t initial_buffer_size)
 	}
 }
 
+inline unpacker::unpacker(ring_tag, size_t capacity)
+{
+	if(!msgpack_unpacker_init_ring(this, capacity)) {
+		throw std::bad_alloc();
+	}
+}
+
 inline unpacker::~unpacker()
 {
 	msgpack_unpacker_destroy(this);
@@ -287,6 +350,18 @@ inline size_t unpacker::message_size() const
 	return msgpack_unpacker_message_size(this);
 }
 
+inline void unpacker::set_limit(const unpack_limit& limit)
+{
+	msgpack_unpacker_set_limit(this, &limit);
+}
+
+inline void unpacker::set_intern(size_t max_keys, size_t max_length)
+{
+	if(!msgpack_unpacker_set_intern(this, max_keys, max_length)) {
+		throw std::bad_alloc();
+	}
+}
+
 inline size_t unpacker::parsed_size() const
 {
 	return msgpack_unpacker_parsed_size(this);
@@ -313,6 +388,17 @@ inline void unpacker::remove_nonparsed_buffer()
 }
 
 
+inline ring_unpacker::ring_unpacker(size_t capacity) :
+	unpacker(ring_tag(), capacity) { }
+
+inline void ring_unpacker::reserve_buffer(size_t size)
+{
+	if(!msgpack_unpacker_reserve_buffer(this, size)) {
+		throw unpack_error("ring buffer is full");
+	}
+}
+
+
 inline void unpack(unpacked* result,
 		const char* data, size_t len, size_t* offset)
 {
@@ -0,0 +1,294 @@
+//
+// MessagePack for C++ event-based deserializer
+//
+// Copyright (C) 2008-2010 FURUHASHI Sadayuki
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+#ifndef MSGPACK_VISITOR_HPP__
+#define MSGPACK_VISITOR_HPP__
+
+#include "msgpack/unpack.hpp"
+#include "msgpack/unpack_define.h"
+
+namespace msgpack {
+
+
+// Visitors receive events of the deserializer instead of objects.
+// Derive from null_visitor and hide the functions you need:
+//
+//     struct sum_visitor : msgpack::null_visitor {
+//         sum_visitor() : sum(0) { }
+//         void visit_uint(uint64_t v) { sum += v; }
+//         uint64_t sum;
+//     };
+//
+// Elements of a map are visited as key, value, key, value, ...
+// Raws refer to the input buffer and are valid only in visit_raw().
+// Exceptions thrown by a visitor abort deserialization and are
+// propagated to the caller.
+struct null_visitor {
+	void visit_nil() { }
+	void visit_boolean(bool v) { }
+	void visit_uint(uint64_t v) { }
+	void visit_int(int64_t v) { }  // negative integers
+	void visit_double(double v) { }
+	void visit_raw(const char* ptr, uint32_t size) { }
+	void start_array(uint32_t n) { }
+	void end_array() { }
+	void start_map(uint32_t n) { }
+	void end_map() { }
+};
+
+
+namespace detail {
+
+struct visit_object {
+	uint32_t count;  // number of elements to be visited
+};
+
+struct visit_user {
+	void* visitor;
+};
+
+template <typename Visitor>
+struct visit_callback {
+	static Visitor& get(visit_user* u)
+		{ return *static_cast<Visitor*>(u->visitor); }
+
+	static visit_object _root(visit_user* u)
+		{ visit_object o = { 0 }; return o; }
+
+	static int _uint8(visit_user* u, uint8_t d, visit_object* o)
+		{ o->count = 0; get(u).visit_uint(d); return 0; }
+
+	static int _uint16(visit_user* u, uint16_t d, visit_object* o)
+		{ o->count = 0; get(u).visit_uint(d); return 0; }
+
+	static int _uint32(visit_user* u, uint32_t d, visit_object* o)
+		{ o->count = 0; get(u).visit_uint(d); return 0; }
+
+	static int _uint64(visit_user* u, uint64_t d, visit_object* o)
+		{ o->count = 0; get(u).visit_uint(d); return 0; }
+
+	static int _int64(visit_user* u, int64_t d, visit_object* o)
+	{
+		o->count = 0;
+		if(d >= 0) { get(u).visit_uint(d); }
+		else { get(u).visit_int(d); }
+		return 0;
+	}
+
+	static int _int8(visit_user* u, int8_t d, visit_object* o)
+		{ return _int64(u, d, o); }
+
+	static int _int16(visit_user* u, int16_t d, visit_object* o)
+		{ return _int64(u, d, o); }
+
+	static int _int32(visit_user* u, int32_t d, visit_object* o)
+		{ return _int64(u, d, o); }
+
+	static int _float(visit_user* u, float d, visit_object* o)
+		{ o->count = 0; get(u).visit_double(d); return 0; }
+
+	static int _double(visit_user* u, double d, visit_object* o)
+		{ o->count = 0; get(u).visit_double(d); return 0; }
+
+	static int _nil(visit_user* u, visit_object* o)
+		{ o->count = 0; get(u).visit_nil(); return 0; }
+
+	static int _true(visit_user* u, visit_object* o)
+		{ o->count = 0; get(u).visit_boolean(true); return 0; }
+
+	static int _false(visit_user* u, visit_object* o)
+		{ o->count = 0; get(u).visit_boolean(false); return 0; }
+
+	static int _array(visit_user* u, unsigned int n, visit_object* o)
+	{
+		o->count = n;
+		get(u).start_array(n);
+		if(n == 0) { get(u).end_array(); }
+		return 0;
+	}
+
+	static int _array_item(visit_user* u, visit_object* c, visit_object o)
+	{
+		if(--c->count == 0) { get(u).end_array(); }
+		return 0;
+	}
+
+	static int _map(visit_user* u, unsigned int n, visit_object* o)
+	{
+		o->count = n;
+		get(u).start_map(n);
+		if(n == 0) { get(u).end_map(); }
+		return 0;
+	}
+
+	static int _map_item(visit_user* u, visit_object* c, visit_object k, visit_object v)
+	{
+		if(--c->count == 0) { get(u).end_map(); }
+		return 0;
+	}
+
+	static int _raw(visit_user* u, const char* b, const char* p, unsigned int l, visit_object* o)
+		{ o->count = 0; get(u).visit_raw(p, l); return 0; }
+};
+
+
+#define msgpack_unpack_struct(name) \
+	visit_template ## name
+
+#define msgpack_unpack_struct_decl(name) \
+	struct visit_template ## name
+
+#define msgpack_unpack_func(ret, name) \
+	template <typename Visitor> \
+	inline ret visit_template ## name
+
+#define msgpack_unpack_callback(name) \
+	visit_callback<Visitor>::name
+
+#define msgpack_unpack_object visit_object
+
+#define msgpack_unpack_user visit_user
+
+#include "msgpack/unpack_template.h"
+
+#undef msgpack_unpack_struct_decl
+
+typedef visit_template_context visit_context;
+
+}  // namespace detail
+
+
+// Deserializes one object and calls functions of the visitor.
+// Returns UNPACK_SUCCESS, UNPACK_EXTRA_BYTES or UNPACK_CONTINUE like
+// msgpack::unpack(), and throws unpack_error on a parse error.
+template <typename Visitor>
+unpack_return visit(const char* data, size_t len, size_t* off, Visitor& v);
+
+
+// Streaming deserializer which drives a visitor.
+// Buffers are managed in the same way as unpacker:
+//
+//     msgpack::visit_unpacker pac;
+//     my_visitor v;
+//     while( /* input is readable */ ) {
+//         pac.reserve_buffer(32*1024);
+//         size_t bytes = input.readsome(pac.buffer(), pac.buffer_capacity());
+//         pac.buffer_consumed(bytes);
+//         while(pac.next(v)) {
+//             // v has visited a whole message
+//         }
+//     }
+//
+// Events of a message may be delivered over several calls of next().
+// next(unpacked*) of unpacker must not be called while a message is
+// being visited, and the unpacker can't be continued after next() threw
+// an exception.
+class visit_unpacker : public unpacker {
+public:
+	visit_unpacker(size_t init_buffer_size = MSGPACK_UNPACKER_INIT_BUFFER_SIZE);
+
+public:
+	using unpacker::next;
+
+	/*! visits the buffered data and returns true if a message is completed */
+	template <typename Visitor>
+	bool next(Visitor& v);
+
+	/*! discards the state of the message being visited */
+	void reset();
+
+private:
+	detail::visit_context m_ctx;
+	bool m_started;
+
+private:
+	visit_unpacker(const visit_unpacker&);
+};
+
+
+template <typename Visitor>
+inline unpack_return visit(const char* data, size_t len, size_t* off, Visitor& v)
+{
+	size_t noff = 0;
+	if(off != NULL) { noff = *off; }
+
+	if(len <= noff) {
+		return UNPACK_CONTINUE;
+	}
+
+	detail::visit_context ctx;
+	detail::visit_template_init<Visitor>(&ctx);
+	ctx.user.visitor = &v;
+
+	int e = detail::visit_template_execute<Visitor>(&ctx, data, len, &noff);
+	if(e < 0) {
+		throw unpack_error("parse error");
+	}
+
+	if(off != NULL) { *off = noff; }
+
+	if(e == 0) {
+		return UNPACK_CONTINUE;
+	}
+
+	if(noff < len) {
+		return UNPACK_EXTRA_BYTES;
+	}
+
+	return UNPACK_SUCCESS;
+}
+
+
+inline visit_unpacker::visit_unpacker(size_t init_buffer_size) :
+	unpacker(init_buffer_size), m_started(false) { }
+
+template <typename Visitor>
+inline bool visit_unpacker::next(Visitor& v)
+{
+	if(!m_started) {
+		detail::visit_template_init<Visitor>(&m_ctx);
+		m_started = true;
+	}
+	m_ctx.user.visitor = &v;
+
+	size_t off = this->off;
+	int ret = detail::visit_template_execute<Visitor>(&m_ctx,
+			msgpack_unpacker::buffer, this->used, &this->off);
+	this->parsed += this->off - off;
+
+	if(ret < 0) {
+		throw unpack_error("parse error");
+	} else if(ret == 0) {
+		return false;
+	}
+
+	m_started = false;
+	this->parsed = 0;
+	return true;
+}
+
+inline void visit_unpacker::reset()
+{
+	m_started = false;
+	unpacker::reset();
+}
+
+
+}  // namespace msgpack
+
+#endif /* msgpack/visitor.hpp */
+
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 
 #ifndef _WIN32
+#include <sys/types.h>
 #include <sys/uio.h>
 #else
 struct iovec {
@@ -48,15 +49,24 @@ typedef struct msgpack_vrefbuffer_inner_buffer {
 	size_t free;
 	char*  ptr;
 	msgpack_vrefbuffer_chunk* head;
+	msgpack_vrefbuffer_chunk* spare;
 } msgpack_vrefbuffer_inner_buffer;
 
 typedef struct msgpack_vrefbuffer {
 	struct iovec* tail;
 	struct iovec* end;
 	struct iovec* array;
+	struct iovec* head;
 
 	size_t chunk_size;
 	size_t ref_size;
+	size_t nconsumed;
+
+	/* statistics for msgpack_vrefbuffer_set_adaptive */
+	size_t base_ref_size;
+	size_t window_bytes;
+	size_t window_refs;
+	size_t window_near;
 
 	msgpack_vrefbuffer_inner_buffer inner_buffer;
 } msgpack_vrefbuffer;
@@ -70,6 +80,14 @@ typedef struct msgpack_vrefbuffer {
 #define MSGPACK_VREFBUFFER_CHUNK_SIZE 8192
 #endif
 
+#ifndef MSGPACK_VREFBUFFER_ADAPTIVE_IOV_SIZE
+#define MSGPACK_VREFBUFFER_ADAPTIVE_IOV_SIZE 1024
+#endif
+
+#ifndef MSGPACK_VREFBUFFER_ADAPTIVE_WINDOW
+#define MSGPACK_VREFBUFFER_ADAPTIVE_WINDOW (64*1024)
+#endif
+
 bool msgpack_vrefbuffer_init(msgpack_vrefbuffer* vbuf,
 		size_t ref_size, size_t chunk_size);
 void msgpack_vrefbuffer_destroy(msgpack_vrefbuffer* vbuf);
@@ -90,8 +108,49 @@ int msgpack_vrefbuffer_append_ref(msgpack_vrefbuffer* vbuf,
 
 int msgpack_vrefbuffer_migrate(msgpack_vrefbuffer* vbuf, msgpack_vrefbuffer* to);
 
+/**
+ * Drops the contents. The chunks are kept for reuse.
+ */
 void msgpack_vrefbuffer_clear(msgpack_vrefbuffer* vref);
 
+/**
+ * Lets ref_size follow the written data instead of staying fixed.
+ * Every MSGPACK_VREFBUFFER_ADAPTIVE_WINDOW bytes, ref_size is doubled
+ * if references left less than MSGPACK_VREFBUFFER_ADAPTIVE_IOV_SIZE
+ * bytes per iovec, and halved if the lower threshold would still meet
+ * that. It stays between the ref_size given to init and chunk_size / 4.
+ */
+void msgpack_vrefbuffer_set_adaptive(msgpack_vrefbuffer* vbuf, bool enable);
+
+/**
+ * Frees the chunks kept for reuse.
+ */
+void msgpack_vrefbuffer_shrink(msgpack_vrefbuffer* vbuf);
+
+/**
+ * Drops the first size bytes of the buffer after they are sent.
+ * The first iovec is shortened when it is sent partially. Chunks whose
+ * contents are sent completely are kept and reused by append_copy.
+ */
+void msgpack_vrefbuffer_consume(msgpack_vrefbuffer* vbuf, size_t size);
+
+/**
+ * True if the iovec points into a chunk of the buffer, that is, it holds
+ * data copied by append_copy rather than memory added by append_ref.
+ * Chunks are reused as soon as they are consumed.
+ */
+bool msgpack_vrefbuffer_is_copy(const msgpack_vrefbuffer* vbuf, const struct iovec* v);
+
+#ifndef _WIN32
+/**
+ * Writes the buffer to fd with writev(2), IOV_MAX iovecs at a time, and
+ * consumes what is written. Stops when the buffer is empty or fd would
+ * block (EAGAIN); calls interrupted by signals are retried.
+ * @return the number of bytes written or -1 with errno set.
+ */
+ssize_t msgpack_vrefbuffer_writev(msgpack_vrefbuffer* vbuf, int fd);
+#endif
+
 /** @} */
 
 
@@ -125,12 +184,12 @@ int msgpack_vrefbuffer_write(void* data, const char* buf, unsigned int len)
 
 const struct iovec* msgpack_vrefbuffer_vec(const msgpack_vrefbuffer* vref)
 {
-	return vref->array;
+	return vref->head;
 }
 
 size_t msgpack_vrefbuffer_veclen(const msgpack_vrefbuffer* vref)
 {
-	return vref->tail - vref->array;
+	return vref->tail - vref->head;
 }
 
 
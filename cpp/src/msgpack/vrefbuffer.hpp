@@ -83,6 +83,34 @@ public:
 		msgpack_vrefbuffer_clear(this);
 	}
 
+	void set_adaptive(bool enable = true)
+	{
+		msgpack_vrefbuffer_set_adaptive(this, enable);
+	}
+
+	void shrink()
+	{
+		msgpack_vrefbuffer_shrink(this);
+	}
+
+	void consume(size_t size)
+	{
+		msgpack_vrefbuffer_consume(this, size);
+	}
+
+#ifndef _WIN32
+	// returns the number of bytes written, which is less than the
+	// buffer size if fd would block
+	size_t writev(int fd)
+	{
+		ssize_t ret = msgpack_vrefbuffer_writev(this, fd);
+		if(ret < 0) {
+			throw std::runtime_error("vrefbuffer writev failed");
+		}
+		return ret;
+	}
+#endif
+
 private:
 	typedef msgpack_vrefbuffer base;
 
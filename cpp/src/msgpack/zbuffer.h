@@ -38,6 +38,8 @@ typedef struct msgpack_zbuffer {
 	z_stream stream;
 	char* data;
 	size_t init_size;
+	const char* dictionary;
+	size_t dictionary_size;
 } msgpack_zbuffer;
 
 #ifndef MSGPACK_ZBUFFER_INIT_SIZE
@@ -53,6 +55,33 @@ static inline void msgpack_zbuffer_free(msgpack_zbuffer* zbuf);
 
 static inline char* msgpack_zbuffer_flush(msgpack_zbuffer* zbuf);
 
+/**
+ * Sets a preset dictionary, which primes the compressor with data like
+ * the messages to compress. Small, repetitive messages are compressed
+ * far better if the dictionary contains their common parts; the most
+ * common strings should come last. The receiver needs the same
+ * dictionary; see msgpack_zunpacker_set_dictionary().
+ *
+ * Must be called before data is written. The dictionary is not copied
+ * and is set again by msgpack_zbuffer_reset(), so it must outlive the
+ * buffer.
+ */
+static inline bool msgpack_zbuffer_set_dictionary(msgpack_zbuffer* zbuf,
+		const char* dictionary, size_t size);
+
+/**
+ * Flushes the data written so far to a byte boundary without ending
+ * the stream, so that the receiver can inflate all of it. Compressing
+ * each message by writing it and calling this function, instead of
+ * msgpack_zbuffer_flush() and msgpack_zbuffer_reset(), keeps the
+ * history of earlier messages to compress later ones with.
+ *
+ * The flushed data is appended to the buffer; send it and call
+ * msgpack_zbuffer_reset_buffer() before the next message.
+ * Returns the buffer, or NULL on errors.
+ */
+static inline char* msgpack_zbuffer_sync_flush(msgpack_zbuffer* zbuf);
+
 static inline const char* msgpack_zbuffer_data(const msgpack_zbuffer* zbuf);
 static inline size_t msgpack_zbuffer_size(const msgpack_zbuffer* zbuf);
 
@@ -162,6 +191,42 @@ char* msgpack_zbuffer_flush(msgpack_zbuffer* zbuf)
 	}
 }
 
+bool msgpack_zbuffer_set_dictionary(msgpack_zbuffer* zbuf,
+		const char* dictionary, size_t size)
+{
+	if(deflateSetDictionary(&zbuf->stream,
+				(const Bytef*)dictionary, (uInt)size) != Z_OK) {
+		return false;
+	}
+	zbuf->dictionary = dictionary;
+	zbuf->dictionary_size = size;
+	return true;
+}
+
+char* msgpack_zbuffer_sync_flush(msgpack_zbuffer* zbuf)
+{
+	zbuf->stream.avail_in = 0;
+	while(true) {
+		if(zbuf->stream.avail_out < MSGPACK_ZBUFFER_RESERVE_SIZE) {
+			if(!msgpack_zbuffer_expand(zbuf)) {
+				return NULL;
+			}
+		}
+		switch(deflate(&zbuf->stream, Z_SYNC_FLUSH)) {
+		case Z_OK:
+			/* the flush is complete unless the output was filled up */
+			if(zbuf->stream.avail_out > 0) {
+				return zbuf->data;
+			}
+			break;
+		case Z_BUF_ERROR:  /* nothing to flush */
+			return zbuf->data;
+		default:
+			return NULL;
+		}
+	}
+}
+
 const char* msgpack_zbuffer_data(const msgpack_zbuffer* zbuf)
 {
 	return zbuf->data;
@@ -183,6 +248,11 @@ bool msgpack_zbuffer_reset(msgpack_zbuffer* zbuf)
 	if(deflateReset(&zbuf->stream) != Z_OK) {
 		return false;
 	}
+	if(zbuf->dictionary != NULL &&
+			deflateSetDictionary(&zbuf->stream, (const Bytef*)zbuf->dictionary,
+				(uInt)zbuf->dictionary_size) != Z_OK) {
+		return false;
+	}
 	msgpack_zbuffer_reset_buffer(zbuf);
 	return true;
 }
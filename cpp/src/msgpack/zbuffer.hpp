@@ -54,6 +54,25 @@ public:
 		return buf;
 	}
 
+	// see msgpack_zbuffer_set_dictionary(); the dictionary must outlive the buffer
+	void set_dictionary(const char* dictionary, size_t size)
+	{
+		if(!msgpack_zbuffer_set_dictionary(this, dictionary, size)) {
+			throw std::invalid_argument("zbuffer dictionary");
+		}
+	}
+
+	// flushes the written messages without ending the stream;
+	// see msgpack_zbuffer_sync_flush()
+	char* sync_flush()
+	{
+		char* buf = msgpack_zbuffer_sync_flush(this);
+		if(!buf) {
+			throw std::bad_alloc();
+		}
+		return buf;
+	}
+
 	char* data()
 	{
 		return base::data;
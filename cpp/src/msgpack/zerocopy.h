@@ -0,0 +1,360 @@
+/*
+ * MessagePack for C zero-copy sender implementation
+ *
+ * Copyright (C) 2010 FURUHASHI Sadayuki
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+#ifndef MSGPACK_ZEROCOPY_H__
+#define MSGPACK_ZEROCOPY_H__
+
+#include "msgpack/vrefbuffer.h"
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <linux/errqueue.h>
+#if defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define MSGPACK_ZEROCOPY_SENDMSG
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#endif
+#ifdef SPLICE_F_GIFT  /* fcntl.h declares vmsplice with _GNU_SOURCE */
+#define MSGPACK_ZEROCOPY_VMSPLICE
+#endif
+#endif
+
+#ifndef IOV_MAX
+#ifdef UIO_MAXIOV
+#define IOV_MAX UIO_MAXIOV
+#else
+#define IOV_MAX 16
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_zerocopy Zero-copy sender
+ * @ingroup msgpack_vrefbuffer
+ *
+ * Sends a msgpack_vrefbuffer like msgpack_vrefbuffer_writev(), except
+ * that runs of iovecs of at least threshold bytes added by append_ref
+ * are not copied into the kernel: they are sent by sendmsg(MSG_ZEROCOPY)
+ * to TCP sockets and by vmsplice(2) to pipes. Smaller iovecs, and the
+ * chunks of the vrefbuffer itself, which are reused as soon as they are
+ * consumed, are copied by writev as before.
+ *
+ * The kernel reads zero-copy memory after the send returns, so memory
+ * referenced by append_ref must be kept and not modified until it is
+ * released: take msgpack_zerocopy_ticket() after the buffer is sent and
+ * wait for msgpack_zerocopy_released() to become true. For sockets, the
+ * kernel reports completion on the error queue; for pipes, when the
+ * reader has read the data.
+ *
+ * Other file descriptors, and kernels without MSG_ZEROCOPY, fall back
+ * to writev and tickets are released at once. Linux only; C programs
+ * define _GNU_SOURCE for vmsplice.
+ * @{
+ */
+
+enum {
+	MSGPACK_ZEROCOPY_NONE,
+	MSGPACK_ZEROCOPY_SOCKET,
+	MSGPACK_ZEROCOPY_PIPE
+};
+
+typedef struct msgpack_zerocopy {
+	int fd;
+	int mode;
+	size_t threshold;
+	/* sockets: zero-copy sendmsg calls; pipes: bytes written */
+	uint64_t issued;
+	uint64_t completed;
+	/* zero-copy sends the kernel copied anyway, as over loopback */
+	uint64_t copied;
+} msgpack_zerocopy;
+
+#ifndef MSGPACK_ZEROCOPY_THRESHOLD
+#define MSGPACK_ZEROCOPY_THRESHOLD (16*1024)
+#endif
+
+/**
+ * Sets up sending to fd. SO_ZEROCOPY is enabled on TCP sockets.
+ */
+static inline void msgpack_zerocopy_init(msgpack_zerocopy* zc, int fd, size_t threshold);
+
+/**
+ * Sends vbuf and consumes what is sent. Stops when the buffer is empty
+ * or fd would block.
+ * @return the number of bytes sent or -1 with errno set.
+ */
+static inline ssize_t msgpack_zerocopy_send(msgpack_zerocopy* zc, msgpack_vrefbuffer* vbuf);
+
+/**
+ * Identifies the zero-copy sends made so far.
+ */
+static inline uint64_t msgpack_zerocopy_ticket(const msgpack_zerocopy* zc);
+
+/**
+ * Reads completions without blocking.
+ * @return false on errors.
+ */
+static inline bool msgpack_zerocopy_poll(msgpack_zerocopy* zc);
+
+/**
+ * True if the kernel no longer reads the memory sent before ticket.
+ */
+static inline bool msgpack_zerocopy_released(msgpack_zerocopy* zc, uint64_t ticket);
+
+/**
+ * Waits up to timeout milliseconds (-1 for ever) for the ticket.
+ * @return 1 if it is released, 0 on timeout and -1 on errors.
+ */
+static inline int msgpack_zerocopy_wait(msgpack_zerocopy* zc, uint64_t ticket, int timeout);
+
+/** @} */
+
+
+void msgpack_zerocopy_init(msgpack_zerocopy* zc, int fd, size_t threshold)
+{
+	zc->fd = fd;
+	zc->mode = MSGPACK_ZEROCOPY_NONE;
+	zc->threshold = threshold;
+	zc->issued = 0;
+	zc->completed = 0;
+	zc->copied = 0;
+
+	struct stat st;
+	if(fstat(fd, &st) < 0) {
+		return;
+	}
+#ifdef MSGPACK_ZEROCOPY_SENDMSG
+	if(S_ISSOCK(st.st_mode)) {
+		int type;
+		socklen_t len = sizeof(type);
+		int one = 1;
+		/* completions of stream sockets come in order */
+		if(getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) == 0 &&
+				type == SOCK_STREAM &&
+				setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0) {
+			zc->mode = MSGPACK_ZEROCOPY_SOCKET;
+		}
+	}
+#endif
+#ifdef MSGPACK_ZEROCOPY_VMSPLICE
+	if(S_ISFIFO(st.st_mode)) {
+		zc->mode = MSGPACK_ZEROCOPY_PIPE;
+	}
+#endif
+}
+
+static inline ssize_t msgpack_zerocopy_sendv(msgpack_zerocopy* zc,
+		struct iovec* vec, size_t n, bool large)
+{
+	if(!large) {
+		return writev(zc->fd, vec, (int)n);
+	}
+#ifdef MSGPACK_ZEROCOPY_SENDMSG
+	if(zc->mode == MSGPACK_ZEROCOPY_SOCKET) {
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = vec;
+		msg.msg_iovlen = n;
+		ssize_t ret = sendmsg(zc->fd, &msg, MSG_ZEROCOPY);
+		if(ret < 0 && errno == ENOBUFS) {
+			/* too many notifications are pending; copy this time */
+			msgpack_zerocopy_poll(zc);
+			return writev(zc->fd, vec, (int)n);
+		}
+		if(ret > 0) {
+			++zc->issued;
+		}
+		return ret;
+	}
+#endif
+#ifdef MSGPACK_ZEROCOPY_VMSPLICE
+	if(zc->mode == MSGPACK_ZEROCOPY_PIPE) {
+		/* vmsplice ignores O_NONBLOCK of the pipe */
+		int fl = fcntl(zc->fd, F_GETFL);
+		return vmsplice(zc->fd, vec, n,
+				(fl >= 0 && (fl & O_NONBLOCK)) ? SPLICE_F_NONBLOCK : 0);
+	}
+#endif
+	return writev(zc->fd, vec, (int)n);
+}
+
+/* only referenced memory is sent without copying; the chunks of vbuf
+ * are overwritten by the next append_copy after they are consumed */
+static inline bool msgpack_zerocopy_large(const msgpack_zerocopy* zc,
+		const msgpack_vrefbuffer* vbuf, const struct iovec* v)
+{
+	return zc->mode != MSGPACK_ZEROCOPY_NONE && v->iov_len >= zc->threshold &&
+		!msgpack_vrefbuffer_is_copy(vbuf, v);
+}
+
+ssize_t msgpack_zerocopy_send(msgpack_zerocopy* zc, msgpack_vrefbuffer* vbuf)
+{
+	ssize_t total = 0;
+
+	while(vbuf->head != vbuf->tail) {
+		/* a run of small iovecs is copied and a run of large ones is not */
+		struct iovec* vec = vbuf->head;
+		const size_t avail = vbuf->tail - vec;
+		const bool large = msgpack_zerocopy_large(zc, vbuf, vec);
+		size_t n = 1;
+		while(n < avail && n < IOV_MAX &&
+				msgpack_zerocopy_large(zc, vbuf, vec + n) == large) {
+			++n;
+		}
+
+		ssize_t ret = msgpack_zerocopy_sendv(zc, vec, n, large);
+		if(ret < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			if(errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+			return -1;
+		}
+
+		if(zc->mode == MSGPACK_ZEROCOPY_PIPE) {
+			zc->issued += ret;
+		}
+		msgpack_vrefbuffer_consume(vbuf, ret);
+		total += ret;
+	}
+
+	return total;
+}
+
+uint64_t msgpack_zerocopy_ticket(const msgpack_zerocopy* zc)
+{
+	return zc->issued;
+}
+
+bool msgpack_zerocopy_poll(msgpack_zerocopy* zc)
+{
+#ifdef MSGPACK_ZEROCOPY_SENDMSG
+	if(zc->mode == MSGPACK_ZEROCOPY_SOCKET) {
+		while(zc->completed < zc->issued) {
+			char control[128];
+			struct msghdr msg;
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_control = control;
+			msg.msg_controllen = sizeof(control);
+
+			if(recvmsg(zc->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+				if(errno == EINTR) {
+					continue;
+				}
+				return errno == EAGAIN || errno == EWOULDBLOCK;
+			}
+
+			struct cmsghdr* cm;
+			for(cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+				struct sock_extended_err ee;
+				memcpy(&ee, CMSG_DATA(cm), sizeof(ee));
+				if(ee.ee_errno != 0 || ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+					continue;
+				}
+				/* ee_info..ee_data are the 32-bit ids of the sends */
+				const uint32_t hi = ee.ee_data - (uint32_t)zc->completed;
+				const uint64_t end = zc->completed + hi + 1;
+				if(end > zc->completed && end <= zc->issued) {
+					zc->completed = end;
+				}
+				if(ee.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+					zc->copied += ee.ee_data - ee.ee_info + 1;
+				}
+			}
+		}
+		return true;
+	}
+#endif
+#ifdef MSGPACK_ZEROCOPY_VMSPLICE
+	if(zc->mode == MSGPACK_ZEROCOPY_PIPE) {
+		int unread;
+		if(ioctl(zc->fd, FIONREAD, &unread) < 0) {
+			return false;
+		}
+		zc->completed = zc->issued - unread;
+		return true;
+	}
+#endif
+	zc->completed = zc->issued;
+	return true;
+}
+
+bool msgpack_zerocopy_released(msgpack_zerocopy* zc, uint64_t ticket)
+{
+	if(zc->completed >= ticket) {
+		return true;
+	}
+	msgpack_zerocopy_poll(zc);
+	return zc->completed >= ticket;
+}
+
+int msgpack_zerocopy_wait(msgpack_zerocopy* zc, uint64_t ticket, int timeout)
+{
+	while(true) {
+		if(!msgpack_zerocopy_poll(zc)) {
+			return -1;
+		}
+		if(zc->completed >= ticket) {
+			return 1;
+		}
+		if(timeout == 0) {
+			return 0;
+		}
+
+		/* the error queue makes a socket readable as POLLERR; there is
+		 * no event for a pipe being read, so it is checked every 1ms */
+		struct pollfd pfd;
+		pfd.fd = zc->fd;
+		pfd.events = 0;
+		pfd.revents = 0;
+		int wait = (zc->mode == MSGPACK_ZEROCOPY_SOCKET) ? timeout :
+			(timeout < 0 || timeout > 1) ? 1 : timeout;
+		if(poll(&pfd, 1, wait) < 0 && errno != EINTR) {
+			return -1;
+		}
+		if(timeout > 0) {
+			timeout -= wait;  /* not exact for sockets woken early */
+			if(timeout < 0) {
+				timeout = 0;
+			}
+		}
+	}
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/zerocopy.h */
+
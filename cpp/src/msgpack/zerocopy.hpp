@@ -0,0 +1,80 @@
+//
+// MessagePack for C++ zero-copy sender implementation
+//
+// Copyright (C) 2010 FURUHASHI Sadayuki
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+#ifndef MSGPACK_ZEROCOPY_HPP__
+#define MSGPACK_ZEROCOPY_HPP__
+
+#include "msgpack/zerocopy.h"
+#include "msgpack/vrefbuffer.hpp"
+#include <stdexcept>
+
+namespace msgpack {
+
+
+// Sends vrefbuffers to a socket or a pipe without copying large
+// references; see msgpack_zerocopy. The file descriptor is not owned.
+class zerocopy : public msgpack_zerocopy {
+public:
+	zerocopy(int fd, size_t threshold = MSGPACK_ZEROCOPY_THRESHOLD)
+	{
+		msgpack_zerocopy_init(this, fd, threshold);
+	}
+
+public:
+	// returns the number of bytes sent, which is less than the
+	// buffer size if fd would block
+	size_t send(vrefbuffer& vbuf)
+	{
+		ssize_t ret = msgpack_zerocopy_send(this, &vbuf);
+		if(ret < 0) {
+			throw std::runtime_error("zerocopy send failed");
+		}
+		return ret;
+	}
+
+	uint64_t ticket() const
+	{
+		return msgpack_zerocopy_ticket(this);
+	}
+
+	bool released(uint64_t ticket)
+	{
+		return msgpack_zerocopy_released(this, ticket);
+	}
+
+	// returns false on timeout
+	bool wait(uint64_t ticket, int timeout = -1)
+	{
+		int ret = msgpack_zerocopy_wait(this, ticket, timeout);
+		if(ret < 0) {
+			throw std::runtime_error("zerocopy wait failed");
+		}
+		return ret > 0;
+	}
+
+private:
+	typedef msgpack_zerocopy base;
+
+private:
+	zerocopy(const zerocopy&);
+};
+
+
+}  // namespace msgpack
+
+#endif /* msgpack/zerocopy.hpp */
+
@@ -77,6 +77,12 @@ bool msgpack_zone_is_empty(msgpack_zone* zone);
 
 void msgpack_zone_clear(msgpack_zone* zone);
 
+/**
+ * Frees the memory allocated from the zone after its chunk_list was
+ * copied to mark. Finalizers are not affected.
+ */
+void msgpack_zone_rollback(msgpack_zone* zone, const msgpack_zone_chunk_list* mark);
+
 /** @} */
 
 
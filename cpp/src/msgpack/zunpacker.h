@@ -0,0 +1,148 @@
+/*
+ * MessagePack for C inflating unpacker implementation
+ *
+ * Copyright (C) 2010 FURUHASHI Sadayuki
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+#ifndef MSGPACK_ZUNPACKER_H__
+#define MSGPACK_ZUNPACKER_H__
+
+#include "msgpack/cunpacker.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @defgroup msgpack_zunpacker Inflating unpacker
+ * @ingroup msgpack_unpack
+ *
+ * Deserializes a stream compressed by msgpack_zbuffer. It is a
+ * msgpack_cunpacker with the deflate codec: compressed data is fed like
+ * to msgpack_unpacker and inflated into the buffer of the unpacker in
+ * windows of MSGPACK_ZUNPACKER_WINDOW_SIZE bytes, as many as needed to
+ * complete the next message.
+ *
+ * Several zlib streams may follow one another, as written by
+ * msgpack_zbuffer_flush() and msgpack_zbuffer_reset().
+ * @{
+ */
+
+typedef msgpack_cunpacker msgpack_zunpacker;
+
+#ifndef MSGPACK_ZUNPACKER_INIT_BUFFER_SIZE
+#define MSGPACK_ZUNPACKER_INIT_BUFFER_SIZE MSGPACK_CUNPACKER_INIT_BUFFER_SIZE
+#endif
+
+#ifndef MSGPACK_ZUNPACKER_WINDOW_SIZE
+#define MSGPACK_ZUNPACKER_WINDOW_SIZE MSGPACK_CUNPACKER_WINDOW_SIZE
+#endif
+
+/**
+ * Initializes an inflating unpacker.
+ * The initial_buffer_size is the size of the buffer of compressed data;
+ * the unpacker for the inflated data has MSGPACK_UNPACKER_INIT_BUFFER_SIZE.
+ */
+static inline bool msgpack_zunpacker_init(msgpack_zunpacker* zpac,
+		size_t initial_buffer_size)
+{
+	if(!msgpack_cunpacker_init(zpac, msgpack_codec_deflate(), initial_buffer_size)) {
+		return false;
+	}
+	zpac->window = MSGPACK_ZUNPACKER_WINDOW_SIZE;
+	return true;
+}
+
+static inline void msgpack_zunpacker_destroy(msgpack_zunpacker* zpac)
+{
+	msgpack_cunpacker_destroy(zpac);
+}
+
+static inline msgpack_zunpacker* msgpack_zunpacker_new(size_t initial_buffer_size)
+{
+	msgpack_zunpacker* zpac = msgpack_cunpacker_new(msgpack_codec_deflate(), initial_buffer_size);
+	if(zpac != NULL) {
+		zpac->window = MSGPACK_ZUNPACKER_WINDOW_SIZE;
+	}
+	return zpac;
+}
+
+static inline void msgpack_zunpacker_free(msgpack_zunpacker* zpac)
+{
+	msgpack_cunpacker_free(zpac);
+}
+
+/**
+ * Sets the preset dictionary which the sender set by
+ * msgpack_zbuffer_set_dictionary(). It is used whenever a stream asks
+ * for it. The dictionary is not copied and must outlive the unpacker.
+ */
+static inline void msgpack_zunpacker_set_dictionary(msgpack_zunpacker* zpac,
+		const char* dictionary, size_t size)
+{
+	msgpack_cunpacker_set_dictionary(zpac, dictionary, size);
+}
+
+/**
+ * Reserves, returns and consumes the buffer of compressed data, like
+ * msgpack_unpacker_reserve_buffer(), msgpack_unpacker_buffer(),
+ * msgpack_unpacker_buffer_capacity() and msgpack_unpacker_buffer_consumed().
+ */
+static inline bool msgpack_zunpacker_reserve_buffer(msgpack_zunpacker* zpac, size_t size)
+{
+	return msgpack_cunpacker_reserve_buffer(zpac, size);
+}
+
+static inline char* msgpack_zunpacker_buffer(msgpack_zunpacker* zpac)
+{
+	return msgpack_cunpacker_buffer(zpac);
+}
+
+static inline size_t msgpack_zunpacker_buffer_capacity(const msgpack_zunpacker* zpac)
+{
+	return msgpack_cunpacker_buffer_capacity(zpac);
+}
+
+static inline void msgpack_zunpacker_buffer_consumed(msgpack_zunpacker* zpac, size_t size)
+{
+	msgpack_cunpacker_buffer_consumed(zpac, size);
+}
+
+/**
+ * Inflates the buffered data until the next message is complete and
+ * deserializes it, like msgpack_cunpacker_execute().
+ */
+static inline int msgpack_zunpacker_execute(msgpack_zunpacker* zpac)
+{
+	return msgpack_cunpacker_execute(zpac);
+}
+
+/**
+ * Deserializes the next message like msgpack_unpacker_next().
+ * Returns false if more compressed data is needed or on errors.
+ */
+static inline bool msgpack_zunpacker_next(msgpack_zunpacker* zpac, msgpack_unpacked* result)
+{
+	return msgpack_cunpacker_next(zpac, result);
+}
+
+/** @} */
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* msgpack/zunpacker.h */
@@ -0,0 +1,58 @@
+//
+// MessagePack for C++ inflating unpacker
+//
+// Copyright (C) 2010 FURUHASHI Sadayuki
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+#ifndef MSGPACK_ZUNPACKER_HPP__
+#define MSGPACK_ZUNPACKER_HPP__
+
+#include "msgpack/zunpacker.h"
+#include "msgpack/cunpacker.hpp"
+
+namespace msgpack {
+
+
+// Unpacker of a stream compressed by zbuffer; a cunpacker with the
+// deflate codec. It is used like unpacker; compressed data is inflated
+// into the unpacker as next() needs it.
+//
+// msgpack::zunpacker pac;
+// while( /* input is readable */ ) {
+//     pac.reserve_buffer(32*1024);
+//     size_t bytes = input.readsome(pac.buffer(), pac.buffer_capacity());
+//     pac.buffer_consumed(bytes);
+//
+//     msgpack::unpacked result;
+//     while(pac.next(&result)) {
+//         on_message(result.get(), result.zone());
+//     }
+// }
+class zunpacker : public cunpacker {
+public:
+	zunpacker(size_t init_buffer_size = MSGPACK_ZUNPACKER_INIT_BUFFER_SIZE) :
+		cunpacker(msgpack_codec_deflate(), init_buffer_size)
+	{
+		window = MSGPACK_ZUNPACKER_WINDOW_SIZE;
+	}
+
+private:
+	zunpacker(const zunpacker&);
+};
+
+
+}  // namespace msgpack
+
+#endif /* msgpack/zunpacker.hpp */
+
@@ -22,62 +22,70 @@ namespace msgpack {
 
 std::ostream& operator<< (std::ostream& s, const object o)
 {
-	switch(o.type) {
-	case type::NIL:
-		s << "nil";
-		break;
-
-	case type::BOOLEAN:
-		s << (o.via.boolean ? "true" : "false");
-		break;
-
-	case type::POSITIVE_INTEGER:
-		s << o.via.u64;
-		break;
-
-	case type::NEGATIVE_INTEGER:
-		s << o.via.i64;
-		break;
-
-	case type::DOUBLE:
-		s << o.via.dec;
-		break;
-
-	case type::RAW:
-		(s << '"').write(o.via.raw.ptr, o.via.raw.size) << '"';
-		break;
-
-	case type::ARRAY:
-		s << "[";
-		if(o.via.array.size != 0) {
-			object* p(o.via.array.ptr);
-			s << *p;
-			++p;
-			for(object* const pend(o.via.array.ptr + o.via.array.size);
-					p < pend; ++p) {
-				s << ", " << *p;
-			}
-		}
-		s << "]";
-		break;
-
-	case type::MAP:
-		s << "{";
-		if(o.via.map.size != 0) {
-			object_kv* p(o.via.map.ptr);
-			s << p->key << "=>" << p->val;
-			++p;
-			for(object_kv* const pend(o.via.map.ptr + o.via.map.size);
-					p < pend; ++p) {
-				s << ", " << p->key << "=>" << p->val;
+	detail::object_stack stack;
+	detail::object_frame cur = { &o, &o + 1, false };
+	for(;;) {
+		if(cur.p == cur.end) {
+			if(stack.empty()) { break; }
+			s << (cur.map ? "}" : "]");
+			stack.pop(cur);
+		} else {
+			const object* const p = detail::object_next(cur);
+
+			switch(p->type) {
+			case type::NIL:
+				s << "nil";
+				break;
+
+			case type::BOOLEAN:
+				s << (p->via.boolean ? "true" : "false");
+				break;
+
+			case type::POSITIVE_INTEGER:
+				s << p->via.u64;
+				break;
+
+			case type::NEGATIVE_INTEGER:
+				s << p->via.i64;
+				break;
+
+			case type::DOUBLE:
+				s << p->via.dec;
+				break;
+
+			case type::RAW:
+				(s << '"').write(p->via.raw.ptr, p->via.raw.size) << '"';
+				break;
+
+			case type::ARRAY:
+				s << "[";
+				if(p->via.array.size != 0) {
+					stack.push(cur, *p);
+					continue;
+				}
+				s << "]";
+				break;
+
+			case type::MAP:
+				s << "{";
+				if(p->via.map.size != 0) {
+					stack.push(cur, *p);
+					continue;
+				}
+				s << "}";
+				break;
+
+			default:
+				// FIXME
+				s << "#<UNKNOWN " << (uint16_t)p->type << ">";
 			}
 		}
-		s << "}";
-		break;
 
-	default:
-		// FIXME
-		s << "#<UNKNOWN " << (uint16_t)o.type << ">";
+		// writes the separator after a finished element; keys have
+		// an odd number of objects left after them
+		if(cur.p < cur.end) {
+			s << ((cur.map && ((cur.end - cur.p) & 1)) ? "=>" : ", ");
+		}
 	}
 	return s;
 }
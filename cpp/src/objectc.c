@@ -18,6 +18,7 @@
 #include "msgpack/object.h"
 #include "msgpack/pack.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #ifndef _MSC_VER
@@ -32,206 +33,324 @@
 #endif
 
 
-int msgpack_pack_object(msgpack_packer* pk, msgpack_object d)
+/*
+ * Nested objects are walked with an explicit stack instead of recursion,
+ * so that deeply nested objects can't overflow the C stack. The range of
+ * objects being walked is kept in a local frame, which is saved on the
+ * stack while the children of a container are walked. The first frames
+ * are embedded in the stack; deeper ones are allocated.
+ * The keys and values of a map are walked as an array of 2 * size
+ * objects, since msgpack_object_kv is a pair of objects.
+ */
+typedef struct object_frame {
+	const msgpack_object* p;
+	const msgpack_object* end;
+	const msgpack_object* q;  /* the other operand of msgpack_object_equal */
+	bool map;
+} object_frame;
+
+#define OBJECT_EMBED_FRAMES 32
+
+typedef struct object_stack {
+	object_frame* frames;
+	size_t depth;
+	size_t capacity;
+	object_frame embed[OBJECT_EMBED_FRAMES];
+} object_stack;
+
+static inline void object_stack_init(object_stack* s)
 {
-	switch(d.type) {
-	case MSGPACK_OBJECT_NIL:
-		return msgpack_pack_nil(pk);
-
-	case MSGPACK_OBJECT_BOOLEAN:
-		if(d.via.boolean) {
-			return msgpack_pack_true(pk);
-		} else {
-			return msgpack_pack_false(pk);
-		}
+	s->frames = s->embed;
+	s->depth = 0;
+	s->capacity = OBJECT_EMBED_FRAMES;
+}
 
-	case MSGPACK_OBJECT_POSITIVE_INTEGER:
-		return msgpack_pack_uint64(pk, d.via.u64);
+static inline void object_stack_destroy(object_stack* s)
+{
+	if(s->frames != s->embed) { free(s->frames); }
+}
 
-	case MSGPACK_OBJECT_NEGATIVE_INTEGER:
-		return msgpack_pack_int64(pk, d.via.i64);
+static int object_stack_expand(object_stack* s)
+{
+	object_frame* tmp = (object_frame*)malloc(sizeof(object_frame) * s->capacity * 2);
+	if(tmp == NULL) { return -1; }
+	memcpy(tmp, s->frames, sizeof(object_frame) * s->depth);
+	object_stack_destroy(s);
+	s->frames = tmp;
+	s->capacity *= 2;
+	return 0;
+}
 
-	case MSGPACK_OBJECT_DOUBLE:
-		return msgpack_pack_double(pk, d.via.dec);
+/* saves cur and starts the n children from p; q is walked in parallel */
+static inline int object_stack_push(object_stack* s, object_frame* cur,
+		const msgpack_object* p, size_t n, const msgpack_object* q, bool map)
+{
+	if(s->depth == s->capacity && object_stack_expand(s) < 0) {
+		return -1;
+	}
+	s->frames[s->depth++] = *cur;
+	cur->p = p;
+	cur->end = p + n;
+	cur->q = q;
+	cur->map = map;
+	return 0;
+}
 
-	case MSGPACK_OBJECT_RAW:
-		{
-			int ret = msgpack_pack_raw(pk, d.via.raw.size);
-			if(ret < 0) { return ret; }
-			return msgpack_pack_raw_body(pk, d.via.raw.ptr, d.via.raw.size);
-		}
+/* the raw body or the children of o, which are read right after o */
+static inline void object_prefetch(const msgpack_object* o)
+{
+	if(o->type >= MSGPACK_OBJECT_RAW) {
+		/* raw, array and map share the layout of {size, ptr} */
+		_msgpack_prefetch(o->via.array.ptr);
+	}
+}
 
-	case MSGPACK_OBJECT_ARRAY:
-		{
-			int ret = msgpack_pack_array(pk, d.via.array.size);
-			if(ret < 0) { return ret; }
+/* walks the root object as a range of one object */
+static inline void object_frame_init(object_frame* cur,
+		const msgpack_object* o, const msgpack_object* q)
+{
+	cur->p = o;
+	cur->end = o + 1;
+	cur->q = q;
+	cur->map = false;
+}
 
-			msgpack_object* o = d.via.array.ptr;
-			msgpack_object* const oend = d.via.array.ptr + d.via.array.size;
-			for(; o != oend; ++o) {
-				ret = msgpack_pack_object(pk, *o);
-				if(ret < 0) { return ret; }
-			}
 
-			return 0;
+int msgpack_pack_object(msgpack_packer* pk, msgpack_object d)
+{
+	object_stack s;
+	object_frame cur;
+	int ret = 0;
+	object_stack_init(&s);
+	object_frame_init(&cur, &d, NULL);
+
+	for(;;) {
+		const msgpack_object* o;
+		if(cur.p == cur.end) {
+			if(s.depth == 0) { break; }
+			cur = s.frames[--s.depth];
+			continue;
+		}
+		o = cur.p++;
+		if(cur.p < cur.end) {
+			/* loaded while o is packed */
+			object_prefetch(cur.p);
 		}
 
-	case MSGPACK_OBJECT_MAP:
-		{
-			int ret = msgpack_pack_map(pk, d.via.map.size);
-			if(ret < 0) { return ret; }
-
-			msgpack_object_kv* kv = d.via.map.ptr;
-			msgpack_object_kv* const kvend = d.via.map.ptr + d.via.map.size;
-			for(; kv != kvend; ++kv) {
-				ret = msgpack_pack_object(pk, kv->key);
-				if(ret < 0) { return ret; }
-				ret = msgpack_pack_object(pk, kv->val);
-				if(ret < 0) { return ret; }
-			}
+		switch(o->type) {
+		case MSGPACK_OBJECT_NIL:
+			ret = msgpack_pack_nil(pk);
+			break;
 
-			return 0;
+		case MSGPACK_OBJECT_BOOLEAN:
+			if(o->via.boolean) {
+				ret = msgpack_pack_true(pk);
+			} else {
+				ret = msgpack_pack_false(pk);
+			}
+			break;
+
+		case MSGPACK_OBJECT_POSITIVE_INTEGER:
+			ret = msgpack_pack_uint64(pk, o->via.u64);
+			break;
+
+		case MSGPACK_OBJECT_NEGATIVE_INTEGER:
+			ret = msgpack_pack_int64(pk, o->via.i64);
+			break;
+
+		case MSGPACK_OBJECT_DOUBLE:
+			ret = msgpack_pack_double(pk, o->via.dec);
+			break;
+
+		case MSGPACK_OBJECT_RAW:
+			ret = msgpack_pack_raw(pk, o->via.raw.size);
+			if(ret < 0) { break; }
+			ret = msgpack_pack_raw_body(pk, o->via.raw.ptr, o->via.raw.size);
+			break;
+
+		case MSGPACK_OBJECT_ARRAY:
+			ret = msgpack_pack_array(pk, o->via.array.size);
+			if(ret < 0 || o->via.array.size == 0) { break; }
+			ret = object_stack_push(&s, &cur, o->via.array.ptr,
+					o->via.array.size, NULL, false);
+			break;
+
+		case MSGPACK_OBJECT_MAP:
+			ret = msgpack_pack_map(pk, o->via.map.size);
+			if(ret < 0 || o->via.map.size == 0) { break; }
+			ret = object_stack_push(&s, &cur, &o->via.map.ptr->key,
+					(size_t)o->via.map.size * 2, NULL, true);
+			break;
+
+		default:
+			ret = -1;
+			break;
 		}
-
-	default:
-		return -1;
+		if(ret < 0) { break; }
 	}
+
+	object_stack_destroy(&s);
+	return ret;
 }
 
 
 void msgpack_object_print(FILE* out, msgpack_object o)
 {
-	switch(o.type) {
-	case MSGPACK_OBJECT_NIL:
-		fprintf(out, "nil");
-		break;
-
-	case MSGPACK_OBJECT_BOOLEAN:
-		fprintf(out, (o.via.boolean ? "true" : "false"));
-		break;
-
-	case MSGPACK_OBJECT_POSITIVE_INTEGER:
-		fprintf(out, "%"PRIu64, o.via.u64);
-		break;
-
-	case MSGPACK_OBJECT_NEGATIVE_INTEGER:
-		fprintf(out, "%"PRIi64, o.via.i64);
-		break;
-
-	case MSGPACK_OBJECT_DOUBLE:
-		fprintf(out, "%f", o.via.dec);
-		break;
-
-	case MSGPACK_OBJECT_RAW:
-		fprintf(out, "\"");
-		fwrite(o.via.raw.ptr, o.via.raw.size, 1, out);
-		fprintf(out, "\"");
-		break;
-
-	case MSGPACK_OBJECT_ARRAY:
-		fprintf(out, "[");
-		if(o.via.array.size != 0) {
-			msgpack_object* p = o.via.array.ptr;
-			msgpack_object_print(out, *p);
-			++p;
-			msgpack_object* const pend = o.via.array.ptr + o.via.array.size;
-			for(; p < pend; ++p) {
-				fprintf(out, ", ");
-				msgpack_object_print(out, *p);
-			}
-		}
-		fprintf(out, "]");
-		break;
-
-	case MSGPACK_OBJECT_MAP:
-		fprintf(out, "{");
-		if(o.via.map.size != 0) {
-			msgpack_object_kv* p = o.via.map.ptr;
-			msgpack_object_print(out, p->key);
-			fprintf(out, "=>");
-			msgpack_object_print(out, p->val);
-			++p;
-			msgpack_object_kv* const pend = o.via.map.ptr + o.via.map.size;
-			for(; p < pend; ++p) {
-				fprintf(out, ", ");
-				msgpack_object_print(out, p->key);
-				fprintf(out, "=>");
-				msgpack_object_print(out, p->val);
+	object_stack s;
+	object_frame cur;
+	object_stack_init(&s);
+	object_frame_init(&cur, &o, NULL);
+
+	for(;;) {
+		const msgpack_object* p;
+		if(cur.p == cur.end) {
+			if(s.depth == 0) { break; }
+			fprintf(out, cur.map ? "}" : "]");
+			cur = s.frames[--s.depth];
+		} else {
+			p = cur.p++;
+
+			switch(p->type) {
+			case MSGPACK_OBJECT_NIL:
+				fprintf(out, "nil");
+				break;
+
+			case MSGPACK_OBJECT_BOOLEAN:
+				fprintf(out, (p->via.boolean ? "true" : "false"));
+				break;
+
+			case MSGPACK_OBJECT_POSITIVE_INTEGER:
+				fprintf(out, "%"PRIu64, p->via.u64);
+				break;
+
+			case MSGPACK_OBJECT_NEGATIVE_INTEGER:
+				fprintf(out, "%"PRIi64, p->via.i64);
+				break;
+
+			case MSGPACK_OBJECT_DOUBLE:
+				fprintf(out, "%f", p->via.dec);
+				break;
+
+			case MSGPACK_OBJECT_RAW:
+				fprintf(out, "\"");
+				fwrite(p->via.raw.ptr, p->via.raw.size, 1, out);
+				fprintf(out, "\"");
+				break;
+
+			case MSGPACK_OBJECT_ARRAY:
+				fprintf(out, "[");
+				/* children are omitted if the stack can't grow */
+				if(p->via.array.size != 0 &&
+						object_stack_push(&s, &cur, p->via.array.ptr,
+							p->via.array.size, NULL, false) == 0) {
+					continue;
+				}
+				fprintf(out, "]");
+				break;
+
+			case MSGPACK_OBJECT_MAP:
+				fprintf(out, "{");
+				if(p->via.map.size != 0 &&
+						object_stack_push(&s, &cur, &p->via.map.ptr->key,
+							(size_t)p->via.map.size * 2, NULL, true) == 0) {
+					continue;
+				}
+				fprintf(out, "}");
+				break;
+
+			default:
+				// FIXME
+				fprintf(out, "#<UNKNOWN %hu %"PRIu64">", p->type, p->via.u64);
 			}
 		}
-		fprintf(out, "}");
-		break;
 
-	default:
-		// FIXME
-		fprintf(out, "#<UNKNOWN %hu %"PRIu64">", o.type, o.via.u64);
+		/* writes the separator after a finished element; keys have
+		 * an odd number of objects left after them */
+		if(cur.p < cur.end) {
+			fprintf(out, (cur.map && ((cur.end - cur.p) & 1)) ? "=>" : ", ");
+		}
 	}
+
+	object_stack_destroy(&s);
 }
 
 bool msgpack_object_equal(const msgpack_object x, const msgpack_object y)
 {
-	if(x.type != y.type) { return false; }
-
-	switch(x.type) {
-	case MSGPACK_OBJECT_NIL:
-		return true;
-
-	case MSGPACK_OBJECT_BOOLEAN:
-		return x.via.boolean == y.via.boolean;
-
-	case MSGPACK_OBJECT_POSITIVE_INTEGER:
-		return x.via.u64 == y.via.u64;
-
-	case MSGPACK_OBJECT_NEGATIVE_INTEGER:
-		return x.via.i64 == y.via.i64;
-
-	case MSGPACK_OBJECT_DOUBLE:
-		return x.via.dec == y.via.dec;
-
-	case MSGPACK_OBJECT_RAW:
-		return x.via.raw.size == y.via.raw.size &&
-			memcmp(x.via.raw.ptr, y.via.raw.ptr, x.via.raw.size) == 0;
-
-	case MSGPACK_OBJECT_ARRAY:
-		if(x.via.array.size != y.via.array.size) {
-			return false;
-		} else if(x.via.array.size == 0) {
-			return true;
-		} else {
-			msgpack_object* px = x.via.array.ptr;
-			msgpack_object* const pxend = x.via.array.ptr + x.via.array.size;
-			msgpack_object* py = y.via.array.ptr;
-			do {
-				if(!msgpack_object_equal(*px, *py)) {
-					return false;
-				}
-				++px;
-				++py;
-			} while(px < pxend);
-			return true;
+	object_stack s;
+	object_frame cur;
+	bool ret = true;
+	object_stack_init(&s);
+	object_frame_init(&cur, &x, &y);
+
+	for(;;) {
+		const msgpack_object* px;
+		const msgpack_object* py;
+		if(cur.p == cur.end) {
+			if(s.depth == 0) { break; }
+			cur = s.frames[--s.depth];
+			continue;
+		}
+		px = cur.p++;
+		py = cur.q++;
+		if(cur.p < cur.end) {
+			object_prefetch(cur.p);
+			object_prefetch(cur.q);
 		}
 
-	case MSGPACK_OBJECT_MAP:
-		if(x.via.map.size != y.via.map.size) {
-			return false;
-		} else if(x.via.map.size == 0) {
-			return true;
-		} else {
-			msgpack_object_kv* px = x.via.map.ptr;
-			msgpack_object_kv* const pxend = x.via.map.ptr + x.via.map.size;
-			msgpack_object_kv* py = y.via.map.ptr;
-			do {
-				if(!msgpack_object_equal(px->key, py->key) || !msgpack_object_equal(px->val, py->val)) {
-					return false;
-				}
-				++px;
-				++py;
-			} while(px < pxend);
-			return true;
+		if(px->type != py->type) {
+			ret = false;
+			break;
 		}
 
-	default:
-		return false;
+		switch(px->type) {
+		case MSGPACK_OBJECT_NIL:
+			break;
+
+		case MSGPACK_OBJECT_BOOLEAN:
+			ret = px->via.boolean == py->via.boolean;
+			break;
+
+		case MSGPACK_OBJECT_POSITIVE_INTEGER:
+			ret = px->via.u64 == py->via.u64;
+			break;
+
+		case MSGPACK_OBJECT_NEGATIVE_INTEGER:
+			ret = px->via.i64 == py->via.i64;
+			break;
+
+		case MSGPACK_OBJECT_DOUBLE:
+			ret = px->via.dec == py->via.dec;
+			break;
+
+		case MSGPACK_OBJECT_RAW:
+			// interned keys are compared by pointer
+			ret = px->via.raw.size == py->via.raw.size &&
+				(px->via.raw.ptr == py->via.raw.ptr ||
+				 memcmp(px->via.raw.ptr, py->via.raw.ptr, px->via.raw.size) == 0);
+			break;
+
+		case MSGPACK_OBJECT_ARRAY:
+			ret = px->via.array.size == py->via.array.size &&
+				(px->via.array.size == 0 ||
+				 object_stack_push(&s, &cur, px->via.array.ptr, px->via.array.size,
+						py->via.array.ptr, false) == 0);
+			break;
+
+		case MSGPACK_OBJECT_MAP:
+			ret = px->via.map.size == py->via.map.size &&
+				(px->via.map.size == 0 ||
+				 object_stack_push(&s, &cur, &px->via.map.ptr->key, (size_t)px->via.map.size * 2,
+						&py->via.map.ptr->key, true) == 0);
+			break;
+
+		default:
+			ret = false;
+			break;
+		}
+		if(!ret) { break; }
 	}
+
+	object_stack_destroy(&s);
+	return ret;
 }
 
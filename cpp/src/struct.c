@@ -0,0 +1,497 @@
+/*
+ * MessagePack for C struct serializer
+ *
+ * Copyright (C) 2008-2010 FURUHASHI Sadayuki
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+#include "msgpack/struct.h"
+#include <string.h>
+
+/*
+ * Fields are processed by functions looked up by their type, so the
+ * loops over fields don't switch on the type of each field.
+ */
+typedef int (*pack_field_func)(msgpack_packer* pk,
+		const char* p, const msgpack_struct_field* f);
+
+
+static int pack_bool(msgpack_packer* pk, const char* p, const msgpack_struct_field* f)
+{
+	if(*(const bool*)p) {
+		return msgpack_pack_true(pk);
+	} else {
+		return msgpack_pack_false(pk);
+	}
+}
+
+#define STRUCT_PACK_NUMBER(name, type) \
+	static int pack_ ## name(msgpack_packer* pk, const char* p, const msgpack_struct_field* f) \
+	{ \
+		return msgpack_pack_ ## name(pk, *(const type*)p); \
+	}
+
+STRUCT_PACK_NUMBER(int8, int8_t)
+STRUCT_PACK_NUMBER(int16, int16_t)
+STRUCT_PACK_NUMBER(int32, int32_t)
+STRUCT_PACK_NUMBER(int64, int64_t)
+STRUCT_PACK_NUMBER(uint8, uint8_t)
+STRUCT_PACK_NUMBER(uint16, uint16_t)
+STRUCT_PACK_NUMBER(uint32, uint32_t)
+STRUCT_PACK_NUMBER(uint64, uint64_t)
+STRUCT_PACK_NUMBER(float, float)
+STRUCT_PACK_NUMBER(double, double)
+
+static int pack_raw(msgpack_packer* pk, const char* p, const msgpack_struct_field* f)
+{
+	const msgpack_object_raw* raw = (const msgpack_object_raw*)p;
+	int ret = msgpack_pack_raw(pk, raw->size);
+	if(ret < 0) { return ret; }
+	return msgpack_pack_raw_body(pk, raw->ptr, raw->size);
+}
+
+static int pack_struct(msgpack_packer* pk, const char* p, const msgpack_struct_field* f)
+{
+	return msgpack_struct_pack(pk, f->desc, p);
+}
+
+static const pack_field_func pack_funcs[MSGPACK_FIELD_TYPE_MAX] = {
+	pack_bool,
+	pack_int8,
+	pack_int16,
+	pack_int32,
+	pack_int64,
+	pack_uint8,
+	pack_uint16,
+	pack_uint32,
+	pack_uint64,
+	pack_float,
+	pack_double,
+	pack_raw,
+	pack_struct,
+};
+
+int msgpack_struct_pack(msgpack_packer* pk,
+		const msgpack_struct_desc* desc, const void* obj)
+{
+	const char* const base = (const char*)obj;
+	const msgpack_struct_field* f = desc->fields;
+	const msgpack_struct_field* const fend = desc->fields + desc->count;
+	int ret;
+
+	if(desc->format == MSGPACK_STRUCT_MAP) {
+		ret = msgpack_pack_map(pk, desc->count);
+		if(ret < 0) { return ret; }
+		for(; f < fend; ++f) {
+			ret = msgpack_pack_raw(pk, f->name_size);
+			if(ret < 0) { return ret; }
+			ret = msgpack_pack_raw_body(pk, f->name, f->name_size);
+			if(ret < 0) { return ret; }
+			ret = (*pack_funcs[f->type])(pk, base + f->offset, f);
+			if(ret < 0) { return ret; }
+		}
+
+	} else {
+		ret = msgpack_pack_array(pk, desc->count);
+		if(ret < 0) { return ret; }
+		for(; f < fend; ++f) {
+			ret = (*pack_funcs[f->type])(pk, base + f->offset, f);
+			if(ret < 0) { return ret; }
+		}
+	}
+
+	return 0;
+}
+
+
+/*
+ * Functions of the deserializer return 1 on success, 0 if the data is
+ * insufficient and -1 on an error, like msgpack_unpack_return.
+ */
+typedef struct struct_reader {
+	const char* p;
+	const char* end;
+} struct_reader;
+
+typedef int (*unpack_field_func)(struct_reader* r,
+		char* p, const msgpack_struct_field* f);
+
+static int unpack_struct_body(struct_reader* r,
+		const msgpack_struct_desc* desc, char* base);
+
+static inline int reader_take(struct_reader* r, size_t n, const char** p)
+{
+	if((size_t)(r->end - r->p) < n) { return 0; }
+	*p = r->p;
+	r->p += n;
+	return 1;
+}
+
+static int read_raw(struct_reader* r, msgpack_object_raw* raw)
+{
+	const char* p;
+	uint32_t n;
+	unsigned char h;
+	if(r->p == r->end) { return 0; }
+	h = (unsigned char)*r->p;
+	if(0xa0 <= h && h <= 0xbf) {
+		++r->p;
+		n = h & 0x1f;
+	} else if(h == 0xda) {
+		if(!reader_take(r, 3, &p)) { return 0; }
+		n = _msgpack_load16(uint16_t, (p + 1));
+	} else if(h == 0xdb) {
+		if(!reader_take(r, 5, &p)) { return 0; }
+		n = _msgpack_load32(uint32_t, (p + 1));
+	} else {
+		return -1;
+	}
+	if(!reader_take(r, n, &p)) { return 0; }
+	raw->ptr = p;
+	raw->size = n;
+	return 1;
+}
+
+/* reads an array or map header; each element takes at least one byte */
+static int read_container(struct_reader* r, bool map, uint32_t* count)
+{
+	const char* p;
+	uint32_t n;
+	unsigned char h;
+	if(r->p == r->end) { return 0; }
+	h = (unsigned char)*r->p;
+	if((map ? 0x80 : 0x90) <= h && h <= (map ? 0x8f : 0x9f)) {
+		++r->p;
+		n = h & 0x0f;
+	} else if(h == (map ? 0xde : 0xdc)) {
+		if(!reader_take(r, 3, &p)) { return 0; }
+		n = _msgpack_load16(uint16_t, (p + 1));
+	} else if(h == (map ? 0xdf : 0xdd)) {
+		if(!reader_take(r, 5, &p)) { return 0; }
+		n = _msgpack_load32(uint32_t, (p + 1));
+	} else {
+		return -1;
+	}
+	if((uint64_t)(r->end - r->p) < (uint64_t)n * (map ? 2 : 1)) { return 0; }
+	*count = n;
+	return 1;
+}
+
+/* reads an integer; *negative is set if it is less than 0 */
+static int read_integer(struct_reader* r, uint64_t* u, bool* negative)
+{
+	const char* p;
+	int64_t i;
+	unsigned char h;
+	if(r->p == r->end) { return 0; }
+	h = (unsigned char)*r->p;
+	if(h <= 0x7f) {
+		++r->p;
+		*u = h;
+		*negative = false;
+		return 1;
+	} else if(h >= 0xe0) {
+		++r->p;
+		*u = (uint64_t)(int64_t)(int8_t)h;
+		*negative = true;
+		return 1;
+	}
+	switch(h) {
+	case 0xcc:
+		if(!reader_take(r, 2, &p)) { return 0; }
+		*u = (uint8_t)p[1];
+		*negative = false;
+		return 1;
+	case 0xcd:
+		if(!reader_take(r, 3, &p)) { return 0; }
+		*u = _msgpack_load16(uint16_t, (p + 1));
+		*negative = false;
+		return 1;
+	case 0xce:
+		if(!reader_take(r, 5, &p)) { return 0; }
+		*u = _msgpack_load32(uint32_t, (p + 1));
+		*negative = false;
+		return 1;
+	case 0xcf:
+		if(!reader_take(r, 9, &p)) { return 0; }
+		*u = _msgpack_load64(uint64_t, (p + 1));
+		*negative = false;
+		return 1;
+	case 0xd0:
+		if(!reader_take(r, 2, &p)) { return 0; }
+		i = (int8_t)p[1];
+		break;
+	case 0xd1:
+		if(!reader_take(r, 3, &p)) { return 0; }
+		i = _msgpack_load16(int16_t, (p + 1));
+		break;
+	case 0xd2:
+		if(!reader_take(r, 5, &p)) { return 0; }
+		i = _msgpack_load32(int32_t, (p + 1));
+		break;
+	case 0xd3:
+		if(!reader_take(r, 9, &p)) { return 0; }
+		i = _msgpack_load64(int64_t, (p + 1));
+		break;
+	default:
+		return -1;
+	}
+	*u = (uint64_t)i;
+	*negative = i < 0;
+	return 1;
+}
+
+static int skip_object(struct_reader* r)
+{
+	size_t count = 1;
+	msgpack_object_raw raw;
+	uint32_t n;
+	const char* p;
+	int ret;
+	do {
+		unsigned char h;
+		if(r->p == r->end) { return 0; }
+		h = (unsigned char)*r->p;
+		--count;
+		if(h <= 0x7f || h >= 0xe0 || h == 0xc0 || h == 0xc2 || h == 0xc3) {
+			++r->p;
+			continue;
+		} else if((0xa0 <= h && h <= 0xbf) || h == 0xda || h == 0xdb) {
+			ret = read_raw(r, &raw);
+		} else if((0x90 <= h && h <= 0x9f) || h == 0xdc || h == 0xdd) {
+			ret = read_container(r, false, &n);
+			count += n;
+		} else if((0x80 <= h && h <= 0x8f) || h == 0xde || h == 0xdf) {
+			ret = read_container(r, true, &n);
+			count += (size_t)n * 2;
+		} else {
+			switch(h) {
+			case 0xcc: case 0xd0: ret = reader_take(r, 2, &p); break;
+			case 0xcd: case 0xd1: ret = reader_take(r, 3, &p); break;
+			case 0xca: case 0xce: case 0xd2: ret = reader_take(r, 5, &p); break;
+			case 0xcb: case 0xcf: case 0xd3: ret = reader_take(r, 9, &p); break;
+			default: return -1;
+			}
+		}
+		if(ret <= 0) { return ret; }
+	} while(count > 0);
+	return 1;
+}
+
+
+static int unpack_bool(struct_reader* r, char* p, const msgpack_struct_field* f)
+{
+	unsigned char h;
+	if(r->p == r->end) { return 0; }
+	h = (unsigned char)*r->p;
+	if(h != 0xc2 && h != 0xc3) { return -1; }
+	++r->p;
+	*(bool*)p = h == 0xc3;
+	return 1;
+}
+
+#define STRUCT_UNPACK_SIGNED(name, type, min, max) \
+	static int unpack_ ## name(struct_reader* r, char* p, const msgpack_struct_field* f) \
+	{ \
+		uint64_t u; \
+		bool negative; \
+		int ret = read_integer(r, &u, &negative); \
+		if(ret <= 0) { return ret; } \
+		if(negative ? (int64_t)u < (min) : u > (uint64_t)(max)) { return -1; } \
+		*(type*)p = (type)u; \
+		return 1; \
+	}
+
+#define STRUCT_UNPACK_UNSIGNED(name, type, max) \
+	static int unpack_ ## name(struct_reader* r, char* p, const msgpack_struct_field* f) \
+	{ \
+		uint64_t u; \
+		bool negative; \
+		int ret = read_integer(r, &u, &negative); \
+		if(ret <= 0) { return ret; } \
+		if(negative || u > (uint64_t)(max)) { return -1; } \
+		*(type*)p = (type)u; \
+		return 1; \
+	}
+
+STRUCT_UNPACK_SIGNED(int8, int8_t, INT8_MIN, INT8_MAX)
+STRUCT_UNPACK_SIGNED(int16, int16_t, INT16_MIN, INT16_MAX)
+STRUCT_UNPACK_SIGNED(int32, int32_t, INT32_MIN, INT32_MAX)
+STRUCT_UNPACK_SIGNED(int64, int64_t, INT64_MIN, INT64_MAX)
+STRUCT_UNPACK_UNSIGNED(uint8, uint8_t, UINT8_MAX)
+STRUCT_UNPACK_UNSIGNED(uint16, uint16_t, UINT16_MAX)
+STRUCT_UNPACK_UNSIGNED(uint32, uint32_t, UINT32_MAX)
+STRUCT_UNPACK_UNSIGNED(uint64, uint64_t, UINT64_MAX)
+
+static int read_double(struct_reader* r, double* d)
+{
+	const char* p;
+	unsigned char h;
+	if(r->p == r->end) { return 0; }
+	h = (unsigned char)*r->p;
+	if(h == 0xca) {
+		union { uint32_t i; float f; } mem;
+		if(!reader_take(r, 5, &p)) { return 0; }
+		mem.i = _msgpack_load32(uint32_t, (p + 1));
+		*d = mem.f;
+		return 1;
+	} else if(h == 0xcb) {
+		union { uint64_t i; double f; } mem;
+		if(!reader_take(r, 9, &p)) { return 0; }
+		mem.i = _msgpack_load64(uint64_t, (p + 1));
+		*d = mem.f;
+		return 1;
+	}
+	return -1;
+}
+
+static int unpack_float(struct_reader* r, char* p, const msgpack_struct_field* f)
+{
+	double d;
+	int ret = read_double(r, &d);
+	if(ret <= 0) { return ret; }
+	*(float*)p = (float)d;
+	return 1;
+}
+
+static int unpack_double(struct_reader* r, char* p, const msgpack_struct_field* f)
+{
+	return read_double(r, (double*)p);
+}
+
+static int unpack_raw(struct_reader* r, char* p, const msgpack_struct_field* f)
+{
+	return read_raw(r, (msgpack_object_raw*)p);
+}
+
+static int unpack_struct(struct_reader* r, char* p, const msgpack_struct_field* f)
+{
+	return unpack_struct_body(r, f->desc, p);
+}
+
+static const unpack_field_func unpack_funcs[MSGPACK_FIELD_TYPE_MAX] = {
+	unpack_bool,
+	unpack_int8,
+	unpack_int16,
+	unpack_int32,
+	unpack_int64,
+	unpack_uint8,
+	unpack_uint16,
+	unpack_uint32,
+	unpack_uint64,
+	unpack_float,
+	unpack_double,
+	unpack_raw,
+	unpack_struct,
+};
+
+static inline const msgpack_struct_field* find_field(
+		const msgpack_struct_desc* desc, uint32_t i, const msgpack_object_raw* key)
+{
+	const msgpack_struct_field* f;
+	const msgpack_struct_field* const fend = desc->fields + desc->count;
+
+	/* keys are usually in the order of the fields */
+	if(i < desc->count) {
+		f = desc->fields + i;
+		if(f->name_size == key->size && memcmp(f->name, key->ptr, key->size) == 0) {
+			return f;
+		}
+	}
+
+	for(f = desc->fields; f < fend; ++f) {
+		if(f->name_size == key->size && memcmp(f->name, key->ptr, key->size) == 0) {
+			return f;
+		}
+	}
+	return NULL;
+}
+
+static int unpack_struct_body(struct_reader* r,
+		const msgpack_struct_desc* desc, char* base)
+{
+	uint32_t n;
+	uint32_t i;
+	int ret;
+
+	if(desc->format == MSGPACK_STRUCT_MAP) {
+		ret = read_container(r, true, &n);
+		if(ret <= 0) { return ret; }
+		for(i=0; i < n; ++i) {
+			msgpack_object_raw key;
+			const msgpack_struct_field* f;
+			ret = read_raw(r, &key);
+			if(ret == 0) { return 0; }
+			if(ret < 0) {
+				/* non-raw key */
+				ret = skip_object(r);
+				if(ret <= 0) { return ret; }
+				ret = skip_object(r);
+			} else if((f = find_field(desc, i, &key)) != NULL) {
+				ret = (*unpack_funcs[f->type])(r, base + f->offset, f);
+			} else {
+				ret = skip_object(r);
+			}
+			if(ret <= 0) { return ret; }
+		}
+
+	} else {
+		const msgpack_struct_field* f = desc->fields;
+		ret = read_container(r, false, &n);
+		if(ret <= 0) { return ret; }
+		for(i=0; i < n; ++i, ++f) {
+			if(i < desc->count) {
+				ret = (*unpack_funcs[f->type])(r, base + f->offset, f);
+			} else {
+				ret = skip_object(r);
+			}
+			if(ret <= 0) { return ret; }
+		}
+	}
+
+	return 1;
+}
+
+msgpack_unpack_return
+msgpack_struct_unpack(const msgpack_struct_desc* desc,
+		const char* data, size_t len, size_t* off, void* obj)
+{
+	struct_reader r;
+	size_t noff = 0;
+	int ret;
+
+	if(off != NULL) { noff = *off; }
+
+	if(len <= noff) {
+		return MSGPACK_UNPACK_CONTINUE;
+	}
+
+	r.p = data + noff;
+	r.end = data + len;
+
+	ret = unpack_struct_body(&r, desc, (char*)obj);
+	if(ret < 0) {
+		return MSGPACK_UNPACK_PARSE_ERROR;
+	} else if(ret == 0) {
+		return MSGPACK_UNPACK_CONTINUE;
+	}
+
+	if(off != NULL) { *off = r.p - data; }
+
+	if(r.p < r.end) {
+		return MSGPACK_UNPACK_EXTRA_BYTES;
+	}
+
+	return MSGPACK_UNPACK_SUCCESS;
+}
+
@@ -17,14 +17,56 @@
  */
 #include "msgpack/unpack.h"
 #include "msgpack/unpack_define.h"
+#include "msgpack/hash.h"
 #include <stdlib.h>
 
+#ifndef _WIN32
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
+
+typedef struct {
+	uint32_t hash;
+	uint32_t size;
+	const char* ptr;
+} intern_entry;
+
+/*
+ * Interned keys are copied into a reference counted block. When the block
+ * or the table is full, the block is released and an empty one is started.
+ * Zones which refer keys in a block hold a reference to it.
+ */
+typedef struct {
+	intern_entry* table;
+	size_t mask;
+	size_t count;
+	size_t max_keys;
+	size_t max_length;
+	char* block;
+	size_t block_used;
+	size_t block_size;
+} intern_dict;
 
 typedef struct {
 	msgpack_zone* z;
 	bool referenced;
+	bool interned;  /* z refers the current block of dict */
+	size_t base;
+	msgpack_unpack_limit limit;
+	intern_dict* dict;
 } unpack_user;
 
+static int intern_key(unpack_user* u, msgpack_object* k);
+
 
 #define msgpack_unpack_struct(name) \
 	struct template ## name
@@ -39,6 +81,9 @@ typedef struct {
 
 #define msgpack_unpack_user unpack_user
 
+#define msgpack_unpack_limit(name) \
+	template_limit ## name
+
 
 struct template_context;
 typedef struct template_context template_context;
@@ -120,6 +165,10 @@ static inline int template_callback_map(unpack_user* u, unsigned int n, msgpack_
 
 static inline int template_callback_map_item(unpack_user* u, msgpack_object* c, msgpack_object k, msgpack_object v)
 {
+	if(u->dict != NULL && k.type == MSGPACK_OBJECT_RAW &&
+			k.via.raw.size <= u->dict->max_length) {
+		if(intern_key(u, &k) < 0) { return -1; }
+	}
 	c->via.map.ptr[c->via.map.size].key = k;
 	c->via.map.ptr[c->via.map.size].val = v;
 	++c->via.map.size;
@@ -135,11 +184,42 @@ static inline int template_callback_raw(unpack_user* u, const char* b, const cha
 	return 0;
 }
 
+static inline int template_limit_raw(unpack_user* u, size_t off, unsigned int l)
+{
+	const msgpack_unpack_limit* lim = &u->limit;
+	if(lim->raw != 0 && l > lim->raw) { return -1; }
+	if(lim->bytes != 0 && u->base + off + l > lim->bytes) { return -1; }
+	return 0;
+}
+
+static inline int template_limit_array(unpack_user* u, size_t off, unsigned int n, unsigned int depth)
+{
+	// every element takes at least 1 byte
+	const msgpack_unpack_limit* lim = &u->limit;
+	if(lim->array != 0 && n > lim->array) { return -1; }
+	if(lim->depth != 0 && depth > lim->depth) { return -1; }
+	if(lim->bytes != 0 && u->base + off + n > lim->bytes) { return -1; }
+	return 0;
+}
+
+static inline int template_limit_map(unpack_user* u, size_t off, unsigned int n, unsigned int depth)
+{
+	// every key and value takes at least 1 byte
+	const msgpack_unpack_limit* lim = &u->limit;
+	if(lim->map != 0 && n > lim->map) { return -1; }
+	if(lim->depth != 0 && depth > lim->depth) { return -1; }
+	if(lim->bytes != 0 && u->base + off + (size_t)n*2 > lim->bytes) { return -1; }
+	return 0;
+}
+
 #include "msgpack/unpack_template.h"
 
 
 #define CTX_CAST(m) ((template_context*)(m))
 #define CTX_REFERENCED(mpac) CTX_CAST((mpac)->ctx)->user.referenced
+#define CTX_LIMIT(mpac) CTX_CAST((mpac)->ctx)->user.limit
+#define CTX_INTERNED(mpac) CTX_CAST((mpac)->ctx)->user.interned
+#define CTX_DICT(mpac) CTX_CAST((mpac)->ctx)->user.dict
 
 #define COUNTER_SIZE (sizeof(_msgpack_atomic_counter_t))
 
@@ -169,27 +249,121 @@ static inline _msgpack_atomic_counter_t get_count(void* buffer)
 }
 
 
+static bool intern_start(intern_dict* d)
+{
+	char* block = (char*)malloc(d->block_size);
+	if(block == NULL) {
+		return false;
+	}
+	init_count(block);
 
-bool msgpack_unpacker_init(msgpack_unpacker* mpac, size_t initial_buffer_size)
+	if(d->block != NULL) {
+		decl_count(d->block);
+	}
+	d->block = block;
+	d->block_used = COUNTER_SIZE;
+	d->count = 0;
+	memset(d->table, 0, sizeof(intern_entry) * (d->mask + 1));
+	return true;
+}
+
+static void intern_free(intern_dict* d)
 {
-	if(initial_buffer_size < COUNTER_SIZE) {
-		initial_buffer_size = COUNTER_SIZE;
+	if(d == NULL) { return; }
+	if(d->block != NULL) {
+		decl_count(d->block);
 	}
+	free(d->table);
+	free(d);
+}
 
-	char* buffer = (char*)malloc(initial_buffer_size);
-	if(buffer == NULL) {
-		return false;
+static int intern_key(unpack_user* u, msgpack_object* k)
+{
+	intern_dict* const d = u->dict;
+	const char* const p = k->via.raw.ptr;
+	const uint32_t l = k->via.raw.size;
+	const uint32_t hash = (uint32_t)msgpack_hash_bytes(p, l, 0);
+
+	size_t pos = hash & d->mask;
+	intern_entry* e;
+	while(true) {
+		e = &d->table[pos];
+		if(e->ptr == NULL) {
+			break;
+		}
+		if(e->hash == hash && e->size == l && memcmp(e->ptr, p, l) == 0) {
+			goto _found;
+		}
+		pos = (pos + 1) & d->mask;
 	}
 
+	if(d->count >= d->max_keys || d->block_used + l > d->block_size) {
+		if(!intern_start(d)) { return -1; }
+		u->interned = false;
+		pos = hash & d->mask;
+		e = &d->table[pos];
+	}
+
+	memcpy(d->block + d->block_used, p, l);
+	e->hash = hash;
+	e->size = l;
+	e->ptr = d->block + d->block_used;
+	d->block_used += l;
+	++d->count;
+
+_found:
+	if(!u->interned) {
+		if(!msgpack_zone_push_finalizer(u->z, decl_count, d->block)) {
+			return -1;
+		}
+		incr_count(d->block);
+		u->interned = true;
+	}
+	k->via.raw.ptr = e->ptr;
+	return 0;
+}
+
+
+
+static bool init_context(msgpack_unpacker* mpac)
+{
 	void* ctx = malloc(sizeof(template_context));
 	if(ctx == NULL) {
-		free(buffer);
 		return false;
 	}
 
 	msgpack_zone* z = msgpack_zone_new(MSGPACK_ZONE_CHUNK_SIZE);
 	if(z == NULL) {
 		free(ctx);
+		return false;
+	}
+
+	mpac->parsed = 0;
+	mpac->z = z;
+	mpac->ctx = ctx;
+
+	template_init(CTX_CAST(mpac->ctx));
+	CTX_CAST(mpac->ctx)->user.z = mpac->z;
+	CTX_CAST(mpac->ctx)->user.referenced = false;
+	CTX_INTERNED(mpac) = false;
+	CTX_DICT(mpac) = NULL;
+	memset(&CTX_LIMIT(mpac), 0, sizeof(msgpack_unpack_limit));
+
+	return true;
+}
+
+bool msgpack_unpacker_init(msgpack_unpacker* mpac, size_t initial_buffer_size)
+{
+	if(initial_buffer_size < COUNTER_SIZE) {
+		initial_buffer_size = COUNTER_SIZE;
+	}
+
+	char* buffer = (char*)malloc(initial_buffer_size);
+	if(buffer == NULL) {
+		return false;
+	}
+
+	if(!init_context(mpac)) {
 		free(buffer);
 		return false;
 	}
@@ -198,24 +372,116 @@ bool msgpack_unpacker_init(msgpack_unpacker* mpac, size_t initial_buffer_size)
 	mpac->used = COUNTER_SIZE;
 	mpac->free = initial_buffer_size - mpac->used;
 	mpac->off = COUNTER_SIZE;
-	mpac->parsed = 0;
 	mpac->initial_buffer_size = initial_buffer_size;
-	mpac->z = z;
-	mpac->ctx = ctx;
+	mpac->ring = 0;
 
 	init_count(mpac->buffer);
 
-	template_init(CTX_CAST(mpac->ctx));
-	CTX_CAST(mpac->ctx)->user.z = mpac->z;
-	CTX_CAST(mpac->ctx)->user.referenced = false;
+	return true;
+}
+
+#ifndef _WIN32
+static int ring_open(size_t size)
+{
+	int fd = -1;
+#if defined(__linux__) && defined(SYS_memfd_create)
+	fd = (int)syscall(SYS_memfd_create, "msgpack_unpacker", 1 /* MFD_CLOEXEC */);
+#endif
+	if(fd < 0) {
+		const char* dir = getenv("TMPDIR");
+		char path[1024];
+		snprintf(path, sizeof(path), "%s/msgpack_unpacker.XXXXXX",
+				dir != NULL ? dir : "/tmp");
+		fd = mkstemp(path);
+		if(fd < 0) {
+			return -1;
+		}
+		unlink(path);
+	}
+
+	if(ftruncate(fd, (off_t)size) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/*
+ * Maps a file of capacity bytes twice back to back in a reserved range
+ * of address space, so that buffer[i] and buffer[capacity+i] are the
+ * same byte.
+ */
+static char* ring_map(size_t capacity)
+{
+	int fd = ring_open(capacity);
+	if(fd < 0) {
+		return NULL;
+	}
+
+	char* buffer = (char*)mmap(NULL, capacity * 2, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(buffer == (char*)MAP_FAILED) {
+		close(fd);
+		return NULL;
+	}
+
+	if(mmap(buffer, capacity, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+			mmap(buffer + capacity, capacity, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		munmap(buffer, capacity * 2);
+		close(fd);
+		return NULL;
+	}
+
+	close(fd);
+	return buffer;
+}
+#endif
+
+bool msgpack_unpacker_init_ring(msgpack_unpacker* mpac, size_t capacity)
+{
+#ifdef _WIN32
+	return false;
+#else
+	const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	if(capacity == 0) {
+		capacity = page;
+	}
+	capacity = (capacity + page - 1) / page * page;
+
+	char* buffer = ring_map(capacity);
+	if(buffer == NULL) {
+		return false;
+	}
+
+	if(!init_context(mpac)) {
+		munmap(buffer, capacity * 2);
+		return false;
+	}
+
+	mpac->buffer = buffer;
+	mpac->used = 0;
+	mpac->free = capacity;
+	mpac->off = 0;
+	mpac->initial_buffer_size = capacity;
+	mpac->ring = capacity;
 
 	return true;
+#endif
 }
 
 void msgpack_unpacker_destroy(msgpack_unpacker* mpac)
 {
 	msgpack_zone_free(mpac->z);
+	intern_free(CTX_DICT(mpac));
 	free(mpac->ctx);
+#ifndef _WIN32
+	if(mpac->ring != 0) {
+		munmap(mpac->buffer, mpac->ring * 2);
+		return;
+	}
+#endif
 	decl_count(mpac->buffer);
 }
 
@@ -235,14 +501,48 @@ msgpack_unpacker* msgpack_unpacker_new(size_t initial_buffer_size)
 	return mpac;
 }
 
+msgpack_unpacker* msgpack_unpacker_new_ring(size_t capacity)
+{
+	msgpack_unpacker* mpac = (msgpack_unpacker*)malloc(sizeof(msgpack_unpacker));
+	if(mpac == NULL) {
+		return NULL;
+	}
+
+	if(!msgpack_unpacker_init_ring(mpac, capacity)) {
+		free(mpac);
+		return NULL;
+	}
+
+	return mpac;
+}
+
 void msgpack_unpacker_free(msgpack_unpacker* mpac)
 {
 	msgpack_unpacker_destroy(mpac);
 	free(mpac);
 }
 
+static bool reclaim_ring(msgpack_unpacker* mpac, size_t size)
+{
+	// bytes from the beginning of the current message are kept, as
+	// objects parsed so far point into them
+	size_t begin = mpac->off - mpac->parsed;
+	if(begin >= mpac->ring) {
+		// the second mapping is the same memory as the first
+		begin -= mpac->ring;
+		mpac->off -= mpac->ring;
+		mpac->used -= mpac->ring;
+	}
+	mpac->free = mpac->ring - (mpac->used - begin);
+	return mpac->free >= size;
+}
+
 bool msgpack_unpacker_expand_buffer(msgpack_unpacker* mpac, size_t size)
 {
+	if(mpac->ring != 0) {
+		return reclaim_ring(mpac, size);
+	}
+
 	if(mpac->used == mpac->off && get_count(mpac->buffer) == 1
 			&& !CTX_REFERENCED(mpac)) {
 		// rewind buffer
@@ -304,14 +604,68 @@ bool msgpack_unpacker_expand_buffer(msgpack_unpacker* mpac, size_t size)
 	return true;
 }
 
+void msgpack_unpacker_set_limit(msgpack_unpacker* mpac, const msgpack_unpack_limit* limit)
+{
+	if(limit == NULL) {
+		memset(&CTX_LIMIT(mpac), 0, sizeof(msgpack_unpack_limit));
+	} else {
+		CTX_LIMIT(mpac) = *limit;
+	}
+}
+
+bool msgpack_unpacker_set_intern(msgpack_unpacker* mpac,
+		size_t max_keys, size_t max_length)
+{
+	intern_free(CTX_DICT(mpac));
+	CTX_DICT(mpac) = NULL;
+	CTX_INTERNED(mpac) = false;
+
+	if(max_keys == 0 || max_length == 0) {
+		return true;
+	}
+
+	intern_dict* d = (intern_dict*)malloc(sizeof(intern_dict));
+	if(d == NULL) {
+		return false;
+	}
+
+	size_t n = 8;
+	while(n < max_keys * 2) { n *= 2; }
+
+	d->table = (intern_entry*)malloc(sizeof(intern_entry) * n);
+	if(d->table == NULL) {
+		free(d);
+		return false;
+	}
+	d->mask = n - 1;
+	d->max_keys = max_keys;
+	d->max_length = max_length;
+	d->block = NULL;
+	d->block_size = COUNTER_SIZE + max_keys * max_length;
+
+	if(!intern_start(d)) {
+		free(d->table);
+		free(d);
+		return false;
+	}
+
+	CTX_DICT(mpac) = d;
+	return true;
+}
+
 int msgpack_unpacker_execute(msgpack_unpacker* mpac)
 {
 	size_t off = mpac->off;
+	// offset of the buffer from the beginning of the current message
+	CTX_CAST(mpac->ctx)->user.base = mpac->parsed - off;
 	int ret = template_execute(CTX_CAST(mpac->ctx),
 			mpac->buffer, mpac->used, &mpac->off);
 	if(mpac->off > off) {
 		mpac->parsed += mpac->off - off;
 	}
+	if(CTX_LIMIT(mpac).bytes != 0 && mpac->parsed > CTX_LIMIT(mpac).bytes) {
+		return -1;
+	}
 	return ret;
 }
 
@@ -333,6 +687,7 @@ msgpack_zone* msgpack_unpacker_release_zone(msgpack_unpacker* mpac)
 
 	msgpack_zone* old = mpac->z;
 	mpac->z = r;
+	CTX_CAST(mpac->ctx)->user.z = mpac->z;
 
 	return old;
 }
@@ -340,17 +695,23 @@ msgpack_zone* msgpack_unpacker_release_zone(msgpack_unpacker* mpac)
 void msgpack_unpacker_reset_zone(msgpack_unpacker* mpac)
 {
 	msgpack_zone_clear(mpac->z);
+	CTX_INTERNED(mpac) = false;
 }
 
 bool msgpack_unpacker_flush_zone(msgpack_unpacker* mpac)
 {
+	// references to interned keys are already pushed to the zone
+	CTX_INTERNED(mpac) = false;
+
 	if(CTX_REFERENCED(mpac)) {
-		if(!msgpack_zone_push_finalizer(mpac->z, decl_count, mpac->buffer)) {
-			return false;
+		// zones don't keep a ring buffer
+		if(mpac->ring == 0) {
+			if(!msgpack_zone_push_finalizer(mpac->z, decl_count, mpac->buffer)) {
+				return false;
+			}
+			incr_count(mpac->buffer);
 		}
 		CTX_REFERENCED(mpac) = false;
-
-		incr_count(mpac->buffer);
 	}
 
 	return true;
@@ -402,6 +763,10 @@ msgpack_unpack(const char* data, size_t len, size_t* off,
 
 	ctx.user.z = result_zone;
 	ctx.user.referenced = false;
+	ctx.user.interned = false;
+	ctx.user.base = 0;
+	memset(&ctx.user.limit, 0, sizeof(msgpack_unpack_limit));
+	ctx.user.dict = NULL;
 
 	int e = template_execute(&ctx, data, len, &noff);
 	if(e < 0) {
@@ -442,6 +807,10 @@ bool msgpack_unpack_next(msgpack_unpacked* result,
 
 	ctx.user.z = z;
 	ctx.user.referenced = false;
+	ctx.user.interned = false;
+	ctx.user.base = 0;
+	memset(&ctx.user.limit, 0, sizeof(msgpack_unpack_limit));
+	ctx.user.dict = NULL;
 
 	int e = template_execute(&ctx, data, len, &noff);
 	if(e <= 0) {
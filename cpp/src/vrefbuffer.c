@@ -18,12 +18,84 @@
 #include "msgpack/vrefbuffer.h"
 #include <stdlib.h>
 #include <string.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <limits.h>
+#endif
+
+#ifndef IOV_MAX
+#ifdef UIO_MAXIOV
+#define IOV_MAX UIO_MAXIOV
+#else
+#define IOV_MAX 16
+#endif
+#endif
 
 struct msgpack_vrefbuffer_chunk {
 	struct msgpack_vrefbuffer_chunk* next;
+	size_t size;
+	/* the chunk is referenced by iovecs up to this sequence number
+	 * (see msgpack_vrefbuffer_seq); (size_t)-1 while it is filled */
+	size_t nvec;
 	/* data ... */
 };
 
+static inline char* msgpack_vrefbuffer_chunk_data(msgpack_vrefbuffer_chunk* chunk)
+{
+	return ((char*)chunk) + sizeof(msgpack_vrefbuffer_chunk);
+}
+
+/* sequence number of an iovec, which does not change when consumed
+ * iovecs are removed from the array */
+static inline size_t msgpack_vrefbuffer_seq(const msgpack_vrefbuffer* vbuf,
+		const struct iovec* v)
+{
+	return vbuf->nconsumed + (v - vbuf->array);
+}
+
+static msgpack_vrefbuffer_chunk* msgpack_vrefbuffer_chunk_new(
+		msgpack_vrefbuffer* vbuf, size_t sz)
+{
+	msgpack_vrefbuffer_inner_buffer* const ib = &vbuf->inner_buffer;
+	msgpack_vrefbuffer_chunk* chunk = ib->spare;
+
+	if(chunk != NULL && sz <= vbuf->chunk_size) {
+		ib->spare = chunk->next;
+	} else {
+		if(sz < vbuf->chunk_size) {
+			sz = vbuf->chunk_size;
+		}
+		chunk = (msgpack_vrefbuffer_chunk*)malloc(
+				sizeof(msgpack_vrefbuffer_chunk) + sz);
+		if(chunk == NULL) {
+			return NULL;
+		}
+		chunk->size = sz;
+	}
+
+	chunk->next = NULL;
+	chunk->nvec = (size_t)-1;
+	return chunk;
+}
+
+/* keeps chunks of the regular size for reuse and frees larger ones */
+static void msgpack_vrefbuffer_chunk_release(
+		msgpack_vrefbuffer* vbuf, msgpack_vrefbuffer_chunk* c)
+{
+	msgpack_vrefbuffer_inner_buffer* const ib = &vbuf->inner_buffer;
+	msgpack_vrefbuffer_chunk* n;
+	while(c != NULL) {
+		n = c->next;
+		if(c->size == vbuf->chunk_size) {
+			c->next = ib->spare;
+			ib->spare = c;
+		} else {
+			free(c);
+		}
+		c = n;
+	}
+}
+
 bool msgpack_vrefbuffer_init(msgpack_vrefbuffer* vbuf,
 		size_t ref_size, size_t chunk_size)
 {
@@ -42,6 +114,13 @@ bool msgpack_vrefbuffer_init(msgpack_vrefbuffer* vbuf,
 	vbuf->tail  = array;
 	vbuf->end   = array + nfirst;
 	vbuf->array = array;
+	vbuf->head  = array;
+	vbuf->nconsumed = 0;
+
+	vbuf->base_ref_size = 0;
+	vbuf->window_bytes = 0;
+	vbuf->window_refs = 0;
+	vbuf->window_near = 0;
 
 	msgpack_vrefbuffer_chunk* chunk = (msgpack_vrefbuffer_chunk*)malloc(
 			sizeof(msgpack_vrefbuffer_chunk) + chunk_size);
@@ -55,7 +134,10 @@ bool msgpack_vrefbuffer_init(msgpack_vrefbuffer* vbuf,
 	ib->free = chunk_size;
 	ib->ptr  = ((char*)chunk) + sizeof(msgpack_vrefbuffer_chunk);
 	ib->head = chunk;
+	ib->spare = NULL;
 	chunk->next = NULL;
+	chunk->size = chunk_size;
+	chunk->nvec = (size_t)-1;
 
 	return true;
 }
@@ -72,44 +154,106 @@ void msgpack_vrefbuffer_destroy(msgpack_vrefbuffer* vbuf)
 			break;
 		}
 	}
+	c = vbuf->inner_buffer.spare;
+	while(c != NULL) {
+		msgpack_vrefbuffer_chunk* n = c->next;
+		free(c);
+		c = n;
+	}
 	free(vbuf->array);
 }
 
 void msgpack_vrefbuffer_clear(msgpack_vrefbuffer* vbuf)
 {
-	msgpack_vrefbuffer_chunk* c = vbuf->inner_buffer.head->next;
+	msgpack_vrefbuffer_inner_buffer* const ib = &vbuf->inner_buffer;
+	msgpack_vrefbuffer_chunk_release(vbuf, ib->head->next);
+
+	msgpack_vrefbuffer_chunk* chunk = ib->head;
+	chunk->next = NULL;
+	ib->free = chunk->size;
+	ib->ptr  = msgpack_vrefbuffer_chunk_data(chunk);
+
+	vbuf->tail = vbuf->array;
+	vbuf->head = vbuf->array;
+	vbuf->nconsumed = 0;
+}
+
+void msgpack_vrefbuffer_shrink(msgpack_vrefbuffer* vbuf)
+{
+	msgpack_vrefbuffer_chunk* c = vbuf->inner_buffer.spare;
 	msgpack_vrefbuffer_chunk* n;
 	while(c != NULL) {
 		n = c->next;
 		free(c);
 		c = n;
 	}
+	vbuf->inner_buffer.spare = NULL;
+}
 
-	msgpack_vrefbuffer_inner_buffer* const ib = &vbuf->inner_buffer;
-	msgpack_vrefbuffer_chunk* chunk = ib->head;
-	chunk->next = NULL;
-	ib->free = vbuf->chunk_size;
-	ib->ptr  = ((char*)chunk) + sizeof(msgpack_vrefbuffer_chunk);
+void msgpack_vrefbuffer_set_adaptive(msgpack_vrefbuffer* vbuf, bool enable)
+{
+	if(vbuf->base_ref_size != 0) {
+		vbuf->ref_size = vbuf->base_ref_size;
+	}
+	vbuf->base_ref_size = 0;
+	if(enable) {
+		vbuf->base_ref_size = vbuf->ref_size != 0 ? vbuf->ref_size : 1;
+		vbuf->ref_size = vbuf->base_ref_size;
+	}
+	vbuf->window_bytes = 0;
+	vbuf->window_refs = 0;
+	vbuf->window_near = 0;
+}
 
-	vbuf->tail = vbuf->array;
+static void msgpack_vrefbuffer_tune(msgpack_vrefbuffer* vbuf)
+{
+	/* a reference takes an iovec and the copies after it take another */
+	const size_t iov_size = MSGPACK_VREFBUFFER_ADAPTIVE_IOV_SIZE * 2;
+
+	if(vbuf->window_bytes < iov_size * vbuf->window_refs) {
+		if(vbuf->ref_size * 2 <= vbuf->chunk_size / 4) {
+			vbuf->ref_size *= 2;
+		}
+	} else if(vbuf->ref_size / 2 >= vbuf->base_ref_size &&
+			vbuf->window_bytes >= iov_size *
+				(vbuf->window_refs + vbuf->window_near)) {
+		/* the copies in [ref_size/2, ref_size) would be references */
+		vbuf->ref_size /= 2;
+	}
+
+	vbuf->window_bytes = 0;
+	vbuf->window_refs = 0;
+	vbuf->window_near = 0;
 }
 
-int msgpack_vrefbuffer_append_ref(msgpack_vrefbuffer* vbuf,
+static int msgpack_vrefbuffer_push(msgpack_vrefbuffer* vbuf,
 		const char* buf, unsigned int len)
 {
 	if(vbuf->tail == vbuf->end) {
-		const size_t nused = vbuf->tail - vbuf->array;
-		const size_t nnext = nused * 2;
+		const size_t nsent = vbuf->head - vbuf->array;
+		const size_t nused = vbuf->tail - vbuf->head;
 
-		struct iovec* nvec = (struct iovec*)realloc(
-				vbuf->array, sizeof(struct iovec)*nnext);
-		if(nvec == NULL) {
-			return -1;
-		}
+		if(nsent >= nused) {
+			/* reuse the space of consumed iovecs */
+			memmove(vbuf->array, vbuf->head, sizeof(struct iovec)*nused);
+			vbuf->nconsumed += nsent;
+			vbuf->head = vbuf->array;
+			vbuf->tail = vbuf->array + nused;
 
-		vbuf->array = nvec;
-		vbuf->end   = nvec + nnext;
-		vbuf->tail  = nvec + nused;
+		} else {
+			const size_t nnext = (nsent + nused) * 2;
+
+			struct iovec* nvec = (struct iovec*)realloc(
+					vbuf->array, sizeof(struct iovec)*nnext);
+			if(nvec == NULL) {
+				return -1;
+			}
+
+			vbuf->array = nvec;
+			vbuf->end   = nvec + nnext;
+			vbuf->head  = nvec + nsent;
+			vbuf->tail  = nvec + nsent + nused;
+		}
 	}
 
 	vbuf->tail->iov_base = (char*)buf;
@@ -119,27 +263,46 @@ int msgpack_vrefbuffer_append_ref(msgpack_vrefbuffer* vbuf,
 	return 0;
 }
 
+int msgpack_vrefbuffer_append_ref(msgpack_vrefbuffer* vbuf,
+		const char* buf, unsigned int len)
+{
+	if(vbuf->base_ref_size != 0) {
+		vbuf->window_bytes += len;
+		++vbuf->window_refs;
+		if(vbuf->window_bytes >= MSGPACK_VREFBUFFER_ADAPTIVE_WINDOW) {
+			msgpack_vrefbuffer_tune(vbuf);
+		}
+	}
+
+	return msgpack_vrefbuffer_push(vbuf, buf, len);
+}
+
 int msgpack_vrefbuffer_append_copy(msgpack_vrefbuffer* vbuf,
 		const char* buf, unsigned int len)
 {
 	msgpack_vrefbuffer_inner_buffer* const ib = &vbuf->inner_buffer;
 
-	if(ib->free < len) {
-		size_t sz = vbuf->chunk_size;
-		if(sz < len) {
-			sz = len;
+	if(vbuf->base_ref_size != 0) {
+		vbuf->window_bytes += len;
+		if(len >= vbuf->ref_size / 2) {
+			++vbuf->window_near;
+		}
+		if(vbuf->window_bytes >= MSGPACK_VREFBUFFER_ADAPTIVE_WINDOW) {
+			msgpack_vrefbuffer_tune(vbuf);
 		}
+	}
 
-		msgpack_vrefbuffer_chunk* chunk = (msgpack_vrefbuffer_chunk*)malloc(
-				sizeof(msgpack_vrefbuffer_chunk) + sz);
+	if(ib->free < len) {
+		msgpack_vrefbuffer_chunk* chunk = msgpack_vrefbuffer_chunk_new(vbuf, len);
 		if(chunk == NULL) {
 			return -1;
 		}
 
+		ib->head->nvec = msgpack_vrefbuffer_seq(vbuf, vbuf->tail);
 		chunk->next = ib->head;
 		ib->head = chunk;
-		ib->free = sz;
-		ib->ptr  = ((char*)chunk) + sizeof(msgpack_vrefbuffer_chunk);
+		ib->free = chunk->size;
+		ib->ptr  = msgpack_vrefbuffer_chunk_data(chunk);
 	}
 
 	char* m = ib->ptr;
@@ -147,30 +310,27 @@ int msgpack_vrefbuffer_append_copy(msgpack_vrefbuffer* vbuf,
 	ib->free -= len;
 	ib->ptr  += len;
 
-	if(vbuf->tail != vbuf->array && m ==
+	if(vbuf->tail != vbuf->head && m ==
 			(const char*)((vbuf->tail-1)->iov_base) + (vbuf->tail-1)->iov_len) {
 		(vbuf->tail-1)->iov_len += len;
 		return 0;
 	} else {
-		return msgpack_vrefbuffer_append_ref(vbuf, m, len);
+		return msgpack_vrefbuffer_push(vbuf, m, len);
 	}
 }
 
 int msgpack_vrefbuffer_migrate(msgpack_vrefbuffer* vbuf, msgpack_vrefbuffer* to)
 {
-	size_t sz = vbuf->chunk_size;
-
-	msgpack_vrefbuffer_chunk* empty = (msgpack_vrefbuffer_chunk*)malloc(
-			sizeof(msgpack_vrefbuffer_chunk) + sz);
+	msgpack_vrefbuffer_chunk* empty = msgpack_vrefbuffer_chunk_new(
+			vbuf, vbuf->chunk_size);
 	if(empty == NULL) {
 		return -1;
 	}
 
-	empty->next = NULL;
 
-
-	const size_t nused = vbuf->tail - vbuf->array;
-	if(to->tail + nused < vbuf->end) {
+	const size_t nused = vbuf->tail - vbuf->head;
+	if((size_t)(to->end - to->tail) < nused) {
+		const size_t tosent = to->head - to->array;
 		const size_t tosize = to->tail - to->array;
 		const size_t reqsize = nused + tosize;
 		size_t nnext = (to->end - to->array) * 2;
@@ -181,40 +341,137 @@ int msgpack_vrefbuffer_migrate(msgpack_vrefbuffer* vbuf, msgpack_vrefbuffer* to)
 		struct iovec* nvec = (struct iovec*)realloc(
 				to->array, sizeof(struct iovec)*nnext);
 		if(nvec == NULL) {
-			free(empty);
+			msgpack_vrefbuffer_chunk_release(vbuf, empty);
 			return -1;
 		}
 
 		to->array = nvec;
 		to->end   = nvec + nnext;
+		to->head  = nvec + tosent;
 		to->tail  = nvec + tosize;
 	}
 
-	memcpy(to->tail, vbuf->array, sizeof(struct iovec)*nused);
+	memcpy(to->tail, vbuf->head, sizeof(struct iovec)*nused);
 
 	to->tail += nused;
+	vbuf->nconsumed = msgpack_vrefbuffer_seq(vbuf, vbuf->tail);
 	vbuf->tail = vbuf->array;
+	vbuf->head = vbuf->array;
 
 
 	msgpack_vrefbuffer_inner_buffer* const ib = &vbuf->inner_buffer;
 	msgpack_vrefbuffer_inner_buffer* const toib = &to->inner_buffer;
 
+	/* the migrated chunks are free once everything in to is consumed.
+	 * The current chunk is kept at the head of the list. */
+	const size_t seq = msgpack_vrefbuffer_seq(to, to->tail);
 	msgpack_vrefbuffer_chunk* last = ib->head;
+	last->nvec = seq;
 	while(last->next != NULL) {
 		last = last->next;
+		last->nvec = seq;
 	}
-	last->next = toib->head;
-	toib->head = ib->head;
 
 	if(toib->free < ib->free) {
+		toib->head->nvec = seq;
+		last->next = toib->head;
+		toib->head = ib->head;
+		toib->head->nvec = (size_t)-1;
 		toib->free = ib->free;
 		toib->ptr  = ib->ptr;
+	} else {
+		last->next = toib->head->next;
+		toib->head->next = ib->head;
 	}
 
 	ib->head = empty;
-	ib->free = sz;
-	ib->ptr  = ((char*)empty) + sizeof(msgpack_vrefbuffer_chunk);
+	ib->free = empty->size;
+	ib->ptr  = msgpack_vrefbuffer_chunk_data(empty);
 
 	return 0;
 }
 
+bool msgpack_vrefbuffer_is_copy(const msgpack_vrefbuffer* vbuf, const struct iovec* v)
+{
+	const char* const p = (const char*)v->iov_base;
+	const msgpack_vrefbuffer_chunk* c = vbuf->inner_buffer.head;
+	for(; c != NULL; c = c->next) {
+		const char* const data = (const char*)c + sizeof(msgpack_vrefbuffer_chunk);
+		if(data <= p && p < data + c->size) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void msgpack_vrefbuffer_consume(msgpack_vrefbuffer* vbuf, size_t size)
+{
+	struct iovec* head = vbuf->head;
+	while(head != vbuf->tail && size >= head->iov_len) {
+		size -= head->iov_len;
+		++head;
+	}
+	if(head != vbuf->tail && size > 0) {
+		head->iov_base = (char*)head->iov_base + size;
+		head->iov_len -= size;
+	}
+	if(head == vbuf->head) {
+		return;
+	}
+	vbuf->head = head;
+
+	msgpack_vrefbuffer_inner_buffer* const ib = &vbuf->inner_buffer;
+
+	if(head == vbuf->tail) {
+		/* everything is sent; rewind the array and the current chunk */
+		vbuf->nconsumed = msgpack_vrefbuffer_seq(vbuf, vbuf->tail);
+		vbuf->tail = vbuf->array;
+		vbuf->head = vbuf->array;
+
+		msgpack_vrefbuffer_chunk_release(vbuf, ib->head->next);
+		ib->head->next = NULL;
+		ib->free = ib->head->size;
+		ib->ptr  = msgpack_vrefbuffer_chunk_data(ib->head);
+		return;
+	}
+
+	/* chunks are ordered from the newest to the oldest */
+	const size_t seq = msgpack_vrefbuffer_seq(vbuf, head);
+	msgpack_vrefbuffer_chunk** p = &ib->head->next;
+	while(*p != NULL && (*p)->nvec > seq) {
+		p = &(*p)->next;
+	}
+	msgpack_vrefbuffer_chunk_release(vbuf, *p);
+	*p = NULL;
+}
+
+#ifndef _WIN32
+ssize_t msgpack_vrefbuffer_writev(msgpack_vrefbuffer* vbuf, int fd)
+{
+	ssize_t total = 0;
+
+	while(vbuf->head != vbuf->tail) {
+		size_t n = vbuf->tail - vbuf->head;
+		if(n > IOV_MAX) {
+			n = IOV_MAX;
+		}
+
+		ssize_t ret = writev(fd, vbuf->head, (int)n);
+		if(ret < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			if(errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+			return -1;
+		}
+
+		msgpack_vrefbuffer_consume(vbuf, ret);
+		total += ret;
+	}
+
+	return total;
+}
+#endif
+
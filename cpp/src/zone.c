@@ -179,6 +179,18 @@ void msgpack_zone_clear(msgpack_zone* zone)
 	clear_chunk_list(&zone->chunk_list, zone->chunk_size);
 }
 
+void msgpack_zone_rollback(msgpack_zone* zone, const msgpack_zone_chunk_list* mark)
+{
+	msgpack_zone_chunk_list* const cl = &zone->chunk_list;
+	msgpack_zone_chunk* c = cl->head;
+	while(c != mark->head) {
+		msgpack_zone_chunk* n = c->next;
+		free(c);
+		c = n;
+	}
+	*cl = *mark;
+}
+
 bool msgpack_zone_init(msgpack_zone* zone, size_t chunk_size)
 {
 	zone->chunk_size = chunk_size;
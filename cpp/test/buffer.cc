@@ -1,7 +1,20 @@
 #include <msgpack.hpp>
 #include <msgpack/zbuffer.hpp>
+#include <msgpack/zunpacker.hpp>
+#include <msgpack/pzbuffer.hpp>
+#include <msgpack/mbuffer.hpp>
+#include "messages.h"
 #include <gtest/gtest.h>
 #include <string.h>
+#include <algorithm>
+#include <string>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <sstream>
 
 TEST(buffer, sbuffer)
 {
@@ -22,6 +35,21 @@ TEST(buffer, sbuffer)
 	EXPECT_TRUE( memcmp(sbuf.data(), "aaa", 3) == 0 );
 }
 
+TEST(buffer, sbuffer_reserve)
+{
+	msgpack::sbuffer sbuf(4);
+	sbuf.write("a", 1);
+
+	sbuf.reserve_buffer(100);
+	EXPECT_TRUE(sbuf.buffer_capacity() >= 100);
+	memset(sbuf.buffer(), 'b', 100);
+	sbuf.buffer_consumed(100);
+
+	EXPECT_EQ(101, sbuf.size());
+	EXPECT_EQ('a', sbuf.data()[0]);
+	EXPECT_EQ('b', sbuf.data()[100]);
+}
+
 
 TEST(buffer, vrefbuffer)
 {
@@ -59,6 +87,205 @@ TEST(buffer, vrefbuffer)
 	EXPECT_TRUE( memcmp(sbuf.data(), "aaa", 3) == 0 );
 }
 
+static std::string vrefbuffer_contents(const msgpack::vrefbuffer& vbuf)
+{
+	std::string s;
+	const struct iovec* vec = vbuf.vector();
+	for(size_t i=0; i < vbuf.vector_size(); ++i) {
+		s.append((const char*)vec[i].iov_base, vec[i].iov_len);
+	}
+	return s;
+}
+
+// appends copies and references in turn
+static void vrefbuffer_fill(msgpack::vrefbuffer& vbuf, std::string& expected,
+		const std::string& ref, int count)
+{
+	for(int i=0; i < count; ++i) {
+		char copy[20];
+		memset(copy, 'a' + i % 26, sizeof(copy));
+		vbuf.write(copy, 1 + i % sizeof(copy));
+		expected.append(copy, 1 + i % sizeof(copy));
+		if(i % 3 == 0) {
+			vbuf.write(ref.data(), ref.size());
+			expected += ref;
+		}
+	}
+}
+
+TEST(buffer, vrefbuffer_consume)
+{
+	std::string ref(100, 'r');
+	msgpack::vrefbuffer vbuf(32, 256);
+	std::string expected;
+	vrefbuffer_fill(vbuf, expected, ref, 500);
+
+	size_t step = 1;
+	while(!expected.empty()) {
+		size_t n = std::min(step, expected.size());
+		vbuf.consume(n);
+		expected.erase(0, n);
+		EXPECT_EQ(expected, vrefbuffer_contents(vbuf));
+		step = step * 3 % 301;
+
+		// interleaved writes land after the unsent data
+		if(step % 7 == 0) {
+			vbuf.write("xyz", 3);
+			expected += "xyz";
+		}
+	}
+	EXPECT_EQ(0, vbuf.vector_size());
+
+	vbuf.consume(10);
+	vbuf.write("a", 1);
+	EXPECT_EQ("a", vrefbuffer_contents(vbuf));
+}
+
+TEST(buffer, vrefbuffer_recycle)
+{
+	std::string ref(100, 'r');
+	msgpack::vrefbuffer vbuf(32, 256);
+
+	// chunks are reused once their contents are consumed
+	std::string expected;
+	vrefbuffer_fill(vbuf, expected, ref, 100);
+	EXPECT_TRUE(vbuf.inner_buffer.spare == NULL);
+	vbuf.consume(expected.size() / 2);
+	EXPECT_TRUE(vbuf.inner_buffer.spare != NULL);
+	expected.erase(0, expected.size() / 2);
+	vrefbuffer_fill(vbuf, expected, ref, 100);
+	EXPECT_EQ(expected, vrefbuffer_contents(vbuf));
+
+	// and the buffer stops allocating in steady state
+	vbuf.consume(expected.size());
+	const struct iovec* array = vbuf.array;
+	for(int i=0; i < 10; ++i) {
+		expected.clear();
+		vrefbuffer_fill(vbuf, expected, ref, 100);
+		if(i > 0) {
+			EXPECT_EQ(array, vbuf.array);
+			EXPECT_TRUE(vbuf.inner_buffer.spare != NULL);
+		}
+		array = vbuf.array;
+		vbuf.consume(expected.size() / 3);
+		expected.erase(0, expected.size() / 3);
+		EXPECT_EQ(expected, vrefbuffer_contents(vbuf));
+		vbuf.consume(expected.size());
+	}
+}
+
+TEST(buffer, vrefbuffer_migrate_consume)
+{
+	std::string ref(100, 'r');
+	msgpack::vrefbuffer vbuf(32, 256);
+	msgpack::vrefbuffer to(32, 256);
+	std::string expected;
+	vrefbuffer_fill(to, expected, ref, 50);
+	to.consume(10);
+	expected.erase(0, 10);
+	vrefbuffer_fill(vbuf, expected, ref, 200);
+	vbuf.migrate(&to);
+	EXPECT_EQ(0, vbuf.vector_size());
+	EXPECT_EQ(expected, vrefbuffer_contents(to));
+
+	vrefbuffer_fill(to, expected, ref, 50);
+	to.consume(expected.size() - 5);
+	EXPECT_EQ(expected.substr(expected.size() - 5), vrefbuffer_contents(to));
+}
+
+TEST(buffer, vrefbuffer_clear_reuse)
+{
+	std::string ref(100, 'r');
+	msgpack::vrefbuffer vbuf(32, 256);
+	std::string expected;
+	vrefbuffer_fill(vbuf, expected, ref, 100);
+	EXPECT_TRUE(vbuf.inner_buffer.spare == NULL);
+
+	// chunks survive clear() and are taken again by the next response
+	vbuf.clear();
+	EXPECT_TRUE(vbuf.inner_buffer.spare != NULL);
+	expected.clear();
+	vrefbuffer_fill(vbuf, expected, ref, 100);
+	EXPECT_TRUE(vbuf.inner_buffer.spare == NULL);
+	EXPECT_EQ(expected, vrefbuffer_contents(vbuf));
+
+	vbuf.clear();
+	vbuf.shrink();
+	EXPECT_TRUE(vbuf.inner_buffer.spare == NULL);
+	vbuf.write("abc", 3);
+	EXPECT_EQ("abc", vrefbuffer_contents(vbuf));
+}
+
+TEST(buffer, vrefbuffer_adaptive)
+{
+	std::string medium(100, 'm');
+	std::string large(64*1024, 'l');
+	msgpack::vrefbuffer fixed;
+	msgpack::vrefbuffer vbuf;
+	vbuf.set_adaptive();
+
+	// many medium strings are copied instead of referenced
+	for(int i=0; i < 10000; ++i) {
+		msgpack::pack(fixed, medium);
+		msgpack::pack(vbuf, medium);
+	}
+	EXPECT_LT(MSGPACK_VREFBUFFER_REF_SIZE, vbuf.ref_size);
+	EXPECT_GE(MSGPACK_VREFBUFFER_CHUNK_SIZE / 4, vbuf.ref_size);
+	EXPECT_EQ(MSGPACK_VREFBUFFER_REF_SIZE, fixed.ref_size);
+	EXPECT_LT(vbuf.vector_size() * 5, fixed.vector_size());
+	EXPECT_EQ(vrefbuffer_contents(fixed), vrefbuffer_contents(vbuf));
+
+	// and the threshold comes back down when large values dominate
+	vbuf.clear();
+	for(int i=0; i < 100; ++i) {
+		msgpack::pack(vbuf, i);
+		msgpack::pack(vbuf, large);
+	}
+	EXPECT_EQ(MSGPACK_VREFBUFFER_REF_SIZE, vbuf.ref_size);
+
+	vbuf.set_adaptive(false);
+	EXPECT_EQ(MSGPACK_VREFBUFFER_REF_SIZE, vbuf.ref_size);
+}
+
+TEST(buffer, vrefbuffer_writev)
+{
+	int fds[2];
+	ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+	ASSERT_EQ(0, fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK));
+
+	// more iovecs than IOV_MAX and more bytes than the socket buffer
+	std::string ref(100, 'r');
+	msgpack::vrefbuffer vbuf(32, 256);
+	std::string expected;
+	vrefbuffer_fill(vbuf, expected, ref, 30000);
+	EXPECT_LT(1024, vbuf.vector_size());
+
+	std::string received;
+	char buf[64*1024];
+	bool blocked = false;
+	while(vbuf.vector_size() > 0) {
+		size_t before = vbuf.vector_size();
+		size_t n = vbuf.writev(fds[0]);
+		if(vbuf.vector_size() > 0) {
+			blocked = true;
+			EXPECT_TRUE(n > 0 || vbuf.vector_size() == before);
+		}
+		ssize_t r;
+		while((r = read(fds[1], buf, sizeof(buf))) > 0) {
+			received.append(buf, r);
+			if(r < (ssize_t)sizeof(buf)) { break; }
+		}
+	}
+	EXPECT_TRUE(blocked);
+	EXPECT_EQ(expected.size(), received.size());
+	EXPECT_TRUE(expected == received);
+
+	signal(SIGPIPE, SIG_IGN);
+	close(fds[1]);
+	vbuf.write("abc", 3);
+	EXPECT_THROW(vbuf.writev(fds[0]), std::runtime_error);
+	close(fds[0]);
+}
 
 TEST(buffer, zbuffer)
 {
@@ -73,3 +300,425 @@ TEST(buffer, zbuffer)
 	size_t size = zbuf.size();
 }
 
+
+
+TEST(buffer, zunpacker)
+{
+	msgpack::zbuffer zbuf;
+	pack_messages(zbuf, 0, 1000);
+	zbuf.flush();
+
+	msgpack::zunpacker pac;
+	EXPECT_EQ(1000, feed(pac, zbuf.data(), zbuf.size(), 7, 0));
+
+	msgpack::zunpacker pac2(16);
+	EXPECT_EQ(1000, feed(pac2, zbuf.data(), zbuf.size(), zbuf.size(), 0));
+}
+
+TEST(buffer, zunpacker_incremental)
+{
+	// messages are returned before the whole stream is fed, and
+	// the unpacker holds only a window of the inflated data
+	msgpack::zbuffer zbuf;
+	pack_messages(zbuf, 0, 200000);
+	zbuf.flush();
+
+	msgpack::zunpacker pac;
+	int count = feed(pac, zbuf.data(), zbuf.size() / 2, 4096, 0);
+	EXPECT_LT(0, count);
+	EXPECT_GT(200000, count);
+	EXPECT_EQ(200000, feed(pac, zbuf.data() + zbuf.size() / 2,
+				zbuf.size() - zbuf.size() / 2, 4096, count));
+	EXPECT_GE((size_t)MSGPACK_UNPACKER_INIT_BUFFER_SIZE, pac.mpac.used + pac.mpac.free);
+}
+
+TEST(buffer, zunpacker_streams)
+{
+	msgpack::zbuffer zbuf;
+	pack_messages(zbuf, 0, 10);
+	zbuf.flush();
+	std::string data(zbuf.data(), zbuf.size());
+	zbuf.reset();
+	pack_messages(zbuf, 10, 20);
+	zbuf.flush();
+	data.append(zbuf.data(), zbuf.size());
+
+	msgpack::zunpacker pac;
+	EXPECT_EQ(20, feed(pac, data.data(), data.size(), 5, 0));
+}
+
+TEST(buffer, zunpacker_broken)
+{
+	msgpack::zbuffer zbuf;
+	pack_messages(zbuf, 0, 10);
+	zbuf.flush();
+	zbuf.data()[zbuf.size() / 2] ^= 0x55;
+
+	msgpack::zunpacker pac;
+	pac.reserve_buffer(zbuf.size());
+	memcpy(pac.buffer(), zbuf.data(), zbuf.size());
+	pac.buffer_consumed(zbuf.size());
+	msgpack::unpacked result;
+	EXPECT_THROW(while(pac.next(&result)) { }, msgpack::unpack_error);
+}
+
+TEST(buffer, zunpacker_c)
+{
+	msgpack::zbuffer zbuf;
+	pack_messages(zbuf, 0, 100);
+	zbuf.flush();
+
+	msgpack_zunpacker* zpac = msgpack_zunpacker_new(MSGPACK_ZUNPACKER_INIT_BUFFER_SIZE);
+	ASSERT_TRUE(zpac != NULL);
+	msgpack_unpacked result;
+	msgpack_unpacked_init(&result);
+	int count = 0;
+	for(size_t off=0; off < zbuf.size(); off += 100) {
+		size_t n = std::min((size_t)100, zbuf.size() - off);
+		ASSERT_TRUE(msgpack_zunpacker_reserve_buffer(zpac, n));
+		memcpy(msgpack_zunpacker_buffer(zpac), zbuf.data() + off, n);
+		msgpack_zunpacker_buffer_consumed(zpac, n);
+		while(msgpack_zunpacker_next(zpac, &result)) {
+			EXPECT_EQ(MSGPACK_OBJECT_ARRAY, result.data.type);
+			EXPECT_EQ((uint64_t)count, result.data.via.array.ptr[0].via.u64);
+			++count;
+		}
+	}
+	EXPECT_EQ(100, count);
+	EXPECT_EQ(0, msgpack_zunpacker_execute(zpac));
+	msgpack_unpacked_destroy(&result);
+	msgpack_zunpacker_free(zpac);
+}
+
+static size_t feed_one(msgpack::zunpacker& pac, msgpack::zbuffer& zbuf, int expected)
+{
+	const size_t size = zbuf.size();
+	pac.reserve_buffer(size);
+	memcpy(pac.buffer(), zbuf.data(), size);
+	pac.buffer_consumed(size);
+	zbuf.reset_buffer();
+
+	msgpack::unpacked result;
+	EXPECT_TRUE(pac.next(&result));
+	EXPECT_EQ(expected, result.get().via.array.ptr[0].as<int>());
+	EXPECT_FALSE(pac.next(&result));
+	return size;
+}
+
+TEST(buffer, zbuffer_sync_flush)
+{
+	// each message is decodable as soon as its flushed bytes arrive
+	msgpack::zbuffer zbuf;
+	msgpack::zunpacker pac;
+	size_t first = 0;
+	size_t last = 0;
+	for(int i=0; i < 100; ++i) {
+		pack_messages(zbuf, i, i+1);
+		zbuf.sync_flush();
+		last = feed_one(pac, zbuf, i);
+		if(i == 0) { first = last; }
+	}
+	// later messages are compressed with the history of earlier ones
+	EXPECT_LT(last, first);
+
+	// flushing nothing adds nothing but a marker
+	zbuf.sync_flush();
+	zbuf.sync_flush();
+	EXPECT_GE((size_t)5, zbuf.size());
+}
+
+TEST(buffer, zbuffer_dictionary)
+{
+	msgpack::sbuffer sample;
+	pack_messages(sample, 0, 4);
+	const std::string dict(sample.data(), sample.size());
+
+	msgpack::zbuffer plain;
+	pack_messages(plain, 100, 101);
+	plain.flush();
+
+	msgpack::zbuffer zbuf;
+	zbuf.set_dictionary(dict.data(), dict.size());
+	std::string data;
+	for(int i=100; i < 110; ++i) {
+		pack_messages(zbuf, i, i+1);
+		zbuf.flush();
+		if(i == 100) { EXPECT_LT(zbuf.size(), plain.size()); }
+		data.append(zbuf.data(), zbuf.size());
+		zbuf.reset();
+	}
+
+	msgpack::zunpacker pac;
+	pac.set_dictionary(dict.data(), dict.size());
+	EXPECT_EQ(110, feed(pac, data.data(), data.size(), 3, 100));
+
+	msgpack::zunpacker nodict;
+	EXPECT_THROW(feed(nodict, data.data(), data.size(), data.size(), 100),
+			msgpack::unpack_error);
+}
+
+TEST(buffer, zbuffer_dictionary_sync_flush)
+{
+	msgpack::sbuffer sample;
+	pack_messages(sample, 0, 4);
+	const std::string dict(sample.data(), sample.size());
+
+	msgpack::zbuffer zbuf;
+	zbuf.set_dictionary(dict.data(), dict.size());
+	msgpack::zunpacker pac;
+	pac.set_dictionary(dict.data(), dict.size());
+	for(int i=0; i < 10; ++i) {
+		pack_messages(zbuf, i, i+1);
+		zbuf.sync_flush();
+		feed_one(pac, zbuf, i);
+	}
+}
+
+static std::string inflate_all(const char* data, size_t size)
+{
+	// one zlib stream, read by zlib alone
+	std::string out;
+	z_stream s;
+	memset(&s, 0, sizeof(s));
+	EXPECT_EQ(Z_OK, inflateInit(&s));
+	s.next_in = (Bytef*)data;
+	s.avail_in = size;
+	int ret;
+	do {
+		char buf[4096];
+		s.next_out = (Bytef*)buf;
+		s.avail_out = sizeof(buf);
+		ret = inflate(&s, Z_NO_FLUSH);
+		out.append(buf, sizeof(buf) - s.avail_out);
+	} while(ret == Z_OK);
+	EXPECT_EQ(Z_STREAM_END, ret);
+	EXPECT_EQ(0u, s.avail_in);
+	inflateEnd(&s);
+	return out;
+}
+
+TEST(buffer, pzbuffer)
+{
+	msgpack::sbuffer sbuf;
+	pack_messages(sbuf, 0, 100000);
+
+	msgpack::pzbuffer pzbuf(4, Z_DEFAULT_COMPRESSION, 64*1024);
+	pack_messages(pzbuf, 0, 100000);
+	pzbuf.flush();
+	EXPECT_EQ(std::string(sbuf.data(), sbuf.size()),
+			inflate_all(pzbuf.data(), pzbuf.size()));
+
+	msgpack::zunpacker pac;
+	EXPECT_EQ(100000, feed(pac, pzbuf.data(), pzbuf.size(), 4096, 0));
+
+	// the blocks don't depend on the number of threads
+	msgpack::pzbuffer single(1, Z_DEFAULT_COMPRESSION, 64*1024);
+	pack_messages(single, 0, 100000);
+	single.flush();
+	EXPECT_EQ(std::string(pzbuf.data(), pzbuf.size()),
+			std::string(single.data(), single.size()));
+
+	// and compress nearly as well as one stream
+	msgpack::zbuffer zbuf;
+	pack_messages(zbuf, 0, 100000);
+	zbuf.flush();
+	EXPECT_LT(pzbuf.size(), zbuf.size() + zbuf.size() / 20);
+}
+
+TEST(buffer, pzbuffer_drain)
+{
+	// compressed blocks are sent while more is written
+	msgpack::pzbuffer pzbuf(2, 1, 4096);
+	std::string out;
+	for(int i=0; i < 100; ++i) {
+		pack_messages(pzbuf, i * 100, (i+1) * 100);
+		out.append(pzbuf.data(), pzbuf.size());
+		pzbuf.reset_buffer();
+	}
+	EXPECT_LT(0u, out.size());
+	pzbuf.flush();
+	pzbuf.flush();
+	out.append(pzbuf.data(), pzbuf.size());
+
+	msgpack::sbuffer sbuf;
+	pack_messages(sbuf, 0, 10000);
+	EXPECT_EQ(std::string(sbuf.data(), sbuf.size()),
+			inflate_all(out.data(), out.size()));
+	EXPECT_THROW(pzbuf.write("a", 1), std::bad_alloc);
+}
+
+TEST(buffer, pzbuffer_reset)
+{
+	msgpack::pzbuffer pzbuf(3, Z_DEFAULT_COMPRESSION, 1024);
+	pzbuf.flush();
+	EXPECT_EQ(std::string(), inflate_all(pzbuf.data(), pzbuf.size()));
+
+	// an unfinished stream is dropped
+	pzbuf.reset();
+	pack_messages(pzbuf, 0, 1000);
+	pzbuf.reset();
+	pack_messages(pzbuf, 10, 20);
+	pzbuf.flush();
+	std::string data(pzbuf.data(), pzbuf.size());
+	pzbuf.reset();
+	pack_messages(pzbuf, 20, 30);
+	pzbuf.flush();
+	data.append(pzbuf.data(), pzbuf.size());
+
+	msgpack::zunpacker pac;
+	EXPECT_EQ(30, feed(pac, data.data(), data.size(), 5, 10));
+}
+
+TEST(buffer, pzbuffer_failure)
+{
+	// deflate rejects the level, so every block fails
+	msgpack_pzbuffer* pzbuf = msgpack_pzbuffer_new(42, 1024, 2, MSGPACK_PZBUFFER_INIT_SIZE);
+	ASSERT_TRUE(pzbuf != NULL);
+	const std::string block(1024, 'x');
+	int ret = 0;
+	for(int i=0; i < 100 && ret == 0; ++i) {
+		ret = msgpack_pzbuffer_write(pzbuf, block.data(), block.size());
+	}
+	EXPECT_EQ(-1, ret);
+
+	// the stream misses a block, so nothing more is accepted
+	for(int i=0; i < 3; ++i) {
+		EXPECT_EQ(-1, msgpack_pzbuffer_write(pzbuf, "a", 1));
+		EXPECT_TRUE(msgpack_pzbuffer_flush(pzbuf) == NULL);
+	}
+
+	// until a new stream is started
+	EXPECT_TRUE(msgpack_pzbuffer_reset(pzbuf));
+	EXPECT_EQ(0u, msgpack_pzbuffer_size(pzbuf));
+	EXPECT_EQ(0, msgpack_pzbuffer_write(pzbuf, "a", 1));
+	EXPECT_TRUE(msgpack_pzbuffer_flush(pzbuf) == NULL);
+	EXPECT_EQ(-1, msgpack_pzbuffer_write(pzbuf, "a", 1));
+	msgpack_pzbuffer_free(pzbuf);
+}
+
+TEST(buffer, pzbuffer_c)
+{
+	msgpack_pzbuffer* pzbuf = msgpack_pzbuffer_new(Z_DEFAULT_COMPRESSION,
+			MSGPACK_PZBUFFER_BLOCK_SIZE, 2, MSGPACK_PZBUFFER_INIT_SIZE);
+	ASSERT_TRUE(pzbuf != NULL);
+	msgpack_packer pk;
+	msgpack_packer_init(&pk, pzbuf, msgpack_pzbuffer_write);
+	for(int i=0; i < 100000; ++i) {
+		msgpack_pack_int(&pk, i);
+	}
+	ASSERT_TRUE(msgpack_pzbuffer_flush(pzbuf) != NULL);
+
+	msgpack::unpacker pac;
+	std::string data = inflate_all(msgpack_pzbuffer_data(pzbuf), msgpack_pzbuffer_size(pzbuf));
+	pac.reserve_buffer(data.size());
+	memcpy(pac.buffer(), data.data(), data.size());
+	pac.buffer_consumed(data.size());
+	msgpack::unpacked result;
+	int count = 0;
+	while(pac.next(&result)) {
+		EXPECT_EQ(count, result.get().as<int>());
+		++count;
+	}
+	EXPECT_EQ(100000, count);
+	msgpack_pzbuffer_free(pzbuf);
+}
+
+static std::string read_file(const char* path)
+{
+	std::ifstream in(path, std::ios::in | std::ios::binary);
+	std::ostringstream file;
+	file << in.rdbuf();
+	return file.str();
+}
+
+TEST(buffer, mbuffer)
+{
+	std::ostringstream path;
+	path << "/tmp/msgpack_mbuffer_test." << getpid();
+
+	// a one-page extent makes values straddle extents
+	std::string expected;
+	{
+		msgpack::mbuffer mbuf(path.str().c_str(), 1);
+		EXPECT_EQ((size_t)sysconf(_SC_PAGESIZE), mbuf.extent);
+		msgpack::sbuffer sbuf;
+		std::string large(10000, 'x');
+		for(int i=0; i < 1000; ++i) {
+			msgpack::pack(mbuf, i);
+			msgpack::pack(sbuf, i);
+			if(i % 100 == 0) {
+				msgpack::pack(mbuf, large);
+				msgpack::pack(sbuf, large);
+			}
+		}
+		expected.assign(sbuf.data(), sbuf.size());
+		EXPECT_EQ(expected.size(), mbuf.size());
+	}
+	EXPECT_TRUE(expected == read_file(path.str().c_str()));
+
+	// close() truncates to the exact size; an empty buffer leaves an empty file
+	{
+		msgpack::mbuffer mbuf(path.str().c_str());
+		mbuf.close();
+		mbuf.close();
+		EXPECT_THROW(mbuf.write("a", 1), std::runtime_error);
+	}
+	struct stat st;
+	ASSERT_EQ(0, stat(path.str().c_str(), &st));
+	EXPECT_EQ(0, st.st_size);
+
+	unlink(path.str().c_str());
+	EXPECT_THROW(msgpack::mbuffer("/nonexistent/dir/file"), std::runtime_error);
+}
+
+TEST(buffer, mbuffer_c)
+{
+	std::ostringstream path;
+	path << "/tmp/msgpack_mbuffer_test_c." << getpid();
+
+	msgpack_mbuffer* mbuf = msgpack_mbuffer_new(path.str().c_str(), MSGPACK_MBUFFER_EXTENT);
+	ASSERT_TRUE(mbuf != NULL);
+	msgpack_packer pk;
+	msgpack_packer_init(&pk, mbuf, msgpack_mbuffer_write);
+	for(int i=0; i < 100; ++i) {
+		msgpack_pack_int(&pk, i);
+	}
+	EXPECT_EQ(100u, msgpack_mbuffer_size(mbuf));
+	EXPECT_TRUE(msgpack_mbuffer_close(mbuf));
+	msgpack_mbuffer_free(mbuf);
+
+	std::string data = read_file(path.str().c_str());
+	EXPECT_EQ(100u, data.size());
+	msgpack::unpacker pac;
+	pac.reserve_buffer(data.size());
+	memcpy(pac.buffer(), data.data(), data.size());
+	pac.buffer_consumed(data.size());
+	msgpack::unpacked result;
+	int count = 0;
+	while(pac.next(&result)) {
+		EXPECT_EQ(count, result.get().as<int>());
+		++count;
+	}
+	EXPECT_EQ(100, count);
+	unlink(path.str().c_str());
+}
+
+TEST(buffer, mbuffer_empty_write)
+{
+	std::ostringstream path;
+	path << "/tmp/msgpack_mbuffer_test_empty." << getpid();
+
+	// nothing is mapped before the first write
+	msgpack_mbuffer mbuf;
+	ASSERT_TRUE(msgpack_mbuffer_init(&mbuf, path.str().c_str(), MSGPACK_MBUFFER_EXTENT));
+	EXPECT_EQ(0, msgpack_mbuffer_write(&mbuf, "", 0));
+	EXPECT_EQ(0, msgpack_mbuffer_write(&mbuf, "abc", 3));
+	EXPECT_EQ(0, msgpack_mbuffer_write(&mbuf, "", 0));
+	EXPECT_EQ(3u, msgpack_mbuffer_size(&mbuf));
+	EXPECT_TRUE(msgpack_mbuffer_close(&mbuf));
+	msgpack_mbuffer_destroy(&mbuf);
+
+	EXPECT_EQ("abc", read_file(path.str().c_str()));
+	unlink(path.str().c_str());
+}
+
@@ -0,0 +1,210 @@
+#include <msgpack.hpp>
+#include <msgpack/cbuffer.hpp>
+#include <msgpack/cunpacker.hpp>
+#include "messages.h"
+#include <gtest/gtest.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+static std::vector<const msgpack_codec*> codecs()
+{
+	std::vector<const msgpack_codec*> v;
+	v.push_back(msgpack_codec_deflate());
+#ifdef MSGPACK_USE_ZSTD
+	v.push_back(msgpack_codec_zstd());
+#endif
+#ifdef MSGPACK_USE_LZ4
+	v.push_back(msgpack_codec_lz4());
+#endif
+	return v;
+}
+
+TEST(codec, roundtrip)
+{
+	std::vector<const msgpack_codec*> v = codecs();
+	for(size_t i=0; i < v.size(); ++i) {
+		SCOPED_TRACE(v[i]->name);
+		msgpack::cbuffer cbuf(v[i]);
+		pack_messages(cbuf, 0, 1000);
+		cbuf.flush();
+
+		msgpack::cunpacker pac(v[i]);
+		EXPECT_EQ(1000, feed(pac, cbuf.data(), cbuf.size(), 7, 0));
+
+		msgpack::cunpacker pac2(v[i], 16);
+		EXPECT_EQ(1000, feed(pac2, cbuf.data(), cbuf.size(), cbuf.size(), 0));
+	}
+}
+
+TEST(codec, large)
+{
+	std::vector<const msgpack_codec*> v = codecs();
+	for(size_t i=0; i < v.size(); ++i) {
+		SCOPED_TRACE(v[i]->name);
+		msgpack::cbuffer cbuf(v[i], MSGPACK_CODEC_DEFAULT_LEVEL, 16);
+		pack_messages(cbuf, 0, 200000);
+		cbuf.flush();
+
+		// messages are returned before the whole stream is fed
+		msgpack::cunpacker pac(v[i]);
+		int count = feed(pac, cbuf.data(), cbuf.size() / 2, 4096, 0);
+		EXPECT_LT(0, count);
+		EXPECT_GT(200000, count);
+		EXPECT_EQ(200000, feed(pac, cbuf.data() + cbuf.size() / 2,
+					cbuf.size() - cbuf.size() / 2, 4096, count));
+	}
+}
+
+TEST(codec, frames)
+{
+	std::vector<const msgpack_codec*> v = codecs();
+	for(size_t i=0; i < v.size(); ++i) {
+		SCOPED_TRACE(v[i]->name);
+		msgpack::cbuffer cbuf(v[i]);
+		pack_messages(cbuf, 0, 10);
+		cbuf.flush();
+		std::string data(cbuf.data(), cbuf.size());
+		cbuf.reset();
+		pack_messages(cbuf, 10, 20);
+		cbuf.flush();
+		data.append(cbuf.data(), cbuf.size());
+
+		// reset() drops an unfinished frame
+		cbuf.reset();
+		pack_messages(cbuf, 100, 110);
+		cbuf.reset();
+		pack_messages(cbuf, 20, 30);
+		cbuf.flush();
+		data.append(cbuf.data(), cbuf.size());
+
+		msgpack::cunpacker pac(v[i]);
+		EXPECT_EQ(30, feed(pac, data.data(), data.size(), 5, 0));
+	}
+}
+
+TEST(codec, sync_flush)
+{
+	std::vector<const msgpack_codec*> v = codecs();
+	for(size_t i=0; i < v.size(); ++i) {
+		SCOPED_TRACE(v[i]->name);
+		msgpack::cbuffer cbuf(v[i]);
+		msgpack::cunpacker pac(v[i]);
+		size_t first = 0;
+		size_t last = 0;
+		for(int j=0; j < 100; ++j) {
+			// each message is decodable as soon as its flushed bytes arrive
+			pack_messages(cbuf, j, j+1);
+			cbuf.sync_flush();
+			last = cbuf.size();
+			if(j == 0) { first = last; }
+			EXPECT_EQ(j+1, feed(pac, cbuf.data(), cbuf.size(), cbuf.size(), j));
+			cbuf.reset_buffer();
+		}
+		EXPECT_LT(last, first);
+	}
+}
+
+TEST(codec, dictionary)
+{
+	msgpack::sbuffer sample;
+	{
+		msgpack::packer<msgpack::sbuffer> pk(sample);
+		for(int i=1000; i < 1010; ++i) {
+			pk.pack_array(3).pack(i);
+			pk.pack(std::string("a message which is repeated in every record"));
+			pk.pack(i);
+		}
+	}
+
+	std::vector<const msgpack_codec*> v = codecs();
+	for(size_t i=0; i < v.size(); ++i) {
+		SCOPED_TRACE(v[i]->name);
+		msgpack::cbuffer plain(v[i]);
+		pack_messages(plain, 0, 1);
+		plain.flush();
+
+		msgpack::cbuffer cbuf(v[i]);
+		if(v[i]->compressor_set_dictionary == NULL) {
+			EXPECT_THROW(cbuf.set_dictionary(sample.data(), sample.size()),
+					std::invalid_argument);
+			continue;
+		}
+		cbuf.set_dictionary(sample.data(), sample.size());
+		std::string data;
+		for(int j=0; j < 3; ++j) {
+			pack_messages(cbuf, j, j+1);
+			cbuf.flush();
+			EXPECT_GT(plain.size(), cbuf.size());
+			data.append(cbuf.data(), cbuf.size());
+			cbuf.reset();
+		}
+
+		msgpack::cunpacker pac(v[i]);
+		pac.set_dictionary(sample.data(), sample.size());
+		EXPECT_EQ(3, feed(pac, data.data(), data.size(), 3, 0));
+
+		msgpack::cunpacker nodict(v[i]);
+		EXPECT_THROW(feed(nodict, data.data(), data.size(), data.size(), 0),
+				msgpack::unpack_error);
+	}
+}
+
+TEST(codec, broken)
+{
+	std::vector<const msgpack_codec*> v = codecs();
+	for(size_t i=0; i < v.size(); ++i) {
+		SCOPED_TRACE(v[i]->name);
+		msgpack::cbuffer cbuf(v[i]);
+		pack_messages(cbuf, 0, 10);
+		cbuf.flush();
+		std::string data(cbuf.data(), cbuf.size());
+		data[0] ^= 0x55;
+
+		msgpack::cunpacker pac(v[i]);
+		EXPECT_THROW(feed(pac, data.data(), data.size(), data.size(), 0),
+				msgpack::unpack_error);
+	}
+}
+
+TEST(codec, c)
+{
+	std::vector<const msgpack_codec*> v = codecs();
+	for(size_t i=0; i < v.size(); ++i) {
+		SCOPED_TRACE(v[i]->name);
+		msgpack_cbuffer* cbuf = msgpack_cbuffer_new(v[i],
+				MSGPACK_CODEC_DEFAULT_LEVEL, MSGPACK_CBUFFER_INIT_SIZE);
+		ASSERT_TRUE(cbuf != NULL);
+		msgpack_packer pk;
+		msgpack_packer_init(&pk, cbuf, msgpack_cbuffer_write);
+		for(int j=0; j < 100; ++j) {
+			msgpack_pack_array(&pk, 1);
+			msgpack_pack_int(&pk, j);
+		}
+		ASSERT_TRUE(msgpack_cbuffer_flush(cbuf) != NULL);
+
+		msgpack_cunpacker* cpac = msgpack_cunpacker_new(v[i],
+				MSGPACK_CUNPACKER_INIT_BUFFER_SIZE);
+		ASSERT_TRUE(cpac != NULL);
+		ASSERT_TRUE(msgpack_cunpacker_reserve_buffer(cpac, msgpack_cbuffer_size(cbuf)));
+		memcpy(msgpack_cunpacker_buffer(cpac), msgpack_cbuffer_data(cbuf),
+				msgpack_cbuffer_size(cbuf));
+		msgpack_cunpacker_buffer_consumed(cpac, msgpack_cbuffer_size(cbuf));
+
+		msgpack_unpacked result;
+		msgpack_unpacked_init(&result);
+		int count = 0;
+		while(msgpack_cunpacker_next(cpac, &result)) {
+			EXPECT_EQ(MSGPACK_OBJECT_ARRAY, result.data.type);
+			EXPECT_EQ((uint64_t)count, result.data.via.array.ptr[0].via.u64);
+			++count;
+		}
+		EXPECT_EQ(100, count);
+		EXPECT_EQ(0, msgpack_cunpacker_execute(cpac));
+
+		msgpack_unpacked_destroy(&result);
+		msgpack_cunpacker_free(cpac);
+		msgpack_cbuffer_free(cbuf);
+	}
+}
+
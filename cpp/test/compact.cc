@@ -0,0 +1,81 @@
+#include <msgpack.hpp>
+#include <msgpack/compact.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <map>
+
+TEST(compact, size)
+{
+	EXPECT_EQ(16, sizeof(msgpack_compact_object));
+}
+
+TEST(compact, unpack)
+{
+	std::map<std::string, std::vector<int> > m;
+	m["id"].push_back(1);
+	m["id"].push_back(-2);
+	m["a long key which is not inline"].push_back(3);
+
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, m);
+
+	msgpack::compact c;
+	uint32_t root = c.unpack(sbuf.data(), sbuf.size());
+
+	msgpack::compact_object o = c.get(root);
+	EXPECT_EQ(msgpack::type::MAP, o.type());
+	EXPECT_EQ(2, o.size());
+
+	msgpack::compact_object k = o.key(0);
+	EXPECT_EQ(msgpack::type::RAW, k.type());
+	EXPECT_EQ(std::string("a long key which is not inline"), std::string(k.raw(), k.size()));
+	EXPECT_EQ(3, o.val(0)[0].u64());
+
+	EXPECT_EQ(std::string("id"), std::string(o.key(1).raw(), o.key(1).size()));
+	EXPECT_EQ(msgpack::type::NEGATIVE_INTEGER, o.val(1)[1].type());
+	EXPECT_EQ(-2, o.val(1)[1].i64());
+
+	msgpack::zone z;
+	std::map<std::string, std::vector<int> > m2 = o.as<std::map<std::string, std::vector<int> > >(&z);
+	EXPECT_TRUE(m == m2);
+}
+
+TEST(compact, append)
+{
+	std::vector<std::string> v;
+	for(int i=0; i < 100; ++i) {
+		v.push_back(std::string(i, 'x'));
+	}
+
+	msgpack::zone z;
+	msgpack::object obj(v, &z);
+
+	msgpack::compact c(16);
+	uint32_t root = c.append(obj);
+
+	msgpack::zone z2;
+	EXPECT_EQ(obj, c.get(root).get(&z2));
+}
+
+TEST(compact, multiple)
+{
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, 1);
+	msgpack::pack(sbuf, std::string("str"));
+	msgpack::pack(sbuf, 2.5);
+
+	msgpack::compact c;
+	size_t off = 0;
+	uint32_t r1 = c.unpack(sbuf.data(), sbuf.size(), &off);
+	uint32_t r2 = c.unpack(sbuf.data(), sbuf.size(), &off);
+	uint32_t r3 = c.unpack(sbuf.data(), sbuf.size(), &off);
+	EXPECT_EQ(sbuf.size(), off);
+
+	EXPECT_EQ(1, c.get(r1).u64());
+	EXPECT_EQ(std::string("str"), std::string(c.get(r2).raw(), c.get(r2).size()));
+	EXPECT_EQ(2.5, c.get(r3).dec());
+
+	EXPECT_THROW(c.unpack(sbuf.data()+1, 2), msgpack::unpack_error);
+	EXPECT_THROW(c.unpack("\xc1", 1), msgpack::unpack_error);
+}
@@ -1,5 +1,14 @@
 #include <msgpack.hpp>
 #include <gtest/gtest.h>
+#include <sstream>
+#include <msgpack/type/tr1/unordered_map.hpp>
+#if __cplusplus >= 201103L
+#include <msgpack/type/cpp11/unordered_map.hpp>
+#include <msgpack/type/cpp11/unordered_set.hpp>
+#endif
+#ifdef MSGPACK_USE_CPP17
+#include <msgpack/type/cpp17/string_view.hpp>
+#endif
 
 class compatibility {
 public:
@@ -72,3 +81,601 @@ TEST(convert, enum_member)
 	EXPECT_EQ(enum_member::B, to.flag);
 }
 
+
+
+class named_member {
+public:
+	named_member() : id(0), flag(enum_member::A), name("default") { }
+
+	int id;
+	enum_member::flags_t flag;
+	std::string name;
+	std::vector<int> values;
+
+	MSGPACK_DEFINE_MAP(id, (int&)flag, name, values);
+};
+
+TEST(convert, define_map)
+{
+	named_member src;
+	src.id = 3;
+	src.flag = enum_member::B;
+	src.name = "kumofs";
+	src.values.push_back(1);
+
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, src);
+
+	msgpack::unpacked msg;
+	msgpack::unpack(&msg, sbuf.data(), sbuf.size());
+	ASSERT_EQ(msgpack::type::MAP, msg.get().type);
+	EXPECT_EQ(4u, msg.get().via.map.size);
+
+	named_member to;
+	EXPECT_NO_THROW( msg.get().convert(&to) );
+	EXPECT_EQ(3, to.id);
+	EXPECT_EQ(enum_member::B, to.flag);
+	EXPECT_EQ("kumofs", to.name);
+	EXPECT_EQ(src.values, to.values);
+
+	named_member direct;
+	msgpack::decode(sbuf.data(), sbuf.size(), direct);
+	EXPECT_EQ(3, direct.id);
+	EXPECT_EQ(enum_member::B, direct.flag);
+	EXPECT_EQ("kumofs", direct.name);
+	EXPECT_EQ(src.values, direct.values);
+
+	msgpack::zone z;
+	msgpack::object obj(src, &z);
+	EXPECT_EQ(msg.get(), obj);
+}
+
+TEST(convert, define_map_unknown_keys)
+{
+	msgpack::sbuffer sbuf;
+	msgpack::packer<msgpack::sbuffer> pk(&sbuf);
+	pk.pack_map(4);
+	pk.pack(std::string("unknown"));
+	pk.pack(std::vector<int>(3, 1));
+	pk.pack(1);  // non-raw key
+	pk.pack(std::string("ignored"));
+	pk.pack(std::string("nam"));  // prefix of a name
+	pk.pack(1);
+	pk.pack(std::string("name"));
+	pk.pack(std::string("mpio"));
+
+	named_member direct;
+	msgpack::decode(sbuf.data(), sbuf.size(), direct);
+	EXPECT_EQ(0, direct.id);
+	EXPECT_EQ("mpio", direct.name);
+
+	msgpack::unpacked msg;
+	msgpack::unpack(&msg, sbuf.data(), sbuf.size());
+	named_member to;
+	msg.get().convert(&to);
+	EXPECT_EQ(0, to.id);
+	EXPECT_EQ("mpio", to.name);
+
+	// arrays are not accepted
+	msgpack::sbuffer array;
+	msgpack::pack(array, std::vector<int>(4, 0));
+	EXPECT_THROW(msgpack::decode(array.data(), array.size(), direct), msgpack::type_error);
+}
+
+TEST(convert, define_map_keys)
+{
+	msgpack::type::define_map_keys keys("a1, a2, a3, a11, a12, a13, b, ab, ba, (int&)_c9, x1y1, x1y2");
+	ASSERT_EQ(12u, keys.size());
+	EXPECT_EQ(std::string("_c9"), std::string(keys.name(9), keys.length(9)));
+
+	for(uint32_t i=0; i < keys.size(); ++i) {
+		EXPECT_EQ((int)i, keys.find(keys.name(i), keys.length(i)));
+	}
+	EXPECT_EQ(-1, keys.find("a", 1));
+	EXPECT_EQ(-1, keys.find("a4", 2));
+	EXPECT_EQ(-1, keys.find("", 0));
+	EXPECT_EQ(-1, keys.find("x1y1x", 5));
+
+	msgpack::type::define_map_keys one("only");
+	EXPECT_EQ(0, one.find("only", 4));
+	EXPECT_EQ(-1, one.find("onl", 3));
+}
+
+
+struct fixed_member {
+	bool b;
+	signed char c;
+	int i;
+	unsigned long long u;
+	double d;
+	MSGPACK_DEFINE(b, c, i, u, d);
+};
+
+struct fixed_wide {
+	int v[17];
+	MSGPACK_DEFINE(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8],
+			v[9], v[10], v[11], v[12], v[13], v[14], v[15], v[16]);
+};
+
+TEST(convert, define_fixed_size)
+{
+	typedef msgpack::type::define<const bool, const signed char, const int,
+			const unsigned long long, const double> fixed_define;
+	typedef msgpack::type::define<const int, const std::string> variable_define;
+	EXPECT_EQ(1u + 2 + 5 + 9 + 9 + 1, (size_t)fixed_define::fixed_size);
+	EXPECT_EQ(0u, (size_t)variable_define::fixed_size);
+
+	fixed_member src;
+	src.b = true;
+	src.c = -100;
+	src.i = 70000;
+	src.u = 1;
+	src.d = 0.5;
+
+	// same encoding as packing the members one by one
+	msgpack::sbuffer fused;
+	msgpack::pack(fused, src);
+	msgpack::sbuffer each;
+	msgpack::packer<msgpack::sbuffer> pk(&each);
+	pk.pack_array(5).pack(src.b).pack(src.c).pack(src.i).pack(src.u).pack(src.d);
+	ASSERT_EQ(each.size(), fused.size());
+	EXPECT_EQ(0, memcmp(each.data(), fused.data(), each.size()));
+
+	// through a buffer on the stack
+	std::ostringstream stream;
+	msgpack::pack(stream, src);
+	EXPECT_EQ(std::string(each.data(), each.size()), stream.str());
+
+	fixed_wide wide;
+	for(int i=0; i < 17; ++i) { wide.v[i] = -i * 1000; }
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, std::vector<fixed_wide>(2, wide));
+	std::vector<fixed_wide> to;
+	msgpack::decode(sbuf.data(), sbuf.size(), to);
+	ASSERT_EQ(2u, to.size());
+	EXPECT_EQ(-16000, to[1].v[16]);
+}
+
+TEST(convert, map_sorted_and_unsorted)
+{
+	msgpack::zone z;
+	std::map<int, std::string> src;
+	for(int i=0; i < 100; ++i) {
+		std::ostringstream s;
+		s << i;
+		src[i * 3] = s.str();
+	}
+
+	// keys in order
+	msgpack::object obj(src, &z);
+	std::map<int, std::string> to;
+	obj.convert(&to);
+	EXPECT_TRUE(src == to);
+
+	// keys out of order, with a duplicated key that wins over the former
+	std::swap(obj.via.map.ptr[10], obj.via.map.ptr[90]);
+	obj.via.map.ptr[50].key = obj.via.map.ptr[20].key;
+	to.clear();
+	obj.convert(&to);
+	EXPECT_EQ(99u, to.size());
+	EXPECT_EQ(src[270], to[270]);
+	EXPECT_EQ(src[150], to[60]);
+
+	// into a map which already has elements
+	std::map<int, std::string> merged;
+	merged[-1] = "a";
+	merged[0] = "b";
+	msgpack::object(src, &z).convert(&merged);
+	EXPECT_EQ(101u, merged.size());
+	EXPECT_EQ("a", merged[-1]);
+	EXPECT_EQ("0", merged[0]);
+}
+
+TEST(convert, map_merging_key)
+{
+	// std::set keys merge into the target when converted, so each key
+	// needs a fresh temporary
+	std::set<int> k2, k3;
+	k2.insert(2);
+	k3.insert(3);
+	std::map<std::set<int>, int> src;
+	src[k2] = 5;
+	src[k3] = 6;
+
+	msgpack::zone z;
+	std::map<std::set<int>, int> to;
+	to[k2] = 0;
+	msgpack::object(src, &z).convert(&to);
+	EXPECT_EQ(2u, to.size());
+	EXPECT_EQ(5, to[k2]);
+	EXPECT_EQ(6, to[k3]);
+}
+
+TEST(convert, map_failed_value)
+{
+	// a key whose value fails to convert is not left with a default value
+	msgpack::sbuffer sbuf;
+	msgpack::packer<msgpack::sbuffer> pk(sbuf);
+	pk.pack_map(3).pack(1).pack(11).pack(2).pack(std::string("x")).pack(3).pack(33);
+	msgpack::unpacked msg;
+	msgpack::unpack(&msg, sbuf.data(), sbuf.size());
+
+	std::map<int, int> empty;
+	EXPECT_THROW(msg.get().convert(&empty), msgpack::type_error);
+	EXPECT_EQ(1u, empty.size());
+	EXPECT_EQ(0u, empty.count(2));
+
+	std::map<int, int> to;
+	to[1] = 10;
+	to[3] = 30;
+	EXPECT_THROW(msg.get().convert(&to), msgpack::type_error);
+	EXPECT_EQ(2u, to.size());
+	EXPECT_EQ(0u, to.count(2));
+	EXPECT_EQ(30, to[3]);
+
+	std::multimap<int, int> mto;
+	mto.insert(std::make_pair(2, 20));
+	EXPECT_THROW(msg.get().convert(&mto), msgpack::type_error);
+	EXPECT_EQ(2u, mto.size());
+	EXPECT_EQ(1u, mto.count(2));
+	EXPECT_EQ(20, mto.find(2)->second);
+
+#if __cplusplus >= 201103L
+	std::unordered_multimap<int, int> umto;
+	umto.insert(std::make_pair(2, 20));
+	EXPECT_THROW(msg.get().convert(&umto), msgpack::type_error);
+	EXPECT_EQ(2u, umto.size());
+	EXPECT_EQ(1u, umto.count(2));
+	EXPECT_EQ(20, umto.find(2)->second);
+#endif
+}
+
+TEST(convert, multimap_order)
+{
+	msgpack::zone z;
+	std::multimap<int, int> src;
+	src.insert(std::make_pair(1, 10));
+	src.insert(std::make_pair(0, 0));
+	src.insert(std::make_pair(1, 11));
+	src.insert(std::make_pair(1, 12));
+
+	std::multimap<int, int> to;
+	msgpack::object(src, &z).convert(&to);
+	EXPECT_TRUE(src == to);
+
+	std::multiset<int> ssrc;
+	ssrc.insert(3);
+	ssrc.insert(1);
+	ssrc.insert(3);
+	std::multiset<int> sto;
+	msgpack::object(ssrc, &z).convert(&sto);
+	EXPECT_TRUE(ssrc == sto);
+
+	std::set<std::string> strs;
+	strs.insert("b");
+	strs.insert("a");
+	std::set<std::string> strs_to;
+	strs_to.insert("c");
+	msgpack::object(strs, &z).convert(&strs_to);
+	EXPECT_EQ(3u, strs_to.size());
+}
+
+#if __cplusplus >= 201103L
+TEST(convert, nested_container_elements)
+{
+	// std::set and std::map merge into the target when converted, so
+	// every element needs a fresh temporary
+	msgpack::zone z;
+	std::set<int> s1, s2;
+	s1.insert(1);
+	s2.insert(2);
+	std::vector<std::set<int> > sets;
+	sets.push_back(s1);
+	sets.push_back(s1);
+	sets.push_back(s2);
+	msgpack::object obj(sets, &z);
+
+	std::set<std::set<int> > set;
+	obj.convert(&set);
+	EXPECT_EQ(2u, set.size());
+	EXPECT_EQ(1u, set.count(s2));
+
+	std::multiset<std::set<int> > multiset;
+	obj.convert(&multiset);
+	EXPECT_EQ(2u, multiset.count(s1));
+	EXPECT_EQ(1u, multiset.count(s2));
+
+	std::multimap<std::set<int>, int> msrc;
+	msrc.insert(std::make_pair(s1, 1));
+	msrc.insert(std::make_pair(s2, 2));
+	std::multimap<std::set<int>, int> multimap;
+	msgpack::object(msrc, &z).convert(&multimap);
+	EXPECT_TRUE(msrc == multimap);
+
+	std::map<int, int> m1, m2;
+	m1[1] = 1;
+	m2[2] = 2;
+	std::multimap<int, std::map<int, int> > usrc;
+	usrc.insert(std::make_pair(1, m1));
+	usrc.insert(std::make_pair(2, m2));
+	std::tr1::unordered_multimap<int, std::map<int, int> > umap;
+	msgpack::object(usrc, &z).convert(&umap);
+	ASSERT_EQ(2u, umap.size());
+	EXPECT_TRUE(m2 == umap.find(2)->second);
+}
+
+TEST(convert, cpp11_unordered)
+{
+	typedef std::unordered_map<std::string, int> string_map;
+	msgpack::zone z;
+	string_map map;
+	std::unordered_multimap<int, std::string> mmap;
+	std::unordered_set<std::string> set;
+	std::unordered_multiset<int> mset;
+	for(int i=0; i < 100; ++i) {
+		std::ostringstream s;
+		s << i;
+		map[s.str()] = i;
+		mmap.insert(std::make_pair(i % 10, s.str()));
+		set.insert(s.str());
+		mset.insert(i % 10);
+	}
+
+	string_map map_to;
+	msgpack::object(map, &z).convert(&map_to);
+	EXPECT_TRUE(map == map_to);
+
+	std::unordered_multimap<int, std::string> mmap_to;
+	msgpack::object(mmap, &z).convert(&mmap_to);
+	EXPECT_TRUE(mmap == mmap_to);
+
+	std::unordered_set<std::string> set_to;
+	msgpack::object(set, &z).convert(&set_to);
+	EXPECT_TRUE(set == set_to);
+
+	std::unordered_multiset<int> mset_to;
+	msgpack::object(mset, &z).convert(&mset_to);
+	EXPECT_TRUE(mset == mset_to);
+
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, map);
+	msgpack::unpacked msg;
+	msgpack::unpack(&msg, sbuf.data(), sbuf.size());
+	EXPECT_TRUE(map == msg.get().as<string_map>());
+}
+#endif
+
+TEST(convert, flat_map)
+{
+	typedef msgpack::type::flat_map<int, std::string> int_map;
+	msgpack::zone z;
+	std::map<int, std::string> src;
+	for(int i=0; i < 100; ++i) {
+		std::ostringstream s;
+		s << i;
+		src[i * 3] = s.str();
+	}
+
+	// keys in order
+	msgpack::object obj(src, &z);
+	int_map to;
+	obj.convert(&to);
+	ASSERT_EQ(100u, to.size());
+	EXPECT_EQ(100u, to.capacity());
+	EXPECT_TRUE(int_map::sequence_type(src.begin(), src.end()) == to.sequence());
+	EXPECT_EQ("33", to.find(99)->second);
+	EXPECT_TRUE(to.find(100) == to.end());
+	EXPECT_EQ(102, to.lower_bound(100)->first);
+
+	// packed in order, as the same map
+	msgpack::sbuffer sbuf1;
+	msgpack::pack(sbuf1, src);
+	msgpack::sbuffer sbuf2;
+	msgpack::pack(sbuf2, to);
+	ASSERT_EQ(sbuf1.size(), sbuf2.size());
+	EXPECT_EQ(0, memcmp(sbuf1.data(), sbuf2.data(), sbuf1.size()));
+	EXPECT_TRUE(msgpack::object(to, &z) == obj);
+
+	int_map decoded;
+	msgpack::decode(sbuf2.data(), sbuf2.size(), decoded);
+	EXPECT_TRUE(to == decoded);
+
+	// keys out of order, with a duplicated key that wins over the former
+	std::swap(obj.via.map.ptr[10], obj.via.map.ptr[90]);
+	obj.via.map.ptr[50].key = obj.via.map.ptr[20].key;
+	int_map shuffled;
+	obj.convert(&shuffled);
+	EXPECT_EQ(99u, shuffled.size());
+	EXPECT_EQ("90", shuffled[270]);
+	EXPECT_EQ("50", shuffled[60]);
+	for(int_map::iterator it(shuffled.begin()); it+1 != shuffled.end(); ++it) {
+		EXPECT_LT(it->first, (it+1)->first);
+	}
+
+	// into a map which already has elements
+	int_map merged;
+	merged[0] = "b";
+	merged[-1] = "a";
+	EXPECT_EQ(-1, merged.begin()->first);
+	msgpack::object(src, &z).convert(&merged);
+	EXPECT_EQ(101u, merged.size());
+	EXPECT_EQ("a", merged[-1]);
+	EXPECT_EQ("0", merged[0]);
+	EXPECT_EQ(1u, merged.erase(0));
+	EXPECT_EQ(0u, merged.count(0));
+}
+
+TEST(convert, flat_set)
+{
+	typedef msgpack::type::flat_set<std::string> string_set;
+	msgpack::zone z;
+	std::set<std::string> src;
+	src.insert("c");
+	src.insert("a");
+	src.insert("b");
+
+	string_set to;
+	msgpack::object obj(src, &z);
+	obj.convert(&to);
+	EXPECT_EQ(3u, to.size());
+	EXPECT_TRUE(std::equal(src.begin(), src.end(), to.begin()));
+	EXPECT_EQ(1u, to.count("b"));
+	EXPECT_FALSE(to.insert("b").second);
+	EXPECT_TRUE(to.insert("d").second);
+
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, to);
+	string_set decoded;
+	msgpack::decode(sbuf.data(), sbuf.size(), decoded);
+	EXPECT_TRUE(to == decoded);
+
+	std::vector<std::string> unsorted;
+	unsorted.push_back("z");
+	unsorted.push_back("a");
+	unsorted.push_back("z");
+	unsorted.push_back("b");
+	msgpack::object(unsorted, &z).convert(&to);
+	EXPECT_EQ(5u, to.size());
+	EXPECT_EQ("a", *to.begin());
+	EXPECT_EQ("z", *(to.end()-1));
+}
+
+TEST(convert, flat_failed_conversion)
+{
+	// a failed conversion leaves the former elements in order
+	typedef msgpack::type::flat_map<int, int> int_map;
+	typedef msgpack::type::flat_set<int> int_set;
+	msgpack::sbuffer sbuf;
+	msgpack::packer<msgpack::sbuffer> pk(sbuf);
+	pk.pack_map(2).pack(3).pack(30).pack(2).pack(std::string("x"));
+	pk.pack_array(2).pack(3).pack(std::string("x"));
+	msgpack::unpacked map_msg;
+	size_t off = 0;
+	msgpack::unpack(&map_msg, sbuf.data(), sbuf.size(), &off);
+	const size_t set_off = off;
+	msgpack::unpacked set_msg;
+	msgpack::unpack(&set_msg, sbuf.data(), sbuf.size(), &off);
+
+	int_map m;
+	m[1] = 10;
+	m[5] = 50;
+	const int_map m_orig(m);
+	EXPECT_THROW(map_msg.get().convert(&m), msgpack::type_error);
+	EXPECT_TRUE(m_orig == m);
+	EXPECT_THROW(msgpack::decode(sbuf.data(), set_off, m), msgpack::type_error);
+	EXPECT_TRUE(m_orig == m);
+	EXPECT_EQ(50, m.find(5)->second);
+	EXPECT_TRUE(m.find(3) == m.end());
+
+	int_set st;
+	st.insert(1);
+	st.insert(5);
+	const int_set st_orig(st);
+	EXPECT_THROW(set_msg.get().convert(&st), msgpack::type_error);
+	EXPECT_TRUE(st_orig == st);
+	EXPECT_THROW(msgpack::decode(sbuf.data() + set_off, sbuf.size() - set_off, st),
+			msgpack::type_error);
+	EXPECT_TRUE(st_orig == st);
+	EXPECT_EQ(0u, st.count(0));
+}
+
+TEST(convert, raw_ref_key)
+{
+	typedef msgpack::type::raw_ref raw_ref;
+	msgpack::zone z;
+	std::map<std::string, int> src;
+	src["apple"] = 1;
+	src["banana"] = 2;
+	src["cherry"] = 3;
+	msgpack::object obj(src, &z);
+
+	std::map<raw_ref, int> ordered;
+	obj.convert(&ordered);
+	EXPECT_EQ(3u, ordered.size());
+	EXPECT_EQ(2, ordered[raw_ref("banana", 6)]);
+	// refers to the zone
+	EXPECT_EQ(obj.via.map.ptr[0].key.via.raw.ptr, ordered.find(raw_ref("apple", 5))->first.ptr);
+
+	const raw_ref a("abc", 3);
+	const raw_ref b("abd", 3);
+	EXPECT_TRUE(a < b);
+	EXPECT_TRUE(a != b);
+	EXPECT_TRUE(a <= a);
+	EXPECT_FALSE(a == b);
+
+	msgpack::type::raw_ref_less less;
+	EXPECT_TRUE(less(a, std::string("abd")));
+	EXPECT_TRUE(less("ab", b));
+	msgpack::type::raw_ref_hash hash;
+	EXPECT_EQ(hash(a), hash(std::string("abc")));
+	EXPECT_NE(hash(a), hash(b));
+
+	std::map<raw_ref, int, msgpack::type::raw_ref_less> transparent;
+	obj.convert(&transparent);
+#if __cplusplus >= 201402L
+	EXPECT_EQ(3, transparent.find(std::string("cherry"))->second);
+	EXPECT_TRUE(transparent.find("durian") == transparent.end());
+#endif
+
+#ifdef MSGPACK_USE_CPP11
+	std::unordered_map<raw_ref, int> unordered;
+	obj.convert(&unordered);
+	EXPECT_EQ(1, unordered[raw_ref("apple", 5)]);
+
+	std::unordered_set<raw_ref, msgpack::type::raw_ref_hash,
+		msgpack::type::raw_ref_equal_to> names;
+	msgpack::object(std::vector<std::string>(3, "x"), &z).convert(&names);
+	EXPECT_EQ(1u, names.size());
+#endif
+}
+
+#ifdef MSGPACK_USE_CPP17
+TEST(convert, string_view)
+{
+	typedef std::map<std::string_view, int> view_map;
+	std::vector<std::string> strs;
+	strs.push_back("first");
+	strs.push_back("second");
+
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, strs);
+	msgpack::unpacked msg;
+	msgpack::unpack(&msg, sbuf.data(), sbuf.size());
+	msgpack::object obj = msg.get();
+
+	std::vector<std::string_view> views;
+	obj.convert(&views);
+	ASSERT_EQ(2u, views.size());
+	EXPECT_EQ("second", views[1]);
+	EXPECT_EQ(obj.via.array.ptr[1].via.raw.ptr, views[1].data());
+
+	// decoded views refer to the data
+	std::vector<std::string_view> decoded;
+	msgpack::decode(sbuf.data(), sbuf.size(), decoded);
+	EXPECT_TRUE(sbuf.data() <= decoded[0].data() &&
+			decoded[0].data() < sbuf.data() + sbuf.size());
+
+	msgpack::sbuffer packed;
+	msgpack::pack(packed, views);
+	ASSERT_EQ(sbuf.size(), packed.size());
+	EXPECT_EQ(0, memcmp(sbuf.data(), packed.data(), sbuf.size()));
+
+	std::map<std::string, int> src;
+	src["a"] = 1;
+	src["bb"] = 2;
+	msgpack::zone z;
+	msgpack::object mobj(src, &z);
+	view_map m;
+	mobj.convert(&m);
+	EXPECT_EQ(2, m["bb"]);
+	// keys of a reused map are compared without conversion
+	m["a"] = 0;
+	mobj.convert(&m);
+	EXPECT_EQ(1, m["a"]);
+
+	std::string_view view("copied");
+	msgpack::object copied(view, &z);
+	EXPECT_NE(view.data(), copied.via.raw.ptr);
+	EXPECT_EQ("copied", copied.as<std::string_view>());
+}
+#endif
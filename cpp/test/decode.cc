@@ -0,0 +1,163 @@
+#include <msgpack.hpp>
+#include <gtest/gtest.h>
+
+struct inner {
+	int id;
+	std::string name;
+	MSGPACK_DEFINE(id, name);
+};
+
+struct outer {
+	outer() : flag(false), ratio(0) { }
+	bool flag;
+	double ratio;
+	std::vector<inner> items;
+	msgpack::type::tuple<int, std::string> pair;
+	std::map<std::string, int> attrs;  // no direct decoder
+	MSGPACK_DEFINE(flag, ratio, items, pair, attrs);
+};
+
+struct shorter {
+	shorter() : flag(true) { }
+	bool flag;
+	MSGPACK_DEFINE(flag);
+};
+
+struct longer {
+	longer() : flag(false), ratio(0), extra(7) { }
+	bool flag;
+	double ratio;
+	std::vector<inner> items;
+	msgpack::type::tuple<int, std::string> pair;
+	std::map<std::string, int> attrs;
+	int extra;
+	MSGPACK_DEFINE(flag, ratio, items, pair, attrs, extra);
+};
+
+
+TEST(decode, define)
+{
+	outer o1;
+	o1.flag = true;
+	o1.ratio = 0.25;
+	for(int i=0; i < 3; ++i) {
+		inner in;
+		in.id = -i * 1000;
+		in.name = std::string(i * 20, 'x');
+		o1.items.push_back(in);
+	}
+	o1.pair = msgpack::type::tuple<int, std::string>(70000, "abc");
+	o1.attrs["k"] = 1;
+
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, o1);
+
+	outer o2;
+	msgpack::decode(sbuf.data(), sbuf.size(), o2);
+	EXPECT_TRUE(o2.flag);
+	EXPECT_EQ(0.25, o2.ratio);
+	ASSERT_EQ(3u, o2.items.size());
+	EXPECT_EQ(-2000, o2.items[2].id);
+	EXPECT_EQ(std::string(40, 'x'), o2.items[2].name);
+	EXPECT_EQ(70000, o2.pair.get<0>());
+	EXPECT_EQ("abc", o2.pair.get<1>());
+	EXPECT_EQ(1, o2.attrs["k"]);
+
+	// fewer and more fields than the message
+	shorter s;
+	size_t off = 0;
+	msgpack::decode(sbuf.data(), sbuf.size(), s, &off);
+	EXPECT_TRUE(s.flag);
+	EXPECT_EQ(sbuf.size(), off);
+
+	longer l;
+	msgpack::decode(sbuf.data(), sbuf.size(), l);
+	EXPECT_EQ(0.25, l.ratio);
+	EXPECT_EQ(7, l.extra);
+}
+
+TEST(decode, compatible_with_convert)
+{
+	msgpack::sbuffer sbuf;
+	msgpack::packer<msgpack::sbuffer> pk(&sbuf);
+	pk.pack_array(3);
+	pk.pack_uint64(1);   // uint 64 encoding of a small number
+	pk.pack_int8(-1);
+	pk.pack_float(1.5f);
+
+	msgpack::type::tuple<unsigned char, short, double> t;
+	msgpack::decode(sbuf.data(), sbuf.size(), t);
+	EXPECT_EQ(1, t.get<0>());
+	EXPECT_EQ(-1, t.get<1>());
+	EXPECT_EQ(1.5, t.get<2>());
+
+	msgpack::type::tuple<unsigned char, unsigned short, double> u;
+	EXPECT_THROW(msgpack::decode(sbuf.data(), sbuf.size(), u), msgpack::type_error);
+
+	msgpack::type::tuple<int, int, int, int> too_many;
+	EXPECT_THROW(msgpack::decode(sbuf.data(), sbuf.size(), too_many), msgpack::type_error);
+
+	std::vector<signed char> v;
+	msgpack::sbuffer big;
+	msgpack::pack(big, std::vector<int>(1, 128));
+	EXPECT_THROW(msgpack::decode(big.data(), big.size(), v), msgpack::type_error);
+}
+
+TEST(decode, errors)
+{
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, std::string("hello"));
+
+	std::string s;
+	EXPECT_THROW(msgpack::decode(sbuf.data(), sbuf.size()-1, s), msgpack::unpack_error);
+
+	msgpack::pack(sbuf, 1);
+	EXPECT_THROW(msgpack::decode(sbuf.data(), sbuf.size(), s), msgpack::unpack_error);
+
+	// array 32 announcing more elements than the data
+	const char big[] = { (char)0xdd, (char)0xff, (char)0xff, (char)0xff, (char)0xff };
+	std::vector<int> v;
+	EXPECT_THROW(msgpack::decode(big, sizeof(big), v), msgpack::unpack_error);
+
+	const char reserved[] = { (char)0xc1 };
+	int i;
+	EXPECT_THROW(msgpack::decode(reserved, sizeof(reserved), i), msgpack::unpack_error);
+}
+
+
+struct member_named_d {
+	member_named_d() : d(0) { }
+	int d;
+	MSGPACK_DEFINE(d);
+};
+
+TEST(decode, member_named_d)
+{
+	member_named_d v1;
+	v1.d = 42;
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, v1);
+
+	member_named_d v2;
+	msgpack::decode(sbuf.data(), sbuf.size(), v2);
+	EXPECT_EQ(42, v2.d);
+}
+
+
+struct map_member_named_d {
+	map_member_named_d() : d(0) { }
+	int d;
+	MSGPACK_DEFINE_MAP(d);
+};
+
+TEST(decode, map_member_named_d)
+{
+	map_member_named_d v1;
+	v1.d = 42;
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, v1);
+
+	map_member_named_d v2;
+	msgpack::decode(sbuf.data(), sbuf.size(), v2);
+	EXPECT_EQ(42, v2.d);
+}
@@ -0,0 +1,275 @@
+#include <msgpack.hpp>
+#include <msgpack/json.hpp>
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <math.h>
+
+static std::string read_file(const char* path)
+{
+	std::ifstream fin(path, std::ios::binary);
+	std::ostringstream s;
+	s << fin.rdbuf();
+	return s.str();
+}
+
+static std::string to_json(const msgpack::sbuffer& sbuf)
+{
+	std::ostringstream s;
+	msgpack::to_json(s, sbuf.data(), sbuf.size());
+	return s.str();
+}
+
+static msgpack::object from_json(const std::string& json, msgpack::sbuffer* sbuf,
+		msgpack::unpacked* msg)
+{
+	msgpack::pack_json(*sbuf, json.data(), json.size());
+	msgpack::unpack(msg, sbuf->data(), sbuf->size());
+	return msg->get();
+}
+
+
+TEST(json, cases)
+{
+	std::string mpac = read_file("cases.mpac");
+	std::string json = read_file("cases.json");
+	while(!json.empty() && json[json.size()-1] == '\n') {
+		json.erase(json.size()-1);
+	}
+
+	// each object of cases.mpac is an element of cases.json
+	msgpack::sbuffer text;
+	text.write("[", 1);
+	size_t off = 0;
+	while(off < mpac.size()) {
+		if(off > 0) { text.write(",", 1); }
+		msgpack::to_json(text, mpac.data(), mpac.size(), &off);
+	}
+	text.write("]", 1);
+	EXPECT_EQ(json, std::string(text.data(), text.size()));
+
+	msgpack::sbuffer sbuf;
+	msgpack::unpacked msg;
+	msgpack::object array = from_json(json, &sbuf, &msg);
+	ASSERT_EQ(msgpack::type::ARRAY, array.type);
+
+	msgpack::unpacker pac;
+	pac.reserve_buffer(mpac.size());
+	memcpy(pac.buffer(), mpac.data(), mpac.size());
+	pac.buffer_consumed(mpac.size());
+	msgpack::unpacked result;
+	uint32_t i = 0;
+	while(pac.next(&result)) {
+		ASSERT_LT(i, array.via.array.size);
+		EXPECT_EQ(result.get(), array.via.array.ptr[i]);
+		++i;
+	}
+	EXPECT_EQ(array.via.array.size, i);
+}
+
+TEST(json, escape)
+{
+	std::string str("a\"b\\c\nd\x01" "e/f\x7f");
+	for(int i=0; i < 40; ++i) {
+		str += (char)('a' + i % 26);
+		str += (i % 7 == 0) ? '\t' : 'x';
+	}
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, str);
+	std::string json = to_json(sbuf);
+	EXPECT_EQ(0u, json.find("\"a\\\"b\\\\c\\nd\\u0001e/f\x7f" "a\\tbx"));
+
+	msgpack::sbuffer back;
+	msgpack::unpacked msg;
+	EXPECT_EQ(str, from_json(json, &back, &msg).as<std::string>());
+
+	// escapes which the writer doesn't produce
+	msgpack::sbuffer sbuf2;
+	msgpack::unpacked msg2;
+	EXPECT_EQ(std::string("/\b\f\r\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80\xef\xbf\xbd" "A"),
+			from_json("\"\\/\\b\\f\\r\\u00e9\\u20AC\\ud83d\\ude00\\ud800\\u0041\"",
+				&sbuf2, &msg2).as<std::string>());
+}
+
+TEST(json, numbers)
+{
+	msgpack::sbuffer sbuf;
+	msgpack::packer<msgpack::sbuffer> pk(&sbuf);
+	pk.pack_array(9);
+	pk.pack(INT64_MIN);
+	pk.pack(UINT64_MAX);
+	pk.pack(0.1);
+	pk.pack(1e300);
+	pk.pack(-2.5e-7);
+	pk.pack(0.1f);
+	pk.pack(1e20);
+	pk.pack(std::numeric_limits<double>::quiet_NaN());
+	pk.pack(-std::numeric_limits<double>::infinity());
+	EXPECT_EQ("[-9223372036854775808,18446744073709551615,0.1,1e+300,"
+			"-2.5e-07,0.1,1e+20,null,null]", to_json(sbuf));
+
+	msgpack::sbuffer back;
+	msgpack::unpacked msg;
+	msgpack::object o = from_json(
+			"[-9223372036854775808,18446744073709551615,18446744073709551616,"
+			"-9223372036854775809,0.1,-1E2,1e+300,0,-0]", &back, &msg);
+	ASSERT_EQ(9u, o.via.array.size);
+	EXPECT_EQ(INT64_MIN, o.via.array.ptr[0].as<int64_t>());
+	EXPECT_EQ(UINT64_MAX, o.via.array.ptr[1].as<uint64_t>());
+	EXPECT_EQ(18446744073709551616.0, o.via.array.ptr[2].as<double>());
+	EXPECT_EQ(-9223372036854775809.0, o.via.array.ptr[3].as<double>());
+	EXPECT_EQ(0.1, o.via.array.ptr[4].as<double>());
+	EXPECT_EQ(-100.0, o.via.array.ptr[5].as<double>());
+	EXPECT_EQ(1e300, o.via.array.ptr[6].as<double>());
+	EXPECT_EQ(msgpack::type::POSITIVE_INTEGER, o.via.array.ptr[7].type);
+	EXPECT_EQ(msgpack::type::POSITIVE_INTEGER, o.via.array.ptr[8].type);
+
+	// doubles and floats are parsed back to the same values
+	msgpack::sbuffer values;
+	msgpack::packer<msgpack::sbuffer> vpk(&values);
+	vpk.pack_array(5000);
+	for(int i=0; i < 1000; ++i) {
+		vpk.pack(i * 0.001);
+		vpk.pack(i / 7.0);
+		vpk.pack(1.0 / (i + 1) - 1e6);
+		vpk.pack((float)(i * 0.3));
+		vpk.pack((float)(1.0 / (i + 1)));
+	}
+	msgpack::sbuffer vback;
+	msgpack::unpacked vmsg;
+	msgpack::object vo = from_json(to_json(values), &vback, &vmsg);
+	msgpack::unpacked vorig;
+	msgpack::unpack(&vorig, values.data(), values.size());
+	ASSERT_EQ(5000u, vo.via.array.size);
+	for(uint32_t i=0; i < 5000; ++i) {
+		const double orig = vorig.get().via.array.ptr[i].as<double>();
+		if(i % 5 >= 3) {
+			EXPECT_EQ((float)orig, (float)vo.via.array.ptr[i].as<double>());
+		} else {
+			EXPECT_EQ(orig, vo.via.array.ptr[i].as<double>());
+		}
+	}
+}
+
+TEST(json, keys)
+{
+	msgpack::sbuffer sbuf;
+	msgpack::packer<msgpack::sbuffer> pk(&sbuf);
+	pk.pack_map(4);
+	pk.pack(1).pack(true);
+	pk.pack(std::string("k")).pack_nil();
+	pk.pack_nil().pack(-1);
+	pk.pack(0.5).pack_map(0);
+	EXPECT_EQ("{\"1\":true,\"k\":null,\"null\":-1,\"0.5\":{}}", to_json(sbuf));
+
+	msgpack::sbuffer bad;
+	msgpack::packer<msgpack::sbuffer> pk2(&bad);
+	pk2.pack_map(1);
+	pk2.pack_array(0).pack(1);
+	EXPECT_EQ(MSGPACK_UNPACK_PARSE_ERROR, msgpack_to_json(bad.data(), bad.size(),
+				NULL, &sbuf, msgpack_sbuffer_write));
+}
+
+TEST(json, nesting)
+{
+	std::string json;
+	for(int i=0; i < 100; ++i) { json += (i % 2) ? "{\"k\":" : "["; }
+	json += "[]";
+	for(int i=99; i >= 0; --i) { json += (i % 2) ? "}" : "]"; }
+
+	msgpack::sbuffer sbuf;
+	msgpack::pack_json(sbuf, json.data(), json.size());
+	EXPECT_EQ(json, to_json(sbuf));
+}
+
+TEST(json, partial)
+{
+	msgpack::sbuffer sbuf;
+	msgpack::packer<msgpack::sbuffer> pk(&sbuf);
+	pk.pack_array(2);
+	pk.pack(std::string("abc"));
+	pk.pack(1.5);
+	pk.pack(7);
+
+	// nothing is written from insufficient data
+	for(size_t len=0; len < sbuf.size() - 1; ++len) {
+		msgpack::sbuffer out;
+		EXPECT_EQ(MSGPACK_UNPACK_CONTINUE, msgpack_to_json(sbuf.data(), len,
+					NULL, &out, msgpack_sbuffer_write));
+		EXPECT_EQ(0u, out.size());
+	}
+
+	msgpack::sbuffer out;
+	size_t off = 0;
+	EXPECT_EQ(MSGPACK_UNPACK_EXTRA_BYTES, msgpack_to_json(sbuf.data(), sbuf.size(),
+				&off, &out, msgpack_sbuffer_write));
+	EXPECT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_to_json(sbuf.data(), sbuf.size(),
+				&off, &out, msgpack_sbuffer_write));
+	EXPECT_EQ("[\"abc\",1.5]7", std::string(out.data(), out.size()));
+	EXPECT_THROW(to_json(sbuf), msgpack::unpack_error);
+}
+
+TEST(json, parse_errors)
+{
+	const char* incomplete[] = {
+		"", " ", "[", "[1,", "{\"a\"", "{\"a\":", "\"ab", "\"\\u00", "tr", "-", "1.", "1e+",
+	};
+	const char* broken[] = {
+		"]", "[1,]", "[1 2]", "{1:2}", "{\"a\" 1}", "\"\x01\"", "\"\\x\"", "tru e",
+		"-a", "1.e1", "[}", "{\"a\":1]", "+1", "nul1",
+	};
+	msgpack::sbuffer sbuf;
+	msgpack_packer pk;
+	msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+	for(size_t i=0; i < sizeof(incomplete) / sizeof(incomplete[0]); ++i) {
+		EXPECT_EQ(MSGPACK_UNPACK_CONTINUE, msgpack_pack_json(&pk,
+					incomplete[i], strlen(incomplete[i]), NULL)) << incomplete[i];
+	}
+	for(size_t i=0; i < sizeof(broken) / sizeof(broken[0]); ++i) {
+		EXPECT_EQ(MSGPACK_UNPACK_PARSE_ERROR, msgpack_pack_json(&pk,
+					broken[i], strlen(broken[i]), NULL)) << broken[i];
+	}
+	// nothing is packed from invalid text
+	EXPECT_EQ(0u, sbuf.size());
+
+	// a stream of values
+	const char* stream = " 1 [true, false]\n{\"a\" : null}\t";
+	size_t off = 0;
+	EXPECT_EQ(MSGPACK_UNPACK_EXTRA_BYTES, msgpack_pack_json(&pk, stream, strlen(stream), &off));
+	EXPECT_EQ(MSGPACK_UNPACK_EXTRA_BYTES, msgpack_pack_json(&pk, stream, strlen(stream), &off));
+	EXPECT_EQ(MSGPACK_UNPACK_SUCCESS, msgpack_pack_json(&pk, stream, strlen(stream), &off));
+	EXPECT_EQ(strlen(stream), off);
+
+	std::ostringstream out;
+	off = 0;
+	while(off < sbuf.size()) {
+		msgpack::to_json(out, sbuf.data(), sbuf.size(), &off);
+	}
+	EXPECT_EQ("1[true,false]{\"a\":null}", out.str());
+}
+
+struct stream_error : std::runtime_error {
+	stream_error() : std::runtime_error("stream error") { }
+};
+
+template <typename E>
+struct failing_stream {
+	void write(const char* buf, size_t len) { throw E(); }
+};
+
+TEST(json, stream_errors)
+{
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, std::string("abc"));
+	const char* json = "[1,2]";
+
+	// the exception of the stream is thrown as it is
+	failing_stream<stream_error> s;
+	EXPECT_THROW(msgpack::to_json(s, sbuf.data(), sbuf.size()), stream_error);
+	EXPECT_THROW(msgpack::pack_json(s, json, strlen(json)), stream_error);
+
+	failing_stream<std::bad_alloc> nomem;
+	EXPECT_THROW(msgpack::to_json(nomem, sbuf.data(), sbuf.size()), std::bad_alloc);
+	EXPECT_THROW(msgpack::pack_json(nomem, json, strlen(json)), std::bad_alloc);
+}
@@ -0,0 +1,46 @@
+#ifndef MSGPACK_TEST_MESSAGES_H__
+#define MSGPACK_TEST_MESSAGES_H__
+
+#include <msgpack.hpp>
+#include <gtest/gtest.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+// records [i, "a message which is repeated in every record", i * 7919 % 65521]
+// which compress well, shared by the tests of compressing buffers
+
+template <typename Buffer>
+static void pack_messages(Buffer& buf, int begin, int end)
+{
+	msgpack::packer<Buffer> pk(buf);
+	for(int i=begin; i < end; ++i) {
+		pk.pack_array(3);
+		pk.pack(i);
+		pk.pack(std::string("a message which is repeated in every record"));
+		pk.pack(i * 7919 % 65521);
+	}
+}
+
+// feeds the data in chunks and checks the records from expected;
+// returns the index of the next record
+template <typename Unpacker>
+static int feed(Unpacker& pac, const char* data, size_t size,
+		size_t chunk, int expected)
+{
+	msgpack::unpacked result;
+	for(size_t off=0; off < size; off += chunk) {
+		size_t n = std::min(chunk, size - off);
+		pac.reserve_buffer(n);
+		memcpy(pac.buffer(), data + off, n);
+		pac.buffer_consumed(n);
+		while(pac.next(&result)) {
+			EXPECT_EQ(expected, result.get().via.array.ptr[0].as<int>());
+			EXPECT_EQ(expected * 7919 % 65521, result.get().via.array.ptr[2].as<int>());
+			++expected;
+		}
+	}
+	return expected;
+}
+
+#endif /* messages.h */
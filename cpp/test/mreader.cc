@@ -0,0 +1,197 @@
+#include <msgpack.hpp>
+#include <msgpack/mbuffer.hpp>
+#include <msgpack/mreader.hpp>
+#include <gtest/gtest.h>
+#include <string.h>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+class mreader_test : public testing::Test {
+protected:
+	virtual void SetUp()
+	{
+		std::ostringstream s;
+		s << "/tmp/msgpack_mreader_test." << getpid();
+		path = s.str();
+	}
+
+	virtual void TearDown()
+	{
+		unlink(path.c_str());
+	}
+
+	// messages [i, "value-i" * (i % 7)] and a large raw every 1000
+	void write_messages(int count)
+	{
+		msgpack::mbuffer mbuf(path.c_str());
+		msgpack::packer<msgpack::mbuffer> pk(mbuf);
+		for(int i=0; i < count; ++i) {
+			pk.pack_array(2);
+			pk.pack(i);
+			if(i % 1000 == 999) {
+				pk.pack(std::string(20000, 'a' + i % 26));
+			} else {
+				pk.pack(value(i));
+			}
+		}
+		mbuf.close();
+	}
+
+	static std::string value(int i)
+	{
+		std::ostringstream s;
+		for(int j=0; j < i % 7; ++j) { s << "value-" << i; }
+		return s.str();
+	}
+
+	static void check(const msgpack::object& obj, int i)
+	{
+		ASSERT_EQ(msgpack::type::ARRAY, obj.type);
+		EXPECT_EQ(i, obj.via.array.ptr[0].as<int>());
+		std::string v = obj.via.array.ptr[1].as<std::string>();
+		if(i % 1000 == 999) {
+			EXPECT_EQ(std::string(20000, 'a' + i % 26), v);
+		} else {
+			EXPECT_EQ(value(i), v);
+		}
+	}
+
+	void write_file(const std::string& data)
+	{
+		msgpack::mbuffer mbuf(path.c_str());
+		mbuf.write(data.data(), data.size());
+		mbuf.close();
+	}
+
+	std::string path;
+};
+
+TEST_F(mreader_test, windows)
+{
+	write_messages(10000);
+
+	// small windows make messages straddle them
+	static const size_t windows[] = { 1, 4096 * 3, MSGPACK_MREADER_WINDOW_SIZE };
+	for(size_t w=0; w < sizeof(windows) / sizeof(windows[0]); ++w) {
+		msgpack::mreader reader(path.c_str(), windows[w], 8192);
+		msgpack::unpacked result;
+		int count = 0;
+		while(reader.next(&result)) {
+			check(result.get(), count);
+			++count;
+		}
+		EXPECT_EQ(10000, count);
+		EXPECT_FALSE(reader.next(&result));
+	}
+}
+
+TEST_F(mreader_test, large_message)
+{
+	// a message much larger than the window
+	std::string large(1024*1024, 'l');
+	{
+		msgpack::mbuffer mbuf(path.c_str());
+		msgpack::pack(mbuf, 1);
+		msgpack::pack(mbuf, large);
+		msgpack::pack(mbuf, 2);
+	}
+	msgpack::mreader reader(path.c_str(), 4096, 0);
+	msgpack::unpacked result;
+	ASSERT_TRUE(reader.next(&result));
+	EXPECT_EQ(1, result.get().as<int>());
+	ASSERT_TRUE(reader.next(&result));
+	EXPECT_TRUE(large == result.get().as<std::string>());
+	ASSERT_TRUE(reader.next(&result));
+	EXPECT_EQ(2, result.get().as<int>());
+	EXPECT_FALSE(reader.next(&result));
+}
+
+TEST_F(mreader_test, zones_keep_windows)
+{
+	write_messages(3000);
+
+	// raw objects refer to the mapping after the reader is gone
+	std::vector<msgpack_unpacked> kept;
+	{
+		msgpack_mreader* mr = msgpack_mreader_new(path.c_str(), 4096, 4096);
+		ASSERT_TRUE(mr != NULL);
+		msgpack_unpacked result;
+		msgpack_unpacked_init(&result);
+		for(int i=0; msgpack_mreader_next(mr, &result); ++i) {
+			if(i % 500 == 499) {
+				kept.push_back(result);
+				msgpack_unpacked_init(&result);
+			}
+		}
+		EXPECT_EQ(msgpack_mreader_offset(mr), mr->file_size);
+		msgpack_unpacked_destroy(&result);
+		msgpack_mreader_free(mr);
+	}
+
+	ASSERT_EQ(6u, kept.size());
+	for(size_t i=0; i < kept.size(); ++i) {
+		check(msgpack::object(kept[i].data), 499 + i * 500);
+		msgpack_unpacked_destroy(&kept[i]);
+	}
+}
+
+TEST_F(mreader_test, shared_zone)
+{
+	write_messages(3000);
+
+	// messages crossing a window must not discard the earlier objects
+	msgpack_mreader* mr = msgpack_mreader_new(path.c_str(), 4096, 4096);
+	ASSERT_TRUE(mr != NULL);
+	msgpack_zone z;
+	msgpack_zone_init(&z, 2048);
+	std::vector<msgpack_object> objs;
+	msgpack_object obj;
+	int ret;
+	while((ret = msgpack_mreader_execute(mr, &z, &obj)) > 0) {
+		objs.push_back(obj);
+	}
+	EXPECT_EQ(0, ret);
+	msgpack_mreader_free(mr);
+
+	ASSERT_EQ(3000u, objs.size());
+	for(size_t i=0; i < objs.size(); ++i) {
+		check(msgpack::object(objs[i]), i);
+	}
+	msgpack_zone_destroy(&z);
+}
+
+TEST_F(mreader_test, broken)
+{
+	write_messages(10);
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, std::string(100, 'x'));
+
+	// truncated at the end of the file
+	write_file(std::string(sbuf.data(), sbuf.size() - 1));
+	{
+		msgpack::mreader reader(path.c_str());
+		msgpack::unpacked result;
+		EXPECT_THROW(reader.next(&result), msgpack::unpack_error);
+	}
+
+	// 0xc1 is not a type
+	write_file(std::string(sbuf.data(), sbuf.size()) + "\xc1");
+	{
+		msgpack::mreader reader(path.c_str());
+		msgpack::unpacked result;
+		EXPECT_TRUE(reader.next(&result));
+		EXPECT_THROW(reader.next(&result), msgpack::unpack_error);
+	}
+
+	write_file(std::string());
+	{
+		msgpack::mreader reader(path.c_str());
+		msgpack::unpacked result;
+		EXPECT_FALSE(reader.next(&result));
+	}
+
+	EXPECT_THROW(msgpack::mreader("/nonexistent/file"), std::runtime_error);
+}
+
@@ -1,5 +1,9 @@
 #include <msgpack.hpp>
+#include <msgpack/map_index.hpp>
+#include <msgpack/hash.h>
 #include <gtest/gtest.h>
+#include <sstream>
+#include <stdio.h>
 
 struct myclass {
 	myclass() : num(0), str("default") { }
@@ -132,3 +136,251 @@ TEST(object, construct_primitive)
 	EXPECT_EQ(true, obj_bool.via.boolean);
 }
 
+
+
+TEST(object, map_index)
+{
+	std::map<std::string, int> m;
+	for(int i=0; i < 1000; ++i) {
+		char buf[16];
+		snprintf(buf, sizeof(buf), "key%d", i);
+		m[buf] = i;
+	}
+
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, m);
+
+	msgpack::zone z;
+	msgpack::object obj;
+	msgpack::unpack_return ret =
+		msgpack::unpack(sbuf.data(), sbuf.size(), NULL, &z, &obj);
+	EXPECT_EQ(ret, msgpack::UNPACK_SUCCESS);
+
+	msgpack::map_index idx(obj, &z);
+	EXPECT_EQ(1000u, idx.size());
+
+	const msgpack::object* v = idx.find("key123", 6);
+	ASSERT_TRUE(v != NULL);
+	EXPECT_EQ(123, v->as<int>());
+
+	v = idx.find(std::string("key999"));
+	ASSERT_TRUE(v != NULL);
+	EXPECT_EQ(999, v->as<int>());
+
+	EXPECT_TRUE(idx.find("key1000", 7) == NULL);
+	EXPECT_TRUE(idx.find(1) == NULL);
+}
+
+
+TEST(object, map_index_mixed)
+{
+	msgpack::sbuffer sbuf;
+	msgpack::packer<msgpack::sbuffer> pk(&sbuf);
+	pk.pack_map(5);
+	pk.pack(1);         pk.pack(std::string("one"));
+	pk.pack(-1);        pk.pack(std::string("minus one"));
+	pk.pack(std::string("1")); pk.pack(std::string("string one"));
+	pk.pack_nil();      pk.pack(std::string("nil"));
+	pk.pack(1);         pk.pack(std::string("duplicated"));
+
+	msgpack::zone z;
+	msgpack::object obj;
+	msgpack::unpack_return ret =
+		msgpack::unpack(sbuf.data(), sbuf.size(), NULL, &z, &obj);
+	EXPECT_EQ(ret, msgpack::UNPACK_SUCCESS);
+
+	msgpack::map_index idx(obj, &z);
+	EXPECT_EQ("one", idx.find(1)->as<std::string>());
+	EXPECT_EQ("one", idx.find(1u)->as<std::string>());
+	EXPECT_EQ("minus one", idx.find(-1)->as<std::string>());
+	EXPECT_EQ("string one", idx.find("1", 1)->as<std::string>());
+	EXPECT_EQ("nil", idx.find(msgpack::object())->as<std::string>());
+	EXPECT_TRUE(idx.find(2) == NULL);
+
+	EXPECT_THROW(msgpack::map_index(msgpack::object(1), &z), msgpack::type_error);
+}
+
+
+TEST(object, hash)
+{
+	msgpack::zone z;
+
+	// integers of any width and their objects hash the same
+	msgpack::object u8(1), u64((uint64_t)1), i8((signed char)1);
+	EXPECT_EQ(msgpack_object_hash(u8), msgpack_object_hash(u64));
+	EXPECT_EQ(msgpack_object_hash(u8), msgpack_object_hash(i8));
+	EXPECT_NE(msgpack_object_hash(msgpack::object(1)), msgpack_object_hash(msgpack::object(2)));
+	EXPECT_NE(msgpack_object_hash(msgpack::object(1)), msgpack_object_hash(msgpack::object(-1)));
+	EXPECT_EQ(msgpack_object_hash(msgpack::object(0.0)), msgpack_object_hash(msgpack::object(-0.0)));
+
+	std::string s1("abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz");
+	std::string s2(s1);
+	EXPECT_EQ(msgpack_object_hash(msgpack::object(s1)), msgpack_object_hash(msgpack::object(s2)));
+	s2[40] = 'X';
+	EXPECT_NE(msgpack_object_hash(msgpack::object(s1)), msgpack_object_hash(msgpack::object(s2)));
+
+	std::vector<int> v1; v1.push_back(1); v1.push_back(2);
+	std::vector<int> v2; v2.push_back(2); v2.push_back(1);
+	EXPECT_NE(msgpack_object_hash(msgpack::object(v1, &z)), msgpack_object_hash(msgpack::object(v2, &z)));
+}
+
+
+TEST(object, hash_encoded)
+{
+	std::map<std::string, std::vector<double> > m;
+	m["a"].push_back(1.5);
+	m["bcdefghijklmnopqrstu"].push_back(-2.0);
+	m["bcdefghijklmnopqrstu"].push_back(0.0);
+
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, m);
+	msgpack::pack(sbuf, -3);
+
+	msgpack::zone z;
+	msgpack::object obj;
+	size_t off = 0;
+	EXPECT_EQ(msgpack::UNPACK_EXTRA_BYTES,
+			msgpack::unpack(sbuf.data(), sbuf.size(), &off, &z, &obj));
+
+	uint64_t h;
+	size_t hoff = 0;
+	EXPECT_EQ(MSGPACK_UNPACK_EXTRA_BYTES,
+			msgpack_hash_encoded(sbuf.data(), sbuf.size(), &hoff, &h));
+	EXPECT_EQ(off, hoff);
+	EXPECT_EQ(msgpack_object_hash(obj), h);
+
+	EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+			msgpack_hash_encoded(sbuf.data(), sbuf.size(), &hoff, &h));
+	EXPECT_EQ(msgpack_object_hash(msgpack::object(-3)), h);
+
+	// wider encodings of the same values
+	const char wide[] = {
+		(char)0x92,                                  // array 2
+		(char)0xcd, 0x00, 0x01,                      // uint16 1
+		(char)0xca, 0x3f, (char)0xc0, 0x00, 0x00 };  // float 1.5
+	std::pair<int, double> p(1, 1.5);
+	EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+			msgpack_hash_encoded(wide, sizeof(wide), NULL, &h));
+	EXPECT_EQ(msgpack_object_hash(msgpack::object(p, &z)), h);
+
+	EXPECT_EQ(MSGPACK_UNPACK_CONTINUE,
+			msgpack_hash_encoded(wide, sizeof(wide)-1, NULL, &h));
+}
+
+
+TEST(object, print_nested)
+{
+	std::map<std::string, std::vector<int> > m;
+	m["a"];
+	m["b"].push_back(1);
+	m["b"].push_back(2);
+	msgpack::zone z;
+	msgpack::object* v = (msgpack::object*)z.malloc(sizeof(msgpack::object) * 3);
+	v[0] = msgpack::object(m, &z);
+	v[1] = msgpack::object(std::vector<int>(), &z);
+	v[2] = msgpack::object(-3);
+	msgpack::object obj;
+	obj.type = msgpack::type::ARRAY;
+	obj.via.array.size = 3;
+	obj.via.array.ptr = v;
+
+	const char expected[] = "[{\"a\"=>[], \"b\"=>[1, 2]}, [], -3]";
+	std::ostringstream s;
+	s << obj;
+	EXPECT_EQ(expected, s.str());
+
+	FILE* f = tmpfile();
+	ASSERT_TRUE(f != NULL);
+	msgpack_object_print(f, obj);
+	rewind(f);
+	char buf[sizeof(expected)+1] = {};
+	EXPECT_EQ(sizeof(expected)-1, fread(buf, 1, sizeof(buf), f));
+	EXPECT_STREQ(expected, buf);
+	fclose(f);
+}
+
+
+// alternately arrays and maps nested depth times, built from the leaf
+// up since the unpacker limits the depth
+static msgpack::object nested_object(msgpack::zone* z, size_t depth, msgpack::object leaf)
+{
+	msgpack::object o = leaf;
+	for(size_t i=depth; i > 0; --i) {
+		if(i % 2 == 1) {
+			msgpack::object* a = (msgpack::object*)z->malloc(sizeof(msgpack::object));
+			*a = o;
+			o.type = msgpack::type::ARRAY;
+			o.via.array.size = 1;
+			o.via.array.ptr = a;
+		} else {
+			msgpack::object_kv* kv = (msgpack::object_kv*)z->malloc(sizeof(msgpack::object_kv));
+			kv->key = msgpack::object(i);
+			kv->val = o;
+			o.type = msgpack::type::MAP;
+			o.via.map.size = 1;
+			o.via.map.ptr = kv;
+		}
+	}
+	return o;
+}
+
+TEST(object, deep_nesting)
+{
+	const size_t depth = 100000;
+	msgpack::zone z;
+	msgpack::object obj = nested_object(&z, depth, msgpack::object(true));
+
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, obj);
+	msgpack::sbuffer cbuf;
+	msgpack_packer pk;
+	msgpack_packer_init(&pk, &cbuf, msgpack_sbuffer_write);
+	EXPECT_EQ(0, msgpack_pack_object(&pk, obj));
+	ASSERT_EQ(sbuf.size(), cbuf.size());
+	EXPECT_EQ(0, memcmp(sbuf.data(), cbuf.data(), sbuf.size()));
+	EXPECT_EQ((char)0x91, sbuf.data()[0]);
+	EXPECT_EQ((char)0x81, sbuf.data()[1]);
+	EXPECT_EQ((char)0x02, sbuf.data()[2]);
+	EXPECT_EQ((char)0xc3, sbuf.data()[sbuf.size()-1]);
+
+	std::ostringstream s;
+	s << obj;
+	const std::string str = s.str();
+	EXPECT_EQ("[{2=>[{4=>[", str.substr(0, 11));
+	std::string tail("true");
+	for(size_t i=0; i < depth; i += 2) { tail += "}]"; }
+	EXPECT_EQ(tail, str.substr(str.size() - tail.size()));
+
+	EXPECT_TRUE(obj == nested_object(&z, depth, msgpack::object(true)));
+	EXPECT_FALSE(obj == nested_object(&z, depth, msgpack::object(false)));
+	EXPECT_FALSE(obj == nested_object(&z, depth-1, msgpack::object(true)));
+}
+
+
+TEST(object, wide_map)
+{
+	std::map<std::string, std::vector<int> > m;
+	for(int i=0; i < 10000; ++i) {
+		std::ostringstream key;
+		key << "key" << i;
+		m[key.str()].push_back(i);
+		m[key.str()].push_back(-i);
+	}
+
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, m);
+	msgpack::zone z;
+	msgpack::object obj;
+	EXPECT_EQ(msgpack::UNPACK_SUCCESS,
+			msgpack::unpack(sbuf.data(), sbuf.size(), NULL, &z, &obj));
+
+	msgpack::sbuffer sbuf2;
+	msgpack::pack(sbuf2, obj);
+	ASSERT_EQ(sbuf.size(), sbuf2.size());
+	EXPECT_EQ(0, memcmp(sbuf.data(), sbuf2.data(), sbuf.size()));
+
+	msgpack::object copy(m, &z);
+	EXPECT_TRUE(obj == copy);
+	copy.via.map.ptr[9999].val.via.array.ptr[1] = msgpack::object(1);
+	EXPECT_FALSE(obj == copy);
+}
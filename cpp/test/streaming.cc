@@ -1,6 +1,7 @@
 #include <msgpack.hpp>
 #include <gtest/gtest.h>
 #include <sstream>
+#include <algorithm>
 
 TEST(streaming, basic)
 {
@@ -218,3 +219,217 @@ TEST(streaming, event_compat)
 	handler.on_read();
 }
 
+
+
+TEST(streaming, limit)
+{
+	msgpack::unpacker pac;
+	pac.set_limit(msgpack::unpack_limit(16, 4, 4, 1024, 2));
+
+	msgpack::unpacked result;
+
+	// raw 32 header announcing 4 GB: rejected before the body arrives
+	const char big_raw[] = { (char)0xdb, (char)0xff, (char)0xff, (char)0xff, (char)0xff };
+	pac.reserve_buffer(sizeof(big_raw));
+	memcpy(pac.buffer(), big_raw, sizeof(big_raw));
+	pac.buffer_consumed(sizeof(big_raw));
+	EXPECT_THROW(pac.next(&result), msgpack::unpack_error);
+}
+
+TEST(streaming, limit_container)
+{
+	msgpack::unpack_limit limit(0, 4, 4, 0, 2);
+	msgpack::unpacked result;
+
+	{
+		// array 32 header announcing 2^32-1 elements
+		msgpack::unpacker pac;
+		pac.set_limit(limit);
+		const char big_array[] = { (char)0xdd, (char)0xff, (char)0xff, (char)0xff, (char)0xff };
+		memcpy(pac.buffer(), big_array, sizeof(big_array));
+		pac.buffer_consumed(sizeof(big_array));
+		EXPECT_THROW(pac.next(&result), msgpack::unpack_error);
+	}
+
+	{
+		// too deep
+		msgpack::unpacker pac;
+		pac.set_limit(limit);
+		const char deep[] = { (char)0x91, (char)0x91, (char)0x91, (char)0x01 };
+		memcpy(pac.buffer(), deep, sizeof(deep));
+		pac.buffer_consumed(sizeof(deep));
+		EXPECT_THROW(pac.next(&result), msgpack::unpack_error);
+	}
+
+	{
+		// within the limits
+		msgpack::unpacker pac;
+		pac.set_limit(limit);
+		const char ok[] = { (char)0x91, (char)0x84,
+			0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08 };
+		memcpy(pac.buffer(), ok, sizeof(ok));
+		pac.buffer_consumed(sizeof(ok));
+		EXPECT_TRUE(pac.next(&result));
+		EXPECT_EQ(msgpack::type::ARRAY, result.get().type);
+		EXPECT_EQ(4, result.get().via.array.ptr[0].via.map.size);
+	}
+}
+
+TEST(streaming, limit_bytes)
+{
+	msgpack::sbuffer sbuf;
+	msgpack::packer<msgpack::sbuffer> pk(&sbuf);
+	std::vector<int> v(8, 1);
+	pk.pack(v);           // 9 bytes
+	v.push_back(1 << 20);
+	pk.pack(v);           // 15 bytes
+
+	msgpack::unpacker pac;
+	pac.set_limit(msgpack::unpack_limit(0, 0, 0, 12));
+	memcpy(pac.buffer(), sbuf.data(), sbuf.size());
+	pac.buffer_consumed(sbuf.size());
+
+	msgpack::unpacked result;
+	EXPECT_TRUE(pac.next(&result));
+	EXPECT_EQ(8, result.get().via.array.size);
+	EXPECT_THROW(pac.next(&result), msgpack::unpack_error);
+}
+
+TEST(streaming, intern)
+{
+	msgpack::sbuffer sbuf;
+	for(int i=0; i < 3; ++i) {
+		std::map<std::string, int> m;
+		m["id"] = i;
+		m["user"] = i * 10;
+		msgpack::pack(sbuf, m);
+	}
+
+	msgpack::unpacker pac;
+	pac.set_intern(16);
+	memcpy(pac.buffer(), sbuf.data(), sbuf.size());
+	pac.buffer_consumed(sbuf.size());
+
+	msgpack::unpacked r1, r2;
+	EXPECT_TRUE(pac.next(&r1));
+	EXPECT_TRUE(pac.next(&r2));
+
+	msgpack::object_kv* k1 = r1.get().via.map.ptr;
+	msgpack::object_kv* k2 = r2.get().via.map.ptr;
+	EXPECT_EQ(k1[0].key.via.raw.ptr, k2[0].key.via.raw.ptr);
+	EXPECT_EQ(k1[1].key.via.raw.ptr, k2[1].key.via.raw.ptr);
+	EXPECT_NE(k1[0].key.via.raw.ptr, k1[1].key.via.raw.ptr);
+
+	std::map<std::string, int> m;
+	r1.get().convert(&m);
+	r2.get().convert(&m);
+	EXPECT_EQ(2u, m.size());
+	EXPECT_EQ(1, m["id"]);
+	EXPECT_EQ(10, m["user"]);
+
+	EXPECT_TRUE(pac.next(&r1));
+	EXPECT_EQ(k2[0].key.via.raw.ptr, r1.get().via.map.ptr[0].key.via.raw.ptr);
+	EXPECT_FALSE(pac.next(&r1));
+}
+
+TEST(streaming, intern_evict)
+{
+	msgpack::sbuffer sbuf;
+	msgpack::packer<msgpack::sbuffer> pk(&sbuf);
+	pk.pack_map(3);
+	pk.pack(std::string("a")); pk.pack(1);
+	pk.pack(std::string("b")); pk.pack(2);
+	pk.pack(std::string("c")); pk.pack(3);
+	pk.pack_map(1);
+	pk.pack(std::string("a")); pk.pack(4);
+
+	msgpack::unpacker pac;
+	pac.set_intern(2);
+	memcpy(pac.buffer(), sbuf.data(), sbuf.size());
+	pac.buffer_consumed(sbuf.size());
+
+	msgpack::unpacked r1, r2;
+	EXPECT_TRUE(pac.next(&r1));
+	EXPECT_TRUE(pac.next(&r2));
+
+	// the dictionary was cleared by "c", but keys of r1 are still alive
+	std::map<std::string, int> m;
+	r1.get().convert(&m);
+	EXPECT_EQ(1, m["a"]);
+	EXPECT_EQ(2, m["b"]);
+	EXPECT_EQ(3, m["c"]);
+	EXPECT_EQ("a", r2.get().via.map.ptr[0].key.as<std::string>());
+	EXPECT_NE(r1.get().via.map.ptr[0].key.via.raw.ptr,
+			r2.get().via.map.ptr[0].key.via.raw.ptr);
+
+	// long keys are not interned
+	pac.set_intern(16, 1);
+	const char m2[] = { (char)0x81, (char)0xa2, 'a', 'b', 0x01 };
+	memcpy(pac.buffer(), m2, sizeof(m2));
+	pac.buffer_consumed(sizeof(m2));
+	EXPECT_TRUE(pac.next(&r1));
+	EXPECT_EQ(pac.nonparsed_buffer() - 3, r1.get().via.map.ptr[0].key.via.raw.ptr);
+}
+
+TEST(streaming, ring)
+{
+	// strings of 0..3000 bytes, so messages wrap around a 4KB ring
+	msgpack::sbuffer sbuf;
+	msgpack::packer<msgpack::sbuffer> pk(&sbuf);
+	for(int i=0; i < 200; ++i) {
+		pk.pack_array(2);
+		pk.pack(i);
+		pk.pack(std::string(i * 15, 'a' + i % 26));
+	}
+
+	msgpack::ring_unpacker pac(4096);
+	const char* const base = pac.buffer();
+	const char* input = sbuf.data();
+	const char* const eof = input + sbuf.size();
+
+	msgpack::unpacked result;
+	int count = 0;
+	while(input < eof) {
+		pac.reserve_buffer(1000);
+
+		// the buffer stays in the double mapping of the ring
+		EXPECT_LE(base, pac.buffer());
+		EXPECT_LE(pac.buffer() + pac.buffer_capacity(), base + 4096 * 2);
+
+		size_t len = std::min((size_t)(eof - input), pac.buffer_capacity());
+		memcpy(pac.buffer(), input, len);
+		input += len;
+		pac.buffer_consumed(len);
+
+		while(pac.next(&result)) {
+			msgpack::object obj = result.get();
+			EXPECT_EQ(count, obj.via.array.ptr[0].as<int>());
+			EXPECT_EQ(std::string(count * 15, 'a' + count % 26),
+					obj.via.array.ptr[1].as<std::string>());
+			++count;
+		}
+	}
+	EXPECT_EQ(200, count);
+}
+
+TEST(streaming, ring_too_large)
+{
+	msgpack::sbuffer sbuf;
+	msgpack::packer<msgpack::sbuffer> pk(&sbuf);
+	pk.pack(std::string(10000, 'a'));
+
+	msgpack::ring_unpacker pac(4096);
+	msgpack::unpacked result;
+	size_t off = 0;
+	EXPECT_THROW({
+		while(off < sbuf.size()) {
+			pac.reserve_buffer();
+			size_t len = std::min(sbuf.size() - off, pac.buffer_capacity());
+			memcpy(pac.buffer(), sbuf.data() + off, len);
+			off += len;
+			pac.buffer_consumed(len);
+			EXPECT_FALSE(pac.next(&result));
+		}
+	}, msgpack::unpack_error);
+	EXPECT_EQ(4096u, off);
+}
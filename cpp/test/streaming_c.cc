@@ -55,3 +55,125 @@ TEST(streaming, basic)
 	}
 }
 
+
+
+
+TEST(streaming, limit)
+{
+	msgpack_unpack_limit limit;
+	memset(&limit, 0, sizeof(limit));
+	limit.map = 1024;
+
+	/* map 16 header announcing 4096 pairs */
+	const char map16[] = { (char)0xde, (char)0x10, (char)0x00 };
+
+	msgpack_unpacker pac;
+	msgpack_unpacker_init(&pac, MSGPACK_UNPACKER_INIT_BUFFER_SIZE);
+	msgpack_unpacker_set_limit(&pac, &limit);
+
+	memcpy(msgpack_unpacker_buffer(&pac), map16, sizeof(map16));
+	msgpack_unpacker_buffer_consumed(&pac, sizeof(map16));
+	EXPECT_EQ(-1, msgpack_unpacker_execute(&pac));
+
+	msgpack_unpacker_destroy(&pac);
+
+	/* removes the limit */
+	msgpack_unpacker_init(&pac, MSGPACK_UNPACKER_INIT_BUFFER_SIZE);
+	msgpack_unpacker_set_limit(&pac, &limit);
+	msgpack_unpacker_set_limit(&pac, NULL);
+
+	memcpy(msgpack_unpacker_buffer(&pac), map16, sizeof(map16));
+	msgpack_unpacker_buffer_consumed(&pac, sizeof(map16));
+	EXPECT_EQ(0, msgpack_unpacker_execute(&pac));
+
+	msgpack_unpacker_destroy(&pac);
+}
+
+
+TEST(streaming, intern)
+{
+	msgpack_sbuffer* buffer = msgpack_sbuffer_new();
+	msgpack_packer* pk = msgpack_packer_new(buffer, msgpack_sbuffer_write);
+	for(int i=0; i < 2; ++i) {
+		msgpack_pack_map(pk, 1);
+		msgpack_pack_raw(pk, 2);
+		msgpack_pack_raw_body(pk, "id", 2);
+		msgpack_pack_int(pk, i);
+	}
+
+	msgpack_unpacker pac;
+	msgpack_unpacker_init(&pac, MSGPACK_UNPACKER_INIT_BUFFER_SIZE);
+	EXPECT_TRUE(msgpack_unpacker_set_intern(&pac, 16, 32));
+
+	memcpy(msgpack_unpacker_buffer(&pac), buffer->data, buffer->size);
+	msgpack_unpacker_buffer_consumed(&pac, buffer->size);
+
+	msgpack_unpacked r1, r2;
+	msgpack_unpacked_init(&r1);
+	msgpack_unpacked_init(&r2);
+	EXPECT_TRUE(msgpack_unpacker_next(&pac, &r1));
+	EXPECT_TRUE(msgpack_unpacker_next(&pac, &r2));
+
+	/* destroying the unpacker doesn't free keys referred by messages */
+	msgpack_unpacker_destroy(&pac);
+
+	EXPECT_EQ(r1.data.via.map.ptr[0].key.via.raw.ptr,
+			r2.data.via.map.ptr[0].key.via.raw.ptr);
+	EXPECT_EQ(0, memcmp("id", r2.data.via.map.ptr[0].key.via.raw.ptr, 2));
+	EXPECT_EQ(1u, r2.data.via.map.ptr[0].val.via.u64);
+
+	msgpack_unpacked_destroy(&r1);
+	msgpack_unpacked_destroy(&r2);
+	msgpack_packer_free(pk);
+	msgpack_sbuffer_free(buffer);
+}
+
+
+TEST(streaming, ring)
+{
+	msgpack_sbuffer* buffer = msgpack_sbuffer_new();
+	msgpack_packer* pk = msgpack_packer_new(buffer, msgpack_sbuffer_write);
+	char body[3000];
+	memset(body, 'x', sizeof(body));
+	for(int i=0; i < 100; ++i) {
+		msgpack_pack_raw(pk, i * 30);
+		msgpack_pack_raw_body(pk, body, i * 30);
+	}
+
+	msgpack_unpacker pac;
+	EXPECT_TRUE(msgpack_unpacker_init_ring(&pac, 4096));
+
+	/* a full ring can't be reserved before messages are parsed */
+	EXPECT_FALSE(msgpack_unpacker_reserve_buffer(&pac, 4097));
+
+	size_t off = 0;
+	int count = 0;
+	while(off < buffer->size) {
+		EXPECT_TRUE(msgpack_unpacker_reserve_buffer(&pac, 1));
+		size_t len = buffer->size - off;
+		if(len > msgpack_unpacker_buffer_capacity(&pac)) {
+			len = msgpack_unpacker_buffer_capacity(&pac);
+		}
+		memcpy(msgpack_unpacker_buffer(&pac), buffer->data + off, len);
+		off += len;
+		msgpack_unpacker_buffer_consumed(&pac, len);
+
+		/* one zone is reused for all messages */
+		int ret;
+		while((ret = msgpack_unpacker_execute(&pac)) > 0) {
+			msgpack_object obj = msgpack_unpacker_data(&pac);
+			EXPECT_EQ(MSGPACK_OBJECT_RAW, obj.type);
+			EXPECT_EQ((uint32_t)count * 30, obj.via.raw.size);
+			EXPECT_EQ(0, memcmp(body, obj.via.raw.ptr, obj.via.raw.size));
+			++count;
+			msgpack_unpacker_reset_zone(&pac);
+			msgpack_unpacker_reset(&pac);
+		}
+		EXPECT_EQ(0, ret);
+	}
+	EXPECT_EQ(100, count);
+
+	msgpack_unpacker_destroy(&pac);
+	msgpack_packer_free(pk);
+	msgpack_sbuffer_free(buffer);
+}
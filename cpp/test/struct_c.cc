@@ -0,0 +1,244 @@
+#include <msgpack.h>
+#include <gtest/gtest.h>
+#include <string.h>
+
+typedef struct {
+	int16_t x;
+	int16_t y;
+} point;
+
+typedef struct {
+	bool active;
+	int id;
+	uint8_t level;
+	uint64_t counter;
+	float ratio;
+	double score;
+	msgpack_object_raw name;
+	point pos;
+} user;
+
+static const msgpack_struct_field point_fields[] = {
+	MSGPACK_STRUCT_FIELD(point, x, MSGPACK_FIELD_INT16),
+	MSGPACK_STRUCT_FIELD(point, y, MSGPACK_FIELD_INT16),
+};
+
+static const msgpack_struct_desc point_desc =
+	MSGPACK_STRUCT_DESC(point_fields, MSGPACK_STRUCT_ARRAY);
+
+static const msgpack_struct_field user_fields[] = {
+	MSGPACK_STRUCT_FIELD(user, active, MSGPACK_FIELD_BOOL),
+	MSGPACK_STRUCT_FIELD(user, id, MSGPACK_FIELD_INT),
+	MSGPACK_STRUCT_FIELD(user, level, MSGPACK_FIELD_UINT8),
+	MSGPACK_STRUCT_FIELD(user, counter, MSGPACK_FIELD_UINT64),
+	MSGPACK_STRUCT_FIELD(user, ratio, MSGPACK_FIELD_FLOAT),
+	MSGPACK_STRUCT_FIELD(user, score, MSGPACK_FIELD_DOUBLE),
+	MSGPACK_STRUCT_FIELD(user, name, MSGPACK_FIELD_RAW),
+	MSGPACK_STRUCT_NESTED(user, pos, &point_desc),
+};
+
+static const msgpack_struct_desc user_array_desc =
+	MSGPACK_STRUCT_DESC(user_fields, MSGPACK_STRUCT_ARRAY);
+
+static const msgpack_struct_desc user_map_desc =
+	MSGPACK_STRUCT_DESC(user_fields, MSGPACK_STRUCT_MAP);
+
+static user make_user()
+{
+	user u;
+	memset(&u, 0, sizeof(u));
+	u.active = true;
+	u.id = -70000;
+	u.level = 200;
+	u.counter = 0xffffffffffffULL;
+	u.ratio = 0.5f;
+	u.score = -1.25;
+	u.name.ptr = "kumofs";
+	u.name.size = 6;
+	u.pos.x = 3;
+	u.pos.y = -4;
+	return u;
+}
+
+static void expect_user(const user& u)
+{
+	EXPECT_TRUE(u.active);
+	EXPECT_EQ(-70000, u.id);
+	EXPECT_EQ(200, u.level);
+	EXPECT_EQ(0xffffffffffffULL, u.counter);
+	EXPECT_EQ(0.5f, u.ratio);
+	EXPECT_EQ(-1.25, u.score);
+	EXPECT_EQ(std::string("kumofs"), std::string(u.name.ptr, u.name.size));
+	EXPECT_EQ(3, u.pos.x);
+	EXPECT_EQ(-4, u.pos.y);
+}
+
+
+TEST(struct, array)
+{
+	user src = make_user();
+
+	msgpack_sbuffer sbuf;
+	msgpack_sbuffer_init(&sbuf);
+	msgpack_packer pk;
+	msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+	EXPECT_EQ(0, msgpack_struct_pack(&pk, &user_array_desc, &src));
+
+	// same as packing the fields one by one
+	msgpack_zone z;
+	msgpack_zone_init(&z, 2048);
+	msgpack_object obj;
+	EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+			msgpack_unpack(sbuf.data, sbuf.size, NULL, &z, &obj));
+	ASSERT_EQ(MSGPACK_OBJECT_ARRAY, obj.type);
+	ASSERT_EQ(8u, obj.via.array.size);
+	EXPECT_EQ(MSGPACK_OBJECT_BOOLEAN, obj.via.array.ptr[0].type);
+	EXPECT_EQ(-70000, obj.via.array.ptr[1].via.i64);
+	EXPECT_EQ(MSGPACK_OBJECT_ARRAY, obj.via.array.ptr[7].type);
+	msgpack_zone_destroy(&z);
+
+	user dst;
+	memset(&dst, 0, sizeof(dst));
+	size_t off = 0;
+	EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+			msgpack_struct_unpack(&user_array_desc, sbuf.data, sbuf.size, &off, &dst));
+	EXPECT_EQ(sbuf.size, off);
+	expect_user(dst);
+
+	// raw fields refer to the data
+	EXPECT_TRUE(sbuf.data <= dst.name.ptr && dst.name.ptr < sbuf.data + sbuf.size);
+
+	// insufficient data
+	for(size_t len=0; len < sbuf.size; ++len) {
+		off = 0;
+		EXPECT_EQ(MSGPACK_UNPACK_CONTINUE,
+				msgpack_struct_unpack(&user_array_desc, sbuf.data, len, &off, &dst));
+	}
+
+	msgpack_sbuffer_destroy(&sbuf);
+}
+
+TEST(struct, map)
+{
+	user src = make_user();
+
+	msgpack_sbuffer sbuf;
+	msgpack_sbuffer_init(&sbuf);
+	msgpack_packer pk;
+	msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+	EXPECT_EQ(0, msgpack_struct_pack(&pk, &user_map_desc, &src));
+	EXPECT_EQ(0, msgpack_struct_pack(&pk, &user_map_desc, &src));
+
+	user dst;
+	memset(&dst, 0, sizeof(dst));
+	size_t off = 0;
+	EXPECT_EQ(MSGPACK_UNPACK_EXTRA_BYTES,
+			msgpack_struct_unpack(&user_map_desc, sbuf.data, sbuf.size, &off, &dst));
+	expect_user(dst);
+	memset(&dst, 0, sizeof(dst));
+	EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+			msgpack_struct_unpack(&user_map_desc, sbuf.data, sbuf.size, &off, &dst));
+	expect_user(dst);
+
+	msgpack_sbuffer_destroy(&sbuf);
+}
+
+TEST(struct, unknown_and_missing)
+{
+	msgpack_sbuffer sbuf;
+	msgpack_sbuffer_init(&sbuf);
+	msgpack_packer pk;
+	msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+
+	// map with keys out of order, an unknown key and a non-raw key
+	msgpack_pack_map(&pk, 4);
+	msgpack_pack_raw(&pk, 2);
+	msgpack_pack_raw_body(&pk, "id", 2);
+	msgpack_pack_int(&pk, 5);
+	msgpack_pack_raw(&pk, 7);
+	msgpack_pack_raw_body(&pk, "unknown", 7);
+	msgpack_pack_array(&pk, 2);
+	msgpack_pack_nil(&pk);
+	msgpack_pack_map(&pk, 1);
+	msgpack_pack_int(&pk, 1);
+	msgpack_pack_double(&pk, 1.0);
+	msgpack_pack_int(&pk, 1);
+	msgpack_pack_true(&pk);
+	msgpack_pack_raw(&pk, 5);
+	msgpack_pack_raw_body(&pk, "level", 5);
+	msgpack_pack_uint8(&pk, 7);
+
+	user dst = make_user();
+	EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+			msgpack_struct_unpack(&user_map_desc, sbuf.data, sbuf.size, NULL, &dst));
+	EXPECT_EQ(5, dst.id);
+	EXPECT_EQ(7, dst.level);
+	EXPECT_EQ(-1.25, dst.score);
+
+	// shorter and longer arrays
+	msgpack_sbuffer_clear(&sbuf);
+	msgpack_pack_array(&pk, 1);
+	msgpack_pack_false(&pk);
+	dst = make_user();
+	EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+			msgpack_struct_unpack(&user_array_desc, sbuf.data, sbuf.size, NULL, &dst));
+	EXPECT_FALSE(dst.active);
+	EXPECT_EQ(-70000, dst.id);
+
+	msgpack_sbuffer_clear(&sbuf);
+	msgpack_pack_array(&pk, 3);
+	msgpack_pack_int(&pk, 1);
+	msgpack_pack_int(&pk, 2);
+	msgpack_pack_raw(&pk, 1);
+	msgpack_pack_raw_body(&pk, "z", 1);
+	point p = { 0, 0 };
+	EXPECT_EQ(MSGPACK_UNPACK_SUCCESS,
+			msgpack_struct_unpack(&point_desc, sbuf.data, sbuf.size, NULL, &p));
+	EXPECT_EQ(1, p.x);
+	EXPECT_EQ(2, p.y);
+
+	msgpack_sbuffer_destroy(&sbuf);
+}
+
+TEST(struct, type_mismatch)
+{
+	msgpack_sbuffer sbuf;
+	msgpack_sbuffer_init(&sbuf);
+	msgpack_packer pk;
+	msgpack_packer_init(&pk, &sbuf, msgpack_sbuffer_write);
+
+	point p = { 0, 0 };
+
+	// out of range of int16_t
+	msgpack_pack_array(&pk, 2);
+	msgpack_pack_int(&pk, 1);
+	msgpack_pack_int(&pk, 40000);
+	EXPECT_EQ(MSGPACK_UNPACK_PARSE_ERROR,
+			msgpack_struct_unpack(&point_desc, sbuf.data, sbuf.size, NULL, &p));
+
+	msgpack_sbuffer_clear(&sbuf);
+	msgpack_pack_array(&pk, 2);
+	msgpack_pack_int(&pk, 1);
+	msgpack_pack_double(&pk, 1.0);
+	EXPECT_EQ(MSGPACK_UNPACK_PARSE_ERROR,
+			msgpack_struct_unpack(&point_desc, sbuf.data, sbuf.size, NULL, &p));
+
+	// negative numbers into unsigned fields
+	msgpack_sbuffer_clear(&sbuf);
+	msgpack_pack_array(&pk, 3);
+	msgpack_pack_true(&pk);
+	msgpack_pack_int(&pk, 1);
+	msgpack_pack_int(&pk, -1);
+	user u = make_user();
+	EXPECT_EQ(MSGPACK_UNPACK_PARSE_ERROR,
+			msgpack_struct_unpack(&user_array_desc, sbuf.data, sbuf.size, NULL, &u));
+
+	// a map for an array
+	msgpack_sbuffer_clear(&sbuf);
+	msgpack_pack_map(&pk, 0);
+	EXPECT_EQ(MSGPACK_UNPACK_PARSE_ERROR,
+			msgpack_struct_unpack(&point_desc, sbuf.data, sbuf.size, NULL, &p));
+
+	msgpack_sbuffer_destroy(&sbuf);
+}
+
@@ -0,0 +1,97 @@
+#include <msgpack.hpp>
+#include <msgpack/visitor.hpp>
+#include <gtest/gtest.h>
+#include <sstream>
+
+// writes events as a text
+struct print_visitor : msgpack::null_visitor {
+	void visit_nil() { s << "nil "; }
+	void visit_boolean(bool v) { s << (v ? "true " : "false "); }
+	void visit_uint(uint64_t v) { s << v << ' '; }
+	void visit_int(int64_t v) { s << v << ' '; }
+	void visit_double(double v) { s << v << ' '; }
+	void visit_raw(const char* p, uint32_t l) { s << '"' << std::string(p, l) << "\" "; }
+	void start_array(uint32_t n) { s << "[" << n << ' '; }
+	void end_array() { s << "] "; }
+	void start_map(uint32_t n) { s << "{" << n << ' '; }
+	void end_map() { s << "} "; }
+	std::ostringstream s;
+};
+
+struct sum_visitor : msgpack::null_visitor {
+	sum_visitor() : sum(0) { }
+	void visit_uint(uint64_t v) { sum += v; }
+	uint64_t sum;
+};
+
+
+TEST(visitor, events)
+{
+	msgpack::sbuffer sbuf;
+	msgpack::packer<msgpack::sbuffer> pk(&sbuf);
+	pk.pack_map(2);
+	pk.pack(std::string("a"));
+	pk.pack_array(3);
+	pk.pack(1);
+	pk.pack(-2);
+	pk.pack_array(0);
+	pk.pack(std::string("b"));
+	pk.pack_map(1);
+	pk.pack_nil();
+	pk.pack(true);
+
+	print_visitor v;
+	EXPECT_EQ(msgpack::UNPACK_SUCCESS,
+			msgpack::visit(sbuf.data(), sbuf.size(), NULL, v));
+	EXPECT_EQ("{2 \"a\" [3 1 -2 [0 ] ] \"b\" {1 nil true } } ", v.s.str());
+}
+
+TEST(visitor, offset)
+{
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, 1);
+	msgpack::pack(sbuf, 2.5);
+
+	print_visitor v;
+	size_t off = 0;
+	EXPECT_EQ(msgpack::UNPACK_EXTRA_BYTES,
+			msgpack::visit(sbuf.data(), sbuf.size(), &off, v));
+	EXPECT_EQ(msgpack::UNPACK_SUCCESS,
+			msgpack::visit(sbuf.data(), sbuf.size(), &off, v));
+	EXPECT_EQ("1 2.5 ", v.s.str());
+	EXPECT_EQ(sbuf.size(), off);
+
+	off = 0;
+	EXPECT_EQ(msgpack::UNPACK_CONTINUE,
+			msgpack::visit(sbuf.data()+1, 1, &off, v));
+
+	const char invalid[] = { (char)0xc1 };
+	EXPECT_THROW(msgpack::visit(invalid, sizeof(invalid), NULL, v),
+			msgpack::unpack_error);
+}
+
+TEST(visitor, streaming)
+{
+	msgpack::sbuffer sbuf;
+	for(int i=0; i < 10; ++i) {
+		std::vector<int> v(i, i);
+		msgpack::pack(sbuf, v);
+	}
+
+	msgpack::visit_unpacker pac;
+	sum_visitor v;
+	int count = 0;
+
+	// feed one byte at a time
+	for(size_t i=0; i < sbuf.size(); ++i) {
+		pac.reserve_buffer(1);
+		pac.buffer()[0] = sbuf.data()[i];
+		pac.buffer_consumed(1);
+		while(pac.next(v)) {
+			++count;
+		}
+	}
+
+	EXPECT_EQ(10, count);
+	EXPECT_EQ(285u, v.sum);  // sum of i*i
+}
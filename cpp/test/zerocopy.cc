@@ -0,0 +1,212 @@
+#include <msgpack.hpp>
+#include <msgpack/zerocopy.hpp>
+#include <gtest/gtest.h>
+#include <string.h>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static void pack_response(msgpack::vrefbuffer& vbuf, std::string& expected,
+		const std::string& body)
+{
+	msgpack::sbuffer sbuf;
+	for(int i=0; i < 4; ++i) {
+		msgpack::packer<msgpack::vrefbuffer> pk(vbuf);
+		pk.pack_map(2);
+		pk.pack(std::string("id")).pack(i);
+		pk.pack(std::string("body")).pack(body);
+
+		msgpack::packer<msgpack::sbuffer> spk(sbuf);
+		spk.pack_map(2);
+		spk.pack(std::string("id")).pack(i);
+		spk.pack(std::string("body")).pack(body);
+	}
+	expected.assign(sbuf.data(), sbuf.size());
+}
+
+static void set_nonblock(int fd)
+{
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+// sends vbuf while reading the other end
+static std::string transfer(msgpack::zerocopy& zc, msgpack::vrefbuffer& vbuf, int in)
+{
+	std::string received;
+	char buf[64*1024];
+	while(vbuf.vector_size() > 0) {
+		zc.send(vbuf);
+		ssize_t r;
+		while((r = read(in, buf, sizeof(buf))) > 0) {
+			received.append(buf, r);
+		}
+	}
+	ssize_t r;
+	while((r = read(in, buf, sizeof(buf))) > 0) {
+		received.append(buf, r);
+	}
+	return received;
+}
+
+TEST(zerocopy, tcp)
+{
+	int lsock = socket(AF_INET, SOCK_STREAM, 0);
+	ASSERT_LE(0, lsock);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t len = sizeof(addr);
+	ASSERT_EQ(0, bind(lsock, (struct sockaddr*)&addr, sizeof(addr)));
+	ASSERT_EQ(0, listen(lsock, 1));
+	ASSERT_EQ(0, getsockname(lsock, (struct sockaddr*)&addr, &len));
+
+	int out = socket(AF_INET, SOCK_STREAM, 0);
+	ASSERT_EQ(0, connect(out, (struct sockaddr*)&addr, sizeof(addr)));
+	int in = accept(lsock, NULL, NULL);
+	ASSERT_LE(0, in);
+	set_nonblock(out);
+	set_nonblock(in);
+
+	msgpack::zerocopy zc(out);
+	std::string body(1024*1024, 'b');
+	msgpack::vrefbuffer vbuf;
+	std::string expected;
+	pack_response(vbuf, expected, body);
+
+	EXPECT_TRUE(expected == transfer(zc, vbuf, in));
+	uint64_t ticket = zc.ticket();
+	if(zc.mode == MSGPACK_ZEROCOPY_SOCKET) {
+		EXPECT_LT(0u, ticket);
+	}
+	EXPECT_TRUE(zc.wait(ticket, 5000));
+	EXPECT_TRUE(zc.released(ticket));
+
+	close(in);
+	close(out);
+	close(lsock);
+}
+
+TEST(zerocopy, pipe)
+{
+	int fds[2];
+	ASSERT_EQ(0, pipe(fds));
+	set_nonblock(fds[0]);
+	set_nonblock(fds[1]);
+
+	msgpack::zerocopy zc(fds[1]);
+	EXPECT_EQ(MSGPACK_ZEROCOPY_PIPE, zc.mode);
+
+	// the body stays referenced by the pipe until it is read
+	std::string body(32*1024, 'p');
+	msgpack::vrefbuffer vbuf;
+	msgpack::packer<msgpack::vrefbuffer>(vbuf).pack(body);
+	EXPECT_LT(0, zc.send(vbuf));
+	EXPECT_EQ(0u, vbuf.vector_size());
+	uint64_t ticket = zc.ticket();
+	EXPECT_FALSE(zc.released(ticket));
+	EXPECT_FALSE(zc.wait(ticket, 10));
+
+	char buf[64*1024];
+	ssize_t n = read(fds[0], buf, sizeof(buf));
+	EXPECT_EQ(32*1024 + 3, n);
+	EXPECT_TRUE(zc.wait(ticket, 0));
+
+	// larger than the pipe
+	std::string expected;
+	body.assign(1024*1024, 'q');
+	pack_response(vbuf, expected, body);
+	EXPECT_TRUE(expected == transfer(zc, vbuf, fds[0]));
+	EXPECT_TRUE(zc.released(zc.ticket()));
+
+	close(fds[0]);
+	close(fds[1]);
+}
+
+TEST(zerocopy, copied_chunks)
+{
+	int fds[2];
+	ASSERT_EQ(0, pipe(fds));
+	set_nonblock(fds[0]);
+	set_nonblock(fds[1]);
+
+	// copies merged in a chunk reach the threshold, but the chunk is
+	// reused once consumed, so it must not be left to the kernel
+	msgpack::vrefbuffer vbuf(MSGPACK_VREFBUFFER_REF_SIZE, 64*1024);
+	msgpack::zerocopy zc(fds[1]);
+	std::string a(20000, 'A');
+	vbuf.append_copy(a.data(), a.size());
+	EXPECT_EQ((ssize_t)a.size(), zc.send(vbuf));
+
+	// written again before the reader drains the pipe
+	std::string b(20000, 'B');
+	vbuf.append_copy(b.data(), b.size());
+
+	char buf[64*1024];
+	ssize_t n = read(fds[0], buf, sizeof(buf));
+	ASSERT_EQ((ssize_t)a.size(), n);
+	EXPECT_TRUE(a == std::string(buf, n));
+	EXPECT_TRUE(zc.released(zc.ticket()));
+
+	close(fds[0]);
+	close(fds[1]);
+}
+
+TEST(zerocopy, fallback)
+{
+	int fds[2];
+	ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+	set_nonblock(fds[0]);
+	set_nonblock(fds[1]);
+
+	msgpack::zerocopy zc(fds[0]);
+	EXPECT_EQ(MSGPACK_ZEROCOPY_NONE, zc.mode);
+
+	std::string body(1024*1024, 'u');
+	msgpack::vrefbuffer vbuf;
+	std::string expected;
+	pack_response(vbuf, expected, body);
+	EXPECT_TRUE(expected == transfer(zc, vbuf, fds[1]));
+	EXPECT_TRUE(zc.released(zc.ticket()));
+
+	close(fds[0]);
+	close(fds[1]);
+}
+
+TEST(zerocopy, c)
+{
+	int fds[2];
+	ASSERT_EQ(0, pipe(fds));
+
+	std::string body(16*1024, 'c');
+	msgpack_vrefbuffer vbuf;
+	ASSERT_TRUE(msgpack_vrefbuffer_init(&vbuf, MSGPACK_VREFBUFFER_REF_SIZE,
+				MSGPACK_VREFBUFFER_CHUNK_SIZE));
+	msgpack_packer pk;
+	msgpack_packer_init(&pk, &vbuf, msgpack_vrefbuffer_write);
+	msgpack_pack_raw(&pk, body.size());
+	msgpack_pack_raw_body(&pk, body.data(), body.size());
+
+	msgpack_zerocopy zc;
+	msgpack_zerocopy_init(&zc, fds[1], 4096);
+	EXPECT_EQ((ssize_t)body.size() + 3, msgpack_zerocopy_send(&zc, &vbuf));
+	EXPECT_EQ((uint64_t)body.size() + 3, msgpack_zerocopy_ticket(&zc));
+
+	char buf[16*1024 + 3];
+	size_t off = 0;
+	while(off < sizeof(buf)) {
+		ssize_t n = read(fds[0], buf + off, sizeof(buf) - off);
+		ASSERT_LT(0, n);
+		off += n;
+	}
+	EXPECT_EQ(1, msgpack_zerocopy_wait(&zc, msgpack_zerocopy_ticket(&zc), -1));
+	EXPECT_TRUE(memcmp(buf + 3, body.data(), body.size()) == 0);
+
+	msgpack_vrefbuffer_destroy(&vbuf);
+	close(fds[0]);
+	close(fds[1]);
+}
+
@@ -1,5 +1,7 @@
 #include <msgpack.hpp>
 #include <gtest/gtest.h>
+#include <string.h>
+#include <string>
 
 TEST(zone, malloc)
 {
@@ -76,3 +78,20 @@ TEST(zone, malloc_no_align)
 	EXPECT_EQ(buf1+4, buf2);
 }
 
+
+TEST(zone, rollback)
+{
+	msgpack::zone z(32);
+	char* kept = (char*)z.malloc(16);
+	memset(kept, 'k', 16);
+	msgpack_zone_chunk_list mark = z.chunk_list;
+	for(int i=0; i < 100; ++i) {
+		memset(z.malloc(64), 'x', 64);
+	}
+	msgpack_zone_rollback(&z, &mark);
+	EXPECT_EQ(mark.ptr, z.chunk_list.ptr);
+	EXPECT_EQ(mark.free, z.chunk_list.free);
+	EXPECT_EQ(std::string(16, 'k'), std::string(kept, 16));
+	char* next = (char*)z.malloc(8);
+	EXPECT_TRUE(next >= kept + 16);
+}
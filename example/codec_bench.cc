@@ -0,0 +1,190 @@
+#include <msgpack.hpp>
+#include <msgpack/cbuffer.hpp>
+#include <msgpack/cunpacker.hpp>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <sys/time.h>
+
+// Compresses msgpack corpora with each codec of msgpack/codec.h and
+// reports the ratio, the compression speed and the speed of cunpacker,
+// which decompresses and deserializes. "none" is msgpack::unpacker.
+//
+//   cases    test/cases.mpac (or the file given) repeated
+//   mixed    values of every type like cases.mpac, with varying contents
+//   records  log-like maps
+//
+// Build with -DMSGPACK_USE_ZSTD -lzstd and -DMSGPACK_USE_LZ4 -llz4 to
+// include those codecs.
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static const size_t corpus_size = 32 * 1024 * 1024;
+
+static std::string cases_corpus(const char* path)
+{
+	std::ifstream in(path, std::ios::in | std::ios::binary);
+	std::ostringstream file;
+	file << in.rdbuf();
+	std::string data;
+	if(file.str().empty()) {
+		return data;
+	}
+	while(data.size() < corpus_size) {
+		data += file.str();
+	}
+	return data;
+}
+
+static std::string mixed_corpus()
+{
+	msgpack::sbuffer sbuf;
+	msgpack::packer<msgpack::sbuffer> pk(sbuf);
+	unsigned int x = 1;
+	for(int i=0; sbuf.size() < corpus_size; ++i) {
+		x = x * 1103515245 + 12345;
+		switch(i % 9) {
+		case 0: pk.pack_nil(); break;
+		case 1: if(x & 1) { pk.pack_true(); } else { pk.pack_false(); } break;
+		case 2: pk.pack((int)(x >> 20) - 2048); break;
+		case 3: pk.pack((unsigned long long)x << (x % 32)); break;
+		case 4: pk.pack(x / 65536.0); break;
+		case 5: pk.pack(std::string("value-") + std::string(x % 24, 'a' + x % 26)); break;
+		case 6: pk.pack_array(3).pack(i).pack(-i).pack(x % 1000); break;
+		case 7: pk.pack_map(2).pack(std::string("key")).pack(i)
+				.pack(std::string("tags")).pack_array(0); break;
+		case 8: pk.pack_raw(0); break;
+		}
+	}
+	return std::string(sbuf.data(), sbuf.size());
+}
+
+static std::string records_corpus()
+{
+	static const char* const actions[] = { "read", "write", "delete" };
+	msgpack::sbuffer sbuf;
+	msgpack::packer<msgpack::sbuffer> pk(sbuf);
+	for(int i=0; sbuf.size() < corpus_size; ++i) {
+		std::ostringstream path;
+		path << "/srv/storage/volumes/project-" << (i % 17) << "/objects/" << (i * 7919 % 100000);
+		pk.pack_map(5);
+		pk.pack(std::string("id")).pack(100000 + i);
+		pk.pack(std::string("action")).pack(std::string(actions[i % 3]));
+		pk.pack(std::string("path")).pack(path.str());
+		pk.pack(std::string("status")).pack(i % 50 ? 200 : 404);
+		pk.pack(std::string("elapsed")).pack((i % 1000) * 0.25);
+	}
+	return std::string(sbuf.data(), sbuf.size());
+}
+
+// writes like packer<cbuffer> does, in small pieces
+static void compress(msgpack::cbuffer& cbuf, const std::string& data)
+{
+	for(size_t off=0; off < data.size(); off += 4096) {
+		size_t n = std::min((size_t)4096, data.size() - off);
+		cbuf.write(data.data() + off, n);
+	}
+	cbuf.flush();
+}
+
+// decompresses without deserializing
+static size_t decompress(const msgpack_codec* codec, const char* data, size_t size)
+{
+	std::vector<char> out(64*1024);
+	void* ctx = codec->decompressor_new();
+	size_t total = 0;
+	while(true) {
+		char* dst = &out[0];
+		size_t avail = out.size();
+		int ret = codec->decompress(ctx, &data, &size, &dst, &avail);
+		total += out.size() - avail;
+		if(ret <= 0) { break; }
+	}
+	codec->decompressor_free(ctx);
+	return total;
+}
+
+template <typename Unpacker>
+static size_t unpack_all(Unpacker& pac, const char* data, size_t size)
+{
+	size_t count = 0;
+	msgpack::unpacked result;
+	for(size_t off=0; off < size; off += 64*1024) {
+		size_t n = std::min((size_t)64*1024, size - off);
+		pac.reserve_buffer(n);
+		memcpy(pac.buffer(), data + off, n);
+		pac.buffer_consumed(n);
+		while(pac.next(&result)) { ++count; }
+	}
+	return count;
+}
+
+static void bench(const char* corpus, const std::string& data,
+		const msgpack_codec* codec, int level)
+{
+	const double mb = data.size() / 1024.0 / 1024.0;
+	std::cout << corpus << " " << (codec ? codec->name : "none");
+	if(codec && level != MSGPACK_CODEC_DEFAULT_LEVEL) { std::cout << " -" << level; }
+
+	if(codec == NULL) {
+		msgpack::unpacker pac;
+		double start = now();
+		unpack_all(pac, data.data(), data.size());
+		std::cout << ": unpack " << mb / (now() - start) << " MB/s" << std::endl;
+		return;
+	}
+
+	msgpack::cbuffer cbuf(codec, level);
+	double start = now();
+	compress(cbuf, data);
+	double csec = now() - start;
+
+	start = now();
+	if(decompress(codec, cbuf.data(), cbuf.size()) != data.size()) {
+		std::cerr << "decompression failed" << std::endl;
+	}
+	double dsec = now() - start;
+
+	msgpack::cunpacker pac(codec);
+	start = now();
+	unpack_all(pac, cbuf.data(), cbuf.size());
+	double usec = now() - start;
+
+	std::cout << ": " << 100.0 * cbuf.size() / data.size() << "%, compress "
+		<< mb / csec << " MB/s, decompress "
+		<< mb / dsec << " MB/s, +unpack "
+		<< mb / usec << " MB/s" << std::endl;
+}
+
+static void bench(const char* corpus, const std::string& data)
+{
+	if(data.empty()) { return; }
+	bench(corpus, data, NULL, 0);
+	bench(corpus, data, msgpack_codec_deflate(), 1);
+	bench(corpus, data, msgpack_codec_deflate(), MSGPACK_CODEC_DEFAULT_LEVEL);
+#ifdef MSGPACK_USE_ZSTD
+	bench(corpus, data, msgpack_codec_zstd(), 1);
+	bench(corpus, data, msgpack_codec_zstd(), MSGPACK_CODEC_DEFAULT_LEVEL);
+#endif
+#ifdef MSGPACK_USE_LZ4
+	bench(corpus, data, msgpack_codec_lz4(), MSGPACK_CODEC_DEFAULT_LEVEL);
+#endif
+}
+
+int main(int argc, char** argv)
+{
+	bench("cases  ", cases_corpus(argc > 1 ? argv[1] : "../test/cases.mpac"));
+	bench("mixed  ", mixed_corpus());
+	bench("records", records_corpus());
+	return 0;
+}
+
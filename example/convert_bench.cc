@@ -0,0 +1,71 @@
+#include <msgpack.hpp>
+#include <msgpack/type/tr1/unordered_map.hpp>
+#include <msgpack/type/tr1/unordered_set.hpp>
+#include <iostream>
+#include <sstream>
+#include <sys/time.h>
+#if __cplusplus >= 201103L
+#include <msgpack/type/cpp11/unordered_map.hpp>
+#include <msgpack/type/cpp11/unordered_set.hpp>
+#endif
+
+// Converts objects of maps and arrays into containers.
+// Keys of maps are packed in sorted order, as std::map produces them.
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+template <typename T>
+static void bench(const char* name, msgpack::object obj, int loop)
+{
+	size_t size = 0;
+	double start = now();
+	for(int i=0; i < loop; ++i) {
+		T v;
+		obj.convert(&v);
+		size += v.size();
+	}
+	double sec = now() - start;
+	std::cout << name << ": " << sec << " sec, "
+		<< (size / sec / 1000 / 1000) << " M elements/s" << std::endl;
+}
+
+int main(void)
+{
+	const int num = 10000;
+	const int loop = 200;
+
+	std::map<std::string, int> map;
+	std::set<int> set;
+	for(int i=0; i < num; ++i) {
+		std::ostringstream key;
+		key << "key-" << i;
+		map[key.str()] = i;
+		set.insert(i * 7);
+	}
+
+	msgpack::zone z;
+	msgpack::object map_obj(map, &z);
+	msgpack::object set_obj(set, &z);
+
+	bench< std::map<std::string, int> >("std::map", map_obj, loop);
+	bench< std::multimap<std::string, int> >("std::multimap", map_obj, loop);
+	bench< std::set<int> >("std::set", set_obj, loop);
+	bench< std::multiset<int> >("std::multiset", set_obj, loop);
+	bench< msgpack::type::assoc_vector<std::string, int> >("assoc_vector", map_obj, loop);
+	bench< msgpack::type::flat_map<std::string, int> >("flat_map", map_obj, loop);
+	bench< msgpack::type::flat_set<int> >("flat_set", set_obj, loop);
+	bench< std::tr1::unordered_map<std::string, int> >("tr1::unordered_map", map_obj, loop);
+	bench< std::tr1::unordered_set<int> >("tr1::unordered_set", set_obj, loop);
+#if __cplusplus >= 201103L
+	bench< std::unordered_map<std::string, int> >("std::unordered_map", map_obj, loop);
+	bench< std::unordered_set<int> >("std::unordered_set", set_obj, loop);
+#endif
+
+	return 0;
+}
+
@@ -0,0 +1,93 @@
+#include <msgpack.hpp>
+#include <iostream>
+#include <vector>
+#include <sys/time.h>
+
+// Packs vectors of small structs through packer<sbuffer> and
+// packer<vrefbuffer>.
+// point is made only of members with a bounded size, so MSGPACK_DEFINE
+// serializes it with one write: directly into the buffer of sbuffer,
+// or through a buffer on the stack for other streams.
+// point_each packs the same members one by one.
+
+struct point {
+	int x;
+	int y;
+	double weight;
+	bool visible;
+	MSGPACK_DEFINE(x, y, weight, visible);
+};
+
+struct point_each : point {
+	template <typename Packer>
+	void msgpack_pack(Packer& pk) const
+	{
+		pk.pack_array(4);
+		pk.pack(x);
+		pk.pack(y);
+		pk.pack(weight);
+		pk.pack(visible);
+	}
+};
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static size_t size_of(const msgpack::sbuffer& sbuf)
+{
+	return sbuf.size();
+}
+
+static size_t size_of(const msgpack::vrefbuffer& vbuf)
+{
+	size_t size = 0;
+	const struct iovec* vec = vbuf.vector();
+	for(size_t i=0; i < vbuf.vector_size(); ++i) {
+		size += vec[i].iov_len;
+	}
+	return size;
+}
+
+template <typename Stream, typename T>
+static void bench(const char* name, const std::vector<T>& v, int loop)
+{
+	size_t size = 0;
+	double start = now();
+	for(int i=0; i < loop; ++i) {
+		Stream buf;
+		msgpack::pack(buf, v);
+		size += size_of(buf);
+	}
+	double sec = now() - start;
+	std::cout << name << ": " << sec << " sec, "
+		<< (size / sec / 1024 / 1024) << " MB/s" << std::endl;
+}
+
+int main(void)
+{
+	const size_t num = 100000;
+	const int loop = 100;
+
+	std::vector<point> fused(num);
+	std::vector<point_each> each(num);
+	for(size_t i=0; i < num; ++i) {
+		point& p = fused[i];
+		p.x = (int)i;
+		p.y = -(int)(i % 1000);
+		p.weight = i * 0.5;
+		p.visible = i % 2 == 0;
+		static_cast<point&>(each[i]) = p;
+	}
+
+	bench<msgpack::sbuffer>("sbuffer, fused write", fused, loop);
+	bench<msgpack::sbuffer>("sbuffer, write per member", each, loop);
+	bench<msgpack::vrefbuffer>("vrefbuffer, fused write", fused, loop);
+	bench<msgpack::vrefbuffer>("vrefbuffer, write per member", each, loop);
+
+	return 0;
+}
+
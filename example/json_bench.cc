@@ -0,0 +1,94 @@
+#include <msgpack.hpp>
+#include <msgpack/json.hpp>
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+#include <sys/time.h>
+
+// Writes records of log-like maps as text:
+// msgpack_to_json() transcodes the serialized data directly, while
+// msgpack_object_print() needs the data deserialized into objects.
+// msgpack_pack_json() parses the JSON text back.
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int discard(void* data, const char* buf, unsigned int len)
+{
+	*(size_t*)data += len;
+	return 0;
+}
+
+static void report(const char* name, double sec, size_t bytes)
+{
+	std::cout << name << ": " << sec << " sec, "
+		<< (bytes / sec / 1024 / 1024) << " MB/s" << std::endl;
+}
+
+int main(void)
+{
+	const int num = 100000;
+	const int loop = 10;
+
+	msgpack::sbuffer sbuf;
+	msgpack::packer<msgpack::sbuffer> pk(&sbuf);
+	for(int i=0; i < num; ++i) {
+		std::ostringstream msg;
+		msg << "request " << i << " served in \"" << (i % 97) << "ms\"\n";
+		pk.pack_map(5);
+		pk.pack(std::string("time")).pack(1280000000 + i);
+		pk.pack(std::string("host")).pack(std::string("web-frontend-01.example.com"));
+		pk.pack(std::string("status")).pack(i % 5 == 0 ? 404 : 200);
+		pk.pack(std::string("latency")).pack(i * 0.001);
+		pk.pack(std::string("message")).pack(msg.str());
+	}
+
+	size_t json_size = 0;
+	double start = now();
+	for(int l=0; l < loop; ++l) {
+		size_t off = 0;
+		while(off < sbuf.size()) {
+			msgpack_to_json(sbuf.data(), sbuf.size(), &off, &json_size, discard);
+		}
+	}
+	report("msgpack_to_json", now() - start, sbuf.size() * loop);
+
+	FILE* null = fopen("/dev/null", "w");
+	start = now();
+	for(int l=0; l < loop; ++l) {
+		msgpack::unpacker pac;
+		pac.reserve_buffer(sbuf.size());
+		memcpy(pac.buffer(), sbuf.data(), sbuf.size());
+		pac.buffer_consumed(sbuf.size());
+		msgpack::unpacked result;
+		while(pac.next(&result)) {
+			msgpack_object_print(null, result.get());
+		}
+	}
+	report("unpack and msgpack_object_print", now() - start, sbuf.size() * loop);
+	fclose(null);
+
+	msgpack::sbuffer json;
+	size_t off = 0;
+	while(off < sbuf.size()) {
+		msgpack::to_json(json, sbuf.data(), sbuf.size(), &off);
+		json.write("\n", 1);
+	}
+	start = now();
+	for(int l=0; l < loop; ++l) {
+		msgpack::sbuffer out;
+		msgpack_packer jpk;
+		msgpack_packer_init(&jpk, &out, msgpack_sbuffer_write);
+		size_t joff = 0;
+		while(joff < json.size()) {
+			msgpack_pack_json(&jpk, json.data(), json.size(), &joff);
+		}
+	}
+	report("msgpack_pack_json", now() - start, json.size() * loop);
+
+	return 0;
+}
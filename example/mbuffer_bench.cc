@@ -0,0 +1,86 @@
+#include <msgpack.hpp>
+#include <msgpack/mbuffer.hpp>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+// Packs records into a file with sbuffer and one write, with
+// packer<std::ofstream>, and with mbuffer, each in its own process,
+// and reports the time and the peak RSS.
+//
+//   usage: mbuffer_bench [MB] [path]
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+template <typename Stream>
+static void pack_records(Stream& out, size_t count)
+{
+	msgpack::packer<Stream> pk(out);
+	for(size_t i=0; i < count; ++i) {
+		pk.pack_map(3);
+		pk.pack(std::string("id")).pack(i);
+		pk.pack(std::string("name")).pack(std::string("a record of a large data set"));
+		pk.pack(std::string("value")).pack(i * 0.5);
+	}
+}
+
+static void run(int mode, const char* path, size_t count)
+{
+	switch(mode) {
+	case 0: {
+		msgpack::sbuffer sbuf;
+		pack_records(sbuf, count);
+		std::ofstream out(path, std::ios::out | std::ios::binary);
+		out.write(sbuf.data(), sbuf.size());
+		break;
+	}
+	case 1: {
+		std::ofstream out(path, std::ios::out | std::ios::binary);
+		pack_records(out, count);
+		break;
+	}
+	case 2: {
+		msgpack::mbuffer mbuf(path);
+		pack_records(mbuf, count);
+		mbuf.close();
+		break;
+	}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	static const char* const names[] = { "sbuffer ", "ofstream", "mbuffer " };
+	const size_t mb = argc > 1 ? atoi(argv[1]) : 1024;
+	const char* path = argc > 2 ? argv[2] : "mbuffer_bench.mpac";
+	const size_t count = mb * 1024 * 1024 / 64;  // records are 64 bytes
+
+	for(int mode=0; mode < 3; ++mode) {
+		double start = now();
+		pid_t pid = fork();
+		if(pid == 0) {
+			run(mode, path, count);
+			struct rusage ru;
+			getrusage(RUSAGE_SELF, &ru);
+			std::cout << names[mode] << ": max RSS " << ru.ru_maxrss / 1024 << " MB" << std::flush;
+			_exit(0);
+		}
+		waitpid(pid, NULL, 0);
+		double sec = now() - start;
+		std::cout << ", " << sec << " sec, " << mb / sec << " MB/s" << std::endl;
+	}
+
+	unlink(path);
+	return 0;
+}
+
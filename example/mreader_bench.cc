@@ -0,0 +1,80 @@
+#include <msgpack.hpp>
+#include <msgpack/mbuffer.hpp>
+#include <msgpack/mreader.hpp>
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+// Writes a file of records with mbuffer and reads it back with read(2)
+// into msgpack::unpacker and with msgpack::mreader.
+//
+//   usage: mreader_bench [MB] [path]
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static size_t read_unpacker(const char* path)
+{
+	int fd = open(path, O_RDONLY);
+	msgpack::unpacker pac;
+	msgpack::unpacked result;
+	size_t count = 0;
+	while(true) {
+		pac.reserve_buffer(1024*1024);
+		ssize_t n = read(fd, pac.buffer(), pac.buffer_capacity());
+		if(n <= 0) { break; }
+		pac.buffer_consumed(n);
+		while(pac.next(&result)) { ++count; }
+	}
+	close(fd);
+	return count;
+}
+
+static size_t read_mreader(const char* path)
+{
+	msgpack::mreader reader(path);
+	msgpack::unpacked result;
+	size_t count = 0;
+	while(reader.next(&result)) { ++count; }
+	return count;
+}
+
+int main(int argc, char** argv)
+{
+	const size_t mb = argc > 1 ? atoi(argv[1]) : 1024;
+	const char* path = argc > 2 ? argv[2] : "mreader_bench.mpac";
+
+	{
+		msgpack::mbuffer mbuf(path);
+		msgpack::packer<msgpack::mbuffer> pk(mbuf);
+		std::string body(200, 'b');
+		for(size_t i=0; mbuf.size() < mb * 1024 * 1024; ++i) {
+			pk.pack_map(3);
+			pk.pack(std::string("id")).pack(i);
+			pk.pack(std::string("name")).pack(std::string("a record of a large data set"));
+			pk.pack(std::string("body")).pack(body);
+		}
+		mbuf.close();
+	}
+
+	double start = now();
+	size_t count = read_unpacker(path);
+	double sec = now() - start;
+	std::cout << "read+unpacker: " << count << " messages, " << mb / sec << " MB/s" << std::endl;
+
+	start = now();
+	count = read_mreader(path);
+	sec = now() - start;
+	std::cout << "mreader      : " << count << " messages, " << mb / sec << " MB/s" << std::endl;
+
+	unlink(path);
+	return 0;
+}
+
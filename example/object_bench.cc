@@ -0,0 +1,266 @@
+#include <msgpack.hpp>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string.h>
+#include <sys/time.h>
+
+// Re-serializes and compares unpacked objects, as test/crosslang.cc does,
+// with the iterative walkers and with recursive ones for comparison.
+// The wide tree is an array of small maps; the deep tree is arrays and
+// maps nested 10000 levels, which the unpacker can't produce.
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int recursive_pack(msgpack_packer* pk, const msgpack_object& d)
+{
+	switch(d.type) {
+	case MSGPACK_OBJECT_NIL:
+		return msgpack_pack_nil(pk);
+	case MSGPACK_OBJECT_BOOLEAN:
+		return d.via.boolean ? msgpack_pack_true(pk) : msgpack_pack_false(pk);
+	case MSGPACK_OBJECT_POSITIVE_INTEGER:
+		return msgpack_pack_uint64(pk, d.via.u64);
+	case MSGPACK_OBJECT_NEGATIVE_INTEGER:
+		return msgpack_pack_int64(pk, d.via.i64);
+	case MSGPACK_OBJECT_DOUBLE:
+		return msgpack_pack_double(pk, d.via.dec);
+	case MSGPACK_OBJECT_RAW:
+		if(msgpack_pack_raw(pk, d.via.raw.size) < 0) { return -1; }
+		return msgpack_pack_raw_body(pk, d.via.raw.ptr, d.via.raw.size);
+	case MSGPACK_OBJECT_ARRAY:
+		if(msgpack_pack_array(pk, d.via.array.size) < 0) { return -1; }
+		for(uint32_t i=0; i < d.via.array.size; ++i) {
+			if(recursive_pack(pk, d.via.array.ptr[i]) < 0) { return -1; }
+		}
+		return 0;
+	case MSGPACK_OBJECT_MAP:
+		if(msgpack_pack_map(pk, d.via.map.size) < 0) { return -1; }
+		for(uint32_t i=0; i < d.via.map.size; ++i) {
+			if(recursive_pack(pk, d.via.map.ptr[i].key) < 0) { return -1; }
+			if(recursive_pack(pk, d.via.map.ptr[i].val) < 0) { return -1; }
+		}
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+static void recursive_packer(msgpack::packer<msgpack::sbuffer>& o, const msgpack::object& v)
+{
+	switch(v.type) {
+	case msgpack::type::NIL:
+		o.pack_nil();
+		break;
+	case msgpack::type::BOOLEAN:
+		if(v.via.boolean) { o.pack_true(); } else { o.pack_false(); }
+		break;
+	case msgpack::type::POSITIVE_INTEGER:
+		o.pack_uint64(v.via.u64);
+		break;
+	case msgpack::type::NEGATIVE_INTEGER:
+		o.pack_int64(v.via.i64);
+		break;
+	case msgpack::type::DOUBLE:
+		o.pack_double(v.via.dec);
+		break;
+	case msgpack::type::RAW:
+		o.pack_raw(v.via.raw.size);
+		o.pack_raw_body(v.via.raw.ptr, v.via.raw.size);
+		break;
+	case msgpack::type::ARRAY:
+		o.pack_array(v.via.array.size);
+		for(uint32_t i=0; i < v.via.array.size; ++i) {
+			recursive_packer(o, v.via.array.ptr[i]);
+		}
+		break;
+	case msgpack::type::MAP:
+		o.pack_map(v.via.map.size);
+		for(uint32_t i=0; i < v.via.map.size; ++i) {
+			recursive_packer(o, v.via.map.ptr[i].key);
+			recursive_packer(o, v.via.map.ptr[i].val);
+		}
+		break;
+	default:
+		throw msgpack::type_error();
+	}
+}
+
+static bool recursive_equal(const msgpack_object& x, const msgpack_object& y)
+{
+	if(x.type != y.type) { return false; }
+	switch(x.type) {
+	case MSGPACK_OBJECT_NIL:
+		return true;
+	case MSGPACK_OBJECT_BOOLEAN:
+		return x.via.boolean == y.via.boolean;
+	case MSGPACK_OBJECT_POSITIVE_INTEGER:
+	case MSGPACK_OBJECT_NEGATIVE_INTEGER:
+		return x.via.u64 == y.via.u64;
+	case MSGPACK_OBJECT_DOUBLE:
+		return x.via.dec == y.via.dec;
+	case MSGPACK_OBJECT_RAW:
+		return x.via.raw.size == y.via.raw.size &&
+			memcmp(x.via.raw.ptr, y.via.raw.ptr, x.via.raw.size) == 0;
+	case MSGPACK_OBJECT_ARRAY:
+		if(x.via.array.size != y.via.array.size) { return false; }
+		for(uint32_t i=0; i < x.via.array.size; ++i) {
+			if(!recursive_equal(x.via.array.ptr[i], y.via.array.ptr[i])) { return false; }
+		}
+		return true;
+	case MSGPACK_OBJECT_MAP:
+		if(x.via.map.size != y.via.map.size) { return false; }
+		for(uint32_t i=0; i < x.via.map.size; ++i) {
+			if(!recursive_equal(x.via.map.ptr[i].key, y.via.map.ptr[i].key) ||
+					!recursive_equal(x.via.map.ptr[i].val, y.via.map.ptr[i].val)) {
+				return false;
+			}
+		}
+		return true;
+	default:
+		return false;
+	}
+}
+
+struct target {
+	msgpack_object obj;
+	msgpack_object copy;
+	msgpack_sbuffer sbuf;
+	msgpack_packer pk;
+	msgpack::sbuffer cbuf;
+	msgpack::packer<msgpack::sbuffer> cpk;
+	target() : cpk(cbuf) { }
+};
+
+static bool run_recursive_pack(target& t)
+{
+	t.sbuf.size = 0;
+	return recursive_pack(&t.pk, t.obj) == 0;
+}
+
+static bool run_pack_object(target& t)
+{
+	t.sbuf.size = 0;
+	return msgpack_pack_object(&t.pk, t.obj) == 0;
+}
+
+static bool run_recursive_packer(target& t)
+{
+	t.cbuf.clear();
+	recursive_packer(t.cpk, msgpack::object(t.obj));
+	return true;
+}
+
+static bool run_packer(target& t)
+{
+	t.cbuf.clear();
+	t.cpk << msgpack::object(t.obj);
+	return true;
+}
+
+static bool run_recursive_equal(target& t)
+{
+	return recursive_equal(t.obj, t.copy);
+}
+
+static bool run_object_equal(target& t)
+{
+	return msgpack_object_equal(t.obj, t.copy);
+}
+
+// reports the best of 3 runs
+static void bench(const char* name, const char* what,
+		bool (*run)(target&), target& t, int loop)
+{
+	double best = 0;
+	for(int r=0; r < 3; ++r) {
+		double start = now();
+		for(int i=0; i < loop; ++i) {
+			if(!run(t)) { std::cerr << what << " failed" << std::endl; }
+		}
+		double sec = now() - start;
+		if(r == 0 || sec < best) { best = sec; }
+	}
+	std::cout << name << " " << what << ": " << best << " sec, "
+		<< (t.sbuf.size * loop / best / 1024 / 1024) << " MB/s" << std::endl;
+}
+
+static void bench(const char* name, msgpack_object obj, msgpack_object copy, int loop)
+{
+	target t;
+	t.obj = obj;
+	t.copy = copy;
+	msgpack_sbuffer_init(&t.sbuf);
+	msgpack_packer_init(&t.pk, &t.sbuf, msgpack_sbuffer_write);
+	msgpack_pack_object(&t.pk, obj);
+
+	bench(name, "recursive pack   ", run_recursive_pack, t, loop);
+	bench(name, "msgpack_pack_obj ", run_pack_object, t, loop);
+	bench(name, "recursive packer ", run_recursive_packer, t, loop);
+	bench(name, "packer<<object   ", run_packer, t, loop);
+	bench(name, "recursive equal  ", run_recursive_equal, t, loop);
+	bench(name, "msgpack_obj_equal", run_object_equal, t, loop);
+
+	msgpack_sbuffer_destroy(&t.sbuf);
+}
+
+// alternately arrays and maps nested depth times
+static msgpack_object nested(msgpack::zone* z, int depth)
+{
+	msgpack_object o;
+	o.type = MSGPACK_OBJECT_NIL;
+	for(int i=depth; i > 0; --i) {
+		if(i % 2 == 1) {
+			msgpack_object* a = (msgpack_object*)z->malloc(sizeof(msgpack_object) * 2);
+			a[0] = o;
+			a[1].type = MSGPACK_OBJECT_POSITIVE_INTEGER;
+			a[1].via.u64 = i;
+			o.type = MSGPACK_OBJECT_ARRAY;
+			o.via.array.size = 2;
+			o.via.array.ptr = a;
+		} else {
+			msgpack_object_kv* kv = (msgpack_object_kv*)z->malloc(sizeof(msgpack_object_kv));
+			kv->key.type = MSGPACK_OBJECT_RAW;
+			kv->key.via.raw.size = 3;
+			kv->key.via.raw.ptr = "key";
+			kv->val = o;
+			o.type = MSGPACK_OBJECT_MAP;
+			o.via.map.size = 1;
+			o.via.map.ptr = kv;
+		}
+	}
+	return o;
+}
+
+int main(void)
+{
+	const int num = 100000;
+	const int loop = 100;
+
+	msgpack::sbuffer sbuf;
+	msgpack::packer<msgpack::sbuffer> pk(sbuf);
+	pk.pack_array(num);
+	for(int i=0; i < num; ++i) {
+		pk.pack_map(3);
+		pk.pack(std::string("id")).pack(i);
+		pk.pack(std::string("name")).pack(std::string("name-of-an-element"));
+		pk.pack(std::string("tags")).pack_array(2).pack(-i).pack(i * 0.5);
+	}
+
+	msgpack::zone z;
+	msgpack::object wide, wide_copy;
+	msgpack::unpack(sbuf.data(), sbuf.size(), NULL, &z, &wide);
+	msgpack::unpack(sbuf.data(), sbuf.size(), NULL, &z, &wide_copy);
+	bench("wide", wide, wide_copy, loop);
+
+	msgpack_object deep = nested(&z, 10000);
+	msgpack_object deep_copy = nested(&z, 10000);
+	bench("deep", deep, deep_copy, loop * 10);
+
+	return 0;
+}
@@ -0,0 +1,73 @@
+#include <msgpack.hpp>
+#include <msgpack/zbuffer.hpp>
+#include <msgpack/pzbuffer.hpp>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <stdlib.h>
+#include <sys/time.h>
+
+// Deflates a large packed snapshot of records with zbuffer on one
+// thread and with pzbuffer on 1, 2, 4 and 8 threads.
+//
+//   usage: pzbuffer_bench [MB] [level]
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void pack_snapshot(msgpack::sbuffer& sbuf, size_t size)
+{
+	static const char* const actions[] = { "read", "write", "delete" };
+	msgpack::packer<msgpack::sbuffer> pk(sbuf);
+	for(int i=0; sbuf.size() < size; ++i) {
+		std::ostringstream path;
+		path << "/srv/storage/volumes/project-" << (i % 17) << "/objects/" << (i * 7919 % 100000);
+		pk.pack_map(4);
+		pk.pack(std::string("id")).pack(100000 + i);
+		pk.pack(std::string("action")).pack(std::string(actions[i % 3]));
+		pk.pack(std::string("path")).pack(path.str());
+		pk.pack(std::string("elapsed")).pack((i % 1000) * 0.25);
+	}
+}
+
+template <typename Buffer>
+static void report(const char* name, Buffer& buf, const msgpack::sbuffer& snapshot)
+{
+	double start = now();
+	for(size_t off=0; off < snapshot.size(); off += 64*1024) {
+		size_t n = snapshot.size() - off;
+		buf.write(snapshot.data() + off, n < 64*1024 ? n : 64*1024);
+	}
+	buf.flush();
+	double sec = now() - start;
+	std::cout << name << ": " << sec << " sec, "
+		<< snapshot.size() / sec / 1024 / 1024 << " MB/s, "
+		<< 100.0 * buf.size() / snapshot.size() << "%" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	const size_t size = (argc > 1 ? atoi(argv[1]) : 256) * 1024 * 1024;
+	const int level = argc > 2 ? atoi(argv[2]) : Z_DEFAULT_COMPRESSION;
+
+	msgpack::sbuffer snapshot;
+	pack_snapshot(snapshot, size);
+
+	{
+		msgpack::zbuffer zbuf(level);
+		report("zbuffer    ", zbuf, snapshot);
+	}
+	static const unsigned int threads[] = { 1, 2, 4, 8 };
+	for(size_t i=0; i < sizeof(threads) / sizeof(threads[0]); ++i) {
+		msgpack::pzbuffer pzbuf(threads[i], level);
+		std::ostringstream name;
+		name << "pzbuffer x" << threads[i];
+		report(name.str().c_str(), pzbuf, snapshot);
+	}
+	return 0;
+}
+
@@ -0,0 +1,86 @@
+#include <msgpack.hpp>
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <stdlib.h>
+#include <sys/time.h>
+
+// Feeds a stream of records of 100 bytes to 256KB in 64KB reads to
+// msgpack::unpacker and msgpack::ring_unpacker, converting each message
+// before the next read, and reports the throughput and the buffer size.
+//
+//   usage: ring_unpacker_bench [MB]
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+template <typename Unpacker>
+static size_t feed(Unpacker& pac, const msgpack::sbuffer& sbuf, size_t* max_buffer)
+{
+	const char* input = sbuf.data();
+	const char* const eof = input + sbuf.size();
+	msgpack::unpacked result;
+	size_t total = 0;
+	*max_buffer = 0;
+
+	while(input < eof) {
+		pac.reserve_buffer(64*1024);
+		size_t len = std::min((size_t)(eof - input),
+				std::min(pac.buffer_capacity(), (size_t)64*1024));
+		memcpy(pac.buffer(), input, len);
+		input += len;
+		pac.buffer_consumed(len);
+
+		while(pac.next(&result)) {
+			std::string body;
+			result.get().via.array.ptr[1].convert(&body);
+			total += body.size();
+		}
+		*max_buffer = std::max(*max_buffer, pac.used + pac.free);
+	}
+	return total;
+}
+
+int main(int argc, char** argv)
+{
+	const size_t mb = argc > 1 ? atoi(argv[1]) : 256;
+
+	msgpack::sbuffer sbuf;
+	msgpack::packer<msgpack::sbuffer> pk(&sbuf);
+	std::string body(256*1024, 'b');
+	for(size_t i=0; sbuf.size() < mb * 1024 * 1024; ++i) {
+		size_t size = (i % 64 == 63) ? body.size() : 100 + i % 1000;
+		pk.pack_array(2);
+		pk.pack(i);
+		pk.pack_raw(size);
+		pk.pack_raw_body(body.data(), size);
+	}
+
+	for(int r=0; r < 3; ++r) {
+		size_t max_buffer;
+		double start = now();
+		{
+			msgpack::unpacker pac;
+			feed(pac, sbuf, &max_buffer);
+		}
+		double sec = now() - start;
+		std::cout << "unpacker     : " << mb / sec << " MB/s, buffer up to "
+			<< max_buffer / 1024 << " KB" << std::endl;
+
+		start = now();
+		{
+			msgpack::ring_unpacker pac(1024*1024);
+			feed(pac, sbuf, &max_buffer);
+		}
+		sec = now() - start;
+		std::cout << "ring_unpacker: " << mb / sec << " MB/s, buffer fixed at "
+			<< 1024 << " KB" << std::endl;
+	}
+
+	return 0;
+}
+
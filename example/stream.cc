@@ -9,7 +9,12 @@
 
 class Server {
 public:
-	Server(int sock) : m_sock(sock) { }
+	Server(int sock) : m_sock(sock)
+	{
+		// reject oversized messages as soon as their headers arrive
+		m_pac.set_limit(msgpack::unpack_limit(
+				1024*1024, 64*1024, 64*1024, 10*1024*1024, 16));
+	}
 
 	~Server() { }
 
@@ -43,10 +48,6 @@ public:
 
 			process_message(msg, life);
 		}
-
-		if(m_pac.message_size() > 10*1024*1024) {
-			throw std::runtime_error("message is too large");
-		}
 	}
 
 private:
@@ -0,0 +1,138 @@
+#include <msgpack.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+// Packs responses of several shapes into one vrefbuffer, sends each one
+// to a pipe with writev and clears the buffer, comparing the fixed
+// ref_size with the adaptive one.
+//
+//   small    maps of integers and short strings
+//   medium   arrays of 40-300 byte strings
+//   large    a few 256KB raw values with small headers
+//   mixed    all of them
+//
+//   usage: vrefbuffer_bench [MB per case]
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void* drain(void* arg)
+{
+	int fd = *(int*)arg;
+	static char buf[256*1024];
+	while(read(fd, buf, sizeof(buf)) > 0) { }
+	return NULL;
+}
+
+struct payload {
+	std::vector<std::string> medium;
+	std::string large;
+
+	payload() : large(256*1024, 'l')
+	{
+		for(int i=0; i < 64; ++i) {
+			medium.push_back(std::string(40 + i * 37 % 260, 'a' + i % 26));
+		}
+	}
+};
+
+static void pack_small(msgpack::packer<msgpack::vrefbuffer>& pk, int n)
+{
+	for(int i=0; i < n; ++i) {
+		pk.pack_map(3);
+		pk.pack(std::string("id")).pack(i);
+		pk.pack(std::string("name")).pack(std::string("user"));
+		pk.pack(std::string("score")).pack(i * 0.5);
+	}
+}
+
+static void pack_medium(msgpack::packer<msgpack::vrefbuffer>& pk, const payload& p, int n)
+{
+	pk.pack_array(n);
+	for(int i=0; i < n; ++i) {
+		pk.pack(p.medium[i % p.medium.size()]);
+	}
+}
+
+static void pack_large(msgpack::packer<msgpack::vrefbuffer>& pk, const payload& p, int n)
+{
+	for(int i=0; i < n; ++i) {
+		pk.pack_map(2);
+		pk.pack(std::string("id")).pack(i);
+		pk.pack(std::string("body")).pack(p.large);
+	}
+}
+
+static void pack_response(msgpack::vrefbuffer& vbuf, const payload& p, int shape)
+{
+	msgpack::packer<msgpack::vrefbuffer> pk(vbuf);
+	switch(shape) {
+	case 0: pack_small(pk, 500); break;
+	case 1: pack_medium(pk, p, 500); break;
+	case 2: pack_large(pk, p, 2); break;
+	case 3:
+		pack_small(pk, 100);
+		pack_medium(pk, p, 200);
+		pack_large(pk, p, 1);
+		break;
+	}
+}
+
+static void bench(int fd, const payload& p, int shape, size_t total, bool adaptive)
+{
+	static const char* const names[] = { "small ", "medium", "large ", "mixed " };
+
+	msgpack::vrefbuffer vbuf;
+	if(adaptive) { vbuf.set_adaptive(); }
+
+	size_t bytes = 0;
+	size_t iovecs = 0;
+	size_t responses = 0;
+	double start = now();
+	while(bytes < total) {
+		pack_response(vbuf, p, shape);
+		iovecs += vbuf.vector_size();
+		while(vbuf.vector_size() > 0) {
+			bytes += vbuf.writev(fd);
+		}
+		vbuf.clear();
+		++responses;
+	}
+	double sec = now() - start;
+
+	std::cout << names[shape] << (adaptive ? " adaptive" : " fixed   ")
+		<< ": " << bytes / sec / 1024 / 1024 << " MB/s, "
+		<< (double)iovecs / responses << " iovecs/response, "
+		<< (double)bytes / iovecs << " bytes/iovec, ref_size "
+		<< vbuf.ref_size << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	const size_t total = (argc > 1 ? atoi(argv[1]) : 256) * 1024 * 1024;
+
+	int fds[2];
+	if(pipe(fds) < 0) { return 1; }
+	pthread_t reader;
+	pthread_create(&reader, NULL, drain, &fds[0]);
+
+	payload p;
+	for(int shape=0; shape < 4; ++shape) {
+		bench(fds[1], p, shape, total, false);
+		bench(fds[1], p, shape, total, true);
+	}
+
+	close(fds[1]);
+	pthread_join(reader, NULL);
+	return 0;
+}
+
@@ -0,0 +1,149 @@
+#include <msgpack.hpp>
+#include <msgpack/zbuffer.hpp>
+#include <msgpack/zunpacker.hpp>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <string.h>
+#include <sys/time.h>
+
+// Compresses small, repetitive messages one by one, as a sender of
+// individual messages has to, and inflates them with zunpacker.
+//
+//   fresh      a new zbuffer per message
+//   reset      flush() and reset() per message
+//   dict       reset per message with a preset dictionary
+//   sync       sync_flush() per message in one long-lived stream
+//   sync+dict  both
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+struct record {
+	int id;
+	std::string user;
+	std::string action;
+	std::string path;
+	std::vector<std::string> tags;
+	std::string host;
+	std::string agent;
+	int status;
+	double elapsed;
+	MSGPACK_DEFINE(id, user, action, path, tags, host, agent, status, elapsed);
+};
+
+static const char* const users[] = { "alice", "bob", "carol", "dave" };
+static const char* const actions[] = { "read", "write", "delete" };
+
+static record make_record(int i)
+{
+	record r;
+	r.id = 100000 + i;
+	r.user = users[i % 4];
+	r.action = actions[i % 3];
+	std::ostringstream path;
+	path << "/srv/storage/volumes/project-" << (i % 17) << "/objects/" << (i * 7919 % 100000);
+	r.path = path.str();
+	r.tags.push_back("region:us-east-1");
+	r.tags.push_back(i % 2 ? "tier:standard" : "tier:archive");
+	r.tags.push_back("service:object-store");
+	std::ostringstream host;
+	host << "storage-node-" << (i % 32) << ".dc1.example.internal";
+	r.host = host.str();
+	r.agent = (i % 5) ? "msgpack-rpc-client/0.5.4 (linux; x86_64)" : "msgpack-rpc-client/0.5.3 (darwin; arm64)";
+	r.status = (i % 50) ? 200 : 404;
+	r.elapsed = (i % 1000) * 0.25;
+	return r;
+}
+
+enum mode { FRESH, RESET, SYNC };
+
+static void bench(const char* name, const std::vector<std::string>& msgs,
+		mode m, const std::string* dict)
+{
+	size_t raw = 0;
+	size_t compressed = 0;
+	std::string out;
+
+	double start = now();
+	msgpack::zbuffer* zbuf = new msgpack::zbuffer();
+	if(dict) { zbuf->set_dictionary(dict->data(), dict->size()); }
+	for(size_t i=0; i < msgs.size(); ++i) {
+		if(m == FRESH && i > 0) {
+			delete zbuf;
+			zbuf = new msgpack::zbuffer();
+			if(dict) { zbuf->set_dictionary(dict->data(), dict->size()); }
+		}
+		zbuf->write(msgs[i].data(), msgs[i].size());
+		if(m == SYNC) {
+			zbuf->sync_flush();
+		} else {
+			zbuf->flush();
+		}
+		raw += msgs[i].size();
+		compressed += zbuf->size();
+		out.append(zbuf->data(), zbuf->size());
+		if(m == RESET) {
+			zbuf->reset();
+		} else {
+			zbuf->reset_buffer();
+		}
+	}
+	delete zbuf;
+	double csec = now() - start;
+
+	start = now();
+	msgpack::zunpacker pac;
+	if(dict) { pac.set_dictionary(dict->data(), dict->size()); }
+	pac.reserve_buffer(out.size());
+	memcpy(pac.buffer(), out.data(), out.size());
+	pac.buffer_consumed(out.size());
+	msgpack::unpacked result;
+	size_t count = 0;
+	while(pac.next(&result)) { ++count; }
+	double dsec = now() - start;
+	if(count != msgs.size()) {
+		std::cerr << name << ": inflated " << count << " messages" << std::endl;
+	}
+
+	std::cout << name << ": " << (double)compressed / msgs.size() << " bytes/msg ("
+		<< 100.0 * compressed / raw << "%), deflate "
+		<< csec * 1e6 / msgs.size() << " us/msg, inflate "
+		<< dsec * 1e6 / msgs.size() << " us/msg" << std::endl;
+}
+
+int main(void)
+{
+	const int num = 100000;
+
+	std::vector<std::string> msgs;
+	size_t raw = 0;
+	for(int i=0; i < num; ++i) {
+		msgpack::sbuffer sbuf;
+		msgpack::pack(sbuf, make_record(i));
+		msgs.push_back(std::string(sbuf.data(), sbuf.size()));
+		raw += sbuf.size();
+	}
+	std::cout << num << " messages, " << (double)raw / num << " bytes/msg" << std::endl;
+
+	// a dictionary of sample messages which are not in the benchmark
+	std::string dict;
+	for(int i=0; i < 8; ++i) {
+		msgpack::sbuffer sbuf;
+		msgpack::pack(sbuf, make_record(num + i * 131));
+		dict.append(sbuf.data(), sbuf.size());
+	}
+
+	bench("fresh    ", msgs, FRESH, NULL);
+	bench("reset    ", msgs, RESET, NULL);
+	bench("dict     ", msgs, RESET, &dict);
+	bench("sync     ", msgs, SYNC, NULL);
+	bench("sync+dict", msgs, SYNC, &dict);
+
+	return 0;
+}
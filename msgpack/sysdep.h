@@ -46,6 +46,13 @@ typedef unsigned int _msgpack_atomic_counter_t;
 #endif
 
 
+#if defined(__GNUC__)
+#define _msgpack_prefetch(addr) __builtin_prefetch(addr)
+#else
+#define _msgpack_prefetch(addr) ((void)0)
+#endif
+
+
 #ifdef _WIN32
 #include <winsock2.h>
 
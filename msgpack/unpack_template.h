@@ -40,6 +40,18 @@
 #error msgpack_unpack_user type is not defined
 #endif
 
+#ifdef msgpack_unpack_limit
+#define limit_raw(len) \
+	if(msgpack_unpack_limit(_raw)(user, \
+		(const char*)p + 1 - data, len) < 0) { goto _failed; }
+#define limit_container(func, count_) \
+	if(msgpack_unpack_limit(func)(user, \
+		(const char*)p + 1 - data, count_, top + 1) < 0) { goto _failed; }
+#else
+#define limit_raw(len)
+#define limit_container(func, count_)
+#endif
+
 #ifndef USE_CASE_RANGE
 #if !defined(_MSC_VER)
 #define USE_CASE_RANGE
@@ -136,9 +148,16 @@ msgpack_unpack_func(int, _execute)(msgpack_unpack_struct(_context)* ctx, const c
 	if(trail == 0) { goto ifzero; } \
 	cs = _cs; \
 	goto _fixed_trail_again
+#define again_raw_trail(trail_len) \
+	trail = trail_len; \
+	limit_raw(trail); \
+	if(trail == 0) { goto _raw_zero; } \
+	cs = ACS_RAW_VALUE; \
+	goto _fixed_trail_again
 
 #define start_container(func, count_, ct_) \
 	if(top >= MSGPACK_EMBED_STACK_SIZE) { goto _failed; } /* FIXME */ \
+	limit_container(func, count_); \
 	if(msgpack_unpack_callback(func)(user, count_, &stack[top].obj) < 0) { goto _failed; } \
 	if((count_) == 0) { obj = stack[top].obj; goto _push; } \
 	stack[top].ct = ct_; \
@@ -235,7 +254,7 @@ msgpack_unpack_func(int, _execute)(msgpack_unpack_struct(_context)* ctx, const c
 					goto _failed;
 				}
 			SWITCH_RANGE(0xa0, 0xbf)  // FixRaw
-				again_fixed_trail_if_zero(ACS_RAW_VALUE, ((unsigned int)*p & 0x1f), _raw_zero);
+				again_raw_trail(((unsigned int)*p & 0x1f));
 			SWITCH_RANGE(0x90, 0x9f)  // FixArray
 				start_container(_array, ((unsigned int)*p) & 0x0f, CT_ARRAY_ITEM);
 			SWITCH_RANGE(0x80, 0x8f)  // FixMap
@@ -303,9 +322,9 @@ msgpack_unpack_func(int, _execute)(msgpack_unpack_struct(_context)* ctx, const c
 			//	push_variable_value(_big_float, data, n, trail);
 
 			case CS_RAW_16:
-				again_fixed_trail_if_zero(ACS_RAW_VALUE, _msgpack_load16(uint16_t,n), _raw_zero);
+				again_raw_trail(_msgpack_load16(uint16_t,n));
 			case CS_RAW_32:
-				again_fixed_trail_if_zero(ACS_RAW_VALUE, _msgpack_load32(uint32_t,n), _raw_zero);
+				again_raw_trail(_msgpack_load32(uint32_t,n));
 			case ACS_RAW_VALUE:
 			_raw_zero:
 				push_variable_value(_raw, data, n, trail);
@@ -313,13 +332,11 @@ msgpack_unpack_func(int, _execute)(msgpack_unpack_struct(_context)* ctx, const c
 			case CS_ARRAY_16:
 				start_container(_array, _msgpack_load16(uint16_t,n), CT_ARRAY_ITEM);
 			case CS_ARRAY_32:
-				/* FIXME security guard */
 				start_container(_array, _msgpack_load32(uint32_t,n), CT_ARRAY_ITEM);
 
 			case CS_MAP_16:
 				start_container(_map, _msgpack_load16(uint16_t,n), CT_MAP_KEY);
 			case CS_MAP_32:
-				/* FIXME security guard */
 				start_container(_map, _msgpack_load32(uint32_t,n), CT_MAP_KEY);
 
 			default:
@@ -397,13 +414,17 @@ _end:
 #undef msgpack_unpack_struct
 #undef msgpack_unpack_object
 #undef msgpack_unpack_user
+#undef msgpack_unpack_limit
 
 #undef push_simple_value
 #undef push_fixed_value
 #undef push_variable_value
 #undef again_fixed_trail
 #undef again_fixed_trail_if_zero
+#undef again_raw_trail
 #undef start_container
+#undef limit_raw
+#undef limit_container
 
 #undef NEXT_CS
 